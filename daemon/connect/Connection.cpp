@@ -23,13 +23,18 @@
 #include "Connection.h"
 #include "Log.h"
 #include "FileSystem.h"
+#include "Util.h"
 
 static const int CONNECTION_READBUFFER_SIZE = 1024;
+static const int CONNECT_ATTEMPT_DELAY_MSEC = 250;
+static const int CONNECT_CANCEL_CHECK_MSEC = 100;
+static const int HOST_CACHE_TTL = 300;
 #ifndef HAVE_GETADDRINFO
 #ifndef HAVE_GETHOSTBYNAME_R
 std::unique_ptr<Mutex> Connection::m_getHostByNameMutex;
 #endif
 #endif
+std::unique_ptr<HostCache> Connection::m_hostCache;
 
 #if defined(__linux__) && !defined(__ANDROID__)
 // Activate DNS resolving workaround for Android:
@@ -105,6 +110,8 @@ void Connection::Init()
 	m_getHostByNameMutex = std::make_unique<Mutex>();
 #endif
 #endif
+
+	m_hostCache = std::make_unique<HostCache>(HOST_CACHE_TTL);
 }
 
 void Connection::Final()
@@ -196,6 +203,9 @@ bool Connection::Disconnect()
 	m_status = csDisconnected;
 	m_socket = INVALID_SOCKET;
 	m_bufAvail = 0;
+#ifndef DISABLE_GZIP
+	CloseCompression();
+#endif
 
 	return res;
 }
@@ -412,10 +422,6 @@ char* Connection::ReadLine(char* buffer, int size, int* bytesReadOut)
 			{
 				break;
 			}
-			else
-			{
-				m_totalBytesRead += bufAvail;
-			}
 			bufPtr = m_readBuf;
 			m_readBuf[bufAvail] = '\0';
 		}
@@ -494,17 +500,19 @@ int Connection::TryRecv(char* buffer, int size)
 {
 	//debug("Receiving data");
 
-	memset(buffer, 0, size);
-
 	int received = recv(m_socket, buffer, size, 0);
 
-	if (received < 0)
+	if (received < 0 && !m_wouldBlock)
 	{
 		ReportError("Could not receive data on socket from %s", m_host, true);
 	}
 	else
 	{
-		m_totalBytesRead += received;
+		if (received < size)
+		{
+			// clearing whole buffer before receiving would be too expensive for large buffers
+			buffer[received] = '\0';
+		}
 	}
 
 	return received;
@@ -541,7 +549,6 @@ bool Connection::Recv(char * buffer, int size)
 		}
 		bufPtr += received;
 		NeedBytes -= received;
-		m_totalBytesRead += received;
 	}
 	return true;
 }
@@ -583,94 +590,46 @@ bool Connection::DoConnect()
 #endif
 	{
 #ifdef HAVE_GETADDRINFO
-		struct addrinfo addr_hints, *addr_list, *addr;
-
-		memset(&addr_hints, 0, sizeof(addr_hints));
-		addr_hints.ai_family = m_ipVersion == ipV4 ? AF_INET : m_ipVersion == ipV6 ? AF_INET6 : AF_UNSPEC;
-		addr_hints.ai_socktype = SOCK_STREAM;
-
-		BString<100> portStr("%d", m_port);
-
-		int res = getaddrinfo(m_host, portStr, &addr_hints, &addr_list);
-		debug("getaddrinfo for %s: %i", *m_host, res);
-
-#ifdef ANDROID_RESOLVE
-		if (res != 0)
-		{
-			CString resolvedHost = ResolveAndroidHost(m_host);
-			if (!resolvedHost.Empty())
-			{
-				res = getaddrinfo(resolvedHost, portStr, &addr_hints, &addr_list);
-			}
-		}
-#endif
+		int family = m_ipVersion == ipV4 ? AF_INET : m_ipVersion == ipV6 ? AF_INET6 : AF_UNSPEC;
 
-		if (res != 0)
+		HostCache::Addresses addresses;
+		bool cached = m_hostCache && m_hostCache->Get(m_host, m_port, family, addresses, Util::CurrentTime());
+		if (!cached)
 		{
-			ReportError("Could not resolve hostname %s", m_host, true
-#ifndef WIN32
-						, res != EAI_SYSTEM ? res : 0
-						, res != EAI_SYSTEM ? gai_strerror(res) : nullptr
-#endif
-						);
-			return false;
-		}
-
-		std::vector<SockAddr> triedAddr;
-		bool connected = false;
-
-		for (addr = addr_list; addr != nullptr; addr = addr->ai_next)
-		{
-			// don't try the same combinations of ai_family, ai_socktype, ai_protocol multiple times
-			SockAddr sa = { addr->ai_family, addr->ai_socktype, addr->ai_protocol };
-			if (std::find(triedAddr.begin(), triedAddr.end(), sa) != triedAddr.end())
+			if (!ResolveHost(family, addresses))
 			{
-				continue;
+				return false;
 			}
-			triedAddr.push_back(sa);
-
-			if (m_socket != INVALID_SOCKET)
+			if (m_hostCache)
 			{
-				closesocket(m_socket);
+				m_hostCache->Put(m_host, m_port, family, addresses, Util::CurrentTime());
 			}
+		}
 
-			m_socket = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
-#ifdef WIN32
-			SetHandleInformation((HANDLE)m_socket, HANDLE_FLAG_INHERIT, 0);
-#endif
-			if (m_socket == INVALID_SOCKET)
-			{
-				// try another addr/family/protocol
-				continue;
-			}
+		HostCache::SortAddresses(addresses,
+			m_hostCache ? m_hostCache->GetPreferredFamily(m_host, m_port, family) : AF_UNSPEC);
 
-			if (ConnectWithTimeout(addr->ai_addr, addr->ai_addrlen))
+		int connectedFamily;
+		if (!ConnectAny(addresses, &connectedFamily))
+		{
+			if (cached && !m_cancelled)
 			{
-				// Connection established
-				connected = true;
-				break;
+				// the host may have got new addresses, resolve again on next attempt
+				m_hostCache->Invalidate(m_host, m_port, family);
 			}
+			return false;
 		}
 
-		if (m_socket == INVALID_SOCKET && addr_list)
-		{
-			ReportError("Socket creation failed for %s", m_host, true);
-		}
-
-		if (!connected && m_socket != INVALID_SOCKET)
+		if (m_hostCache)
 		{
-			ReportError("Connection to %s failed", m_host, true);
-			closesocket(m_socket);
-			m_socket = INVALID_SOCKET;
+			m_hostCache->SetPreferredFamily(m_host, m_port, family, connectedFamily);
 		}
 
-		freeaddrinfo(addr_list);
-
-		if (m_socket == INVALID_SOCKET)
+		if (m_cancelled)
 		{
+			// cancelled just before the socket was published
 			return false;
 		}
-
 #else
 
 		struct sockaddr_in	sSocketAddress;
@@ -715,6 +674,271 @@ bool Connection::DoConnect()
 	return true;
 }
 
+#ifdef HAVE_GETADDRINFO
+bool Connection::ResolveHost(int family, HostCache::Addresses& addresses)
+{
+	struct addrinfo addr_hints, *addr_list, *addr;
+
+	memset(&addr_hints, 0, sizeof(addr_hints));
+	addr_hints.ai_family = family;
+	addr_hints.ai_socktype = SOCK_STREAM;
+
+	BString<100> portStr("%d", m_port);
+
+	int res = getaddrinfo(m_host, portStr, &addr_hints, &addr_list);
+	debug("getaddrinfo for %s: %i", *m_host, res);
+
+#ifdef ANDROID_RESOLVE
+	if (res != 0)
+	{
+		CString resolvedHost = ResolveAndroidHost(m_host);
+		if (!resolvedHost.Empty())
+		{
+			res = getaddrinfo(resolvedHost, portStr, &addr_hints, &addr_list);
+		}
+	}
+#endif
+
+	if (res != 0)
+	{
+		ReportError("Could not resolve hostname %s", m_host, true
+#ifndef WIN32
+					, res != EAI_SYSTEM ? res : 0
+					, res != EAI_SYSTEM ? gai_strerror(res) : nullptr
+#endif
+					);
+		return false;
+	}
+
+	for (addr = addr_list; addr != nullptr; addr = addr->ai_next)
+	{
+		HostCache::Address address;
+		memset(&address, 0, sizeof(address));
+		address.family = addr->ai_family;
+		address.socktype = addr->ai_socktype;
+		address.protocol = addr->ai_protocol;
+		address.addrLen = (socklen_t)std::min((size_t)addr->ai_addrlen, sizeof(address.addr));
+		memcpy(&address.addr, addr->ai_addr, address.addrLen);
+
+		// don't try the same address multiple times
+		if (std::find_if(addresses.begin(), addresses.end(),
+			[&address](HostCache::Address& other)
+			{
+				return other.addrLen == address.addrLen && !memcmp(&other.addr, &address.addr, address.addrLen);
+			}) == addresses.end())
+		{
+			addresses.push_back(address);
+		}
+	}
+
+	freeaddrinfo(addr_list);
+
+	return true;
+}
+
+/*
+ * Connects to the first responding address. The connection attempts are started one after
+ * another with a short delay, without waiting for the previous attempts to fail. An address
+ * family which doesn't work therefore doesn't cost the full connect timeout on each
+ * connect ("happy eyeballs", RFC 8305).
+ */
+bool Connection::ConnectAny(HostCache::Addresses& addresses, int* family)
+{
+	struct Attempt
+	{
+		SOCKET socket;
+		int family;
+	};
+	typedef std::vector<Attempt> Attempts;
+
+	Attempts attempts;
+	SOCKET connected = INVALID_SOCKET;
+	bool socketCreated = false;
+	int lastError = 0;
+	uint32 next = 0;
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point deadline = now + std::chrono::seconds(m_timeout);
+	std::chrono::steady_clock::time_point nextStart = now;
+
+	while (connected == INVALID_SOCKET && (next < addresses.size() || !attempts.empty()))
+	{
+		if (m_cancelled)
+		{
+#ifdef WIN32
+			lastError = WSAECANCELLED;
+#else
+			lastError = ECANCELED;
+#endif
+			break;
+		}
+
+		if (next < addresses.size() && now >= nextStart)
+		{
+			// start next attempt
+			HostCache::Address& address = addresses[next++];
+			SOCKET sock = socket(address.family, address.socktype, address.protocol);
+			if (sock == INVALID_SOCKET)
+			{
+#ifdef WIN32
+				lastError = WSAGetLastError();
+#else
+				lastError = errno;
+#endif
+				continue;
+			}
+			socketCreated = true;
+#ifdef WIN32
+			SetHandleInformation((HANDLE)sock, HANDLE_FLAG_INHERIT, 0);
+			u_long mode = 1;
+			bool nonBlocking = ioctlsocket(sock, FIONBIO, &mode) == 0;
+#else
+			bool nonBlocking = fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK) == 0;
+#endif
+
+			int ret = nonBlocking ? connect(sock, (struct sockaddr*)&address.addr, address.addrLen) : -1;
+			if (ret == 0)
+			{
+				connected = sock;
+				*family = address.family;
+				break;
+			}
+
+#ifdef WIN32
+			int err = WSAGetLastError();
+			bool inProgress = nonBlocking && err == WSAEWOULDBLOCK;
+#else
+			int err = errno;
+			bool inProgress = nonBlocking && err == EINPROGRESS;
+#endif
+			if (!inProgress)
+			{
+				lastError = err;
+				closesocket(sock);
+				continue;
+			}
+
+			attempts.push_back({sock, address.family});
+			nextStart = now + std::chrono::milliseconds(CONNECT_ATTEMPT_DELAY_MSEC);
+		}
+
+		if (attempts.empty())
+		{
+			now = std::chrono::steady_clock::now();
+			continue;
+		}
+
+		// wait until one of the attempts completes or the next attempt is due,
+		// waking up regularly to check if the connecting was cancelled
+		std::chrono::steady_clock::time_point waitUntil = now + std::chrono::milliseconds(CONNECT_CANCEL_CHECK_MSEC);
+		if (next < addresses.size())
+		{
+			waitUntil = std::min(waitUntil, nextStart);
+		}
+		if (m_timeout > 0)
+		{
+			waitUntil = std::min(waitUntil, deadline);
+		}
+		int waitMsec = (int)std::max((int64)0, (int64)std::chrono::duration_cast<std::chrono::milliseconds>(
+			waitUntil - now).count());
+		struct timeval tv;
+		tv.tv_sec = waitMsec / 1000;
+		tv.tv_usec = (waitMsec % 1000) * 1000;
+
+		fd_set wset, eset;
+		FD_ZERO(&wset);
+		SOCKET maxSocket = 0;
+		for (Attempt& attempt : attempts)
+		{
+			FD_SET(attempt.socket, &wset);
+			maxSocket = std::max(maxSocket, attempt.socket);
+		}
+		eset = wset;
+
+		int ret = select((int)maxSocket + 1, nullptr, &wset, &eset, &tv);
+		now = std::chrono::steady_clock::now();
+		if (ret < 0)
+		{
+#ifdef WIN32
+			lastError = WSAGetLastError();
+#else
+			lastError = errno;
+#endif
+			break;
+		}
+
+		for (Attempts::iterator it = attempts.begin(); it != attempts.end(); )
+		{
+			Attempt& attempt = *it;
+			if (!FD_ISSET(attempt.socket, &wset) && !FD_ISSET(attempt.socket, &eset))
+			{
+				it++;
+				continue;
+			}
+
+			int error = 0;
+			socklen_t len = sizeof(error);
+			if (getsockopt(attempt.socket, SOL_SOCKET, SO_ERROR, (char*)&error, &len) == 0 && error == 0)
+			{
+				connected = attempt.socket;
+				*family = attempt.family;
+				attempts.erase(it);
+				break;
+			}
+
+			// the attempt failed, the next one doesn't need to wait
+			lastError = error;
+			closesocket(attempt.socket);
+			it = attempts.erase(it);
+			nextStart = now;
+		}
+
+		if (connected == INVALID_SOCKET && m_timeout > 0 && now >= deadline)
+		{
+#ifdef WIN32
+			lastError = WSAETIMEDOUT;
+#else
+			lastError = ETIMEDOUT;
+#endif
+			break;
+		}
+	}
+
+	for (Attempt& attempt : attempts)
+	{
+		closesocket(attempt.socket);
+	}
+
+	if (connected == INVALID_SOCKET)
+	{
+#ifdef WIN32
+		WSASetLastError(lastError);
+#else
+		errno = lastError;
+#endif
+		ReportError(socketCreated || m_cancelled ? "Connection to %s failed" : "Socket creation failed for %s",
+			m_host, true);
+		return false;
+	}
+
+	// put socket back in blocking mode
+#ifdef WIN32
+	u_long mode = 0;
+	if (ioctlsocket(connected, FIONBIO, &mode) != 0)
+#else
+	if (fcntl(connected, F_SETFL, fcntl(connected, F_GETFL, 0) & ~O_NONBLOCK) < 0)
+#endif
+	{
+		ReportError("Socket initialization failed for %s", m_host, true);
+		closesocket(connected);
+		return false;
+	}
+
+	m_socket = connected;
+	return true;
+}
+#endif
+
 bool Connection::InitSocketOpts(SOCKET socket)
 {
 	char* optbuf = nullptr;
@@ -884,6 +1108,8 @@ bool Connection::DoDisconnect()
 		m_socket = INVALID_SOCKET;
 	}
 
+	m_nonBlocking = false;
+	m_cancelled = false;
 	m_status = csDisconnected;
 	return true;
 }
@@ -895,9 +1121,82 @@ void Connection::ReadBuffer(char** buffer, int *bufLen)
 	m_bufAvail = 0;
 };
 
+/*
+ * Puts the data back into the read buffer, the data must be read after all data
+ * obtained from ReadBuffer() was processed.
+ */
+void Connection::UnreadBuffer(const char* buffer, int bufLen)
+{
+	if (m_readBuf.Size() < bufLen + 1)
+	{
+		m_readBuf.Reserve(bufLen + 1);
+	}
+	memmove(m_readBuf, buffer, bufLen);
+	m_readBuf[bufLen] = '\0';
+	m_bufPtr = m_readBuf;
+	m_bufAvail = bufLen;
+}
+
+/*
+ * Checks if there is already received data which can be read without waiting for the socket:
+ * either in the internal read buffer or in the buffer of TLS layer.
+ */
+bool Connection::HasPendingData()
+{
+	if (m_bufAvail > 0)
+	{
+		return true;
+	}
+#ifndef DISABLE_TLS
+	if (m_tlsSocket && m_tlsSocket->Pending() > 0)
+	{
+		return true;
+	}
+#endif
+#ifndef DISABLE_GZIP
+	if (m_inflateStream && (m_inflateStream->avail_in > 0 || m_inflatePending))
+	{
+		return true;
+	}
+#endif
+	return false;
+}
+
+/*
+ * In non-blocking mode TryRecv() returns immediately if there is no data to read yet,
+ * this case is reported by GetWouldBlock().
+ */
+bool Connection::SetNonBlocking(bool nonBlocking)
+{
+#ifdef WIN32
+	u_long mode = nonBlocking ? 1 : 0;
+	if (ioctlsocket(m_socket, FIONBIO, &mode) != 0)
+	{
+		return false;
+	}
+#else
+	int flags = fcntl(m_socket, F_GETFL, 0);
+	if (flags < 0 || fcntl(m_socket, F_SETFL, nonBlocking ? flags | O_NONBLOCK : flags & ~O_NONBLOCK) < 0)
+	{
+		return false;
+	}
+#endif
+
+	m_nonBlocking = nonBlocking;
+#ifndef DISABLE_TLS
+	if (m_tlsSocket)
+	{
+		m_tlsSocket->SetNonBlocking(nonBlocking);
+	}
+#endif
+
+	return true;
+}
+
 void Connection::Cancel()
 {
 	debug("Cancelling connection");
+	m_cancelled = true;
 	if (m_socket != INVALID_SOCKET)
 	{
 		m_status = csCancelled;
@@ -984,6 +1283,7 @@ bool Connection::StartTls(bool isClient, const char* certFile, const char* keyFi
 
 	m_tlsSocket = std::make_unique<ConTlsSocket>(m_socket, isClient, m_host, certFile, keyFile, m_cipher, this);
 	m_tlsSocket->SetSuppressErrors(m_suppressErrors);
+	m_tlsSocket->SetSessionCache(m_tlsSessionCache);
 
 	return m_tlsSocket->Start();
 }
@@ -996,36 +1296,73 @@ void Connection::CloseTls()
 		m_tlsSocket.reset();
 	}
 }
+#endif
 
 int Connection::recv(SOCKET s, char* buf, int len, int flags)
+{
+#ifndef DISABLE_GZIP
+	if (m_inflateStream)
+	{
+		return InflateRecv(buf, len);
+	}
+#endif
+	return RawRecv(s, buf, len, flags);
+}
+
+int Connection::send(SOCKET s, const char* buf, int len, int flags)
+{
+#ifndef DISABLE_GZIP
+	if (m_deflateStream)
+	{
+		return DeflateSend(buf, len);
+	}
+#endif
+	return RawSend(s, buf, len, flags);
+}
+
+int Connection::RawRecv(SOCKET s, char* buf, int len, int flags)
 {
 	int received = 0;
+	m_wouldBlock = false;
 
+#ifndef DISABLE_TLS
 	if (m_tlsSocket)
 	{
 		m_tlsError = false;
 		received = m_tlsSocket->Recv(buf, len);
 		if (received < 0)
 		{
-			m_tlsError = true;
+			m_wouldBlock = m_tlsSocket->GetWouldBlock();
+			m_tlsError = !m_wouldBlock;
 			return -1;
 		}
 	}
 	else
+#endif
 	{
 		received = ::recv(s, buf, len, flags);
+#ifdef WIN32
+		m_wouldBlock = received < 0 && m_nonBlocking && WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+		m_wouldBlock = received < 0 && m_nonBlocking && (errno == EAGAIN || errno == EWOULDBLOCK);
+#endif
 	}
+
+	if (received > 0)
+	{
+		m_totalBytesRead += received;
+	}
+
 	return received;
 }
 
-int Connection::send(SOCKET s, const char* buf, int len, int flags)
+int Connection::RawSend(SOCKET s, const char* buf, int len, int flags)
 {
-	int sent = 0;
-
+#ifndef DISABLE_TLS
 	if (m_tlsSocket)
 	{
 		m_tlsError = false;
-		sent = m_tlsSocket->Send(buf, len);
+		int sent = m_tlsSocket->Send(buf, len);
 		if (sent < 0)
 		{
 			m_tlsError = true;
@@ -1033,11 +1370,153 @@ int Connection::send(SOCKET s, const char* buf, int len, int flags)
 		}
 		return sent;
 	}
-	else
+#endif
+
+	return ::send(s, buf, len, flags);
+}
+
+#ifndef DISABLE_GZIP
+/*
+ * Activates compression of the connection (NNTP COMPRESS DEFLATE, RFC 8054): from now on
+ * the data is transmitted as raw deflate stream in both directions. Must be called
+ * right after the compression was negotiated, with no compressed data sent yet.
+ */
+bool Connection::StartCompression()
+{
+	debug("Starting compression");
+
+	m_inflateStream = std::make_unique<z_stream>();
+	m_deflateStream = std::make_unique<z_stream>();
+
+	if (inflateInit2(m_inflateStream.get(), -MAX_WBITS) != Z_OK)
 	{
-		sent = ::send(s, buf, len, flags);
-		return sent;
+		m_inflateStream.reset();
+		m_deflateStream.reset();
+		ReportError("Could not start compression for %s", m_host, false);
+		return false;
 	}
+
+	if (deflateInit2(m_deflateStream.get(), Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS,
+		MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		m_deflateStream.reset();
+		CloseCompression();
+		ReportError("Could not start compression for %s", m_host, false);
+		return false;
+	}
+
+	m_inflateBuf.Reserve(CONNECTION_READBUFFER_SIZE * 64);
+	m_deflateBuf.Reserve(CONNECTION_READBUFFER_SIZE * 64);
+	m_inflatePending = false;
+
+	// data already received must be decompressed too
+	if (m_bufAvail > 0)
+	{
+		if (m_inflateBuf.Size() < m_bufAvail)
+		{
+			m_inflateBuf.Reserve(m_bufAvail);
+		}
+		memcpy(m_inflateBuf, m_bufPtr, m_bufAvail);
+		m_inflateStream->next_in = (Bytef*)(char*)m_inflateBuf;
+		m_inflateStream->avail_in = m_bufAvail;
+		m_bufAvail = 0;
+	}
+
+	return true;
+}
+
+void Connection::CloseCompression()
+{
+	if (m_inflateStream)
+	{
+		inflateEnd(m_inflateStream.get());
+		m_inflateStream.reset();
+	}
+	if (m_deflateStream)
+	{
+		deflateEnd(m_deflateStream.get());
+		m_deflateStream.reset();
+	}
+	m_inflatePending = false;
+}
+
+/*
+ * Receives compressed data and returns decompressed data. Waits for the socket only if no
+ * decompressed data can be produced from the data received earlier.
+ */
+int Connection::InflateRecv(char* buf, int len)
+{
+	z_stream* stream = m_inflateStream.get();
+	stream->next_out = (Bytef*)buf;
+	stream->avail_out = len;
+
+	while (true)
+	{
+		if (stream->avail_in == 0 && !m_inflatePending)
+		{
+			int received = RawRecv(m_socket, m_inflateBuf, m_inflateBuf.Size(), 0);
+			if (received <= 0)
+			{
+				return received;
+			}
+			stream->next_in = (Bytef*)(char*)m_inflateBuf;
+			stream->avail_in = received;
+		}
+
+		int ret = inflate(stream, Z_SYNC_FLUSH);
+		if (ret != Z_OK && ret != Z_BUF_ERROR)
+		{
+			ReportError("Could not decompress data received from %s", m_host, false);
+			return -1;
+		}
+
+		int produced = len - stream->avail_out;
+		// the output buffer is full, more output may be pending within the stream;
+		// it's then reported by HasPendingData() even if it turns out to be empty
+		m_inflatePending = stream->avail_out == 0;
+		if (produced > 0)
+		{
+			m_uncompressedBytesRead += produced;
+			return produced;
+		}
+	}
+}
+
+int Connection::DeflateSend(const char* buf, int len)
+{
+	z_stream* stream = m_deflateStream.get();
+	stream->next_in = (Bytef*)buf;
+	stream->avail_in = len;
+
+	do
+	{
+		stream->next_out = (Bytef*)(char*)m_deflateBuf;
+		stream->avail_out = m_deflateBuf.Size();
+		if (deflate(stream, Z_SYNC_FLUSH) == Z_STREAM_ERROR)
+		{
+			return -1;
+		}
+
+		int size = m_deflateBuf.Size() - stream->avail_out;
+		for (int sent = 0; sent < size; )
+		{
+			int res = RawSend(m_socket, m_deflateBuf + sent, size - sent, 0);
+			if (res <= 0)
+			{
+				return -1;
+			}
+			sent += res;
+		}
+	} while (stream->avail_out == 0);
+
+	return len;
+}
+
+int Connection::FetchUncompressedBytesRead()
+{
+	int total = m_uncompressedBytesRead;
+	m_uncompressedBytesRead = 0;
+	return total;
 }
 #endif
 
@@ -23,6 +23,7 @@
 #define CONNECTION_H
 
 #include "NString.h"
+#include "HostCache.h"
 
 #ifndef HAVE_GETADDRINFO
 #ifndef HAVE_GETHOSTBYNAME_R
@@ -65,6 +66,10 @@ public:
 	int TryRecv(char* buffer, int size);
 	char* ReadLine(char* buffer, int size, int* bytesRead);
 	void ReadBuffer(char** buffer, int *bufLen);
+	void UnreadBuffer(const char* buffer, int bufLen);
+	bool HasPendingData();
+	bool SetNonBlocking(bool nonBlocking);
+	bool GetWouldBlock() { return m_wouldBlock; }
 	int WriteLine(const char* buffer);
 	std::unique_ptr<Connection> Accept();
 	void Cancel();
@@ -76,6 +81,7 @@ public:
 	void SetTimeout(int timeout) { m_timeout = timeout; }
 	void SetIPVersion(EIPVersion ipVersion) { m_ipVersion = ipVersion; }
 	EStatus GetStatus() { return m_status; }
+	SOCKET GetSocket() { return m_socket; }
 	void SetSuppressErrors(bool suppressErrors);
 	bool GetSuppressErrors() { return m_suppressErrors; }
 	const char* GetRemoteAddr();
@@ -84,6 +90,12 @@ public:
 	void SetForceClose(bool forceClose) { m_forceClose = forceClose; }
 #ifndef DISABLE_TLS
 	bool StartTls(bool isClient, const char* certFile, const char* keyFile);
+	void SetTlsSessionCache(TlsSessionCache* tlsSessionCache) { m_tlsSessionCache = tlsSessionCache; }
+#endif
+#ifndef DISABLE_GZIP
+	bool StartCompression();
+	bool GetCompression() { return (bool)m_inflateStream; }
+	int FetchUncompressedBytesRead();
 #endif
 	int FetchTotalBytesRead();
 
@@ -104,6 +116,10 @@ protected:
 	int m_totalBytesRead = 0;
 	bool m_gracefull = false;
 	bool m_forceClose = false;
+	bool m_nonBlocking = false;
+	bool m_wouldBlock = false;
+	// set by Cancel(), also while there is no socket yet because the connecting is in progress
+	std::atomic<bool> m_cancelled{false};
 
 	struct SockAddr
 	{
@@ -128,13 +144,24 @@ protected:
 	};
 
 	std::unique_ptr<ConTlsSocket> m_tlsSocket;
+	TlsSessionCache* m_tlsSessionCache = nullptr;
 	bool m_tlsError = false;
 #endif
+#ifndef DISABLE_GZIP
+	std::unique_ptr<z_stream> m_inflateStream;
+	std::unique_ptr<z_stream> m_deflateStream;
+	// separate buffers: received data may still wait for inflating when sending
+	CharBuffer m_inflateBuf;
+	CharBuffer m_deflateBuf;
+	bool m_inflatePending = false;
+	int m_uncompressedBytesRead = 0;
+#endif
 #ifndef HAVE_GETADDRINFO
 #ifndef HAVE_GETHOSTBYNAME_R
 	static std::unique_ptr<Mutex> m_getHostByNameMutex;
 #endif
 #endif
+	static std::unique_ptr<HostCache> m_hostCache;
 
 	void ReportError(const char* msgPrefix, const char* msgArg, bool PrintErrCode, int herrno = 0,
 		const char* herrMsg = nullptr);
@@ -143,14 +170,24 @@ protected:
 	bool DoDisconnect();
 	bool InitSocketOpts(SOCKET socket);
 	bool ConnectWithTimeout(void* address, int address_len);
-#ifndef HAVE_GETADDRINFO
+#ifdef HAVE_GETADDRINFO
+	bool ResolveHost(int family, HostCache::Addresses& addresses);
+	bool ConnectAny(HostCache::Addresses& addresses, int* family);
+#else
 	in_addr_t ResolveHostAddr(const char* host);
 #endif
-#ifndef DISABLE_TLS
 	int recv(SOCKET s, char* buf, int len, int flags);
 	int send(SOCKET s, const char* buf, int len, int flags);
+	int RawRecv(SOCKET s, char* buf, int len, int flags);
+	int RawSend(SOCKET s, const char* buf, int len, int flags);
+#ifndef DISABLE_TLS
 	void CloseTls();
 #endif
+#ifndef DISABLE_GZIP
+	int InflateRecv(char* buf, int len);
+	int DeflateSend(const char* buf, int len);
+	void CloseCompression();
+#endif
 };
 
 #endif
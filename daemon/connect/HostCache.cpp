@@ -0,0 +1,134 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "nzbget.h"
+#include "HostCache.h"
+
+bool HostCache::Get(const char* host, int port, int family, Addresses& addresses, time_t curTime)
+{
+	Guard guard(m_mutex);
+
+	Entry* entry = FindEntry(host, port, family);
+	if (!entry || entry->addresses.empty() || entry->expireTime <= curTime)
+	{
+		return false;
+	}
+
+	addresses = entry->addresses;
+	return true;
+}
+
+void HostCache::Put(const char* host, int port, int family, const Addresses& addresses, time_t curTime)
+{
+	Guard guard(m_mutex);
+
+	Entry* entry = FindEntry(host, port, family);
+	if (!entry)
+	{
+		m_entries.push_back({host, port, family, {}, 0, AF_UNSPEC});
+		entry = &m_entries.back();
+	}
+
+	entry->addresses = addresses;
+	entry->expireTime = curTime + m_ttl;
+}
+
+void HostCache::Invalidate(const char* host, int port, int family)
+{
+	Guard guard(m_mutex);
+
+	Entry* entry = FindEntry(host, port, family);
+	if (entry)
+	{
+		entry->addresses.clear();
+	}
+}
+
+int HostCache::GetPreferredFamily(const char* host, int port, int family)
+{
+	Guard guard(m_mutex);
+
+	Entry* entry = FindEntry(host, port, family);
+	return entry ? entry->preferredFamily : AF_UNSPEC;
+}
+
+void HostCache::SetPreferredFamily(const char* host, int port, int family, int preferredFamily)
+{
+	Guard guard(m_mutex);
+
+	Entry* entry = FindEntry(host, port, family);
+	if (entry)
+	{
+		entry->preferredFamily = preferredFamily;
+	}
+}
+
+HostCache::Entry* HostCache::FindEntry(const char* host, int port, int family)
+{
+	for (Entry& entry : m_entries)
+	{
+		if (entry.port == port && entry.family == family && !strcmp(entry.host, host))
+		{
+			return &entry;
+		}
+	}
+	return nullptr;
+}
+
+/*
+ * Orders the addresses for connection attempts: the address families alternate,
+ * starting with the preferred family or with the family of the first address
+ * returned by resolver (RFC 8305, section 4).
+ */
+void HostCache::SortAddresses(Addresses& addresses, int preferredFamily)
+{
+	if (addresses.empty())
+	{
+		return;
+	}
+
+	int firstFamily = preferredFamily;
+	if (std::find_if(addresses.begin(), addresses.end(),
+		[firstFamily](Address& address) { return address.family == firstFamily; }) == addresses.end())
+	{
+		firstFamily = addresses.front().family;
+	}
+
+	Addresses first;
+	Addresses other;
+	for (Address& address : addresses)
+	{
+		(address.family == firstFamily ? first : other).push_back(address);
+	}
+
+	addresses.clear();
+	for (uint32 i = 0; i < first.size() || i < other.size(); i++)
+	{
+		if (i < first.size())
+		{
+			addresses.push_back(first[i]);
+		}
+		if (i < other.size())
+		{
+			addresses.push_back(other[i]);
+		}
+	}
+}
@@ -0,0 +1,75 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef HOSTCACHE_H
+#define HOSTCACHE_H
+
+#include "NString.h"
+#include "Thread.h"
+
+/*
+ * Keeps resolved addresses of hosts for a few minutes, so that many connections to the
+ * same news server don't query DNS each time. Also remembers the address family of
+ * the last successful connection to each host, its addresses are tried first next time.
+ */
+class HostCache
+{
+public:
+	struct Address
+	{
+		int family;
+		int socktype;
+		int protocol;
+		sockaddr_storage addr;
+		socklen_t addrLen;
+	};
+
+	typedef std::vector<Address> Addresses;
+
+	HostCache(int ttl) : m_ttl(ttl) {}
+	bool Get(const char* host, int port, int family, Addresses& addresses, time_t curTime);
+	void Put(const char* host, int port, int family, const Addresses& addresses, time_t curTime);
+	void Invalidate(const char* host, int port, int family);
+	int GetPreferredFamily(const char* host, int port, int family);
+	void SetPreferredFamily(const char* host, int port, int family, int preferredFamily);
+	static void SortAddresses(Addresses& addresses, int preferredFamily);
+
+private:
+	struct Entry
+	{
+		CString host;
+		int port;
+		int family;
+		Addresses addresses;
+		time_t expireTime;
+		int preferredFamily;
+	};
+
+	typedef std::vector<Entry> Entries;
+
+	int m_ttl;
+	Entries m_entries;
+	Mutex m_mutex;
+
+	Entry* FindEntry(const char* host, int port, int family);
+};
+
+#endif
@@ -0,0 +1,59 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "nzbget.h"
+#include "TlsSessionCache.h"
+
+static const int MAX_SESSIONS = 32;
+
+bool TlsSessionCache::Take(SessionData& data)
+{
+	Guard guard(m_mutex);
+
+	if (m_sessions.empty())
+	{
+		return false;
+	}
+
+	data = std::move(m_sessions.back());
+	m_sessions.pop_back();
+	return true;
+}
+
+void TlsSessionCache::Put(SessionData data)
+{
+	Guard guard(m_mutex);
+
+	m_sessions.push_back(std::move(data));
+	if ((int)m_sessions.size() > MAX_SESSIONS)
+	{
+		m_sessions.pop_front();
+	}
+}
+
+void TlsSessionCache::AddHandshake(bool resumed)
+{
+	m_handshakes++;
+	if (resumed)
+	{
+		m_resumed++;
+	}
+}
@@ -0,0 +1,53 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef TLSSESSIONCACHE_H
+#define TLSSESSIONCACHE_H
+
+#include "Thread.h"
+
+/*
+ * Keeps TLS sessions (session ids or tickets) of one server to resume them on reconnect
+ * instead of making a full handshake. Each stored session is given out only once
+ * since TLS 1.3 tickets should not be reused; a connection puts its session back
+ * after the handshake (or once it has received a new ticket).
+ */
+class TlsSessionCache
+{
+public:
+	typedef std::vector<uint8> SessionData;
+
+	bool Take(SessionData& data);
+	void Put(SessionData data);
+	void AddHandshake(bool resumed);
+	int GetHandshakes() { return m_handshakes; }
+	int GetResumed() { return m_resumed; }
+
+private:
+	typedef std::deque<SessionData> Sessions;
+
+	Mutex m_mutex;
+	Sessions m_sessions;
+	std::atomic<int> m_handshakes{0};
+	std::atomic<int> m_resumed{0};
+};
+
+#endif
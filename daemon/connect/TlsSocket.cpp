@@ -31,6 +31,9 @@
 CString TlsSocket::m_certStore;
 
 #ifdef HAVE_LIBGNUTLS
+// key for session tickets issued in server mode, shared by all connections
+static gnutls_datum_t g_TicketKey = {nullptr, 0};
+
 #ifdef NEED_GCRYPT_LOCKING
 
 /**
@@ -158,6 +161,11 @@ void TlsSocket::Init()
 		return;
 	}
 
+	if (gnutls_session_ticket_key_generate(&g_TicketKey) != 0)
+	{
+		debug("Could not generate TLS session ticket key");
+	}
+
 #endif /* HAVE_LIBGNUTLS */
 
 #ifdef HAVE_OPENSSL
@@ -184,6 +192,11 @@ void TlsSocket::Init()
 void TlsSocket::Final()
 {
 #ifdef HAVE_LIBGNUTLS
+	if (g_TicketKey.data)
+	{
+		gnutls_free(g_TicketKey.data);
+		g_TicketKey = {nullptr, 0};
+	}
 	gnutls_global_deinit();
 #endif /* HAVE_LIBGNUTLS */
 
@@ -318,7 +331,7 @@ bool TlsSocket::Start()
 		return false;
 	}
 
-	if (m_host)
+	if (m_isClient && m_host)
 	{
 		m_retCode = gnutls_server_name_set((gnutls_session_t)m_session, GNUTLS_NAME_DNS, m_host, m_host.Length());
 		if (m_retCode != 0)
@@ -338,6 +351,15 @@ bool TlsSocket::Start()
 		return false;
 	}
 
+	if (m_isClient && m_sessionCache)
+	{
+		ResumeSession();
+	}
+	else if (!m_isClient && g_TicketKey.data)
+	{
+		gnutls_session_ticket_enable_server((gnutls_session_t)m_session, &g_TicketKey);
+	}
+
 	gnutls_transport_set_ptr((gnutls_session_t)m_session, (gnutls_transport_ptr_t)(size_t)m_socket);
 
 	m_retCode = gnutls_handshake((gnutls_session_t)m_session);
@@ -354,6 +376,12 @@ bool TlsSocket::Start()
 		return false;
 	}
 
+	if (m_isClient && m_sessionCache)
+	{
+		m_sessionCache->AddHandshake(gnutls_session_is_resumed((gnutls_session_t)m_session) != 0);
+		StoreSession();
+	}
+
 	m_connected = true;
 	return true;
 #endif /* HAVE_LIBGNUTLS */
@@ -448,6 +476,11 @@ bool TlsSocket::Start()
 		return false;
 	}
 
+	if (m_isClient && m_sessionCache)
+	{
+		ResumeSession();
+	}
+
 	int error_code = m_isClient ? SSL_connect((SSL*)m_session) : SSL_accept((SSL*)m_session);
 	if (error_code < 1)
 	{
@@ -472,11 +505,96 @@ bool TlsSocket::Start()
 		return false;
 	}
 
+	if (m_isClient && m_sessionCache)
+	{
+		m_sessionCache->AddHandshake(SSL_session_reused((SSL*)m_session) != 0);
+		StoreSession();
+	}
+
 	m_connected = true;
 	return true;
 #endif /* HAVE_OPENSSL */
 }
 
+/*
+ * Sets a session from the cache to be resumed during the handshake.
+ */
+void TlsSocket::ResumeSession()
+{
+	TlsSessionCache::SessionData data;
+	if (!m_sessionCache->Take(data))
+	{
+		return;
+	}
+
+#ifdef HAVE_LIBGNUTLS
+	m_retCode = gnutls_session_set_data((gnutls_session_t)m_session, data.data(), data.size());
+	if (m_retCode != 0)
+	{
+		debug("Could not resume TLS session for %s: %s", *m_host, gnutls_strerror(m_retCode));
+	}
+#endif /* HAVE_LIBGNUTLS */
+
+#ifdef HAVE_OPENSSL
+	const uint8* ptr = data.data();
+	SSL_SESSION* session = d2i_SSL_SESSION(nullptr, &ptr, (long)data.size());
+	if (session)
+	{
+		SSL_set_session((SSL*)m_session, session);
+		SSL_SESSION_free(session);
+	}
+#endif /* HAVE_OPENSSL */
+}
+
+/*
+ * Puts the session into the cache once it can be resumed. With TLS 1.3 this is
+ * the case only after the server has sent a session ticket, which happens after
+ * the handshake, therefore the method is also called on receiving of data.
+ */
+void TlsSocket::StoreSession()
+{
+#ifdef HAVE_LIBGNUTLS
+	gnutls_session_t session = (gnutls_session_t)m_session;
+#if GNUTLS_VERSION_NUMBER >= 0x030603
+	if (gnutls_protocol_get_version(session) == GNUTLS_TLS1_3 &&
+		!(gnutls_session_get_flags(session) & GNUTLS_SFLAGS_SESSION_TICKET))
+	{
+		return;
+	}
+#endif
+
+	gnutls_datum_t data;
+	if (gnutls_session_get_data2(session, &data) == 0)
+	{
+		m_sessionCache->Put(TlsSessionCache::SessionData(data.data, data.data + data.size));
+		gnutls_free(data.data);
+	}
+#endif /* HAVE_LIBGNUTLS */
+
+#ifdef HAVE_OPENSSL
+	SSL_SESSION* session = SSL_get_session((SSL*)m_session);
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L && !defined(LIBRESSL_VERSION_NUMBER)
+	if (!session || !SSL_SESSION_is_resumable(session))
+#else
+	if (!session)
+#endif
+	{
+		return;
+	}
+
+	int len = i2d_SSL_SESSION(session, nullptr);
+	if (len > 0)
+	{
+		TlsSessionCache::SessionData data(len);
+		uint8* ptr = data.data();
+		i2d_SSL_SESSION(session, &ptr);
+		m_sessionCache->Put(std::move(data));
+	}
+#endif /* HAVE_OPENSSL */
+
+	m_sessionStored = true;
+}
+
 bool TlsSocket::ValidateCert()
 {
 #ifdef HAVE_LIBGNUTLS
@@ -668,13 +786,49 @@ int TlsSocket::Send(const char* buffer, int size)
 int TlsSocket::Recv(char* buffer, int size)
 {
 #ifdef HAVE_LIBGNUTLS
-	m_retCode = gnutls_record_recv((gnutls_session_t)m_session, buffer, size);
+	while (true)
+	{
+#ifdef WIN32
+		WSASetLastError(0);
+		m_retCode = gnutls_record_recv((gnutls_session_t)m_session, buffer, size);
+		bool socketError = WSAGetLastError() != 0;
+#else
+		errno = 0;
+		m_retCode = gnutls_record_recv((gnutls_session_t)m_session, buffer, size);
+		bool socketError = errno != 0;
+#endif
+
+		if (m_retCode == GNUTLS_E_INTERRUPTED)
+		{
+			continue;
+		}
+
+		// after processing of a post-handshake message (such as a TLS 1.3 session ticket)
+		// GnuTLS returns GNUTLS_E_AGAIN even on blocking sockets; unlike on a receive
+		// timeout the socket error is not set in this case. The call is repeated
+		// when the next data arrives.
+		if (m_retCode != GNUTLS_E_AGAIN || m_nonBlocking || socketError || !WaitReadable())
+		{
+			break;
+		}
+	}
+
+	// on non-blocking socket the rest of a record hasn't arrived yet
+	m_wouldBlock = m_nonBlocking && m_retCode == GNUTLS_E_AGAIN &&
+		gnutls_record_get_direction((gnutls_session_t)m_session) == 0;
 #endif /* HAVE_LIBGNUTLS */
 
 #ifdef HAVE_OPENSSL
 	m_retCode = SSL_read((SSL*)m_session, buffer, size);
+	m_wouldBlock = m_nonBlocking && m_retCode < 0 &&
+		SSL_get_error((SSL*)m_session, m_retCode) == SSL_ERROR_WANT_READ;
 #endif /* HAVE_OPENSSL */
 
+	if (m_wouldBlock)
+	{
+		return -1;
+	}
+
 	if (m_retCode < 0)
 	{
 #ifdef HAVE_OPENSSL
@@ -690,7 +844,73 @@ int TlsSocket::Recv(char* buffer, int size)
 		return -1;
 	}
 
+	if (m_sessionCache && !m_sessionStored)
+	{
+		StoreSession();
+	}
+
 	return m_retCode;
 }
 
+/*
+ * Waits until data can be read from the (blocking) socket, at most for the receive
+ * timeout of the socket. Returns "false" on timeout or error.
+ */
+bool TlsSocket::WaitReadable()
+{
+#ifdef HAVE_LIBGNUTLS
+	if (gnutls_record_check_pending((gnutls_session_t)m_session) > 0)
+	{
+		return true;
+	}
+#endif
+
+	struct timeval tv = {0, 0};
+#ifdef WIN32
+	DWORD timeout = 0;
+	int len = sizeof(timeout);
+	if (!getsockopt(m_socket, SOL_SOCKET, SO_RCVTIMEO, (char*)&timeout, &len))
+	{
+		tv.tv_sec = timeout / 1000;
+		tv.tv_usec = (timeout % 1000) * 1000;
+	}
+#else
+	socklen_t len = sizeof(tv);
+	getsockopt(m_socket, SOL_SOCKET, SO_RCVTIMEO, &tv, &len);
+#endif
+	bool infinite = tv.tv_sec == 0 && tv.tv_usec == 0;
+
+	fd_set rset;
+	int ret;
+	do
+	{
+		FD_ZERO(&rset);
+		FD_SET(m_socket, &rset);
+		ret = select((int)m_socket + 1, &rset, nullptr, nullptr, infinite ? nullptr : &tv);
+	}
+#ifdef WIN32
+	while (ret < 0 && WSAGetLastError() == WSAEINTR);
+#else
+	while (ret < 0 && errno == EINTR);
+#endif
+
+	return ret > 0;
+}
+
+int TlsSocket::Pending()
+{
+	if (!m_session)
+	{
+		return 0;
+	}
+
+#ifdef HAVE_LIBGNUTLS
+	return (int)gnutls_record_check_pending((gnutls_session_t)m_session);
+#endif /* HAVE_LIBGNUTLS */
+
+#ifdef HAVE_OPENSSL
+	return SSL_pending((SSL*)m_session);
+#endif /* HAVE_OPENSSL */
+}
+
 #endif
@@ -23,6 +23,7 @@
 #ifndef DISABLE_TLS
 
 #include "NString.h"
+#include "TlsSessionCache.h"
 
 class TlsSocket
 {
@@ -39,7 +40,11 @@ public:
 	void Close();
 	int Send(const char* buffer, int size);
 	int Recv(char* buffer, int size);
+	int Pending();
+	void SetNonBlocking(bool nonBlocking) { m_nonBlocking = nonBlocking; }
+	bool GetWouldBlock() { return m_wouldBlock; }
 	void SetSuppressErrors(bool suppressErrors) { m_suppressErrors = suppressErrors; }
+	void SetSessionCache(TlsSessionCache* sessionCache) { m_sessionCache = sessionCache; }
 
 protected:
 	virtual void PrintError(const char* errMsg);
@@ -55,6 +60,10 @@ private:
 	bool m_initialized = false;
 	bool m_connected = false;
 	int m_retCode;
+	TlsSessionCache* m_sessionCache = nullptr;
+	bool m_sessionStored = false;
+	bool m_nonBlocking = false;
+	bool m_wouldBlock = false;
 	static CString m_certStore;
 
 	// using "void*" to prevent the including of GnuTLS/OpenSSL header files into TlsSocket.h
@@ -63,6 +72,9 @@ private:
 
 	void ReportError(const char* errMsg, bool suppressable = true);
 	bool ValidateCert();
+	void ResumeSession();
+	void StoreSession();
+	bool WaitReadable();
 };
 
 #endif
@@ -97,6 +97,8 @@ static const char* OPTION_PARBUFFER				= "ParBuffer";
 static const char* OPTION_PARTHREADS			= "ParThreads";
 static const char* OPTION_RARRENAME				= "RarRename";
 static const char* OPTION_HEALTHCHECK			= "HealthCheck";
+static const char* OPTION_PRECHECK				= "PreCheck";
+static const char* OPTION_PRECHECKSAMPLE		= "PreCheckSample";
 static const char* OPTION_DIRECTRENAME			= "DirectRename";
 static const char* OPTION_UMASK					= "UMask";
 static const char* OPTION_UPDATEINTERVAL		= "UpdateInterval";
@@ -140,6 +142,13 @@ static const char* OPTION_QUOTASTARTDAY			= "QuotaStartDay";
 static const char* OPTION_DAILYQUOTA			= "DailyQuota";
 static const char* OPTION_REORDERFILES			= "ReorderFiles";
 static const char* OPTION_UPDATECHECK			= "UpdateCheck";
+static const char* OPTION_DOWNLOADENGINE		= "DownloadEngine";
+static const char* OPTION_ADAPTIVECONNECTIONS	= "AdaptiveConnections";
+static const char* OPTION_HEDGESPEED			= "HedgeSpeed";
+static const char* OPTION_WARMCONNECTIONS		= "WarmConnections";
+static const char* OPTION_DECODETHREADS			= "DecodeThreads";
+static const char* OPTION_FLUSHTHREADS			= "FlushThreads";
+static const char* OPTION_WRITEENGINE			= "WriteEngine";
 
 // obsolete options
 static const char* OPTION_POSTLOGKIND			= "PostLogKind";
@@ -476,6 +485,8 @@ void Options::InitDefaults()
 	SetOption(OPTION_PARTHREADS, "1");
 	SetOption(OPTION_RARRENAME, "yes");
 	SetOption(OPTION_HEALTHCHECK, "none");
+	SetOption(OPTION_PRECHECK, "none");
+	SetOption(OPTION_PRECHECKSAMPLE, "10");
 	SetOption(OPTION_DIRECTRENAME, "no");
 	SetOption(OPTION_SCRIPTORDER, "");
 	SetOption(OPTION_EXTENSIONS, "");
@@ -525,6 +536,13 @@ void Options::InitDefaults()
 	SetOption(OPTION_DAILYQUOTA, "0");
 	SetOption(OPTION_REORDERFILES, "no");
 	SetOption(OPTION_UPDATECHECK, "none");
+	SetOption(OPTION_DOWNLOADENGINE, "pool");
+	SetOption(OPTION_ADAPTIVECONNECTIONS, "no");
+	SetOption(OPTION_HEDGESPEED, "0");
+	SetOption(OPTION_WARMCONNECTIONS, "0");
+	SetOption(OPTION_DECODETHREADS, "0");
+	SetOption(OPTION_FLUSHTHREADS, "1");
+	SetOption(OPTION_WRITEENGINE, "stdio");
 }
 
 void Options::InitOptFile()
@@ -722,12 +740,17 @@ void Options::InitOptions()
 	m_timeCorrection *= 60;
 	m_propagationDelay		= ParseIntValue(OPTION_PROPAGATIONDELAY, 10) * 60;
 	m_articleCache			= ParseIntValue(OPTION_ARTICLECACHE, 10);
+	m_preCheckSample		= ParseIntValue(OPTION_PRECHECKSAMPLE, 10);
 	m_eventInterval			= ParseIntValue(OPTION_EVENTINTERVAL, 10);
 	m_parBuffer				= ParseIntValue(OPTION_PARBUFFER, 10);
 	m_parThreads			= ParseIntValue(OPTION_PARTHREADS, 10);
 	m_monthlyQuota			= ParseIntValue(OPTION_MONTHLYQUOTA, 10);
 	m_quotaStartDay			= ParseIntValue(OPTION_QUOTASTARTDAY, 10);
 	m_dailyQuota			= ParseIntValue(OPTION_DAILYQUOTA, 10);
+	m_hedgeSpeed			= ParseIntValue(OPTION_HEDGESPEED, 10);
+	m_warmConnections		= ParseIntValue(OPTION_WARMCONNECTIONS, 10);
+	m_decodeThreads			= ParseIntValue(OPTION_DECODETHREADS, 10);
+	m_flushThreads			= ParseIntValue(OPTION_FLUSHTHREADS, 10);
 
 	m_nzbLog				= (bool)ParseEnumValue(OPTION_NZBLOG, BoolCount, BoolNames, BoolValues);
 	m_appendCategoryDir		= (bool)ParseEnumValue(OPTION_APPENDCATEGORYDIR, BoolCount, BoolNames, BoolValues);
@@ -760,6 +783,7 @@ void Options::InitOptions()
 	m_urlForce				= (bool)ParseEnumValue(OPTION_URLFORCE, BoolCount, BoolNames, BoolValues);
 	m_certCheck				= (bool)ParseEnumValue(OPTION_CERTCHECK, BoolCount, BoolNames, BoolValues);
 	m_reorderFiles			= (bool)ParseEnumValue(OPTION_REORDERFILES, BoolCount, BoolNames, BoolValues);
+	m_adaptiveConnections	= (bool)ParseEnumValue(OPTION_ADAPTIVECONNECTIONS, BoolCount, BoolNames, BoolValues);
 
 	const char* OutputModeNames[] = { "loggable", "logable", "log", "colored", "color", "ncurses", "curses" };
 	const int OutputModeValues[] = { omLoggable, omLoggable, omLoggable, omColored, omColored, omNCurses, omNCurses };
@@ -786,11 +810,26 @@ void Options::InitOptions()
 	const int FileNamingCount = 4;
 	m_fileNaming = (EFileNaming)ParseEnumValue(OPTION_FILENAMING, FileNamingCount, FileNamingNames, FileNamingValues);
 
+	const char* DownloadEngineNames[] = { "threaded", "pool", "event" };
+	const int DownloadEngineValues[] = { deThreaded, dePool, deEvent };
+	const int DownloadEngineCount = 3;
+	m_downloadEngine = (EDownloadEngine)ParseEnumValue(OPTION_DOWNLOADENGINE, DownloadEngineCount, DownloadEngineNames, DownloadEngineValues);
+
+	const char* WriteEngineNames[] = { "stdio", "uring", "uringdirect", "mmap" };
+	const int WriteEngineValues[] = { weStdio, weUring, weUringDirect, weMmap };
+	const int WriteEngineCount = 4;
+	m_writeEngine = (EWriteEngine)ParseEnumValue(OPTION_WRITEENGINE, WriteEngineCount, WriteEngineNames, WriteEngineValues);
+
 	const char* HealthCheckNames[] = { "pause", "delete", "park", "none" };
 	const int HealthCheckValues[] = { hcPause, hcDelete, hcPark, hcNone };
 	const int HealthCheckCount = 4;
 	m_healthCheck = (EHealthCheck)ParseEnumValue(OPTION_HEALTHCHECK, HealthCheckCount, HealthCheckNames, HealthCheckValues);
 
+	const char* PreCheckNames[] = { "none", "sample", "full" };
+	const int PreCheckValues[] = { pcNone, pcSample, pcFull };
+	const int PreCheckCount = 3;
+	m_preCheck = (EPreCheck)ParseEnumValue(OPTION_PRECHECK, PreCheckCount, PreCheckNames, PreCheckValues);
+
 	const char* TargetNames[] = { "screen", "log", "both", "none" };
 	const int TargetValues[] = { mtScreen, mtLog, mtBoth, mtNone };
 	const int TargetCount = 4;
@@ -1018,12 +1057,30 @@ void Options::InitServers()
 			ipversion = ParseEnumValue(BString<100>("Server%i.IpVersion", n), IpVersionCount, IpVersionNames, IpVersionValues);
 		}
 
+		const char* ncompression = GetOption(BString<100>("Server%i.Compression", n));
+		bool compression = false;
+		if (ncompression)
+		{
+			compression = (bool)ParseEnumValue(BString<100>("Server%i.Compression", n), BoolCount, BoolNames, BoolValues);
+#ifdef DISABLE_GZIP
+			if (compression)
+			{
+				ConfigError("Invalid value for option \"%s\": program was compiled without gzip-support",
+					*BString<100>("Server%i.Compression", n));
+				compression = false;
+			}
+#endif
+		}
+
 		const char* ncipher = GetOption(BString<100>("Server%i.Cipher", n));
 		const char* nconnections = GetOption(BString<100>("Server%i.Connections", n));
 		const char* nretention = GetOption(BString<100>("Server%i.Retention", n));
+		const char* npipelinedepth = GetOption(BString<100>("Server%i.PipelineDepth", n));
+		const char* ndownloadrate = GetOption(BString<100>("Server%i.DownloadRate", n));
 
 		bool definition = nactive || nname || nlevel || ngroup || nhost || nport || noptional ||
-			nusername || npassword || nconnections || njoingroup || ntls || ncipher || nretention;
+			nusername || npassword || nconnections || njoingroup || ntls || ncipher || nretention ||
+			npipelinedepth || ndownloadrate || ncompression;
 		bool completed = nhost && nport && nconnections;
 
 		if (!definition)
@@ -1045,7 +1102,10 @@ void Options::InitServers()
 					nretention ? atoi(nretention) : 0,
 					nlevel ? atoi(nlevel) : 0,
 					ngroup ? atoi(ngroup) : 0,
-					optional);
+					optional,
+					npipelinedepth ? atoi(npipelinedepth) : 1,
+					ndownloadrate ? atoi(ndownloadrate) * 1024 : 0,
+					compression);
 			}
 		}
 		else
@@ -1074,8 +1134,9 @@ void Options::InitCategories()
 
 		const char* nextensions = GetOption(BString<100>("Category%i.Extensions", n));
 		const char* naliases = GetOption(BString<100>("Category%i.Aliases", n));
+		const char* ndownloadrate = GetOption(BString<100>("Category%i.DownloadRate", n));
 
-		bool definition = nname || ndestdir || nunpack || nextensions || naliases;
+		bool definition = nname || ndestdir || nunpack || nextensions || naliases || ndownloadrate;
 		bool completed = nname && strlen(nname) > 0;
 
 		if (!definition)
@@ -1091,7 +1152,8 @@ void Options::InitCategories()
 				CheckDir(destDir, BString<100>("Category%i.DestDir", n), m_destDir, false, false);
 			}
 
-			m_categories.emplace_back(nname, destDir, unpack, nextensions);
+			m_categories.emplace_back(nname, destDir, unpack, nextensions,
+				ndownloadrate ? atoi(ndownloadrate) * 1024 : 0);
 			Category& category = m_categories.back();
 
 			// split Aliases into tokens and create items for each token
@@ -1536,7 +1598,9 @@ bool Options::ValidateOptionName(const char* optname, const char* optvalue)
 			!strcasecmp(p, ".encryption") || !strcasecmp(p, ".connections") ||
 			!strcasecmp(p, ".cipher") || !strcasecmp(p, ".group") ||
 			!strcasecmp(p, ".retention") || !strcasecmp(p, ".optional") ||
-			!strcasecmp(p, ".notes") || !strcasecmp(p, ".ipversion")))
+			!strcasecmp(p, ".notes") || !strcasecmp(p, ".ipversion") ||
+			!strcasecmp(p, ".pipelinedepth") || !strcasecmp(p, ".downloadrate") ||
+			!strcasecmp(p, ".compression")))
 		{
 			return true;
 		}
@@ -1559,7 +1623,7 @@ bool Options::ValidateOptionName(const char* optname, const char* optvalue)
 		char* p = (char*)optname + 8;
 		while (*p >= '0' && *p <= '9') p++;
 		if (p && (!strcasecmp(p, ".name") || !strcasecmp(p, ".destdir") || !strcasecmp(p, ".extensions") ||
-			!strcasecmp(p, ".unpack") || !strcasecmp(p, ".aliases")))
+			!strcasecmp(p, ".unpack") || !strcasecmp(p, ".aliases") || !strcasecmp(p, ".downloadrate")))
 		{
 			return true;
 		}
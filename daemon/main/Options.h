@@ -70,6 +70,12 @@ public:
 		hcPark,
 		hcNone
 	};
+	enum EPreCheck
+	{
+		pcNone,
+		pcSample,
+		pcFull
+	};
 	enum ESchedulerCommand
 	{
 		scPauseDownload,
@@ -98,6 +104,19 @@ public:
 		nfArticle,
 		nfNzb
 	};
+	enum EDownloadEngine
+	{
+		deThreaded,
+		dePool,
+		deEvent
+	};
+	enum EWriteEngine
+	{
+		weStdio,
+		weUring,
+		weUringDirect,
+		weMmap
+	};
 
 	class OptEntry
 	{
@@ -139,13 +158,15 @@ public:
 	class Category
 	{
 	public:
-		Category(const char* name, const char* destDir, bool unpack, const char* extensions) :
-			m_name(name), m_destDir(destDir), m_unpack(unpack), m_extensions(extensions) {}
+		Category(const char* name, const char* destDir, bool unpack, const char* extensions, int downloadRate) :
+			m_name(name), m_destDir(destDir), m_unpack(unpack), m_extensions(extensions),
+			m_downloadRate(downloadRate) {}
 		const char* GetName() { return m_name; }
 		const char* GetDestDir() { return m_destDir; }
 		bool GetUnpack() { return m_unpack; }
 		const char* GetExtensions() { return m_extensions; }
 		NameList* GetAliases() { return &m_aliases; }
+		int GetDownloadRate() { return m_downloadRate; }
 
 	private:
 		CString m_name;
@@ -153,6 +174,7 @@ public:
 		bool m_unpack;
 		CString m_extensions;
 		NameList m_aliases;
+		int m_downloadRate;
 	};
 
 	typedef std::deque<Category> CategoriesBase;
@@ -169,7 +191,7 @@ public:
 		virtual void AddNewsServer(int id, bool active, const char* name, const char* host,
 			int port, int ipVersion, const char* user, const char* pass, bool joinGroup,
 			bool tls, const char* cipher, int maxConnections, int retention,
-			int level, int group, bool optional) = 0;
+			int level, int group, bool optional, int pipelineDepth, int downloadRate, bool compression) = 0;
 		virtual void AddFeed(int id, const char* name, const char* url, int interval,
 			const char* filter, bool backlog, bool pauseNzb, const char* category,
 			int priority, const char* extensions) {}
@@ -256,6 +278,8 @@ public:
 	int GetParThreads() { return m_parThreads; }
 	bool GetRarRename() { return m_rarRename; }
 	EHealthCheck GetHealthCheck() { return m_healthCheck; }
+	EPreCheck GetPreCheck() { return m_preCheck; }
+	int GetPreCheckSample() { return m_preCheckSample; }
 	const char* GetScriptOrder() { return m_scriptOrder; }
 	const char* GetExtensions() { return m_extensions; }
 	int GetUMask() { return m_umask; }
@@ -301,6 +325,13 @@ public:
 	bool GetReorderFiles() { return m_reorderFiles; }
 	EFileNaming GetFileNaming() { return m_fileNaming; }
 	int GetDownloadRate() const { return m_downloadRate; }
+	EDownloadEngine GetDownloadEngine() { return m_downloadEngine; }
+	bool GetAdaptiveConnections() { return m_adaptiveConnections; }
+	int GetHedgeSpeed() { return m_hedgeSpeed; }
+	int GetWarmConnections() { return m_warmConnections; }
+	int GetDecodeThreads() { return m_decodeThreads; }
+	int GetFlushThreads() { return m_flushThreads; }
+	EWriteEngine GetWriteEngine() { return m_writeEngine; }
 
 	Categories* GetCategories() { return &m_categories; }
 	Category* FindCategory(const char* name, bool searchAliases) { return m_categories.FindCategory(name, searchAliases); }
@@ -390,6 +421,8 @@ private:
 	bool m_rarRename = false;
 	bool m_directRename = false;
 	EHealthCheck m_healthCheck = hcNone;
+	EPreCheck m_preCheck = pcNone;
+	int m_preCheckSample = 10;
 	CString m_extensions;
 	CString m_scriptOrder;
 	int m_umask = 0;
@@ -434,6 +467,13 @@ private:
 	bool m_reorderFiles = false;
 	EFileNaming m_fileNaming = nfArticle;
 	int m_downloadRate = 0;
+	EDownloadEngine m_downloadEngine = dePool;
+	bool m_adaptiveConnections = false;
+	int m_hedgeSpeed = 0;
+	int m_warmConnections = 0;
+	int m_decodeThreads = 0;
+	int m_flushThreads = 1;
+	EWriteEngine m_writeEngine = weStdio;
 
 	// Application mode
 	bool m_serverMode = false;
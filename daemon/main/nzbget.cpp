@@ -48,6 +48,7 @@
 #include "Maintenance.h"
 #include "ArticleWriter.h"
 #include "StatMeter.h"
+#include "BandwidthLimiter.h"
 #include "QueueScript.h"
 #include "Util.h"
 #include "FileSystem.h"
@@ -77,6 +78,7 @@ ServerPool* g_ServerPool;
 QueueCoordinator* g_QueueCoordinator;
 UrlCoordinator* g_UrlCoordinator;
 StatMeter* g_StatMeter;
+BandwidthLimiter* g_BandwidthLimiter;
 PrePostProcessor* g_PrePostProcessor;
 HistoryCoordinator* g_HistoryCoordinator;
 DupeCoordinator* g_DupeCoordinator;
@@ -181,7 +183,7 @@ public:
 	virtual void AddNewsServer(int id, bool active, const char* name, const char* host,
 		int port, int ipVersion, const char* user, const char* pass, bool joinGroup,
 		bool tls, const char* cipher, int maxConnections, int retention,
-		int level, int group, bool optional);
+		int level, int group, bool optional, int pipelineDepth, int downloadRate, bool compression);
 	virtual void AddFeed(int id, const char* name, const char* url, int interval,
 		const char* filter, bool backlog, bool pauseNzb, const char* category,
 		int priority, const char* feedScript);
@@ -200,6 +202,7 @@ private:
 	std::unique_ptr<QueueCoordinator> m_queueCoordinator;
 	std::unique_ptr<UrlCoordinator> m_urlCoordinator;
 	std::unique_ptr<StatMeter> m_statMeter;
+	std::unique_ptr<BandwidthLimiter> m_bandwidthLimiter;
 	std::unique_ptr<PrePostProcessor> m_prePostProcessor;
 	std::unique_ptr<HistoryCoordinator> m_historyCoordinator;
 	std::unique_ptr<DupeCoordinator> m_dupeCoordinator;
@@ -322,6 +325,7 @@ void NZBGet::Init()
 	{
 		m_serverPool->InitConnections();
 		m_statMeter->Init();
+		m_bandwidthLimiter->Init(m_serverPool->GetServers(), m_options->GetCategories());
 	}
 
 	InstallErrorHandler();
@@ -360,6 +364,9 @@ void NZBGet::CreateGlobals()
 	m_statMeter = std::make_unique<StatMeter>();
 	g_StatMeter = m_statMeter.get();
 
+	m_bandwidthLimiter = std::make_unique<BandwidthLimiter>();
+	g_BandwidthLimiter = m_bandwidthLimiter.get();
+
 	m_scanner = std::make_unique<Scanner>();
 	g_Scanner = m_scanner.get();
 
@@ -469,6 +476,7 @@ void NZBGet::Cleanup()
 	g_QueueScriptCoordinator = nullptr;
 	g_Maintenance = nullptr;
 	g_StatMeter = nullptr;
+	g_BandwidthLimiter = nullptr;
 	g_CommandScriptLog = nullptr;
 #ifdef WIN32
 	g_WinConsole = nullptr;
@@ -1008,10 +1016,11 @@ void NZBGet::Daemonize()
 
 void NZBGet::AddNewsServer(int id, bool active, const char* name, const char* host,
 	int port, int ipVersion, const char* user, const char* pass, bool joinGroup, bool tls,
-	const char* cipher, int maxConnections, int retention, int level, int group, bool optional)
+	const char* cipher, int maxConnections, int retention, int level, int group, bool optional,
+	int pipelineDepth, int downloadRate, bool compression)
 {
 	m_serverPool->AddServer(std::make_unique<NewsServer>(id, active, name, host, port, ipVersion, user, pass, joinGroup,
-		tls, cipher, maxConnections, retention, level, group, optional));
+		tls, cipher, maxConnections, retention, level, group, optional, pipelineDepth, downloadRate, compression));
 }
 
 void NZBGet::AddFeed(int id, const char* name, const char* url, int interval, const char* filter,
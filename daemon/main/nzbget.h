@@ -170,6 +170,8 @@ using namespace MSXML;
 #include <sys/wait.h>
 #include <sys/un.h>
 #include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <stdint.h>
@@ -187,6 +189,15 @@ using namespace MSXML;
 #include <sys/prctl.h>
 #endif
 
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
+#ifdef HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+
 #ifdef HAVE_ENDIAN_H
 #include <endian.h>
 #endif
@@ -226,6 +237,7 @@ using namespace MSXML;
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
 #include <chrono>
 
 // NOTE: do not include <iostream> in "nzbget.h". <iostream> contains objects requiring
@@ -0,0 +1,278 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "nzbget.h"
+#include "ArticleDecoderPool.h"
+#include "Options.h"
+#include "Log.h"
+#include "Util.h"
+
+static const int CHUNK_SIZE = 1024*64;
+static const int64 MIN_QUEUED_BYTES = 1024*1024*16;
+static const int WAIT_INTERVAL_MSEC = 100;
+
+ArticleDecoderPool::ArticleDecoderPool(int threads)
+{
+	debug("Starting %i article decoders", threads);
+
+	m_maxQueuedBytes = std::max((int64)g_Options->GetArticleCache() * 1024 * 1024, MIN_QUEUED_BYTES);
+
+	for (int i = 0; i < threads; i++)
+	{
+		m_workers.push_back(std::make_unique<Worker>(this));
+		m_workers.back()->Start();
+	}
+}
+
+void ArticleDecoderPool::Stop()
+{
+	debug("Stopping ArticleDecoderPool");
+
+	m_stopped = true;
+	NotifySpace();
+
+	for (std::unique_ptr<Worker>& worker : m_workers)
+	{
+		worker->WakeUp();
+		while (worker->IsRunning())
+		{
+			Util::Sleep(10);
+		}
+	}
+
+	debug("ArticleDecoderPool stopped");
+}
+
+void ArticleDecoderPool::Open(Stream* stream)
+{
+	stream->m_pool = this;
+	stream->m_finished = false;
+	stream->m_drained = false;
+	stream->m_failed = false;
+	stream->m_worker = m_workers[m_nextWorker++ % m_workers.size()].get();
+	stream->m_worker->Add(stream);
+}
+
+void ArticleDecoderPool::Close(Stream* stream)
+{
+	if (!stream->m_worker)
+	{
+		return;
+	}
+
+	stream->m_finished = true;
+	stream->m_worker->WakeUp();
+
+	auto drained = [&]{ return stream->m_drained || m_stopped; };
+	if (!drained())
+	{
+		Guard guard(m_spaceMutex);
+		m_spaceWaiters++;
+		while (!drained())
+		{
+			m_spaceCond.WaitFor(m_spaceMutex, WAIT_INTERVAL_MSEC, drained);
+		}
+		m_spaceWaiters--;
+	}
+
+	stream->m_worker = nullptr;
+}
+
+/*
+ * Wakes up connections waiting for room in the decoding queue or for completion of a stream.
+ */
+void ArticleDecoderPool::NotifySpace()
+{
+	if (m_spaceWaiters > 0)
+	{
+		Guard guard(m_spaceMutex);
+		m_spaceCond.NotifyAll();
+	}
+}
+
+char* ArticleDecoderPool::Stream::GetBuffer(int* size)
+{
+	if (!m_current.data)
+	{
+		ArticleDecoderPool* pool = m_pool;
+		auto available = [&]
+		{
+			return m_failed || pool->m_stopped ||
+				(pool->m_queuedBytes < pool->m_maxQueuedBytes && (m_chunks < MAX_CHUNKS || !m_free.Empty()));
+		};
+
+		if (!available())
+		{
+			// backpressure: the decoders can't keep up, stop receiving for a while
+			Guard guard(pool->m_spaceMutex);
+			pool->m_spaceWaiters++;
+			while (!available())
+			{
+				pool->m_spaceCond.WaitFor(pool->m_spaceMutex, WAIT_INTERVAL_MSEC, available);
+			}
+			pool->m_spaceWaiters--;
+		}
+
+		if (m_failed || pool->m_stopped)
+		{
+			return nullptr;
+		}
+
+		if (!m_free.Pop(m_current))
+		{
+			m_current.data = std::make_unique<char[]>(CHUNK_SIZE);
+			m_chunks++;
+		}
+	}
+
+	*size = CHUNK_SIZE;
+	return m_current.data.get();
+}
+
+void ArticleDecoderPool::Stream::Push(int len)
+{
+	m_current.len = len;
+	m_pool->m_queuedBytes += len;
+	// never fails: there are no more chunks than the queue can hold
+	m_filled.Push(std::move(m_current));
+	m_worker->WakeUp();
+}
+
+/*
+ * Called by the decoder thread, returns "false" if there was no data to process.
+ */
+bool ArticleDecoderPool::Stream::ProcessNext()
+{
+	Chunk chunk;
+	if (!m_filled.Pop(chunk))
+	{
+		return false;
+	}
+
+	if (!m_failed && !Process(chunk.data.get(), chunk.len))
+	{
+		m_failed = true;
+	}
+
+	m_pool->m_queuedBytes -= chunk.len;
+	m_free.Push(std::move(chunk));
+	m_pool->NotifySpace();
+
+	return true;
+}
+
+void ArticleDecoderPool::Worker::Add(Stream* stream)
+{
+	Guard guard(m_addedMutex);
+	m_added.push_back(stream);
+	m_wakeCond.NotifyOne();
+}
+
+void ArticleDecoderPool::Worker::WakeUp()
+{
+	// pairs with the fence in "Run": either the worker sees the new data before
+	// going to sleep or the sleeping flag is seen here
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (m_sleeping)
+	{
+		Guard guard(m_addedMutex);
+		m_wakeCond.NotifyOne();
+	}
+}
+
+void ArticleDecoderPool::Worker::Run()
+{
+	debug("Entering ArticleDecoder-loop");
+
+	while (!m_owner->m_stopped)
+	{
+		if (!ProcessStreams())
+		{
+			Guard guard(m_addedMutex);
+			m_sleeping = true;
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (!HasWork() && !m_owner->m_stopped)
+			{
+				m_wakeCond.WaitFor(m_addedMutex, WAIT_INTERVAL_MSEC);
+			}
+			m_sleeping = false;
+		}
+	}
+
+	debug("Exiting ArticleDecoder-loop");
+}
+
+/*
+ * Processes one chunk of each stream, the streams are served in turn.
+ * Returns "false" if there was nothing to do.
+ */
+bool ArticleDecoderPool::Worker::ProcessStreams()
+{
+	{
+		Guard guard(m_addedMutex);
+		std::move(m_added.begin(), m_added.end(), std::back_inserter(m_streams));
+		m_added.clear();
+	}
+
+	bool processed = false;
+	for (Streams::iterator it = m_streams.begin(); it != m_streams.end(); )
+	{
+		Stream* stream = *it;
+		// the flag is checked before the queue: all data pushed before is then visible
+		bool finished = stream->m_finished;
+		if (stream->ProcessNext())
+		{
+			processed = true;
+			it++;
+		}
+		else if (finished)
+		{
+			// the stream must not be accessed after it's marked as drained
+			it = m_streams.erase(it);
+			stream->m_drained = true;
+			m_owner->NotifySpace();
+		}
+		else
+		{
+			it++;
+		}
+	}
+
+	return processed;
+}
+
+bool ArticleDecoderPool::Worker::HasWork()
+{
+	if (!m_added.empty())
+	{
+		return true;
+	}
+
+	for (Stream* stream : m_streams)
+	{
+		if (stream->m_finished || !stream->m_filled.Empty())
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,127 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef ARTICLEDECODERPOOL_H
+#define ARTICLEDECODERPOOL_H
+
+#include "Thread.h"
+#include "Container.h"
+
+/*
+ * Pool of threads decoding article data received by download connections.
+ * Each article being downloaded has a stream: the connection fills buffers and
+ * pushes them into the stream, one of the decoder threads takes them out and processes
+ * them in the same order. The buffers are passed via lock-free queues, the decoder
+ * thread is woken up only when it has nothing to do.
+ * The amount of data waiting for decoding is limited, the connections wait when the
+ * limit is reached.
+ */
+class ArticleDecoderPool
+{
+private:
+	class Worker;
+
+public:
+	class Stream
+	{
+	public:
+		virtual ~Stream() {};
+		// returns a buffer to receive the data into or "nullptr" if the decoding has failed
+		char* GetBuffer(int* size);
+		// passes "len" bytes of data in the buffer returned by "GetBuffer" for decoding
+		void Push(int len);
+		bool GetFailed() { return m_failed; }
+
+	protected:
+		// called by a decoder thread, returns "false" on failure
+		virtual bool Process(char* buffer, int len) = 0;
+
+	private:
+		struct Chunk
+		{
+			std::unique_ptr<char[]> data;
+			int len = 0;
+		};
+
+		static const int MAX_CHUNKS = 16;
+
+		ArticleDecoderPool* m_pool = nullptr;
+		Worker* m_worker = nullptr;
+		SpscQueue<Chunk, MAX_CHUNKS> m_filled;
+		SpscQueue<Chunk, MAX_CHUNKS> m_free;
+		Chunk m_current;
+		int m_chunks = 0;
+		std::atomic<bool> m_finished{false};
+		std::atomic<bool> m_drained{false};
+		std::atomic<bool> m_failed{false};
+
+		bool ProcessNext();
+
+		friend class ArticleDecoderPool;
+	};
+
+	ArticleDecoderPool(int threads);
+	void Stop();
+	// attaches the stream to one of the decoder threads
+	void Open(Stream* stream);
+	// waits until all data of the stream is decoded and detaches it
+	void Close(Stream* stream);
+
+private:
+	class Worker : public Thread
+	{
+	public:
+		Worker(ArticleDecoderPool* owner) : m_owner(owner) {}
+		virtual void Run();
+		void Add(Stream* stream);
+		void WakeUp();
+
+	private:
+		typedef std::vector<Stream*> Streams;
+
+		ArticleDecoderPool* m_owner;
+		// streams being processed, accessed only by the worker thread
+		Streams m_streams;
+		// newly opened streams, taken over by the worker thread
+		Streams m_added;
+		Mutex m_addedMutex;
+		ConditionVar m_wakeCond;
+		std::atomic<bool> m_sleeping{false};
+
+		bool ProcessStreams();
+		bool HasWork();
+	};
+
+	typedef std::vector<std::unique_ptr<Worker>> Workers;
+
+	Workers m_workers;
+	std::atomic<uint32> m_nextWorker{0};
+	std::atomic<int64> m_queuedBytes{0};
+	int64 m_maxQueuedBytes;
+	std::atomic<int> m_spaceWaiters{0};
+	std::atomic<bool> m_stopped{false};
+	Mutex m_spaceMutex;
+	ConditionVar m_spaceCond;
+
+	void NotifySpace();
+};
+
+#endif
@@ -28,8 +28,14 @@
 #include "WorkState.h"
 #include "ServerPool.h"
 #include "StatMeter.h"
+#include "BandwidthLimiter.h"
 #include "Util.h"
 
+static const int RECEIVE_BUFFER_MIN = 1024*4;
+static const int RECEIVE_BUFFER_MAX = 1024*512;
+static const int CONNECTION_WAIT_MSEC = 100;
+static const int THROTTLE_SLEEP_MSEC = 100;
+
 ArticleDownloader::ArticleDownloader()
 {
 	debug("Creating ArticleDownloader");
@@ -42,12 +48,124 @@ ArticleDownloader::~ArticleDownloader()
 	debug("Destroying ArticleDownloader");
 }
 
+void ArticleDownloader::SetDecoderPool(ArticleDecoderPool* decoderPool)
+{
+	m_decoderPool = decoderPool;
+	m_decodeStream = std::make_unique<DecodeStream>(this);
+}
+
 void ArticleDownloader::SetInfoName(const char* infoName)
 {
 	m_infoName = infoName;
 	m_articleWriter.SetInfoName(m_infoName);
 }
 
+/*
+ * Makes this (not yet started) downloader a duplicate of another downloader
+ * of the same article. The duplicate keeps the article in the cache only.
+ */
+void ArticleDownloader::HedgeWith(ArticleDownloader* articleDownloader)
+{
+	m_hedgeState = articleDownloader->m_hedgeState;
+	m_hedgeState->hedged = true;
+	m_articleWriter.SetCacheOnly(true);
+}
+
+/*
+ * Called when a download having a duplicate is completed, the download queue must be locked.
+ * Returns "true" if the result of the download must be dropped: either the duplicate
+ * has delivered the article or it's still running and may deliver it.
+ */
+bool ArticleDownloader::ResolveHedge()
+{
+	if (m_hedgePartner)
+	{
+		ArticleDownloader* partner = m_hedgePartner;
+		partner->SetHedgePartner(nullptr);
+		m_hedgePartner = nullptr;
+
+		if (m_status == adFinished)
+		{
+			// the other download isn't needed anymore
+			partner->SetHedgeDiscarded(true);
+			partner->Stop();
+			return false;
+		}
+
+		// the other download is still running and may succeed
+		m_hedgeDiscarded = true;
+	}
+
+	return m_hedgeDiscarded;
+}
+
+void ArticleDownloader::Run()
+{
+	debug("Entering ArticleDownloader-loop");
+
+	Prepare();
+
+	EStatus status = StartAttempt();
+	while (status == adRunning)
+	{
+		status = Download();
+		if (!FinishAttempt(status))
+		{
+			break;
+		}
+		status = StartAttempt();
+	}
+
+	Complete(status);
+
+	debug("Exiting ArticleDownloader-loop");
+}
+
+void ArticleDownloader::Prepare()
+{
+	SetStatus(adRunning);
+
+	m_articleWriter.SetFileInfo(m_fileInfo);
+	m_articleWriter.SetArticleInfo(m_articleInfo);
+	m_articleWriter.Prepare();
+
+	m_retries = g_Options->GetArticleRetries() > 0 ? g_Options->GetArticleRetries() : 1;
+	m_remainedRetries = m_retries;
+	m_failedServers.reserve(g_ServerPool->GetServers()->size());
+	m_serverConfigGeneration = g_ServerPool->GetGeneration();
+	m_force = m_fileInfo->GetNzbInfo()->GetForcePriority();
+	m_category = g_Options->FindCategory(m_fileInfo->GetNzbInfo()->GetCategory(), false);
+}
+
+/*
+ * Makes one attempt to obtain a connection from the server pool, waiting up to "waitMsec"
+ * for a connection to become free.
+ * Returns "true" if the connection was obtained or if there is no sense in waiting anymore.
+ */
+bool ArticleDownloader::AcquireConnection(int waitMsec)
+{
+	bool stop = IsStopped() || m_serverConfigGeneration != g_ServerPool->GetGeneration();
+
+	if (!m_connection && !stop && m_pipelineConnection)
+	{
+		// the request for the article was already sent, wait until its response is next
+		bool lost = false;
+		m_connection = g_ServerPool->GetPipelinedConnection(m_pipelineConnection, m_articleInfo->GetMessageId(),
+			&lost, waitMsec);
+		if (m_connection || lost)
+		{
+			m_pipelineConnection = nullptr;
+		}
+	}
+
+	if (!m_connection && !stop && !m_pipelineConnection)
+	{
+		m_connection = g_ServerPool->GetConnection(m_level, m_wantServer, &m_failedServers, waitMsec);
+	}
+
+	return m_connection || stop;
+}
+
 /*
  * How server management (for one particular article) works:
 	- there is a list of failed servers which is initially empty;
@@ -68,196 +186,237 @@ void ArticleDownloader::SetInfoName(const char* infoName)
 		- if all servers from current level were tried, increase level;
 		- if all servers from all levels were tried, break the loop with failure status.
 	<end-loop>
+
+	StartAttempt() runs the loop until the article body can be received and returns "adRunning"
+	then, otherwise the final status; FinishAttempt() evaluates the result of the attempt.
 */
-void ArticleDownloader::Run()
+ArticleDownloader::EStatus ArticleDownloader::StartAttempt()
 {
-	debug("Entering ArticleDownloader-loop");
-
-	SetStatus(adRunning);
-
-	m_articleWriter.SetFileInfo(m_fileInfo);
-	m_articleWriter.SetArticleInfo(m_articleInfo);
-	m_articleWriter.Prepare();
-
 	EStatus status = adFailed;
-	int retries = g_Options->GetArticleRetries() > 0 ? g_Options->GetArticleRetries() : 1;
-	int remainedRetries = retries;
-	ServerPool::RawServerList failedServers;
-	failedServers.reserve(g_ServerPool->GetServers()->size());
-	NewsServer* wantServer = nullptr;
-	NewsServer* lastServer = nullptr;
-	int level = 0;
-	int serverConfigGeneration = g_ServerPool->GetGeneration();
-	bool force = m_fileInfo->GetNzbInfo()->GetForcePriority();
 
 	while (!IsStopped())
 	{
-		status = adFailed;
-
 		SetStatus(adWaiting);
-		while (!m_connection && !(IsStopped() || serverConfigGeneration != g_ServerPool->GetGeneration()))
+		while (!AcquireConnection(CONNECTION_WAIT_MSEC)) ;
+
+		status = BeginAttempt();
+		if (status == adRunning || status == adRetry)
 		{
-			m_connection = g_ServerPool->GetConnection(level, wantServer, &failedServers);
-			Util::Sleep(5);
+			return status;
 		}
-		SetLastUpdateTimeNow();
-		SetStatus(adRunning);
 
-		if (IsStopped() || ((g_WorkState->GetPauseDownload() || g_WorkState->GetQuotaReached()) && !force) ||
-			(g_WorkState->GetTempPauseDownload() && !m_fileInfo->GetExtraPriority()) ||
-			serverConfigGeneration != g_ServerPool->GetGeneration())
+		if (!EndAttempt(status))
 		{
-			status = adRetry;
 			break;
 		}
+	}
 
-		lastServer = m_connection->GetNewsServer();
-		level = lastServer->GetNormLevel();
+	return status;
+}
 
-		m_connection->SetSuppressErrors(false);
+/*
+ * Completes the download of article body and evaluates the result of the attempt.
+ * Returns "true" if another attempt should be made via "StartAttempt()".
+ */
+bool ArticleDownloader::FinishAttempt(EStatus& status)
+{
+	status = FinishDownload(status);
+	return EndAttempt(status);
+}
 
-		m_connectionName.Format("%s (%s)",
-			m_connection->GetNewsServer()->GetName(), m_connection->GetHost());
+/*
+ * Connects to server and requests the article.
+ * Returns "adRunning" if the article body is ready to be received,
+ * "adRetry" if the download must be postponed or the result of failed attempt.
+ */
+ArticleDownloader::EStatus ArticleDownloader::BeginAttempt()
+{
+	SetLastUpdateTimeNow();
+	SetStatus(adRunning);
+	m_downloadAttempted = false;
 
-		// check server retention
-		bool retentionFailure = m_connection->GetNewsServer()->GetRetention() > 0 &&
-			(Util::CurrentTime() - m_fileInfo->GetTime()) / 86400 > m_connection->GetNewsServer()->GetRetention();
-		if (retentionFailure)
-		{
-			detail("Article %s @ %s failed: out of server retention (file age: %i, configured retention: %i)",
-				*m_infoName, *m_connectionName,
-				(int)(Util::CurrentTime() - m_fileInfo->GetTime()) / 86400,
-				m_connection->GetNewsServer()->GetRetention());
-			status = adFailed;
-			FreeConnection(true);
-		}
+	if (IsStopped() || ((g_WorkState->GetPauseDownload() || g_WorkState->GetQuotaReached()) && !m_force) ||
+		(g_WorkState->GetTempPauseDownload() && !m_fileInfo->GetExtraPriority()) ||
+		m_serverConfigGeneration != g_ServerPool->GetGeneration())
+	{
+		return adRetry;
+	}
 
-		if (m_connection && !IsStopped())
-		{
-			detail("Downloading %s @ %s", *m_infoName, *m_connectionName);
-		}
+	m_lastServer = m_connection->GetNewsServer();
+	m_level = m_lastServer->GetNormLevel();
+	m_attemptServer = m_lastServer;
 
-		// test connection
-		bool connected = m_connection && m_connection->Connect();
-		if (connected && !IsStopped())
-		{
-			NewsServer* newsServer = m_connection->GetNewsServer();
+	m_connection->SetSuppressErrors(false);
 
-			// Download article
-			status = Download();
+	m_connectionName.Format("%s (%s)",
+		m_connection->GetNewsServer()->GetName(), m_connection->GetHost());
 
-			if (status == adFinished || status == adFailed || status == adNotFound || status == adCrcError)
-			{
-				m_serverStats.StatOp(newsServer->GetId(), status == adFinished ? 1 : 0, status == adFinished ? 0 : 1, ServerStatList::soSet);
-			}
-		}
+	// check server retention
+	m_retentionFailure = m_connection->GetNewsServer()->GetRetention() > 0 &&
+		(Util::CurrentTime() - m_fileInfo->GetTime()) / 86400 > m_connection->GetNewsServer()->GetRetention();
+	if (m_retentionFailure)
+	{
+		detail("Article %s @ %s failed: out of server retention (file age: %i, configured retention: %i)",
+			*m_infoName, *m_connectionName,
+			(int)(Util::CurrentTime() - m_fileInfo->GetTime()) / 86400,
+			m_connection->GetNewsServer()->GetRetention());
+		FreeConnection(true);
+	}
 
-		if (m_connection)
-		{
-			AddServerData();
-		}
+	if (m_connection && !IsStopped())
+	{
+		detail("Downloading %s @ %s", *m_infoName, *m_connectionName);
+	}
 
-		if (!connected && m_connection)
-		{
-			detail("Article %s @ %s failed: could not establish connection", *m_infoName, *m_connectionName);
-		}
+	// test connection
+	m_connected = m_connection && m_connection->Connect();
+	if (m_connected && !IsStopped())
+	{
+		m_downloadAttempted = true;
+		return StartDownload();
+	}
 
-		if (status == adConnectError)
-		{
-			connected = false;
-			status = adFailed;
-		}
+	return adFailed;
+}
 
-		if (connected && status == adFailed)
-		{
-			remainedRetries--;
-		}
+/*
+ * Evaluates the result of download attempt.
+ * Returns "true" if another attempt should be made.
+ */
+bool ArticleDownloader::EndAttempt(EStatus& status)
+{
+	if (m_downloadAttempted &&
+		(status == adFinished || status == adFailed || status == adNotFound || status == adCrcError))
+	{
+		m_serverStats.StatOp(m_lastServer->GetId(), status == adFinished ? 1 : 0, status == adFinished ? 0 : 1, ServerStatList::soSet);
+	}
 
-		bool optionalBlocked = false;
-		if (!connected && m_connection && !IsStopped())
-		{
-			g_ServerPool->BlockServer(lastServer);
-			optionalBlocked = lastServer->GetOptional();
-		}
+	if (m_downloadAttempted && (status == adFinished || status == adNotFound || status == adCrcError))
+	{
+		m_lastServer->GetRating()->AddArticle(status == adFinished, m_bodyBytes,
+			std::chrono::duration_cast<std::chrono::microseconds>(
+				std::chrono::steady_clock::now() - m_bodyStartTime).count());
+	}
 
-		wantServer = nullptr;
-		if (connected && status == adFailed && remainedRetries > 0 && !retentionFailure)
-		{
-			wantServer = lastServer;
-		}
-		else
-		{
-			FreeConnection(status == adFinished || status == adNotFound);
-		}
+	if (m_connection)
+	{
+		AddServerData();
+	}
 
-		if (status == adFinished || status == adFatalError)
-		{
-			break;
-		}
+	bool connected = m_connected;
 
-		if (IsStopped() || ((g_WorkState->GetPauseDownload() || g_WorkState->GetQuotaReached()) && !force) ||
-			(g_WorkState->GetTempPauseDownload() && !m_fileInfo->GetExtraPriority()) ||
-			serverConfigGeneration != g_ServerPool->GetGeneration())
-		{
-			status = adRetry;
-			break;
-		}
+	if (!connected && m_connection)
+	{
+		detail("Article %s @ %s failed: could not establish connection", *m_infoName, *m_connectionName);
+	}
+
+	if (status == adConnectError)
+	{
+		connected = false;
+		status = adFailed;
+	}
+
+	if (connected && status == adFailed)
+	{
+		m_remainedRetries--;
+	}
+
+	bool optionalBlocked = false;
+	if (!connected && m_connection && !IsStopped())
+	{
+		g_ServerPool->BlockServer(m_lastServer);
+		optionalBlocked = m_lastServer->GetOptional();
+	}
+
+	m_wantServer = nullptr;
+	if (connected && status == adFailed && m_remainedRetries > 0 && !m_retentionFailure &&
+		!(m_connection && m_connection->IsPipelineBusy()))
+	{
+		m_wantServer = m_lastServer;
+	}
+	else
+	{
+		FreeConnection(status == adFinished || status == adNotFound);
+	}
+
+	if (status == adFinished || status == adFatalError)
+	{
+		return false;
+	}
 
-		if (!wantServer && (connected || retentionFailure || optionalBlocked))
+	if (IsStopped() || ((g_WorkState->GetPauseDownload() || g_WorkState->GetQuotaReached()) && !m_force) ||
+		(g_WorkState->GetTempPauseDownload() && !m_fileInfo->GetExtraPriority()) ||
+		m_serverConfigGeneration != g_ServerPool->GetGeneration())
+	{
+		status = adRetry;
+		return false;
+	}
+
+	if (!m_wantServer && (connected || m_retentionFailure || optionalBlocked))
+	{
+		if (!optionalBlocked)
 		{
-			if (!optionalBlocked)
-			{
-				failedServers.push_back(lastServer);
-			}
+			m_failedServers.push_back(m_lastServer);
+		}
 
-			// if all servers from current level were tried, increase level
-			// if all servers from all levels were tried, break the loop with failure status
+		// if all servers from current level were tried, increase level
+		// if all servers from all levels were tried, break the loop with failure status
 
-			bool allServersOnLevelFailed = true;
-			for (NewsServer* candidateServer : g_ServerPool->GetServers())
+		bool allServersOnLevelFailed = true;
+		for (NewsServer* candidateServer : g_ServerPool->GetServers())
+		{
+			if (candidateServer->GetNormLevel() == m_level)
 			{
-				if (candidateServer->GetNormLevel() == level)
+				bool serverFailed = !candidateServer->GetActive() || candidateServer->GetMaxConnections() == 0 ||
+					(candidateServer->GetOptional() && g_ServerPool->IsServerBlocked(candidateServer));
+				if (!serverFailed)
 				{
-					bool serverFailed = !candidateServer->GetActive() || candidateServer->GetMaxConnections() == 0 ||
-						(candidateServer->GetOptional() && g_ServerPool->IsServerBlocked(candidateServer));
-					if (!serverFailed)
+					for (NewsServer* ignoreServer : m_failedServers)
 					{
-						for (NewsServer* ignoreServer : failedServers)
+						if (ignoreServer == candidateServer ||
+							(ignoreServer->GetGroup() > 0 && ignoreServer->GetGroup() == candidateServer->GetGroup() &&
+							 ignoreServer->GetNormLevel() == candidateServer->GetNormLevel()))
 						{
-							if (ignoreServer == candidateServer ||
-								(ignoreServer->GetGroup() > 0 && ignoreServer->GetGroup() == candidateServer->GetGroup() &&
-								 ignoreServer->GetNormLevel() == candidateServer->GetNormLevel()))
-							{
-								serverFailed = true;
-								break;
-							}
+							serverFailed = true;
+							break;
 						}
 					}
-					if (!serverFailed)
-					{
-						allServersOnLevelFailed = false;
-						break;
-					}
 				}
-			}
-
-			if (allServersOnLevelFailed)
-			{
-				if (level < g_ServerPool->GetMaxNormLevel())
+				if (!serverFailed)
 				{
-					detail("Article %s @ all level %i servers failed, increasing level", *m_infoName, level);
-					level++;
-				}
-				else
-				{
-					detail("Article %s @ all servers failed", *m_infoName);
-					status = adFailed;
+					allServersOnLevelFailed = false;
 					break;
 				}
 			}
+		}
 
-			remainedRetries = retries;
+		if (allServersOnLevelFailed)
+		{
+			if (m_level < g_ServerPool->GetMaxNormLevel())
+			{
+				detail("Article %s @ all level %i servers failed, increasing level", *m_infoName, m_level);
+				m_level++;
+			}
+			else
+			{
+				detail("Article %s @ all servers failed", *m_infoName);
+				status = adFailed;
+				return false;
+			}
 		}
+
+		m_remainedRetries = m_retries;
+	}
+
+	return true;
+}
+
+void ArticleDownloader::Complete(EStatus status)
+{
+	if (m_pipelineConnection)
+	{
+		g_ServerPool->CancelPipelineRequest(m_pipelineConnection, m_articleInfo->GetMessageId());
+		m_pipelineConnection = nullptr;
 	}
 
 	FreeConnection(status == adFinished);
@@ -285,16 +444,53 @@ void ArticleDownloader::Run()
 
 	SetStatus(status);
 	Notify(nullptr);
-
-	debug("Exiting ArticleDownloader-loop");
 }
 
 ArticleDownloader::EStatus ArticleDownloader::Download()
+{
+	EStatus status = adRunning;
+
+	while (!IsStopped() && !GetEof() && status == adRunning)
+	{
+		status = ReceiveData();
+		Throttle();
+	}
+
+	return status;
+}
+
+/*
+ * Waits until the bandwidth used by the last portion of data is paid off.
+ */
+void ArticleDownloader::Throttle()
+{
+	std::chrono::steady_clock::time_point resumeTime = std::chrono::steady_clock::now() +
+		std::chrono::microseconds(m_throttleDelay);
+	m_throttleDelay = 0;
+
+	for (std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		now < resumeTime && !IsStopped(); now = std::chrono::steady_clock::now())
+	{
+		std::this_thread::sleep_for(std::min(resumeTime - now,
+			std::chrono::steady_clock::duration(std::chrono::milliseconds(THROTTLE_SLEEP_MSEC))));
+		SetLastUpdateTimeNow();
+	}
+}
+
+/*
+ * Sends the article request and checks the response.
+ * Returns "adRunning" if the article body follows.
+ */
+ArticleDownloader::EStatus ArticleDownloader::StartDownload()
 {
 	const char* response = nullptr;
 	EStatus status = adRunning;
 	m_writingStarted = false;
-	m_articleInfo->SetCrc(0);
+	if (!m_hedgeState->hedged)
+	{
+		// with duplicate downloads the crc is set by the download which delivers the article
+		m_articleInfo->SetCrc(0);
+	}
 
 	if (m_contentAnalyzer)
 	{
@@ -321,8 +517,9 @@ ArticleDownloader::EStatus ArticleDownloader::Download()
 	}
 
 	// retrieve article
-	response = m_connection->Request(BString<1024>("%s %s\r\n",
-		g_Options->GetRawArticle() ? "ARTICLE" : "BODY", m_articleInfo->GetMessageId()));
+	std::chrono::steady_clock::time_point requestTime = std::chrono::steady_clock::now();
+	response = m_connection->RequestArticle(g_Options->GetRawArticle() ? "ARTICLE" : "BODY",
+		m_articleInfo->GetMessageId());
 
 	status = CheckResponse(response, "could not fetch article");
 	if (status != adFinished)
@@ -330,63 +527,279 @@ ArticleDownloader::EStatus ArticleDownloader::Download()
 		return status;
 	}
 
+	m_bodyStartTime = std::chrono::steady_clock::now();
+	m_bodyBytes = 0;
+	m_lastServer->GetRating()->AddResponse(
+		std::chrono::duration_cast<std::chrono::microseconds>(m_bodyStartTime - requestTime).count());
+
 	m_decoder.Clear();
 	m_decoder.SetCrcCheck(g_Options->GetCrcCheck());
 	m_decoder.SetRawMode(g_Options->GetRawArticle());
 
-	status = adRunning;
-	CharBuffer lineBuf(1024*4);
+	if (m_decodeStream)
+	{
+		m_receiveEof = false;
+		// the body starts on a new line
+		m_articleEndState = 2;
+		m_decoderPool->Open(m_decodeStream.get());
+	}
+
+	return adRunning;
+}
 
-	while (!IsStopped() && !m_decoder.GetEof())
+/*
+ * Receives and processes one portion of article body.
+ * Returns "adRunning" if the data was processed successfully.
+ */
+ArticleDownloader::EStatus ArticleDownloader::ReceiveData()
+{
+	if (m_decodeStream)
 	{
-		// throttle the bandwidth
-		while (!IsStopped() && (g_WorkState->GetSpeedLimit() > 0.0f) &&
-			(g_StatMeter->CalcCurrentDownloadSpeed() > g_WorkState->GetSpeedLimit() ||
-			g_StatMeter->CalcMomentaryDownloadSpeed() > g_WorkState->GetSpeedLimit()))
+		return ReceiveChunk();
+	}
+
+	// Once the writing is started the yEnc-data is decoded directly into the article cache.
+	// The decoded data is never larger than encoded, therefore the amount of data received
+	// at once is limited to the room left in the cache segment.
+	int outputSize = 0;
+	char* output = m_writingStarted && m_decoder.GetFormat() == Decoder::efYenc ?
+		m_articleWriter.GetWriteBuffer(&outputSize) : nullptr;
+
+	char* buffer;
+	int len;
+	m_connection->ReadBuffer(&buffer, &len);
+	if (len == 0)
+	{
+		// receive buffer is sized to the article, the headers are received in small portions
+		int size = RECEIVE_BUFFER_MIN;
+		if (m_writingStarted)
 		{
-			SetLastUpdateTimeNow();
-			Util::Sleep(10);
+			size = std::min(std::max(m_articleInfo->GetSize(), RECEIVE_BUFFER_MIN), RECEIVE_BUFFER_MAX);
+			if (output && outputSize >= RECEIVE_BUFFER_MIN)
+			{
+				size = std::min(size, outputSize);
+			}
 		}
 
-		char* buffer;
-		int len;
-		m_connection->ReadBuffer(&buffer, &len);
-		if (len == 0)
+		// with speed limit the data is received in small portions to keep the traffic smooth
+		int maxSize = g_BandwidthLimiter->GetMaxReadSize();
+		if (maxSize > 0)
 		{
-			len = m_connection->TryRecv(lineBuf, lineBuf.Size());
-			buffer = lineBuf;
+			size = std::min(size, maxSize);
 		}
 
-		// have we encountered a timeout?
-		if (len <= 0)
+		if (m_lineBuf.Size() < size + 1)
 		{
-			if (!IsStopped())
-			{
-				detail("Article %s @ %s failed: Unexpected end of article", *m_infoName, *m_connectionName);
-			}
-			status = adFailed;
-			break;
+			m_lineBuf.Reserve(size + 1);
 		}
+		len = m_connection->TryRecv(m_lineBuf, size);
+		buffer = m_lineBuf;
+	}
 
-		g_StatMeter->AddSpeedReading(len);
-		time_t oldTime = m_lastUpdateTime;
-		SetLastUpdateTimeNow();
-		if (oldTime != m_lastUpdateTime)
+	if (len < 0 && m_connection->GetWouldBlock())
+	{
+		// non-blocking connection, no data yet
+		return adRunning;
+	}
+
+	if (len > outputSize)
+	{
+		output = nullptr;
+	}
+
+	// have we encountered a timeout?
+	if (len <= 0)
+	{
+		if (!IsStopped())
 		{
-			AddServerData();
+			detail("Article %s @ %s failed: Unexpected end of article", *m_infoName, *m_connectionName);
 		}
+		return adFailed;
+	}
+
+	CountReceived(len);
 
-		// decode article data
-		len = m_decoder.DecodeBuffer(buffer, len);
+	if (!DecodeData(buffer, len, output))
+	{
+		return adFatalError;
+	}
 
-		// write to output file
-		if (len > 0 && !Write(buffer, len))
+	if (m_decoder.GetRemainderLength() > 0)
+	{
+		// data of the next pipelined response
+		m_connection->UnreadBuffer(m_decoder.GetRemainder(), m_decoder.GetRemainderLength());
+	}
+
+	return adRunning;
+}
+
+/*
+ * With decoder threads the data is only received here and passed to the decoder pool.
+ * The end of article must be detected here as well, because the data after it belongs
+ * to the next pipelined response and must be left in the connection.
+ */
+ArticleDownloader::EStatus ArticleDownloader::ReceiveChunk()
+{
+	int size;
+	char* chunk = m_decodeStream->GetBuffer(&size);
+	if (!chunk)
+	{
+		return adFatalError;
+	}
+
+	// with speed limit the data is received in small portions to keep the traffic smooth
+	int maxSize = g_BandwidthLimiter->GetMaxReadSize();
+	if (maxSize > 0)
+	{
+		size = std::min(size, maxSize);
+	}
+
+	char* buffer;
+	int available;
+	int len;
+	m_connection->ReadBuffer(&buffer, &available);
+	if (available > 0)
+	{
+		len = std::min(available, size);
+		memcpy(chunk, buffer, len);
+	}
+	else
+	{
+		len = m_connection->TryRecv(chunk, size);
+		buffer = chunk;
+		available = len;
+	}
+
+	if (len < 0 && m_connection->GetWouldBlock())
+	{
+		// non-blocking connection, no data yet
+		return adRunning;
+	}
+
+	// have we encountered a timeout?
+	if (len <= 0)
+	{
+		if (!IsStopped())
 		{
-			status = adFatalError;
-			break;
+			detail("Article %s @ %s failed: Unexpected end of article", *m_infoName, *m_connectionName);
+		}
+		return adFailed;
+	}
+
+	int end = FindArticleEnd(chunk, len);
+	if (end > -1)
+	{
+		len = end;
+		m_receiveEof = true;
+	}
+
+	if (available > len)
+	{
+		// data of the next pipelined response or not yet copied data
+		m_connection->UnreadBuffer(buffer + len, available - len);
+	}
+
+	CountReceived(len);
+	m_decodeStream->Push(len);
+
+	return adRunning;
+}
+
+void ArticleDownloader::CountReceived(int len)
+{
+	g_StatMeter->AddSpeedReading(len);
+	m_bodyBytes += len;
+	m_receivedBytes += len;
+	if (g_BandwidthLimiter->IsActive())
+	{
+		m_throttleDelay = g_BandwidthLimiter->Consume(len, m_connection->GetNewsServer(), m_category);
+	}
+
+	time_t oldTime = m_lastUpdateTime;
+	SetLastUpdateTimeNow();
+	if (oldTime != m_lastUpdateTime)
+	{
+		AddServerData();
+	}
+}
+
+/*
+ * Looks for the line consisting of a single dot, which terminates the article.
+ * The search continues across the buffers.
+ * Returns the length of data up to and including the terminating line or -1.
+ */
+int ArticleDownloader::FindArticleEnd(const char* buffer, int len)
+{
+	static const char TERMINATOR[] = "\r\n.\r\n";
+
+	int state = m_articleEndState;
+	for (int i = 0; i < len; i++)
+	{
+		if (state == 0)
+		{
+			const char* cr = (const char*)memchr(buffer + i, '\r', len - i);
+			if (!cr)
+			{
+				break;
+			}
+			i = (int)(cr - buffer);
+		}
+
+		char ch = buffer[i];
+		state = ch == TERMINATOR[state] ? state + 1 : ch == '\r' ? 1 : 0;
+		if (state == sizeof(TERMINATOR) - 1)
+		{
+			m_articleEndState = 0;
+			return i + 1;
 		}
 	}
 
+	m_articleEndState = state;
+	return -1;
+}
+
+bool ArticleDownloader::DecodeData(char* buffer, int len, char* output)
+{
+	// decode article data
+	len = m_decoder.DecodeBuffer(buffer, len, output);
+	if (output)
+	{
+		buffer = output;
+	}
+
+	// write to output file
+	return len == 0 || Write(buffer, len);
+}
+
+/*
+ * Called by a thread of decoder pool.
+ */
+bool ArticleDownloader::DecodeChunk(char* buffer, int len)
+{
+	int outputSize = 0;
+	char* output = m_writingStarted && m_decoder.GetFormat() == Decoder::efYenc ?
+		m_articleWriter.GetWriteBuffer(&outputSize) : nullptr;
+
+	return DecodeData(buffer, len, len <= outputSize ? output : nullptr);
+}
+
+/*
+ * Waits until the decoder pool has processed all received data.
+ * Returns "false" if the decoding has failed.
+ */
+bool ArticleDownloader::WaitDecoded()
+{
+	if (!m_decodeStream)
+	{
+		return true;
+	}
+
+	m_decoderPool->Close(m_decodeStream.get());
+	return !m_decodeStream->GetFailed();
+}
+
+ArticleDownloader::EStatus ArticleDownloader::FinishDownload(EStatus status)
+{
 	if (IsStopped())
 	{
 		status = adFailed;
@@ -394,13 +807,47 @@ ArticleDownloader::EStatus ArticleDownloader::Download()
 
 	if (status == adRunning)
 	{
+		if (m_keepConnection)
+		{
+			KeepConnection();
+		}
 		FreeConnection(true);
-		status = DecodeCheck();
+		// the connection is already free while the decoding of the last data completes
+		status = WaitDecoded() ? DecodeCheck() : adFatalError;
+		if (status == adFinished && !ClaimArticle())
+		{
+			detail("Article %s @ %s discarded: already downloaded via another connection",
+				*m_infoName, *m_connectionName);
+			status = adFatalError;
+		}
+		if (status != adFinished && m_keptConnection)
+		{
+			// the article must be downloaded again, maybe from another server
+			g_ServerPool->FreeConnection(DetachConnection(), true);
+		}
+	}
+	else
+	{
+		WaitDecoded();
+		if (m_connection && m_connection->IsPipelineBusy())
+		{
+			// the article was read only partially, the responses to pipelined
+			// requests can't be read and must be requested again
+			m_connection->Disconnect();
+		}
 	}
 
 	if (m_writingStarted)
 	{
-		m_articleWriter.Finish(status == adFinished);
+		if (m_hedgeState->hedged && status != adFinished)
+		{
+			m_articleWriter.Discard();
+		}
+		else
+		{
+			m_articleWriter.Finish(status == adFinished);
+		}
+		m_writingStarted = false;
 	}
 
 	if (status == adFinished)
@@ -574,6 +1021,7 @@ void ArticleDownloader::FreeConnection(bool keepConnected)
 	{
 		debug("Releasing connection");
 		Guard guard(m_connectionMutex);
+		m_connection->CancelPipelineRequest(m_articleInfo->GetMessageId());
 		if (!keepConnected || m_connection->GetStatus() == Connection::csCancelled)
 		{
 			m_connection->Disconnect();
@@ -584,9 +1032,40 @@ void ArticleDownloader::FreeConnection(bool keepConnected)
 	}
 }
 
+/*
+ * Takes the connection away from the downloader without returning it to the server pool,
+ * so that it can be used for the next article. The connection is available via
+ * "DetachConnection()" after the download is completed.
+ */
+void ArticleDownloader::KeepConnection()
+{
+	if (m_connection && m_connection->GetStatus() == Connection::csConnected &&
+		!m_connection->IsPipelineBusy())
+	{
+		Guard guard(m_connectionMutex);
+		m_connection->CancelPipelineRequest(m_articleInfo->GetMessageId());
+		AddServerData();
+		m_keptConnection = m_connection;
+		m_connection = nullptr;
+	}
+}
+
+NntpConnection* ArticleDownloader::DetachConnection()
+{
+	NntpConnection* connection = m_keptConnection;
+	m_keptConnection = nullptr;
+	return connection;
+}
+
 void ArticleDownloader::AddServerData()
 {
 	int bytesRead = m_connection->FetchTotalBytesRead();
 	g_StatMeter->AddServerData(bytesRead, m_connection->GetNewsServer()->GetId());
 	m_downloadedSize += bytesRead;
+#ifndef DISABLE_GZIP
+	if (m_connection->GetCompression())
+	{
+		m_connection->GetNewsServer()->AddCompressedData(bytesRead, m_connection->FetchUncompressedBytesRead());
+	}
+#endif
 }
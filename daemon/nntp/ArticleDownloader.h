@@ -29,6 +29,9 @@
 #include "NntpConnection.h"
 #include "Decoder.h"
 #include "ArticleWriter.h"
+#include "ArticleDecoderPool.h"
+#include "ServerPool.h"
+#include "Options.h"
 #include "Util.h"
 
 class ArticleContentAnalyzer
@@ -73,17 +76,71 @@ public:
 	const char* GetInfoName() { return m_infoName; }
 	const char* GetConnectionName() { return m_connectionName; }
 	void SetConnection(NntpConnection* connection) { m_connection = connection; }
+	NntpConnection* GetConnection() { return m_connection; }
+	void SetPipelineConnection(NntpConnection* connection) { m_pipelineConnection = connection; }
+	void SetKeepConnection(bool keepConnection) { m_keepConnection = keepConnection; }
+	virtual NntpConnection* DetachConnection();
 	void CompleteFileParts() { m_articleWriter.CompleteFileParts(); }
 	int GetDownloadedSize() { return m_downloadedSize; }
 	void SetContentAnalyzer(std::unique_ptr<ArticleContentAnalyzer> contentAnalyzer) { m_contentAnalyzer = std::move(contentAnalyzer); }
 	ArticleContentAnalyzer* GetContentAnalyzer() { return m_contentAnalyzer.get(); }
+	int64 GetReceivedBytes() { return m_receivedBytes; }
+	NewsServer* GetNewsServer() { return m_attemptServer; }
+	void SetDecoderPool(ArticleDecoderPool* decoderPool);
+
+	void HedgeWith(ArticleDownloader* articleDownloader);
+	bool GetHedged() { return m_hedgeState->hedged; }
+	ArticleDownloader* GetHedgePartner() { return m_hedgePartner; }
+	void SetHedgePartner(ArticleDownloader* hedgePartner) { m_hedgePartner = hedgePartner; }
+	bool GetHedgeDiscarded() { return m_hedgeDiscarded; }
+	void SetHedgeDiscarded(bool hedgeDiscarded) { m_hedgeDiscarded = hedgeDiscarded; }
+	// returns "true" if the article is claimed by this download and not by its duplicate
+	bool ClaimArticle() { return !m_hedgeState->claimed.exchange(true); }
+	bool ResolveHedge();
 
 	void LogDebugInfo();
 
+	// download in steps, used by the event download engine instead of "Run()":
+	// "StartAttempt" and "FinishAttempt" may block, the article body can be received
+	// via "ReceiveData" from a non-blocking connection
+	void Prepare();
+	EStatus StartAttempt();
+	EStatus ReceiveData();
+	bool FinishAttempt(EStatus& status);
+	void Complete(EStatus status);
+	bool HasPendingData() { return m_connection && m_connection->HasPendingData(); }
+	bool GetEof() { return m_decodeStream ? m_receiveEof : m_decoder.GetEof(); }
+	// returns the time in microseconds the receiving must be paused for to obey the speed limit
+	int64 FetchThrottleDelay() { int64 delay = m_throttleDelay; m_throttleDelay = 0; return delay; }
+
+protected:
+	void SetStatus(EStatus status) { m_status = status; }
+
 private:
+	// duplicate downloads of the same article share the state, only the download
+	// which claims the article first delivers it, the other one is discarded
+	struct HedgeState
+	{
+		std::atomic<bool> hedged{false};
+		std::atomic<bool> claimed{false};
+	};
+
+	class DecodeStream : public ArticleDecoderPool::Stream
+	{
+	public:
+		DecodeStream(ArticleDownloader* owner) : m_owner(owner) {}
+	protected:
+		virtual bool Process(char* buffer, int len) { return m_owner->DecodeChunk(buffer, len); }
+	private:
+		ArticleDownloader* m_owner;
+	};
+
 	FileInfo* m_fileInfo;
 	ArticleInfo* m_articleInfo;
 	NntpConnection* m_connection = nullptr;
+	NntpConnection* m_pipelineConnection = nullptr;
+	NntpConnection* m_keptConnection = nullptr;
+	bool m_keepConnection = false;
 	EStatus m_status = adUndefined;
 	Mutex m_connectionMutex;
 	CString m_infoName;
@@ -96,12 +153,51 @@ private:
 	bool m_writingStarted;
 	int m_downloadedSize = 0;
 	std::unique_ptr<ArticleContentAnalyzer> m_contentAnalyzer;
+	CharBuffer m_lineBuf;
+	Options::Category* m_category = nullptr;
+	int64 m_throttleDelay = 0;
+	std::chrono::steady_clock::time_point m_bodyStartTime;
+	int64 m_bodyBytes = 0;
+	std::atomic<int64> m_receivedBytes{0};
+	std::atomic<NewsServer*> m_attemptServer{nullptr};
+	std::shared_ptr<HedgeState> m_hedgeState = std::make_shared<HedgeState>();
+	ArticleDownloader* m_hedgePartner = nullptr;
+	bool m_hedgeDiscarded = false;
+	ArticleDecoderPool* m_decoderPool = nullptr;
+	std::unique_ptr<DecodeStream> m_decodeStream;
+	bool m_receiveEof = false;
+	int m_articleEndState = 0;
+
+	// state of server management, kept between download attempts
+	int m_retries;
+	int m_remainedRetries;
+	ServerPool::RawServerList m_failedServers;
+	NewsServer* m_wantServer = nullptr;
+	NewsServer* m_lastServer = nullptr;
+	int m_level = 0;
+	int m_serverConfigGeneration = 0;
+	bool m_force = false;
+	bool m_connected = false;
+	bool m_retentionFailure = false;
+	bool m_downloadAttempted = false;
 
+	bool AcquireConnection(int waitMsec);
+	EStatus BeginAttempt();
+	bool EndAttempt(EStatus& status);
 	EStatus Download();
+	EStatus StartDownload();
+	EStatus ReceiveChunk();
+	void CountReceived(int len);
+	int FindArticleEnd(const char* buffer, int len);
+	bool DecodeData(char* buffer, int len, char* output);
+	bool DecodeChunk(char* buffer, int len);
+	bool WaitDecoded();
+	EStatus FinishDownload(EStatus status);
+	void Throttle();
 	EStatus DecodeCheck();
 	void FreeConnection(bool keepConnected);
+	void KeepConnection();
 	EStatus CheckResponse(const char* response, const char* comment);
-	void SetStatus(EStatus status) { m_status = status; }
 	bool Write(char* buffer, int len);
 	void AddServerData();
 };
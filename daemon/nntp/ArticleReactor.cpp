@@ -0,0 +1,479 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "nzbget.h"
+#include "ArticleReactor.h"
+#include "Log.h"
+#include "Util.h"
+#include "FileSystem.h"
+
+static const int REACTOR_MAX_LOOPS = 4;
+static const int REACTOR_MAX_EVENTS = 64;
+// interval for checking of stopped downloaders, their sockets may be closed already
+static const int REACTOR_CHECK_MSEC = 100;
+
+ArticleReactor::ArticleReactor()
+{
+	int loops = std::max(std::min((int)std::thread::hardware_concurrency(), REACTOR_MAX_LOOPS), 1);
+	for (int i = 0; i < loops; i++)
+	{
+		m_loops.push_back(std::make_unique<EventLoop>(this));
+	}
+}
+
+bool ArticleReactor::IsSupported()
+{
+#ifdef HAVE_SYS_EPOLL_H
+	return true;
+#else
+	return false;
+#endif
+}
+
+void ArticleReactor::Start()
+{
+	info("Using event download engine with %i event loop(s)", (int)m_loops.size());
+
+	for (std::unique_ptr<EventLoop>& loop : m_loops)
+	{
+		loop->Start();
+	}
+}
+
+void ArticleReactor::Stop()
+{
+	debug("Stopping ArticleReactor");
+
+	{
+		Guard guard(m_jobsMutex);
+		m_stopped = true;
+		m_jobsCond.NotifyAll();
+	}
+
+	for (std::unique_ptr<EventLoop>& loop : m_loops)
+	{
+		loop->Stop();
+	}
+
+	for (std::unique_ptr<EventLoop>& loop : m_loops)
+	{
+		while (loop->IsRunning())
+		{
+			Util::Sleep(10);
+		}
+	}
+
+	for (std::unique_ptr<Worker>& worker : m_workers)
+	{
+		while (worker->IsRunning())
+		{
+			Util::Sleep(10);
+		}
+	}
+
+	debug("ArticleReactor stopped");
+}
+
+void ArticleReactor::AddDownloader(ArticleDownloader* articleDownloader)
+{
+	AddJob(articleDownloader, ArticleDownloader::adUndefined);
+}
+
+void ArticleReactor::AddJob(ArticleDownloader* articleDownloader, ArticleDownloader::EStatus status)
+{
+	Guard guard(m_jobsMutex);
+
+	m_jobs.push_back({articleDownloader, status});
+
+	if (m_idleWorkers < (int)m_jobs.size())
+	{
+		debug("Starting new reactor worker");
+		m_workers.push_back(std::make_unique<Worker>(this));
+		m_workers.back()->Start();
+	}
+	else
+	{
+		m_jobsCond.NotifyOne();
+	}
+}
+
+bool ArticleReactor::TakeJob(Job& job)
+{
+	Guard guard(m_jobsMutex);
+
+	m_idleWorkers++;
+	m_jobsCond.Wait(m_jobsMutex, [&]{ return !m_jobs.empty() || m_stopped; });
+	m_idleWorkers--;
+
+	if (m_jobs.empty())
+	{
+		return false;
+	}
+
+	job = m_jobs.front();
+	m_jobs.pop_front();
+	return true;
+}
+
+/*
+ * Passes the downloader, which is ready to receive the article body, to the least loaded event loop.
+ */
+void ArticleReactor::StartReceiving(ArticleDownloader* articleDownloader)
+{
+	EventLoop* bestLoop = nullptr;
+	int bestLoad = 0;
+	for (std::unique_ptr<EventLoop>& loop : m_loops)
+	{
+		int load = loop->GetLoad();
+		if (!bestLoop || load < bestLoad)
+		{
+			bestLoop = loop.get();
+			bestLoad = load;
+		}
+	}
+
+	bestLoop->AddDownloader(articleDownloader);
+}
+
+void ArticleReactor::Worker::Run()
+{
+	debug("Entering ArticleReactor-worker-loop");
+
+	Job job;
+	while (m_owner->TakeJob(job))
+	{
+		Execute(job);
+	}
+
+	debug("Exiting ArticleReactor-worker-loop");
+}
+
+void ArticleReactor::Worker::Execute(Job& job)
+{
+	ArticleDownloader* articleDownloader = job.downloader;
+	ArticleDownloader::EStatus status = job.status;
+
+	if (status == ArticleDownloader::adUndefined)
+	{
+		articleDownloader->Prepare();
+		status = articleDownloader->StartAttempt();
+	}
+	else if (articleDownloader->FinishAttempt(status))
+	{
+		status = articleDownloader->StartAttempt();
+	}
+
+	if (status == ArticleDownloader::adRunning)
+	{
+		m_owner->StartReceiving(articleDownloader);
+		return;
+	}
+
+	articleDownloader->Complete(status);
+	if (articleDownloader->GetAutoDestroy())
+	{
+		delete articleDownloader;
+	}
+}
+
+ArticleReactor::EventLoop::EventLoop(ArticleReactor* owner) : m_owner(owner)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	m_epollFd = epoll_create1(0);
+	if (m_epollFd == -1)
+	{
+		error("Could not create epoll instance: %s", *FileSystem::GetLastErrorMessage());
+	}
+
+	if (pipe(m_wakeupPipe) == 0)
+	{
+		fcntl(m_wakeupPipe[0], F_SETFL, O_NONBLOCK);
+		fcntl(m_wakeupPipe[1], F_SETFL, O_NONBLOCK);
+		epoll_event event{};
+		event.events = EPOLLIN;
+		event.data.ptr = nullptr;
+		epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeupPipe[0], &event);
+	}
+#endif
+}
+
+ArticleReactor::EventLoop::~EventLoop()
+{
+#ifdef HAVE_SYS_EPOLL_H
+	for (int fd : {m_epollFd, m_wakeupPipe[0], m_wakeupPipe[1]})
+	{
+		if (fd != -1)
+		{
+			close(fd);
+		}
+	}
+#endif
+}
+
+int ArticleReactor::EventLoop::GetLoad()
+{
+	Guard guard(m_incomingMutex);
+	return m_load;
+}
+
+void ArticleReactor::EventLoop::AddDownloader(ArticleDownloader* articleDownloader)
+{
+	{
+		Guard guard(m_incomingMutex);
+		m_incoming.push_back(articleDownloader);
+		m_load++;
+	}
+	WakeUp();
+}
+
+void ArticleReactor::EventLoop::Stop()
+{
+	Thread::Stop();
+	WakeUp();
+}
+
+void ArticleReactor::EventLoop::WakeUp()
+{
+#ifdef HAVE_SYS_EPOLL_H
+	if (m_wakeupPipe[1] != -1)
+	{
+		char ch = 0;
+		(void)!write(m_wakeupPipe[1], &ch, 1);
+	}
+#endif
+}
+
+void ArticleReactor::EventLoop::TakeIncoming()
+{
+	Downloaders incoming;
+	{
+		Guard guard(m_incomingMutex);
+		incoming = std::move(m_incoming);
+		m_incoming.clear();
+	}
+
+	for (ArticleDownloader* articleDownloader : incoming)
+	{
+		m_entries.push_back({articleDownloader, esReceiving, INVALID_SOCKET});
+		Entry& entry = m_entries.back();
+		if (!Register(entry))
+		{
+			Finish(entry, ArticleDownloader::adFailed);
+		}
+		else if (articleDownloader->HasPendingData())
+		{
+			// the beginning of the body was received together with the response
+			Process(entry);
+		}
+	}
+}
+
+void ArticleReactor::EventLoop::Run()
+{
+	debug("Entering ArticleReactor-loop");
+
+#ifdef HAVE_SYS_EPOLL_H
+	epoll_event events[REACTOR_MAX_EVENTS];
+
+	while (!IsStopped())
+	{
+		TakeIncoming();
+
+		// throttled downloaders are resumed once their bandwidth is paid off
+		int timeout = REACTOR_CHECK_MSEC;
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		for (Entry& entry : m_entries)
+		{
+			if (entry.state == esThrottled)
+			{
+				entry.downloader->SetLastUpdateTimeNow();
+				int remaining = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+					entry.resumeTime - now).count() + 1;
+				timeout = std::max(std::min(timeout, remaining), 0);
+			}
+		}
+
+		int eventCount = epoll_wait(m_epollFd, events, REACTOR_MAX_EVENTS, timeout);
+
+		for (int i = 0; i < eventCount; i++)
+		{
+			Entry* entry = (Entry*)events[i].data.ptr;
+			if (!entry)
+			{
+				char buf[64];
+				while (read(m_wakeupPipe[0], buf, sizeof(buf)) > 0) ;
+				continue;
+			}
+
+			Process(*entry);
+		}
+
+		now = std::chrono::steady_clock::now();
+		for (Entries::iterator it = m_entries.begin(); it != m_entries.end(); )
+		{
+			Entry& entry = *it;
+			if (entry.state == esThrottled && (entry.resumeTime <= now || entry.downloader->IsStopped()))
+			{
+				Resume(entry);
+			}
+
+			if (entry.state == esReceiving && entry.downloader->IsStopped())
+			{
+				Finish(entry, ArticleDownloader::adFailed);
+			}
+
+			if (entry.state == esCompleted)
+			{
+				it = m_entries.erase(it);
+				Guard guard(m_incomingMutex);
+				m_load--;
+			}
+			else
+			{
+				it++;
+			}
+		}
+	}
+#endif
+
+	debug("Exiting ArticleReactor-loop");
+}
+
+/*
+ * Receives the data available on the connection without waiting for the network.
+ * Once the article body is received the downloader is passed back to the workers.
+ */
+void ArticleReactor::EventLoop::Process(Entry& entry)
+{
+	if (entry.state != esReceiving)
+	{
+		return;
+	}
+
+	ArticleDownloader* downloader = entry.downloader;
+	ArticleDownloader::EStatus status;
+	int64 throttleDelay;
+
+	do
+	{
+		status = downloader->ReceiveData();
+		throttleDelay = downloader->FetchThrottleDelay();
+	} while (status == ArticleDownloader::adRunning && !downloader->GetEof() &&
+		throttleDelay == 0 && downloader->HasPendingData());
+
+	if (status == ArticleDownloader::adRunning && !downloader->GetEof() && !downloader->IsStopped())
+	{
+		if (throttleDelay > 0)
+		{
+			Throttle(entry, throttleDelay);
+		}
+		return;
+	}
+
+	Finish(entry, status);
+}
+
+bool ArticleReactor::EventLoop::Register(Entry& entry)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	NntpConnection* connection = entry.downloader->GetConnection();
+	if (!connection->SetNonBlocking(true))
+	{
+		return false;
+	}
+
+	entry.socket = connection->GetSocket();
+	epoll_event event{};
+	event.events = EPOLLIN;
+	event.data.ptr = &entry;
+	if (entry.socket == INVALID_SOCKET || epoll_ctl(m_epollFd, EPOLL_CTL_ADD, entry.socket, &event) != 0)
+	{
+		entry.socket = INVALID_SOCKET;
+		connection->SetNonBlocking(false);
+		return false;
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+void ArticleReactor::EventLoop::Unregister(Entry& entry)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	// the socket may be already closed by cancelling of the download
+	NntpConnection* connection = entry.downloader->GetConnection();
+	if (entry.socket != INVALID_SOCKET && connection->GetSocket() == entry.socket)
+	{
+		epoll_ctl(m_epollFd, EPOLL_CTL_DEL, entry.socket, nullptr);
+		connection->SetNonBlocking(false);
+	}
+#endif
+	entry.socket = INVALID_SOCKET;
+}
+
+/*
+ * Returns the downloader to the workers, which finish the download and make another attempt if needed.
+ */
+void ArticleReactor::EventLoop::Finish(Entry& entry, ArticleDownloader::EStatus status)
+{
+	Unregister(entry);
+	entry.state = esCompleted;
+	m_owner->AddJob(entry.downloader, status);
+}
+
+/*
+ * Stops watching the connection until the bandwidth used by the downloader is paid off.
+ * The data is left in socket buffers meanwhile. The socket is removed from epoll
+ * completely, since hang-ups and errors are reported even without requested events
+ * and would wake up the loop over and over again.
+ */
+void ArticleReactor::EventLoop::Throttle(Entry& entry, int64 delay)
+{
+	entry.state = esThrottled;
+	entry.resumeTime = std::chrono::steady_clock::now() + std::chrono::microseconds(delay);
+
+#ifdef HAVE_SYS_EPOLL_H
+	epoll_ctl(m_epollFd, EPOLL_CTL_DEL, entry.socket, nullptr);
+#endif
+}
+
+void ArticleReactor::EventLoop::Resume(Entry& entry)
+{
+	entry.state = esReceiving;
+
+#ifdef HAVE_SYS_EPOLL_H
+	epoll_event event{};
+	event.events = EPOLLIN;
+	event.data.ptr = &entry;
+	if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, entry.socket, &event) != 0)
+	{
+		// the socket was closed meanwhile by cancelling of the download
+		Finish(entry, ArticleDownloader::adFailed);
+		return;
+	}
+#endif
+
+	if (entry.downloader->HasPendingData())
+	{
+		Process(entry);
+	}
+}
@@ -0,0 +1,130 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef ARTICLEREACTOR_H
+#define ARTICLEREACTOR_H
+
+#include "Thread.h"
+#include "ArticleDownloader.h"
+
+/*
+ * Event driven download engine (option "DownloadEngine=event").
+ * Instead of running each article downloader in its own thread a few event loops
+ * serve all downloaders, waiting for their non-blocking connections to become readable
+ * via epoll. The phases of download which may block (waiting for a free connection,
+ * connecting, requesting the article and finishing the download) are executed by
+ * a pool of worker threads; the server management logic (retries, levels)
+ * of ArticleDownloader is used as is.
+ */
+class ArticleReactor
+{
+public:
+	ArticleReactor();
+	static bool IsSupported();
+	void Start();
+	void Stop();
+	void AddDownloader(ArticleDownloader* articleDownloader);
+
+private:
+	struct Job
+	{
+		ArticleDownloader* downloader;
+		// the status of the received article body or "adUndefined" for a new downloader
+		ArticleDownloader::EStatus status;
+	};
+
+	class Worker : public Thread
+	{
+	public:
+		Worker(ArticleReactor* owner) : m_owner(owner) {}
+		virtual void Run();
+
+	private:
+		ArticleReactor* m_owner;
+
+		void Execute(Job& job);
+	};
+
+	class EventLoop : public Thread
+	{
+	public:
+		EventLoop(ArticleReactor* owner);
+		virtual ~EventLoop();
+		virtual void Run();
+		virtual void Stop();
+		void AddDownloader(ArticleDownloader* articleDownloader);
+		int GetLoad();
+
+	private:
+		enum EState
+		{
+			esReceiving,
+			esThrottled,
+			esCompleted
+		};
+
+		struct Entry
+		{
+			ArticleDownloader* downloader;
+			EState state;
+			SOCKET socket;
+			std::chrono::steady_clock::time_point resumeTime;
+		};
+
+		typedef std::list<Entry> Entries;
+		typedef std::vector<ArticleDownloader*> Downloaders;
+
+		ArticleReactor* m_owner;
+		int m_epollFd = -1;
+		int m_wakeupPipe[2] = {-1, -1};
+		Entries m_entries;
+		Downloaders m_incoming;
+		Mutex m_incomingMutex;
+		int m_load = 0;
+
+		void TakeIncoming();
+		void WakeUp();
+		void Process(Entry& entry);
+		bool Register(Entry& entry);
+		void Unregister(Entry& entry);
+		void Finish(Entry& entry, ArticleDownloader::EStatus status);
+		void Throttle(Entry& entry, int64 delay);
+		void Resume(Entry& entry);
+	};
+
+	typedef std::vector<std::unique_ptr<EventLoop>> EventLoops;
+	typedef std::vector<std::unique_ptr<Worker>> Workers;
+	typedef std::deque<Job> Jobs;
+
+	EventLoops m_loops;
+	Workers m_workers;
+	Jobs m_jobs;
+	int m_idleWorkers = 0;
+	bool m_stopped = false;
+	Mutex m_jobsMutex;
+	ConditionVar m_jobsCond;
+
+	void AddJob(ArticleDownloader* articleDownloader, ArticleDownloader::EStatus status);
+	bool TakeJob(Job& job);
+	void StartReceiving(ArticleDownloader* articleDownloader);
+};
+
+#endif
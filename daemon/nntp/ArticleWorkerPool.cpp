@@ -0,0 +1,153 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "nzbget.h"
+#include "ArticleWorkerPool.h"
+#include "ServerPool.h"
+#include "Log.h"
+#include "Util.h"
+
+void ArticleWorkerPool::Stop()
+{
+	debug("Stopping ArticleWorkerPool");
+
+	{
+		Guard guard(m_jobsMutex);
+		m_stopped = true;
+		m_jobsCond.NotifyAll();
+	}
+
+	for (std::unique_ptr<Worker>& worker : m_workers)
+	{
+		while (worker->IsRunning())
+		{
+			Util::Sleep(10);
+		}
+	}
+
+	debug("ArticleWorkerPool stopped");
+}
+
+void ArticleWorkerPool::AddDownloader(ArticleDownloader* articleDownloader)
+{
+	Guard guard(m_jobsMutex);
+
+	m_jobs.push_back(articleDownloader);
+	RemoveRetiredWorkers();
+
+	if (m_idleWorkers < (int)m_jobs.size() &&
+		(m_maxWorkers == 0 || (int)m_workers.size() - m_retiredWorkers < m_maxWorkers))
+	{
+		debug("Starting new article worker");
+		m_workers.push_back(std::make_unique<Worker>(this));
+		m_workers.back()->Start();
+	}
+	else
+	{
+		m_jobsCond.NotifyOne();
+	}
+}
+
+/*
+ * Objects of exited workers are deleted when the next download is added.
+ * Must be called with locked jobs mutex.
+ */
+void ArticleWorkerPool::RemoveRetiredWorkers()
+{
+	m_workers.erase(std::remove_if(m_workers.begin(), m_workers.end(),
+		[&](std::unique_ptr<Worker>& worker)
+		{
+			if (worker->GetRetired() && !worker->IsRunning())
+			{
+				m_retiredWorkers--;
+				return true;
+			}
+			return false;
+		}), m_workers.end());
+}
+
+/*
+ * Waits for the next download. Returns "nullptr" if the pool is stopped or if the worker
+ * was idle for too long and should exit.
+ */
+ArticleDownloader* ArticleWorkerPool::TakeJob(Worker* worker)
+{
+	Guard guard(m_jobsMutex);
+
+	m_idleWorkers++;
+	m_jobsCond.WaitFor(m_jobsMutex, m_idleTimeoutMsec, [&]{ return !m_jobs.empty() || m_stopped; });
+	m_idleWorkers--;
+
+	if (m_jobs.empty())
+	{
+		if (!m_stopped)
+		{
+			debug("Retiring idle article worker");
+			worker->m_retired = true;
+			m_retiredWorkers++;
+		}
+		return nullptr;
+	}
+
+	ArticleDownloader* articleDownloader = m_jobs.front();
+	m_jobs.pop_front();
+	return articleDownloader;
+}
+
+void ArticleWorkerPool::Worker::Run()
+{
+	debug("Entering ArticleWorker-loop");
+
+	while (ArticleDownloader* articleDownloader = m_owner->TakeJob(this))
+	{
+		Execute(articleDownloader);
+	}
+
+	debug("Exiting ArticleWorker-loop");
+}
+
+void ArticleWorkerPool::Worker::Execute(ArticleDownloader* articleDownloader)
+{
+	while (articleDownloader)
+	{
+		// the file may be already deleted when the download completes, remember its id
+		int fileId = articleDownloader->GetFileInfo()->GetId();
+
+		articleDownloader->SetKeepConnection(true);
+		articleDownloader->Run();
+		NntpConnection* connection = articleDownloader->DetachConnection();
+
+		if (articleDownloader->GetAutoDestroy())
+		{
+			delete articleDownloader;
+		}
+		articleDownloader = nullptr;
+
+		if (connection)
+		{
+			articleDownloader = m_owner->m_jobSource->ContinueDownload(fileId, connection);
+			if (!articleDownloader)
+			{
+				g_ServerPool->FreeConnection(connection, true);
+			}
+		}
+	}
+}
@@ -0,0 +1,94 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef ARTICLEWORKERPOOL_H
+#define ARTICLEWORKERPOOL_H
+
+#include "Thread.h"
+#include "ArticleDownloader.h"
+
+/*
+ * Pool of long-lived threads used by pool download engine.
+ * Instead of starting a new thread for each article the downloaders are executed by
+ * worker threads, which are created on demand (up to the given maximum) and then reused.
+ * Workers being idle for a while exit, so the pool shrinks after a peak.
+ * After a successful download the worker keeps the connection and asks the job source
+ * (queue coordinator) for the next article of the same file; the connection is returned
+ * to the server pool only if there is no such article.
+ */
+class ArticleWorkerPool
+{
+public:
+	class JobSource
+	{
+	public:
+		virtual ~JobSource() {};
+		// returns a downloader for the next article of the file, which must be
+		// downloaded via given connection, or "nullptr"
+		virtual ArticleDownloader* ContinueDownload(int fileId, NntpConnection* connection) = 0;
+	};
+
+	ArticleWorkerPool(JobSource* jobSource) : m_jobSource(jobSource) {}
+	void Stop();
+	void AddDownloader(ArticleDownloader* articleDownloader);
+	// "0" - unlimited; further downloads wait in the queue for a free worker
+	void SetMaxWorkers(int maxWorkers) { Guard guard(m_jobsMutex); m_maxWorkers = maxWorkers; }
+	void SetIdleTimeout(int idleTimeoutMsec) { Guard guard(m_jobsMutex); m_idleTimeoutMsec = idleTimeoutMsec; }
+	int GetWorkerCount() { Guard guard(m_jobsMutex); return (int)m_workers.size() - m_retiredWorkers; }
+	int GetIdleWorkerCount() { Guard guard(m_jobsMutex); return m_idleWorkers; }
+
+private:
+	class Worker : public Thread
+	{
+	public:
+		Worker(ArticleWorkerPool* owner) : m_owner(owner) {}
+		virtual void Run();
+		bool GetRetired() { return m_retired; }
+
+	private:
+		ArticleWorkerPool* m_owner;
+		// guarded by jobs mutex
+		bool m_retired = false;
+
+		void Execute(ArticleDownloader* articleDownloader);
+
+		friend class ArticleWorkerPool;
+	};
+
+	typedef std::vector<std::unique_ptr<Worker>> Workers;
+	typedef std::deque<ArticleDownloader*> Jobs;
+
+	JobSource* m_jobSource;
+	Workers m_workers;
+	Jobs m_jobs;
+	int m_idleWorkers = 0;
+	int m_retiredWorkers = 0;
+	int m_maxWorkers = 0;
+	int m_idleTimeoutMsec = 60000;
+	bool m_stopped = false;
+	Mutex m_jobsMutex;
+	ConditionVar m_jobsCond;
+
+	ArticleDownloader* TakeJob(Worker* worker);
+	void RemoveRetiredWorkers();
+};
+
+#endif
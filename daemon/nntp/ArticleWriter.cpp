@@ -25,6 +25,7 @@
 #include "Log.h"
 #include "Util.h"
 #include "FileSystem.h"
+#include "IoUring.h"
 
 CachedSegmentData::~CachedSegmentData()
 {
@@ -61,6 +62,7 @@ bool ArticleWriter::Start(Decoder::EFormat format, const char* filename, int64 f
 	int64 articleOffset, int articleSize)
 {
 	m_outFile.Close();
+	m_outputMapping.reset();
 	m_format = format;
 	m_articleOffset = articleOffset;
 	m_articleSize = articleSize ? articleSize : m_articleInfo->GetSize();
@@ -102,11 +104,17 @@ bool ArticleWriter::Start(Decoder::EFormat format, const char* filename, int64 f
 				}
 				m_fileInfo->SetOutputInitialized(true);
 			}
+
+			if (g_Options->GetWriteEngine() == Options::weMmap && !m_cacheOnly &&
+				!g_Options->GetRawArticle() && !g_Options->GetSkipWrite())
+			{
+				MapOutputFile(fileSize);
+			}
 		}
 	}
 
 	// allocate cache buffer
-	if (g_Options->GetArticleCache() > 0 && !g_Options->GetRawArticle() &&
+	if (g_Options->GetArticleCache() > 0 && !g_Options->GetRawArticle() && !m_outputMapping &&
 		(!g_Options->GetDirectWrite() || m_format == Decoder::efYenc))
 	{
 		m_articleData = g_ArticleCache->Alloc(m_articleSize);
@@ -117,13 +125,19 @@ bool ArticleWriter::Start(Decoder::EFormat format, const char* filename, int64 f
 			m_articleData = g_ArticleCache->Alloc(m_articleSize);
 		}
 
-		if (!m_articleData.GetData())
+		if (!m_articleData.GetData() && !m_cacheOnly)
 		{
 			detail("Article cache is full, using disk for %s", *m_infoName);
 		}
 	}
 
-	if (!m_articleData.GetData())
+	if (!m_articleData.GetData() && m_cacheOnly)
+	{
+		detail("Article cache is full, cancelling duplicate download of %s", *m_infoName);
+		return false;
+	}
+
+	if (!m_articleData.GetData() && !m_outputMapping)
 	{
 		bool directWrite = (g_Options->GetDirectWrite() || m_fileInfo->GetForceDirectWrite()) && m_format == Decoder::efYenc;
 		const char* outFilename = directWrite ? m_outputFilename : m_tempFilename;
@@ -163,7 +177,21 @@ bool ArticleWriter::Write(char* buffer, int len)
 
 	if (!g_Options->GetRawArticle() && m_articleData.GetData())
 	{
-		memcpy(m_articleData.GetData() + m_articlePtr - len, buffer, len);
+		char* dest = m_articleData.GetData() + m_articlePtr - len;
+		if (buffer != dest)
+		{
+			memcpy(dest, buffer, len);
+		}
+		return true;
+	}
+
+	if (m_outputMapping)
+	{
+		char* dest = m_outputMapping->GetData() + m_articleOffset + m_articlePtr - len;
+		if (buffer != dest)
+		{
+			memcpy(dest, buffer, len);
+		}
 		return true;
 	}
 
@@ -175,9 +203,37 @@ bool ArticleWriter::Write(char* buffer, int len)
 	return m_outFile.Write(buffer, len) > 0;
 }
 
+/*
+ * Returns the place in the article cache or in the mapped output file where the next
+ * portion of decoded data can be put directly, without copying it in Write(), and the
+ * room left there. Returns nullptr if the article is written via file operations.
+ */
+char* ArticleWriter::GetWriteBuffer(int* size)
+{
+	if (g_Options->GetRawArticle() || m_articlePtr >= m_articleSize)
+	{
+		return nullptr;
+	}
+
+	if (m_articleData.GetData())
+	{
+		*size = m_articleSize - m_articlePtr;
+		return m_articleData.GetData() + m_articlePtr;
+	}
+
+	if (m_outputMapping)
+	{
+		*size = m_articleSize - m_articlePtr;
+		return m_outputMapping->GetData() + m_articleOffset + m_articlePtr;
+	}
+
+	return nullptr;
+}
+
 void ArticleWriter::Finish(bool success)
 {
 	m_outFile.Close();
+	m_outputMapping.reset();
 
 	if (!success)
 	{
@@ -210,6 +266,7 @@ void ArticleWriter::Finish(bool success)
 			Guard contentGuard = g_ArticleCache->GuardContent();
 			m_articleInfo->AttachSegment(std::make_unique<CachedSegmentData>(std::move(m_articleData)), m_articleOffset, m_articlePtr);
 			m_fileInfo->SetCachedArticles(m_fileInfo->GetCachedArticles() + 1);
+			g_ArticleCache->FileCached(m_fileInfo, m_articlePtr);
 		}
 		else
 		{
@@ -229,6 +286,24 @@ void ArticleWriter::Finish(bool success)
 	}
 }
 
+/*
+ * Drops the downloaded data without touching the result of the article,
+ * which may have been produced by another download of the same article.
+ */
+void ArticleWriter::Discard()
+{
+	bool directWrite = (g_Options->GetDirectWrite() || m_fileInfo->GetForceDirectWrite()) && m_format == Decoder::efYenc;
+	bool tempFile = m_outFile.Active() && !directWrite;
+
+	m_outFile.Close();
+	if (tempFile)
+	{
+		FileSystem::DeleteFile(m_tempFilename);
+	}
+	m_articleData = CachedSegmentData();
+	m_outputMapping.reset();
+}
+
 /* creates output file and subdirectores */
 bool ArticleWriter::CreateOutputFile(int64 size)
 {
@@ -265,6 +340,34 @@ bool ArticleWriter::CreateOutputFile(int64 size)
 	return true;
 }
 
+/*
+ * Maps the output file into memory when the first article of the file is written,
+ * the articles are then decoded directly into the file. Must be called with locked
+ * output file. If the file can't be mapped the articles are written via file operations.
+ */
+void ArticleWriter::MapOutputFile(int64 fileSize)
+{
+	std::shared_ptr<MappedFile> mapping = m_fileInfo->GetOutputMapping();
+
+	// never write into a mapping of a file which was replaced in the meantime
+	if (!mapping || strcmp(mapping->GetFilename(), m_outputFilename))
+	{
+		mapping = std::make_shared<MappedFile>();
+		if (!mapping->Open(m_outputFilename, fileSize))
+		{
+			detail("Could not map file %s into memory, writing it via file operations: %s",
+				*m_outputFilename, *FileSystem::GetLastErrorMessage());
+		}
+		// a failed mapping is kept as well to not try it again for every article
+		m_fileInfo->SetOutputMapping(mapping);
+	}
+
+	if (mapping->GetData() && m_articleOffset + m_articleSize <= mapping->GetSize())
+	{
+		m_outputMapping = mapping;
+	}
+}
+
 void ArticleWriter::BuildOutputFilename()
 {
 	BString<1024> filename("%s%c%i.%03i", g_Options->GetTempDir(), PATH_SEPARATOR,
@@ -292,6 +395,165 @@ void ArticleWriter::BuildOutputFilename()
 	}
 }
 
+/*
+ * Writes cached segments of a file in direct write mode. Segments lying next to each
+ * other in the file go into one vectored write or, if io_uring is active, are queued
+ * for asynchronous writing.
+ */
+class SegmentWriter
+{
+public:
+	SegmentWriter(DiskFile& outFile, const char* filename);
+	~SegmentWriter();
+	/*
+	 * Writes the run of adjacent segments beginning with article "first", the articles
+	 * must be sorted by offset. Returns the index of the first article not written.
+	 */
+	int WriteRun(std::vector<ArticleInfo*>& articles, int first);
+	// waits for queued writes, the segments must be kept until then
+	bool Finish();
+
+private:
+	DiskFile& m_outFile;
+	std::unique_ptr<IoUring::Batch> m_batch;
+	int m_fd = -1;
+	int m_directFd = -1;
+	// alignment of ranges written via O_DIRECT: page size or file system block size
+	int m_directAlign = 0;
+	bool m_failed = false;
+
+	void WriteSegment(const char* buffer, int size, int64 offset);
+};
+
+SegmentWriter::SegmentWriter(DiskFile& outFile, const char* filename) : m_outFile(outFile)
+{
+#ifndef WIN32
+	IoUring* ioUring = g_ArticleCache->GetIoUring();
+	if (!ioUring || g_Options->GetSkipWrite())
+	{
+		return;
+	}
+
+	m_fd = open(filename, O_WRONLY);
+	if (m_fd < 0)
+	{
+		return;
+	}
+
+#ifdef O_DIRECT
+	if (g_Options->GetWriteEngine() == Options::weUringDirect)
+	{
+		m_directFd = open(filename, O_WRONLY | O_DIRECT);
+		struct stat buffer;
+		m_directAlign = (int)std::max(sysconf(_SC_PAGESIZE),
+			fstat(m_fd, &buffer) == 0 ? (long)buffer.st_blksize : 0L);
+	}
+#endif
+
+	m_batch = std::make_unique<IoUring::Batch>(ioUring);
+#endif
+}
+
+SegmentWriter::~SegmentWriter()
+{
+	m_batch.reset();
+
+#ifndef WIN32
+	if (m_directFd > -1)
+	{
+		close(m_directFd);
+	}
+	if (m_fd > -1)
+	{
+		close(m_fd);
+	}
+#endif
+}
+
+int SegmentWriter::WriteRun(std::vector<ArticleInfo*>& articles, int first)
+{
+	std::vector<DiskFile::WriteSegment> segments;
+	int64 runEnd = articles[first]->GetSegmentOffset();
+	int index = first;
+
+	for (; index < (int)articles.size() && articles[index]->GetSegmentOffset() == runEnd; index++)
+	{
+		ArticleInfo* pa = articles[index];
+		segments.push_back({pa->GetSegmentContent(), pa->GetSegmentSize()});
+		runEnd += pa->GetSegmentSize();
+	}
+
+	if (g_Options->GetSkipWrite())
+	{
+		return index;
+	}
+
+	if (m_batch)
+	{
+		int64 offset = articles[first]->GetSegmentOffset();
+		for (DiskFile::WriteSegment& segment : segments)
+		{
+			WriteSegment((const char*)segment.buffer, segment.size, offset);
+			offset += segment.size;
+		}
+	}
+	else if (!m_outFile.WriteAt(articles[first]->GetSegmentOffset(), segments.data(), (int)segments.size()))
+	{
+		m_failed = true;
+	}
+
+	return index;
+}
+
+/*
+ * In O_DIRECT mode only whole pages lying inside of the segment are written directly.
+ * The partial pages at the beginning and at the end of the segment share the page with
+ * neighbour segments; they are written via page cache, together with the neighbours.
+ * Direct and buffered writes of the same page, running in parallel in one batch, aren't
+ * coherent: the data of the direct write can be overwritten when the cached page is
+ * written back.
+ */
+void SegmentWriter::WriteSegment(const char* buffer, int size, int64 offset)
+{
+	int64 directStart = offset;
+	int64 directEnd = offset;
+	if (m_directFd > -1 && ((intptr_t)buffer - offset) % m_directAlign == 0)
+	{
+		directStart = (offset + m_directAlign - 1) / m_directAlign * m_directAlign;
+		directEnd = (offset + size) / m_directAlign * m_directAlign;
+	}
+
+	if (directEnd <= directStart)
+	{
+		m_batch->Write(m_fd, buffer, size, offset);
+		return;
+	}
+
+	int head = (int)(directStart - offset);
+	int tail = (int)(offset + size - directEnd);
+	if (head > 0)
+	{
+		m_batch->Write(m_fd, buffer, head, offset);
+	}
+	m_batch->Write(m_directFd, buffer + head, (int)(directEnd - directStart), directStart, m_fd);
+	if (tail > 0)
+	{
+		m_batch->Write(m_fd, buffer + size - tail, tail, directEnd);
+	}
+}
+
+bool SegmentWriter::Finish()
+{
+	if (m_batch && !m_batch->Finish())
+	{
+		errno = m_batch->GetError();
+		m_failed = true;
+	}
+
+	return !m_failed;
+}
+
+
 void ArticleWriter::CompleteFileParts()
 {
 	debug("Completing file parts");
@@ -314,6 +576,14 @@ void ArticleWriter::CompleteFileParts()
 
 	bool cached = m_fileInfo->GetCachedArticles() > 0;
 
+	if (directWrite)
+	{
+		// the file is unmapped by the last article writer using it, the system
+		// then starts writing of the whole file
+		Guard guard = m_fileInfo->GuardOutputFile();
+		m_fileInfo->SetOutputMapping(nullptr);
+	}
+
 	if (g_Options->GetRawArticle())
 	{
 		detail("Moving articles for %s", *infoFilename);
@@ -395,7 +665,7 @@ void ArticleWriter::CompleteFileParts()
 		std::unique_ptr<ArticleCache::FlushGuard> flushGuard;
 		if (cached)
 		{
-			flushGuard = std::make_unique<ArticleCache::FlushGuard>(g_ArticleCache->GuardFlush());
+			flushGuard = std::make_unique<ArticleCache::FlushGuard>(g_ArticleCache->GuardFlush(m_fileInfo));
 		}
 
 		CharBuffer buffer;
@@ -406,6 +676,43 @@ void ArticleWriter::CompleteFileParts()
 			buffer.Reserve(1024 * 64);
 		}
 
+		if (directWrite && cached)
+		{
+			// cached segments lying next to each other go into the file with one write
+			std::vector<ArticleInfo*> cachedArticles;
+			for (ArticleInfo* pa : m_fileInfo->GetArticles())
+			{
+				if (pa->GetStatus() == ArticleInfo::aiFinished && pa->GetSegmentContent())
+				{
+					cachedArticles.push_back(pa);
+				}
+			}
+
+			std::sort(cachedArticles.begin(), cachedArticles.end(),
+				[](ArticleInfo* pa1, ArticleInfo* pa2)
+				{
+					return pa1->GetSegmentOffset() < pa2->GetSegmentOffset();
+				});
+
+			SegmentWriter segmentWriter(outfile, m_outputFilename);
+			for (int index = 0; index < (int)cachedArticles.size(); )
+			{
+				index = segmentWriter.WriteRun(cachedArticles, index);
+			}
+
+			if (!segmentWriter.Finish())
+			{
+				m_fileInfo->GetNzbInfo()->PrintMessage(Message::mkError,
+					"Could not write to file %s: %s", *m_outputFilename,
+					*FileSystem::GetLastErrorMessage());
+			}
+
+			for (ArticleInfo* pa : cachedArticles)
+			{
+				pa->DiscardSegment();
+			}
+		}
+
 		for (ArticleInfo* pa : m_fileInfo->GetArticles())
 		{
 			if (pa->GetStatus() != ArticleInfo::aiFinished)
@@ -579,7 +886,7 @@ void ArticleWriter::FlushCache()
 	int64 flushedSize = 0;
 
 	{
-		ArticleCache::FlushGuard flushGuard = g_ArticleCache->GuardFlush();
+		ArticleCache::FlushGuard flushGuard = g_ArticleCache->GuardFlush(m_fileInfo);
 
 		std::vector<ArticleInfo*> cachedArticles;
 
@@ -603,8 +910,22 @@ void ArticleWriter::FlushCache()
 			}
 		}
 
-		for (ArticleInfo* pa : cachedArticles)
+		if (directWrite)
 		{
+			std::sort(cachedArticles.begin(), cachedArticles.end(),
+				[](ArticleInfo* pa1, ArticleInfo* pa2)
+				{
+					return pa1->GetSegmentOffset() < pa2->GetSegmentOffset();
+				});
+		}
+
+		std::unique_ptr<SegmentWriter> segmentWriter;
+		int index = 0;
+
+		while (index < (int)cachedArticles.size())
+		{
+			ArticleInfo* pa = cachedArticles[index];
+
 			if (m_fileInfo->GetDeleted() && !m_fileInfo->GetNzbInfo()->GetParking())
 			{
 				// the file was deleted during flushing: stop flushing immediately
@@ -624,6 +945,7 @@ void ArticleWriter::FlushCache()
 					break;
 				}
 				needBufFile = true;
+				segmentWriter = std::make_unique<SegmentWriter>(outfile, m_fileInfo->GetOutputFilename());
 			}
 
 			BString<1024> destFile;
@@ -650,20 +972,26 @@ void ArticleWriter::FlushCache()
 				needBufFile = false;
 			}
 
+			int runEnd = index + 1;
+
 			if (directWrite)
 			{
-				outfile.Seek(pa->GetSegmentOffset());
+				runEnd = segmentWriter->WriteRun(cachedArticles, index);
 			}
-
-			if (!g_Options->GetSkipWrite())
+			else if (!g_Options->GetSkipWrite())
 			{
 				outfile.Write(pa->GetSegmentContent(), pa->GetSegmentSize());
 			}
 
-			flushedSize += pa->GetSegmentSize();
-			flushedArticles++;
-
-			pa->DiscardSegment();
+			for (; index < runEnd; index++)
+			{
+				flushedSize += cachedArticles[index]->GetSegmentSize();
+				flushedArticles++;
+				if (!directWrite)
+				{
+					cachedArticles[index]->DiscardSegment();
+				}
+			}
 
 			if (!directWrite)
 			{
@@ -678,12 +1006,29 @@ void ArticleWriter::FlushCache()
 			}
 		}
 
+		if (segmentWriter)
+		{
+			if (!segmentWriter->Finish())
+			{
+				m_fileInfo->GetNzbInfo()->PrintMessage(Message::mkError,
+					"Could not write to file %s: %s", m_fileInfo->GetOutputFilename(),
+					*FileSystem::GetLastErrorMessage());
+			}
+
+			segmentWriter.reset();
+			for (int i = 0; i < index; i++)
+			{
+				cachedArticles[i]->DiscardSegment();
+			}
+		}
+
 		outfile.Close();
 
 		{
 			Guard contentGuard = g_ArticleCache->GuardContent();
 			m_fileInfo->SetCachedArticles(m_fileInfo->GetCachedArticles() - flushedArticles);
 			m_fileInfo->SetFlushLocked(false);
+			g_ArticleCache->FileFlushed(m_fileInfo, flushedSize);
 		}
 	}
 
@@ -760,15 +1105,221 @@ bool ArticleWriter::MoveCompletedFiles(NzbInfo* nzbInfo, const char* oldDestDir)
 }
 
 
+static const int ARENA_BLOCK_SIZE = 1024*16;
+static const int ARENA_RELEASE_DELAY_MSEC = 1000*10;
+static const int IOURING_ENTRIES = 64;
+
+ArticleCache::~ArticleCache()
+{
+	if (m_arena)
+	{
+#ifdef WIN32
+		VirtualFree(m_arena, 0, MEM_RELEASE);
+#else
+		munmap(m_arena, m_arenaSize);
+#endif
+	}
+}
+
+/*
+ * Reserves address space for the whole cache at once. The system provides the memory
+ * when it's used first time (on Windows the blocks are committed on allocation).
+ * If the reservation fails (possible in 32 bit mode) the segments are allocated
+ * on the heap instead.
+ */
+void ArticleCache::ReserveArena()
+{
+	m_arenaReserved = true;
+
+	size_t size = (size_t)g_Options->GetArticleCache() * 1024 * 1024;
+
+#ifdef WIN32
+	void* arena = VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_READWRITE);
+#else
+	int flags = MAP_PRIVATE | MAP_ANON;
+#ifdef MAP_NORESERVE
+	flags |= MAP_NORESERVE;
+#endif
+	void* arena = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+	if (arena == MAP_FAILED)
+	{
+		arena = nullptr;
+	}
+#endif
+
+	if (!arena)
+	{
+		detail("Could not reserve %i MB for article cache, allocating articles individually",
+			g_Options->GetArticleCache());
+		return;
+	}
+
+#ifdef MADV_HUGEPAGE
+	// large pages reduce TLB misses when decoding into the cache and writing from it
+	madvise(arena, size, MADV_HUGEPAGE);
+#endif
+
+	m_arena = (char*)arena;
+	m_arenaSize = size;
+	AddFreeExtent(0, (int)(size / ARENA_BLOCK_SIZE));
+}
+
+/*
+ * Prepares asynchronous writing of cached segments if enabled. The arena is registered
+ * with the kernel, which can then write the segments without mapping their memory
+ * for each request.
+ */
+void ArticleCache::InitIoUring()
+{
+	if ((g_Options->GetWriteEngine() != Options::weUring &&
+		 g_Options->GetWriteEngine() != Options::weUringDirect) || !g_Options->GetDirectWrite())
+	{
+		return;
+	}
+
+	std::unique_ptr<IoUring> ioUring = std::make_unique<IoUring>();
+	if (!ioUring->Init(IOURING_ENTRIES))
+	{
+		warn("Could not initialize io_uring, writing articles via stdio: %s",
+			*FileSystem::GetLastErrorMessage());
+		return;
+	}
+
+	if (m_arena && !ioUring->RegisterBuffer(m_arena, m_arenaSize))
+	{
+		// the kernel pins the whole registered memory, which is limited by RLIMIT_MEMLOCK
+		warn("Could not register article cache memory (%i MB) for io_uring, "
+			"the limit of locked memory (RLIMIT_MEMLOCK, \"ulimit -l\") may be too low: %s",
+			(int)(m_arenaSize / 1024 / 1024), *FileSystem::GetLastErrorMessage());
+	}
+
+	m_ioUring = std::move(ioUring);
+	m_ioUringReady = true;
+}
+
+/*
+ * Gives the memory of the (empty) arena back to the system, the address space remains reserved.
+ */
+void ArticleCache::ReleaseArenaMemory()
+{
+	debug("Releasing memory of article cache");
+
+#ifdef WIN32
+	VirtualFree(m_arena, m_arenaSize, MEM_DECOMMIT);
+#else
+	madvise(m_arena, m_arenaSize, MADV_DONTNEED);
+#endif
+
+	m_arenaTouched = false;
+}
+
+/*
+ * Amount of memory taken by a segment of given size; in the arena the segments
+ * occupy whole blocks.
+ */
+size_t ArticleCache::AllocSize(int size)
+{
+	if (!m_arena)
+	{
+		return size;
+	}
+
+	return (size_t)std::max((size + ARENA_BLOCK_SIZE - 1) / ARENA_BLOCK_SIZE, 1) * ARENA_BLOCK_SIZE;
+}
+
+/*
+ * Finds the smallest free run of blocks large enough for the segment (best fit).
+ * Articles of the same file have equal sizes, the freed runs are therefore
+ * often reused as a whole. Still the free blocks may be scattered in runs too short
+ * for the segment, the allocation then fails even if the cache limit isn't reached.
+ */
+char* ArticleCache::ArenaAlloc(int blocks)
+{
+	FreeExtentsBySize::iterator it = m_freeBySize.lower_bound(std::make_pair(blocks, 0));
+	if (it == m_freeBySize.end())
+	{
+		return nullptr;
+	}
+
+	int first = it->second;
+	int count = it->first;
+	char* data = m_arena + (size_t)first * ARENA_BLOCK_SIZE;
+
+#ifdef WIN32
+	// the address space is only reserved, the memory must be committed before use;
+	// committing already committed pages has no effect
+	if (!VirtualAlloc(data, (size_t)blocks * ARENA_BLOCK_SIZE, MEM_COMMIT, PAGE_READWRITE))
+	{
+		return nullptr;
+	}
+#endif
+
+	RemoveFreeExtent(m_freeExtents.find(first));
+	if (count > blocks)
+	{
+		AddFreeExtent(first + blocks, count - blocks);
+	}
+
+	m_arenaTouched = true;
+	return data;
+}
+
+/*
+ * Returns blocks into the arena, the run is merged with adjacent free runs.
+ */
+void ArticleCache::ArenaFree(char* data, int blocks)
+{
+	int first = (int)((data - m_arena) / ARENA_BLOCK_SIZE);
+	int count = blocks;
+
+	FreeExtents::iterator next = m_freeExtents.lower_bound(first);
+	if (next != m_freeExtents.begin())
+	{
+		FreeExtents::iterator prev = std::prev(next);
+		if (prev->first + prev->second == first)
+		{
+			first = prev->first;
+			count += prev->second;
+			RemoveFreeExtent(prev);
+		}
+	}
+
+	if (next != m_freeExtents.end() && next->first == first + count)
+	{
+		count += next->second;
+		RemoveFreeExtent(next);
+	}
+
+	AddFreeExtent(first, count);
+}
+
+void ArticleCache::AddFreeExtent(int first, int count)
+{
+	m_freeExtents.emplace(first, count);
+	m_freeBySize.emplace(count, first);
+}
+
+void ArticleCache::RemoveFreeExtent(FreeExtents::iterator it)
+{
+	m_freeBySize.erase(std::make_pair(it->second, it->first));
+	m_freeExtents.erase(it);
+}
+
 CachedSegmentData ArticleCache::Alloc(int size)
 {
 	Guard guard(m_allocMutex);
 
-	void* p = nullptr;
+	if (!m_arenaReserved)
+	{
+		ReserveArena();
+	}
+
+	char* p = nullptr;
+	size_t allocSize = AllocSize(size);
 
-	if (m_allocated + size <= (size_t)g_Options->GetArticleCache() * 1024 * 1024)
+	if (m_allocated + allocSize <= (size_t)g_Options->GetArticleCache() * 1024 * 1024)
 	{
-		p = malloc(size);
+		p = m_arena ? ArenaAlloc((int)(allocSize / ARENA_BLOCK_SIZE)) : (char*)malloc(size);
 		if (p)
 		{
 			if (!m_allocated && g_Options->GetServerMode() && g_Options->GetContinuePartial())
@@ -780,17 +1331,36 @@ CachedSegmentData ArticleCache::Alloc(int size)
 				// Resume Run(), the notification arrives later, after releasing m_allocMutex
 				m_allocCond.NotifyAll();
 			}
-			m_allocated += size;
+			m_allocated += allocSize;
 		}
 	}
 
-	return CachedSegmentData((char*)p, p ? size : 0);
+	return CachedSegmentData(p, p ? size : 0);
 }
 
 bool ArticleCache::Realloc(CachedSegmentData* segment, int newSize)
 {
 	Guard guard(m_allocMutex);
 
+	if (m_arena)
+	{
+		// segments in the arena can only shrink, the blocks at the end are freed
+		size_t oldAllocSize = AllocSize(segment->m_size);
+		size_t newAllocSize = AllocSize(newSize);
+		if (newSize <= 0 || newAllocSize > oldAllocSize)
+		{
+			return false;
+		}
+
+		if (newAllocSize < oldAllocSize)
+		{
+			ArenaFree(segment->m_data + newAllocSize, (int)((oldAllocSize - newAllocSize) / ARENA_BLOCK_SIZE));
+			m_allocated -= oldAllocSize - newAllocSize;
+		}
+		segment->m_size = newSize;
+		return true;
+	}
+
 	void* p = realloc(segment->m_data, newSize);
 	if (p)
 	{
@@ -806,10 +1376,18 @@ void ArticleCache::Free(CachedSegmentData* segment)
 {
 	if (segment->m_size)
 	{
-		free(segment->m_data);
+		if (!m_arena)
+		{
+			free(segment->m_data);
+		}
 
 		Guard guard(m_allocMutex);
-		m_allocated -= segment->m_size;
+		size_t allocSize = AllocSize(segment->m_size);
+		if (m_arena)
+		{
+			ArenaFree(segment->m_data, (int)(allocSize / ARENA_BLOCK_SIZE));
+		}
+		m_allocated -= allocSize;
 		if (!m_allocated && g_Options->GetServerMode() && g_Options->GetContinuePartial())
 		{
 			g_DiskState->DeleteCacheFlag();
@@ -818,6 +1396,38 @@ void ArticleCache::Free(CachedSegmentData* segment)
 }
 
 void ArticleCache::Run()
+{
+	{
+		Guard guard(m_allocMutex);
+		if (!m_arenaReserved)
+		{
+			ReserveArena();
+		}
+	}
+	InitIoUring();
+
+	for (int i = 1; i < g_Options->GetFlushThreads(); i++)
+	{
+		m_flushWorkers.push_back(std::make_unique<FlushWorker>(this));
+		m_flushWorkers.back()->Start();
+	}
+
+	FlushLoop(true);
+
+	for (std::unique_ptr<FlushWorker>& worker : m_flushWorkers)
+	{
+		while (worker->IsRunning())
+		{
+			Util::Sleep(10);
+		}
+	}
+}
+
+/*
+ * Executed by the cache thread and by each additional flush worker.
+ * The workers pick different files and write them in parallel.
+ */
+void ArticleCache::FlushLoop(bool mainThread)
 {
 	// automatically flush the cache if it is filled to 90% (only in DirectWrite mode)
 	size_t fillThreshold = (size_t)g_Options->GetArticleCache() * 1024 * 1024 / 100 * 90;
@@ -832,10 +1442,25 @@ void ArticleCache::Run()
 		{
 			justFlushed = CheckFlush(m_allocated >= fillThreshold);
 			resetCounter = 0;
+			if (!justFlushed && IsStopped())
+			{
+				// the remaining files are being flushed by other workers
+				Util::Sleep(5);
+			}
 		}
 		else if (!m_allocated)
 		{
 			Guard guard(m_allocMutex);
+			if (mainThread && m_arenaTouched && !(GetIoUring() && GetIoUring()->GetBufferRegistered()))
+			{
+				// give the memory back to the system if the cache stays empty for a while;
+				// the memory registered with io_uring is pinned by the kernel and stays
+				m_allocCond.WaitFor(m_allocMutex, ARENA_RELEASE_DELAY_MSEC, [&]{ return IsStopped() || m_allocated > 0; });
+				if (!m_allocated)
+				{
+					ReleaseArenaMemory();
+				}
+			}
 			m_allocCond.Wait(m_allocMutex, [&]{ return IsStopped() || m_allocated > 0; });
 			resetCounter = 0;
 		}
@@ -861,52 +1486,164 @@ bool ArticleCache::CheckFlush(bool flushEverything)
 	debug("Checking cache, Allocated: %i, FlushEverything: %i", (int)m_allocated, (int)flushEverything);
 
 	BString<1024> infoName;
+	FileInfo* fileInfo = nullptr;
 
 	{
 		GuardedDownloadQueue downloadQueue = DownloadQueue::Guard();
-		for (NzbInfo* nzbInfo : downloadQueue->GetQueue())
+		fileInfo = PickDirtyFile(flushEverything);
+		if (fileInfo)
 		{
-			if (m_fileInfo)
-			{
-				break;
-			}
+			infoName.Format("%s%c%s", fileInfo->GetNzbInfo()->GetName(), PATH_SEPARATOR, fileInfo->GetFilename());
+		}
+	}
 
-			for (FileInfo* fileInfo : nzbInfo->GetFileList())
-			{
-				if (fileInfo->GetCachedArticles() > 0 && (fileInfo->GetActiveDownloads() == 0 || flushEverything))
-				{
-					m_fileInfo = fileInfo;
-					infoName.Format("%s%c%s", m_fileInfo->GetNzbInfo()->GetName(), PATH_SEPARATOR, m_fileInfo->GetFilename());
-					break;
-				}
-			}
+	if (!fileInfo)
+	{
+		debug("Checking cache... nothing to flush");
+		return false;
+	}
+
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+	ArticleWriter articleWriter;
+	articleWriter.SetFileInfo(fileInfo);
+	articleWriter.SetInfoName(infoName);
+	articleWriter.FlushCache();
+
+	int latency = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - startTime).count();
+
+	ReleaseDirtyFile(fileInfo);
+
+	Guard guard(m_flushMutex);
+	m_flushLatency = (m_flushLatency * 3 + latency) / 4;
+
+	return true;
+}
+
+/*
+ * Chooses the next file to flush from the files having cached articles. Normally
+ * the files are flushed in the order they got into the cache, once their downloads
+ * are finished. When the cache is almost full the files with most cached data go first,
+ * regardless of active downloads, to free as much memory as possible.
+ * Must be called with locked download queue.
+ */
+FileInfo* ArticleCache::PickDirtyFile(bool flushEverything)
+{
+	Guard contentGuard(m_contentMutex);
+	Guard flushGuard(m_flushMutex);
+
+	FileInfo* picked = nullptr;
+	DirtyFile* pickedDirty = nullptr;
+
+	for (DirtyFiles::iterator it = m_dirtyFiles.begin(); it != m_dirtyFiles.end(); )
+	{
+		FileInfo* fileInfo = it->first;
+		DirtyFile& dirtyFile = it->second;
+
+		if (fileInfo->GetCachedArticles() == 0)
+		{
+			// the cached articles were discarded
+			it = m_dirtyFiles.erase(it);
+			continue;
+		}
+
+		if (!m_busyFiles.count(fileInfo) &&
+			(fileInfo->GetActiveDownloads() == 0 || flushEverything) &&
+			(!pickedDirty ||
+			 (flushEverything ? dirtyFile.cachedSize > pickedDirty->cachedSize :
+				dirtyFile.dirtySerial < pickedDirty->dirtySerial)))
+		{
+			picked = fileInfo;
+			pickedDirty = &dirtyFile;
 		}
+
+		it++;
 	}
 
-	if (m_fileInfo)
+	if (picked)
 	{
-		ArticleWriter articleWriter;
-		articleWriter.SetFileInfo(m_fileInfo);
-		articleWriter.SetInfoName(infoName);
-		articleWriter.FlushCache();
-		m_fileInfo = nullptr;
-		return true;
+		m_busyFiles.insert(picked);
 	}
 
-	debug("Checking cache... nothing to flush");
+	return picked;
+}
 
-	return false;
+void ArticleCache::ReleaseDirtyFile(FileInfo* fileInfo)
+{
+	Guard guard(m_flushMutex);
+	m_busyFiles.erase(fileInfo);
 }
 
-ArticleCache::FlushGuard::FlushGuard(Mutex& mutex) : m_guard(&mutex)
+bool ArticleCache::FileBusy(FileInfo* fileInfo)
 {
-	g_ArticleCache->m_flushing = true;
+	Guard guard(m_flushMutex);
+	return m_busyFiles.count(fileInfo) > 0;
+}
+
+void ArticleCache::FileCached(FileInfo* fileInfo, int size)
+{
+	DirtyFile& dirtyFile = m_dirtyFiles[fileInfo];
+	if (dirtyFile.cachedSize == 0)
+	{
+		dirtyFile.dirtySerial = ++m_dirtySerial;
+	}
+	dirtyFile.cachedSize += size;
+}
+
+void ArticleCache::FileFlushed(FileInfo* fileInfo, int64 size)
+{
+	DirtyFiles::iterator it = m_dirtyFiles.find(fileInfo);
+	if (it == m_dirtyFiles.end())
+	{
+		return;
+	}
+
+	if (fileInfo->GetCachedArticles() == 0)
+	{
+		m_dirtyFiles.erase(it);
+	}
+	else
+	{
+		it->second.cachedSize -= size;
+	}
+}
+
+void ArticleCache::FileDeleted(FileInfo* fileInfo)
+{
+	m_dirtyFiles.erase(fileInfo);
+}
+
+void ArticleCache::GetFlushBacklog(int* files, int64* size)
+{
+	Guard guard(m_contentMutex);
+
+	*files = 0;
+	*size = 0;
+	for (DirtyFiles::value_type& dirtyFile : m_dirtyFiles)
+	{
+		(*files)++;
+		*size += dirtyFile.second.cachedSize;
+	}
+}
+
+ArticleCache::FlushGuard::FlushGuard(FileInfo* fileInfo) : m_fileInfo(fileInfo)
+{
+	ArticleCache* cache = g_ArticleCache;
+	Guard guard(cache->m_flushMutex);
+	cache->m_flushCond.Wait(cache->m_flushMutex, [&]{ return !cache->m_guardedFiles.count(m_fileInfo); });
+	cache->m_guardedFiles.insert(m_fileInfo);
+	cache->m_flushing++;
 }
 
 ArticleCache::FlushGuard::~FlushGuard()
 {
-	if (m_guard)
+	if (m_fileInfo)
 	{
-		g_ArticleCache->m_flushing = false;
+		ArticleCache* cache = g_ArticleCache;
+		Guard guard(cache->m_flushMutex);
+		cache->m_guardedFiles.erase(m_fileInfo);
+		cache->m_flushing--;
+		cache->m_flushCond.NotifyAll();
 	}
 }
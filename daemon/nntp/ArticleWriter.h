@@ -25,6 +25,7 @@
 #include "DownloadInfo.h"
 #include "Decoder.h"
 #include "FileSystem.h"
+#include "IoUring.h"
 
 class CachedSegmentData : public SegmentData
 {
@@ -51,10 +52,13 @@ public:
 	void SetInfoName(const char* infoName) { m_infoName = infoName; }
 	void SetFileInfo(FileInfo* fileInfo) { m_fileInfo = fileInfo; }
 	void SetArticleInfo(ArticleInfo* articleInfo) { m_articleInfo = articleInfo; }
+	void SetCacheOnly(bool cacheOnly) { m_cacheOnly = cacheOnly; }
 	void Prepare();
 	bool Start(Decoder::EFormat format, const char* filename, int64 fileSize, int64 articleOffset, int articleSize);
 	bool Write(char* buffer, int len);
+	char* GetWriteBuffer(int* size);
 	void Finish(bool success);
+	void Discard();
 	bool GetDuplicate() { return m_duplicate; }
 	void CompleteFileParts();
 	static bool MoveCompletedFiles(NzbInfo* nzbInfo, const char* oldDestDir);
@@ -69,52 +73,122 @@ private:
 	const char* m_resultFilename = nullptr;
 	Decoder::EFormat m_format = Decoder::efUnknown;
 	CachedSegmentData m_articleData;
+	std::shared_ptr<MappedFile> m_outputMapping;
 	int64 m_articleOffset;
 	int m_articleSize;
 	int m_articlePtr;
 	bool m_duplicate = false;
+	bool m_cacheOnly = false;
 	CString m_infoName;
 
 	bool CreateOutputFile(int64 size);
 	void BuildOutputFilename();
+	void MapOutputFile(int64 fileSize);
 	void SetWriteBuffer(DiskFile& outFile, int recSize);
 };
 
 class ArticleCache : public Thread
 {
 public:
+	// prevents concurrent flushing of the same file, different files can be flushed in parallel
 	class FlushGuard
 	{
 	public:
-		FlushGuard(FlushGuard&& other) = default;
+		FlushGuard(FlushGuard&& other) : m_fileInfo(other.m_fileInfo) { other.m_fileInfo = nullptr; }
 		~FlushGuard();
 	private:
-		Guard m_guard;
-		FlushGuard(Mutex& mutex);
+		FileInfo* m_fileInfo;
+		FlushGuard(FileInfo* fileInfo);
 		friend class ArticleCache;
 	};
 
+	virtual ~ArticleCache();
 	virtual void Run();
 	virtual void Stop();
 	CachedSegmentData Alloc(int size);
 	bool Realloc(CachedSegmentData* segment, int newSize);
 	void Free(CachedSegmentData* segment);
-	FlushGuard GuardFlush() { return FlushGuard(m_flushMutex); }
+	FlushGuard GuardFlush(FileInfo* fileInfo) { return FlushGuard(fileInfo); }
 	Guard GuardContent() { return Guard(m_contentMutex); }
-	bool GetFlushing() { return m_flushing; }
+	bool GetFlushing() { return m_flushing > 0; }
 	size_t GetAllocated() { return m_allocated; }
-	bool FileBusy(FileInfo* fileInfo) { return fileInfo == m_fileInfo; }
+	bool FileBusy(FileInfo* fileInfo);
+	// the following three must be called with content guard
+	void FileCached(FileInfo* fileInfo, int size);
+	void FileFlushed(FileInfo* fileInfo, int64 size);
+	void FileDeleted(FileInfo* fileInfo);
+	void GetFlushBacklog(int* files, int64* size);
+	// flush workers pick the files to flush and release them when the flushing is done
+	FileInfo* PickDirtyFile(bool flushEverything);
+	void ReleaseDirtyFile(FileInfo* fileInfo);
+	int GetFlushLatency() { return m_flushLatency; }
+	IoUring* GetIoUring() { return m_ioUringReady ? m_ioUring.get() : nullptr; }
 
 private:
+	class FlushWorker : public Thread
+	{
+	public:
+		FlushWorker(ArticleCache* owner) : m_owner(owner) {}
+		virtual void Run() { m_owner->FlushLoop(false); }
+	private:
+		ArticleCache* m_owner;
+	};
+
+	// file having articles in the cache
+	struct DirtyFile
+	{
+		int64 cachedSize = 0;
+		// order in which the files got into the cache
+		int64 dirtySerial = 0;
+	};
+
+	typedef std::map<int, int> FreeExtents;
+	typedef std::set<std::pair<int, int>> FreeExtentsBySize;
+	typedef std::map<FileInfo*, DirtyFile> DirtyFiles;
+	typedef std::set<FileInfo*> FileSet;
+	typedef std::vector<std::unique_ptr<FlushWorker>> FlushWorkers;
+
 	size_t m_allocated = 0;
-	bool m_flushing = false;
+	std::atomic<int> m_flushing{0};
+	// cache memory reserved at once and divided into blocks,
+	// each segment occupies a continuous run of blocks
+	char* m_arena = nullptr;
+	size_t m_arenaSize = 0;
+	bool m_arenaReserved = false;
+	bool m_arenaTouched = false;
+	// free runs of blocks: first block -> block count
+	FreeExtents m_freeExtents;
+	// same free runs ordered by (block count, first block) for best-fit search
+	FreeExtentsBySize m_freeBySize;
 	Mutex m_allocMutex;
 	Mutex m_flushMutex;
 	Mutex m_contentMutex;
-	FileInfo* m_fileInfo = nullptr;
 	ConditionVar m_allocCond;
+	ConditionVar m_flushCond;
+	// files with cached articles, guarded by content mutex
+	DirtyFiles m_dirtyFiles;
+	// files picked by flush workers, guarded by flush mutex
+	FileSet m_busyFiles;
+	// files being flushed or completed, guarded by flush mutex
+	FileSet m_guardedFiles;
+	int64 m_dirtySerial = 0;
+	FlushWorkers m_flushWorkers;
+	// average duration of flushing one file, milliseconds
+	std::atomic<int> m_flushLatency{0};
+	std::unique_ptr<IoUring> m_ioUring;
+	// set once the ring is ready, download and completion threads may look at it any time
+	std::atomic<bool> m_ioUringReady{false};
 
+	void FlushLoop(bool mainThread);
 	bool CheckFlush(bool flushEverything);
+	void ReserveArena();
+	void InitIoUring();
+	void ReleaseArenaMemory();
+	size_t AllocSize(int size);
+	char* ArenaAlloc(int blocks);
+	void ArenaFree(char* data, int blocks);
+	void AddFreeExtent(int first, int count);
+	void RemoveFreeExtent(FreeExtents::iterator it);
 };
 
 extern ArticleCache* g_ArticleCache;
@@ -0,0 +1,151 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "nzbget.h"
+#include "BandwidthLimiter.h"
+#include "WorkState.h"
+
+// amount of data which can be received at once without waiting, in milliseconds of transfer
+static const int BUCKET_BURST_MSEC = 5;
+// the amount of data read at once is limited to this time of transfer to keep the traffic smooth
+static const int READ_CHUNK_MSEC = 10;
+static const int READ_CHUNK_MIN = 1024;
+
+void TokenBucket::SetRate(int rate, std::chrono::steady_clock::time_point now)
+{
+	Guard guard(m_mutex);
+
+	if (rate != m_rate)
+	{
+		m_rate = rate;
+		m_tokens = 0;
+		m_lastTime = now;
+	}
+}
+
+/*
+ * Takes tokens for received data.
+ * Returns the time in microseconds the receiver must wait before reading more data.
+ */
+int64 TokenBucket::Consume(int bytes, std::chrono::steady_clock::time_point now)
+{
+	Guard guard(m_mutex);
+
+	if (m_rate <= 0)
+	{
+		return 0;
+	}
+
+	// concurrent callers take the time before locking, it may be behind the last time
+	int64 elapsed = 0;
+	if (now > m_lastTime)
+	{
+		elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - m_lastTime).count();
+		m_lastTime = now;
+	}
+
+	double burst = (double)m_rate * BUCKET_BURST_MSEC / 1000;
+	m_tokens = std::min(m_tokens + (double)m_rate * elapsed / 1000000, burst);
+	m_tokens -= bytes;
+
+	return m_tokens < 0 ? (int64)(-m_tokens * 1000000 / m_rate) : 0;
+}
+
+void BandwidthLimiter::Init(Servers* servers, Options::Categories* categories)
+{
+	for (std::unique_ptr<NewsServer>& newsServer : *servers)
+	{
+		if (newsServer->GetDownloadRate() > 0)
+		{
+			std::unique_ptr<TokenBucket> bucket = std::make_unique<TokenBucket>();
+			bucket->SetRate(newsServer->GetDownloadRate(), Now());
+			m_serverBuckets[newsServer.get()] = std::move(bucket);
+			m_minRate = m_minRate > 0 ? std::min(m_minRate, newsServer->GetDownloadRate()) : newsServer->GetDownloadRate();
+		}
+	}
+
+	for (Options::Category& category : *categories)
+	{
+		if (category.GetDownloadRate() > 0)
+		{
+			std::unique_ptr<TokenBucket> bucket = std::make_unique<TokenBucket>();
+			bucket->SetRate(category.GetDownloadRate(), Now());
+			m_categoryBuckets[&category] = std::move(bucket);
+			m_minRate = m_minRate > 0 ? std::min(m_minRate, category.GetDownloadRate()) : category.GetDownloadRate();
+		}
+	}
+}
+
+bool BandwidthLimiter::IsActive()
+{
+	return g_WorkState->GetSpeedLimit() > 0 || m_minRate > 0;
+}
+
+/*
+ * Returns the max amount of data to read at once or 0 if unlimited.
+ */
+int BandwidthLimiter::GetMaxReadSize()
+{
+	int rate = g_WorkState->GetSpeedLimit();
+	if (m_minRate > 0 && (rate == 0 || m_minRate < rate))
+	{
+		rate = m_minRate;
+	}
+
+	return rate > 0 ? std::max(rate / 1000 * READ_CHUNK_MSEC, READ_CHUNK_MIN) : 0;
+}
+
+/*
+ * Takes tokens for received data from all buckets applicable for the download.
+ * Returns the time in microseconds the receiver must wait before reading more data.
+ */
+int64 BandwidthLimiter::Consume(int bytes, NewsServer* newsServer, Options::Category* category)
+{
+	std::chrono::steady_clock::time_point now = Now();
+
+	int speedLimit = g_WorkState->GetSpeedLimit();
+	if (speedLimit != m_globalBucket.GetRate())
+	{
+		m_globalBucket.SetRate(speedLimit, now);
+	}
+
+	int64 wait = m_globalBucket.Consume(bytes, now);
+
+	if (!m_serverBuckets.empty())
+	{
+		ServerBuckets::iterator pos = m_serverBuckets.find(newsServer);
+		if (pos != m_serverBuckets.end())
+		{
+			wait = std::max(wait, pos->second->Consume(bytes, now));
+		}
+	}
+
+	if (!m_categoryBuckets.empty() && category)
+	{
+		CategoryBuckets::iterator pos = m_categoryBuckets.find(category);
+		if (pos != m_categoryBuckets.end())
+		{
+			wait = std::max(wait, pos->second->Consume(bytes, now));
+		}
+	}
+
+	return wait;
+}
@@ -0,0 +1,82 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef BANDWIDTHLIMITER_H
+#define BANDWIDTHLIMITER_H
+
+#include "Thread.h"
+#include "NewsServer.h"
+#include "Options.h"
+
+/*
+ * Token bucket with a burst of a few milliseconds of data.
+ * Received data is paid with tokens; when there are not enough tokens the bucket goes
+ * into debt and the receiver must wait until the debt is paid off. Every receiver
+ * waits for the debt accumulated by all receivers before it, which makes the bucket
+ * fair across connections.
+ * The current time is passed by the caller.
+ */
+class TokenBucket
+{
+public:
+	void SetRate(int rate, std::chrono::steady_clock::time_point now);
+	int GetRate() { return m_rate; }
+	int64 Consume(int bytes, std::chrono::steady_clock::time_point now);
+
+private:
+	Mutex m_mutex;
+	// read without locking for a quick check whether the rate has changed
+	std::atomic<int> m_rate{0};
+	double m_tokens = 0;
+	std::chrono::steady_clock::time_point m_lastTime;
+};
+
+/*
+ * Limits download speed globally (option "DownloadRate" and speed limit set via
+ * remote interface or scheduler) and optionally per server and per category
+ * (options "ServerX.DownloadRate" and "CategoryX.DownloadRate").
+ */
+class BandwidthLimiter
+{
+public:
+	virtual ~BandwidthLimiter() {}
+	void Init(Servers* servers, Options::Categories* categories);
+	bool IsActive();
+	int GetMaxReadSize();
+	int64 Consume(int bytes, NewsServer* newsServer, Options::Category* category);
+
+protected:
+	// clock of the buckets, replaced in tests
+	virtual std::chrono::steady_clock::time_point Now() { return std::chrono::steady_clock::now(); }
+
+private:
+	typedef std::unordered_map<NewsServer*, std::unique_ptr<TokenBucket>> ServerBuckets;
+	typedef std::unordered_map<Options::Category*, std::unique_ptr<TokenBucket>> CategoryBuckets;
+
+	TokenBucket m_globalBucket;
+	ServerBuckets m_serverBuckets;
+	CategoryBuckets m_categoryBuckets;
+	int m_minRate = 0;
+};
+
+extern BandwidthLimiter* g_BandwidthLimiter;
+
+#endif
@@ -0,0 +1,196 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "nzbget.h"
+#include "ConnectionTuner.h"
+#include "ServerPool.h"
+#include "StatMeter.h"
+#include "Log.h"
+#include "Util.h"
+
+// length of probe interval in seconds
+static const int PROBE_INTERVAL = 5;
+// the server must have been busy (all allowed connections in use) for this part of the interval
+static const int BUSY_PERCENT = 60;
+// an additional connection must improve the throughput at least by this much
+static const int MIN_GAIN_PERCENT = 5;
+// drop of throughput considered as throttling by the server
+static const int DROP_PERCENT = 25;
+static const int DECREASE_PERCENT = 75;
+// number of probe intervals to hold the connection count after the knee of the curve was found
+static const int HOLD_INTERVALS = 6;
+
+ConnectionTuner::Controller::Controller(int maxConnections) :
+	m_maxConnections(maxConnections)
+{
+	m_limit = std::max((maxConnections + 1) / 2, 1);
+}
+
+/*
+ * Processes the throughput measured with the current connection count.
+ * Returns the new connection count.
+ */
+int ConnectionTuner::Controller::Update(int rate)
+{
+	int limit = m_limit;
+	int probing = m_probing;
+	m_probing = 0;
+
+	if (probing > 0)
+	{
+		if ((int64)rate * 100 >= (int64)m_lastRate * (100 + MIN_GAIN_PERCENT))
+		{
+			m_reason = "throughput increased";
+			Probe(1);
+		}
+		else
+		{
+			m_limit--;
+			m_holdIntervals = HOLD_INTERVALS;
+			m_nextProbe = -1;
+			m_reason = "no throughput gain";
+		}
+	}
+	else if (probing < 0)
+	{
+		if ((int64)rate * 100 >= (int64)m_lastRate * (100 - MIN_GAIN_PERCENT))
+		{
+			m_reason = "no throughput loss";
+			Probe(-1);
+		}
+		else
+		{
+			m_limit++;
+			m_holdIntervals = HOLD_INTERVALS;
+			m_nextProbe = 1;
+			m_reason = "throughput decreased";
+		}
+	}
+	else if (m_lastRate > 0 && (int64)rate * 100 < (int64)m_lastRate * (100 - DROP_PERCENT))
+	{
+		m_limit = std::max(limit * DECREASE_PERCENT / 100, 1);
+		m_holdIntervals = HOLD_INTERVALS;
+		m_nextProbe = 1;
+		m_reason = "throughput dropped";
+	}
+	else if (m_holdIntervals > 0)
+	{
+		m_holdIntervals--;
+	}
+	else
+	{
+		m_reason = "probing";
+		if (!Probe(m_nextProbe))
+		{
+			Probe(-m_nextProbe);
+		}
+	}
+
+	m_lastRate = rate;
+	return m_limit;
+}
+
+bool ConnectionTuner::Controller::Probe(int direction)
+{
+	int limit = m_limit + direction;
+	if (limit < 1 || limit > m_maxConnections)
+	{
+		return false;
+	}
+
+	m_limit = limit;
+	m_probing = direction;
+	return true;
+}
+
+void ConnectionTuner::Init()
+{
+	for (NewsServer* newsServer : g_ServerPool->GetServers())
+	{
+		if (newsServer->GetActive() && newsServer->GetMaxConnections() > 1)
+		{
+			m_serverStates.push_back({newsServer, Controller(newsServer->GetMaxConnections()), 0, 0, 0});
+			g_ServerPool->SetActiveConnections(newsServer, m_serverStates.back().controller.GetLimit());
+		}
+	}
+}
+
+/*
+ * Called once per second while downloading.
+ */
+void ConnectionTuner::Check()
+{
+	bool measure = false;
+	for (ServerState& state : m_serverStates)
+	{
+		state.ticks++;
+		if (g_ServerPool->GetConnectionsInUse(state.newsServer) >= state.newsServer->GetActiveConnections())
+		{
+			state.busyTicks++;
+		}
+		measure |= state.ticks >= PROBE_INTERVAL;
+	}
+
+	if (!measure)
+	{
+		return;
+	}
+
+	std::vector<int64> serverBytes;
+	for (ServerVolume& serverVolume : g_StatMeter->GuardServerVolumes())
+	{
+		serverBytes.push_back(serverVolume.GetTotalBytes());
+	}
+
+	for (ServerState& state : m_serverStates)
+	{
+		if (state.ticks < PROBE_INTERVAL)
+		{
+			continue;
+		}
+
+		int id = state.newsServer->GetId();
+		int64 bytes = id < (int)serverBytes.size() ? serverBytes[id] : 0;
+		int rate = (int)((bytes - state.lastBytes) / state.ticks);
+		bool busy = state.busyTicks * 100 >= state.ticks * BUSY_PERCENT;
+		bool firstInterval = state.lastBytes == 0;
+
+		state.lastBytes = bytes;
+		state.ticks = 0;
+		state.busyTicks = 0;
+
+		if (!busy || firstInterval || !state.newsServer->GetActive() ||
+			g_ServerPool->IsServerBlocked(state.newsServer))
+		{
+			continue;
+		}
+
+		int limit = state.controller.GetLimit();
+		int newLimit = state.controller.Update(rate);
+		if (newLimit != limit)
+		{
+			info("Changing number of connections for %s from %i to %i: %s at %s",
+				state.newsServer->GetName(), limit, newLimit, state.controller.GetReason(),
+				*Util::FormatSpeed(rate));
+			g_ServerPool->SetActiveConnections(state.newsServer, newLimit);
+		}
+	}
+}
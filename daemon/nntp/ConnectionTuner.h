@@ -0,0 +1,82 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef CONNECTIONTUNER_H
+#define CONNECTIONTUNER_H
+
+#include "NewsServer.h"
+
+/*
+ * Adjusts the number of connections used for each news server within the configured
+ * maximum (option "AdaptiveConnections"). The throughput of the server is measured
+ * over probe intervals; intervals in which the server didn't have enough work to use
+ * all its connections are not taken into account.
+ */
+class ConnectionTuner
+{
+public:
+	/*
+	 * Additive increase, multiplicative decrease: one connection is added as long as
+	 * this improves the throughput noticeably. Once it doesn't (the knee of the curve
+	 * is reached) the connection is taken away again and the count is held for a while
+	 * before probing again, this time downwards: connections are removed one by one
+	 * as long as this doesn't reduce the throughput. If the throughput drops without
+	 * adding connections (the server is throttling) the count is reduced by a quarter.
+	 */
+	class Controller
+	{
+	public:
+		Controller(int maxConnections);
+		int GetLimit() { return m_limit; }
+		int Update(int rate);
+		const char* GetReason() { return m_reason; }
+
+	private:
+		int m_maxConnections;
+		int m_limit;
+		int m_lastRate = 0;
+		int m_probing = 0;
+		int m_nextProbe = 1;
+		int m_holdIntervals = 0;
+		const char* m_reason = "";
+
+		bool Probe(int direction);
+	};
+
+	void Init();
+	void Check();
+
+private:
+	struct ServerState
+	{
+		NewsServer* newsServer;
+		Controller controller;
+		int64 lastBytes;
+		int ticks;
+		int busyTicks;
+	};
+
+	typedef std::vector<ServerState> ServerStates;
+
+	ServerStates m_serverStates;
+};
+
+#endif
@@ -59,8 +59,10 @@ void Decoder::Clear()
  * At the end of yEnc-data switches back to line by line mode to
  * process '=yend'-marker and EOF-marker.
  * UU-encoded articles are processed completely in line by line mode.
+ * Decoded yEnc-data is put into "outbuf" (must have room for "len" bytes)
+ * or into "buffer" if "outbuf" isn't set.
  */
-int Decoder::DecodeBuffer(char* buffer, int len)
+int Decoder::DecodeBuffer(char* buffer, int len, char* outbuf)
 {
 	if (m_rawMode)
 	{
@@ -68,11 +70,16 @@ int Decoder::DecodeBuffer(char* buffer, int len)
 		return len;
 	}
 
+	if (!outbuf)
+	{
+		outbuf = buffer;
+	}
+
 	int outlen = 0;
 
 	if (m_body && m_format == efYenc)
 	{
-		outlen = DecodeYenc(buffer, buffer, len);
+		outlen = DecodeYenc(buffer, outbuf, len);
 		if (m_body)
 		{
 			return outlen;
@@ -90,8 +97,11 @@ int Decoder::DecodeBuffer(char* buffer, int len)
 
 		if (line[0] == '.' && line[1] == '\r')
 		{
+			// keep the data received after the article (responses to pipelined requests)
 			m_eof = true;
-			m_lineBuf.SetLength(0);
+			len = m_lineBuf.Length() - (int)(end + 1 - m_lineBuf);
+			memmove((char*)m_lineBuf, end + 1, len);
+			m_lineBuf.SetLength(len);
 			return outlen;
 		}
 
@@ -105,7 +115,7 @@ int Decoder::DecodeBuffer(char* buffer, int len)
 			ProcessYenc(line, llen);
 			if (m_body)
 			{
-				outlen = DecodeYenc(end + 1, buffer, m_lineBuf.Length() - (int)(end + 1 - m_lineBuf));
+				outlen = DecodeYenc(end + 1, outbuf, m_lineBuf.Length() - (int)(end + 1 - m_lineBuf));
 				if (m_body)
 				{
 					m_lineBuf.SetLength(0);
@@ -239,7 +249,9 @@ int Decoder::DecodeYenc(char* buffer, char* outbuf, int len)
 	const unsigned char* src = (unsigned char*)buffer;
 	unsigned char* dst = (unsigned char*)outbuf;
 
-	int endseq = YEncode::decode(&src, &dst, len, (YEncode::YencDecoderState*)&m_state);
+	int endseq = m_crcCheck ?
+		YEncode::decode_crc(&src, &dst, len, (YEncode::YencDecoderState*)&m_state, (YEncode::crc_state*)m_crc32.GetState()) :
+		YEncode::decode(&src, &dst, len, (YEncode::YencDecoderState*)&m_state);
 	int outlen = (int)((char*)dst - outbuf);
 
 	// endseq:
@@ -259,11 +271,6 @@ int Decoder::DecodeYenc(char* buffer, char* outbuf, int len)
 		m_body = false;
 	}
 
-	if (m_crcCheck)
-	{
-		m_crc32.Append((uchar*)outbuf, (uint32)outlen);
-	}
-
 	m_outSize += outlen;
 
 	return outlen;
@@ -47,7 +47,7 @@ public:
 	Decoder();
 	EStatus Check();
 	void Clear();
-	int DecodeBuffer(char* buffer, int len);
+	int DecodeBuffer(char* buffer, int len, char* outbuf = nullptr);
 	void SetCrcCheck(bool crcCheck) { m_crcCheck = crcCheck; }
 	void SetRawMode(bool rawMode) { m_rawMode = rawMode; }
 	EFormat GetFormat() { return m_format; }
@@ -57,6 +57,8 @@ public:
 	uint32 GetExpectedCrc() { return m_expectedCRC; }
 	uint32 GetCalculatedCrc() { return m_calculatedCRC; }
 	bool GetEof() { return m_eof; }
+	const char* GetRemainder() { return m_lineBuf; }
+	int GetRemainderLength() { return m_eof ? m_lineBuf.Length() : 0; }
 	const char* GetArticleFilename() { return m_articleFilename; }
 
 private: 
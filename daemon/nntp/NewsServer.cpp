@@ -24,11 +24,14 @@
 
 NewsServer::NewsServer(int id, bool active, const char* name, const char* host, int port, int ipVersion,
 	const char* user, const char* pass, bool joinGroup, bool tls, const char* cipher,
-	int maxConnections, int retention, int level, int group, bool optional) :
+	int maxConnections, int retention, int level, int group, bool optional, int pipelineDepth,
+	int downloadRate, bool compression) :
 		m_id(id), m_active(active), m_name(name), m_host(host ? host : ""), m_port(port), m_ipVersion(ipVersion),
 		m_user(user ? user : ""), m_password(pass ? pass : ""), m_joinGroup(joinGroup), m_tls(tls),
-		m_cipher(cipher ? cipher : ""), m_maxConnections(maxConnections), m_retention(retention),
-		m_level(level), m_normLevel(level), m_group(group), m_optional(optional)
+		m_cipher(cipher ? cipher : ""), m_maxConnections(maxConnections), m_activeConnections(maxConnections), m_retention(retention),
+		m_level(level), m_normLevel(level), m_group(group), m_optional(optional),
+		m_pipelineDepth(pipelineDepth > 0 ? pipelineDepth : 1), m_downloadRate(downloadRate),
+		m_compression(compression)
 {
 	if (m_name.Empty())
 	{
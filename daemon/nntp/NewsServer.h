@@ -28,6 +28,8 @@
 #define NEWSSERVER_H
 
 #include "NString.h"
+#include "TlsSessionCache.h"
+#include "ServerRating.h"
 
 class NewsServer
 {
@@ -35,7 +37,7 @@ public:
 	NewsServer(int id, bool active, const char* name, const char* host, int port, int ipVersion,
 		const char* user, const char* pass, bool joinGroup,
 		bool tls, const char* cipher, int maxConnections, int retention,
-		int level, int group, bool optional);
+		int level, int group, bool optional, int pipelineDepth, int downloadRate, bool compression);
 	int GetId() { return m_id; }
 	int GetStateId() { return m_stateId; }
 	void SetStateId(int stateId) { m_stateId = stateId; }
@@ -49,6 +51,10 @@ public:
 	const char* GetUser() { return m_user; }
 	const char* GetPassword() { return m_password; }
 	int GetMaxConnections() { return m_maxConnections; }
+	int GetActiveConnections() { return m_activeConnections; }
+	void SetActiveConnections(int activeConnections) { m_activeConnections = activeConnections; }
+	int GetConnectionsInUse() { return m_connectionsInUse; }
+	void SetConnectionsInUse(int connectionsInUse) { m_connectionsInUse = connectionsInUse; }
 	int GetLevel() { return m_level; }
 	int GetNormLevel() { return m_normLevel; }
 	void SetNormLevel(int level) { m_normLevel = level; }
@@ -57,8 +63,17 @@ public:
 	const char* GetCipher() { return m_cipher; }
 	int GetRetention() { return m_retention; }
 	bool GetOptional() { return m_optional; }
+	int GetPipelineDepth() { return m_pipelineDepth; }
+	int GetDownloadRate() { return m_downloadRate; }
+	bool GetCompression() { return m_compression; }
+	void AddCompressedData(int compressedBytes, int uncompressedBytes)
+		{ m_compressedBytes += compressedBytes; m_uncompressedBytes += uncompressedBytes; }
+	int64 GetCompressedBytes() { return m_compressedBytes; }
+	int64 GetUncompressedBytes() { return m_uncompressedBytes; }
 	time_t GetBlockTime() { return m_blockTime; }
 	void SetBlockTime(time_t blockTime) { m_blockTime = blockTime; }
+	TlsSessionCache* GetTlsSessionCache() { return &m_tlsSessionCache; }
+	ServerRating* GetRating() { return &m_rating; }
 
 private:
 	int m_id;
@@ -74,12 +89,21 @@ private:
 	bool m_tls;
 	CString m_cipher;
 	int m_maxConnections;
+	int m_activeConnections;
+	int m_connectionsInUse = 0;
 	int m_retention;
 	int m_level;
 	int m_normLevel;
 	int m_group;
 	bool m_optional = false;
+	int m_pipelineDepth = 1;
+	int m_downloadRate = 0;
+	bool m_compression = false;
+	std::atomic<int64> m_compressedBytes{0};
+	std::atomic<int64> m_uncompressedBytes{0};
 	time_t m_blockTime = 0;
+	TlsSessionCache m_tlsSessionCache;
+	ServerRating m_rating;
 };
 
 typedef std::vector<std::unique_ptr<NewsServer>> Servers;
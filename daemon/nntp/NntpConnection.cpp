@@ -32,6 +32,9 @@ NntpConnection::NntpConnection(NewsServer* newsServer) :
 {
 	m_lineBuf.Reserve(CONNECTION_LINEBUFFER_SIZE);
 	SetCipher(newsServer->GetCipher());
+#ifndef DISABLE_TLS
+	SetTlsSessionCache(newsServer->GetTlsSessionCache());
+#endif
 	SetIPVersion(newsServer->GetIpVersion() == 4 ? Connection::ipV4 :
 		newsServer->GetIpVersion() == 6 ? Connection::ipV6 : Connection::ipAuto);
 }
@@ -45,6 +48,11 @@ const char* NntpConnection::Request(const char* req)
 
 	m_authError = false;
 
+	if (!DrainPipeline(true))
+	{
+		return nullptr;
+	}
+
 	WriteLine(req);
 
 	char* answer = ReadLine(m_lineBuf, m_lineBuf.Size(), nullptr);
@@ -71,6 +79,29 @@ const char* NntpConnection::Request(const char* req)
 	return answer;
 }
 
+/*
+ * Sends a cheap command to prevent the server from closing an idle connection.
+ * Any answer other than the expected one means the connection isn't usable anymore
+ * (for example the server has already sent a timeout message), it is then closed.
+ */
+bool NntpConnection::KeepAlive()
+{
+	if (m_status != csConnected)
+	{
+		return false;
+	}
+
+	const char* answer = Request("DATE\r\n");
+	if (!answer || strncmp(answer, "111", 3))
+	{
+		debug("Keepalive to %s failed: %s", GetHost(), answer ? answer : "no answer");
+		Disconnect();
+		return false;
+	}
+
+	return true;
+}
+
 bool NntpConnection::Authenticate()
 {
 	if (strlen(m_newsServer->GetUser()) == 0 || strlen(m_newsServer->GetPassword()) == 0)
@@ -196,6 +227,13 @@ bool NntpConnection::Connect()
 		return false;
 	}
 
+	{
+		// requests sent over previous connection are lost, they must be sent again
+		Guard guard(m_pipelineMutex);
+		m_pipeline.erase(std::remove_if(m_pipeline.begin(), m_pipeline.end(),
+			[](PipelineRequest& request) { return request.sent; }), m_pipeline.end());
+	}
+
 	char* answer = ReadLine(m_lineBuf, m_lineBuf.Size(), nullptr);
 
 	if (!answer)
@@ -218,13 +256,58 @@ bool NntpConnection::Connect()
 		return false;
 	}
 
+#ifndef DISABLE_GZIP
+	if (m_newsServer->GetCompression() && !NegotiateCompression())
+	{
+		return false;
+	}
+#endif
+
 	debug("Connection to %s established", GetHost());
 
 	return true;
 }
 
+#ifndef DISABLE_GZIP
+/*
+ * Enables compression of the connection (COMPRESS DEFLATE, RFC 8054).
+ * Servers not supporting compression are used without it.
+ */
+bool NntpConnection::NegotiateCompression()
+{
+	const char* answer = Request("COMPRESS DEFLATE\r\n");
+	if (!answer)
+	{
+		ReportErrorAnswer("Connection to %s (%s) failed: Connection closed by remote host", nullptr);
+		Disconnect();
+		return false;
+	}
+
+	if (strncmp(answer, "206", 3))
+	{
+		debug("Compression is not supported by %s: %s", GetHost(), answer);
+		return true;
+	}
+
+	if (!StartCompression())
+	{
+		Disconnect();
+		return false;
+	}
+
+	debug("Compression for %s enabled", GetHost());
+	return true;
+}
+#endif
+
 bool NntpConnection::Disconnect()
 {
+	{
+		// waiting downloaders notice that their requests are gone and use other connections
+		Guard guard(m_pipelineMutex);
+		m_pipeline.clear();
+	}
+
 	if (m_status == csConnected)
 	{
 		Request("quit\r\n");
@@ -233,6 +316,236 @@ bool NntpConnection::Disconnect()
 	return Connection::Disconnect();
 }
 
+/*
+ * Pipelining: requests for several articles are sent at once, one after another,
+ * without waiting for responses. The responses are read by the downloaders in the
+ * same order the requests were sent. Downloaders which gave up waiting only mark
+ * their requests as cancelled; the responses to such requests are skipped.
+ */
+const char* NntpConnection::RequestArticle(const char* command, const char* messageId)
+{
+	if (!IsPipelineHead(messageId))
+	{
+		CancelPipelineRequest(messageId);
+		return Request(BString<1024>("%s %s\r\n", command, messageId));
+	}
+
+	m_authError = false;
+
+	if (!SendPipeline(command) || !DrainPipeline(false))
+	{
+		return nullptr;
+	}
+
+	{
+		Guard guard(m_pipelineMutex);
+		m_pipeline.pop_front();
+	}
+
+	char* answer = ReadLine(m_lineBuf, m_lineBuf.Size(), nullptr);
+
+	if (answer && !strncmp(answer, "480", 3))
+	{
+		debug("%s requested authorization", GetHost());
+
+		// all requests sent after ours were rejected too
+		if (!DrainPipeline(true) || !Authenticate())
+		{
+			return nullptr;
+		}
+
+		//try again
+		{
+			Guard guard(m_pipelineMutex);
+			m_pipeline.emplace_front(messageId);
+		}
+
+		if (!SendPipeline(command))
+		{
+			return nullptr;
+		}
+
+		{
+			Guard guard(m_pipelineMutex);
+			m_pipeline.pop_front();
+		}
+
+		answer = ReadLine(m_lineBuf, m_lineBuf.Size(), nullptr);
+	}
+
+	return answer;
+}
+
+void NntpConnection::AddPipelineRequest(const char* messageId)
+{
+	Guard guard(m_pipelineMutex);
+	m_pipeline.emplace_back(messageId);
+}
+
+void NntpConnection::CancelPipelineRequest(const char* messageId)
+{
+	Guard guard(m_pipelineMutex);
+	for (PipelineRequest& request : m_pipeline)
+	{
+		if (!request.cancelled && !strcmp(request.messageId, messageId))
+		{
+			request.cancelled = true;
+			break;
+		}
+	}
+}
+
+bool NntpConnection::HasPipelineRequest(const char* messageId)
+{
+	Guard guard(m_pipelineMutex);
+	return std::find_if(m_pipeline.begin(), m_pipeline.end(),
+		[messageId](PipelineRequest& request)
+		{
+			return !request.cancelled && !strcmp(request.messageId, messageId);
+		}) != m_pipeline.end();
+}
+
+bool NntpConnection::IsPipelineHead(const char* messageId)
+{
+	Guard guard(m_pipelineMutex);
+	for (PipelineRequest& request : m_pipeline)
+	{
+		if (!request.cancelled)
+		{
+			return !strcmp(request.messageId, messageId);
+		}
+	}
+	return false;
+}
+
+bool NntpConnection::IsPipelineBusy()
+{
+	Guard guard(m_pipelineMutex);
+	return std::find_if(m_pipeline.begin(), m_pipeline.end(),
+		[](PipelineRequest& request) { return !request.cancelled; }) != m_pipeline.end();
+}
+
+/*
+ * Sends STAT requests for several articles at once. The responses must be read
+ * with "ReadResponse()" in the same order.
+ */
+bool NntpConnection::SendStatRequests(const std::vector<const char*>& messageIds)
+{
+	m_authError = false;
+
+	if (!DrainPipeline(true))
+	{
+		return false;
+	}
+
+	StringBuilder requests;
+	for (const char* messageId : messageIds)
+	{
+		requests.AppendFmt("STAT %s\r\n", messageId);
+	}
+
+	return requests.Empty() || Send(requests, requests.Length());
+}
+
+const char* NntpConnection::ReadResponse()
+{
+	return ReadLine(m_lineBuf, m_lineBuf.Size(), nullptr);
+}
+
+bool NntpConnection::SendPipeline(const char* command)
+{
+	StringBuilder requests;
+
+	{
+		Guard guard(m_pipelineMutex);
+
+		// cancelled requests which weren't sent yet are not needed anymore
+		m_pipeline.erase(std::remove_if(m_pipeline.begin(), m_pipeline.end(),
+			[](PipelineRequest& request) { return !request.sent && request.cancelled; }), m_pipeline.end());
+
+		for (PipelineRequest& request : m_pipeline)
+		{
+			if (!request.sent)
+			{
+				requests.AppendFmt("%s %s\r\n", command, *request.messageId);
+				request.sent = true;
+			}
+		}
+	}
+
+	return requests.Empty() || Send(requests, requests.Length());
+}
+
+/*
+ * With "all == false" skips responses to cancelled requests at the head of pipeline.
+ * With "all == true" skips responses to all sent requests; the requests which are
+ * still wanted are marked as unsent and will be sent again.
+ */
+bool NntpConnection::DrainPipeline(bool all)
+{
+	while (true)
+	{
+		bool sent;
+
+		{
+			Guard guard(m_pipelineMutex);
+			if (m_pipeline.empty() || (!all && !m_pipeline.front().cancelled))
+			{
+				break;
+			}
+
+			PipelineRequest& request = m_pipeline.front();
+			sent = request.sent;
+			if (request.cancelled || !all)
+			{
+				m_pipeline.pop_front();
+			}
+			else if (sent)
+			{
+				// move to the end, the order of remaining requests is kept
+				request.sent = false;
+				m_pipeline.push_back(std::move(request));
+				m_pipeline.pop_front();
+			}
+			else
+			{
+				break;
+			}
+		}
+
+		if (sent && !SkipResponse())
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool NntpConnection::SkipResponse()
+{
+	char* answer = ReadLine(m_lineBuf, m_lineBuf.Size(), nullptr);
+	if (!answer)
+	{
+		return false;
+	}
+
+	if (!strncmp(answer, "22", 2))
+	{
+		// article follows
+		while ((answer = ReadLine(m_lineBuf, m_lineBuf.Size(), nullptr)))
+		{
+			if (!strcmp(answer, ".\r\n"))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	return true;
+}
+
 void NntpConnection::ReportErrorAnswer(const char* msgPrefix, const char* answer)
 {
 	BString<1024> errStr(msgPrefix, m_newsServer->GetName(), m_newsServer->GetHost(), answer);
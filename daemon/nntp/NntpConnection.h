@@ -25,6 +25,7 @@
 #include "NString.h"
 #include "NewsServer.h"
 #include "Connection.h"
+#include "Thread.h"
 
 class NntpConnection : public Connection
 {
@@ -34,20 +35,48 @@ public:
 	virtual bool Disconnect();
 	NewsServer* GetNewsServer() { return m_newsServer; }
 	const char* Request(const char* req);
+	bool KeepAlive();
 	const char* JoinGroup(const char* grp);
+	const char* RequestArticle(const char* command, const char* messageId);
+	void AddPipelineRequest(const char* messageId);
+	void CancelPipelineRequest(const char* messageId);
+	bool HasPipelineRequest(const char* messageId);
+	bool IsPipelineHead(const char* messageId);
+	bool IsPipelineBusy();
+	bool SendStatRequests(const std::vector<const char*>& messageIds);
+	const char* ReadResponse();
+	bool Authenticate();
 	bool GetAuthError() { return m_authError; }
 
 private:
+	struct PipelineRequest
+	{
+		CString messageId;
+		bool sent = false;
+		bool cancelled = false;
+
+		PipelineRequest(const char* messageId) : messageId(messageId) {}
+	};
+
+	typedef std::deque<PipelineRequest> Pipeline;
+
 	NewsServer* m_newsServer;
 	CString m_activeGroup;
 	CharBuffer m_lineBuf;
 	bool m_authError = false;
+	Pipeline m_pipeline;
+	Mutex m_pipelineMutex;
 
 	void Clear();
+	bool SendPipeline(const char* command);
+	bool DrainPipeline(bool all);
+	bool SkipResponse();
 	void ReportErrorAnswer(const char* msgPrefix, const char* answer);
-	bool Authenticate();
 	bool AuthInfoUser(int recur);
 	bool AuthInfoPass(int recur);
+#ifndef DISABLE_GZIP
+	bool NegotiateCompression();
+#endif
 };
 
 #endif
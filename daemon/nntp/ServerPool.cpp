@@ -25,11 +25,26 @@
 
 static const int CONNECTION_HOLD_SECODNS = 5;
 
+// idle warm connections are kept alive by sending a command after this time
+
+// servers rated lower still get this share (in percent) of the weight of the best
+// server, so that their ratings are kept up to date
+static const int MIN_WEIGHT_PERCENT = 10;
+
 void ServerPool::PooledConnection::SetFreeTimeNow()
 {
 	m_freeTime = Util::CurrentTime();
 }
 
+void ServerPool::PooledConnection::SetInUse(bool inUse)
+{
+	if (inUse != m_inUse)
+	{
+		GetNewsServer()->SetConnectionsInUse(GetNewsServer()->GetConnectionsInUse() + (inUse ? 1 : -1));
+		m_inUse = inUse;
+	}
+}
+
 
 void ServerPool::AddServer(std::unique_ptr<NewsServer> newsServer)
 {
@@ -135,15 +150,44 @@ void ServerPool::InitConnections()
 	}
 
 	m_generation++;
+
+	// waiters must check the new configuration
+	NotifyWaiters((int)m_levelConds.size() - 1);
 }
 
 /* Returns connection from any server on a given level or nullptr if there is no free connection at the moment.
  * If all servers are blocked and all are optional a connection from the next level is returned instead.
+ * With "waitMsec" the caller is blocked until a connection becomes free, the server configuration
+ * changes or the time is out.
  */
-NntpConnection* ServerPool::GetConnection(int level, NewsServer* wantServer, RawServerList* ignoreServers)
+NntpConnection* ServerPool::GetConnection(int level, NewsServer* wantServer, RawServerList* ignoreServers, int waitMsec)
 {
 	Guard guard(m_connectionsMutex);
 
+	int generation = m_generation;
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(waitMsec);
+
+	while (true)
+	{
+		NntpConnection* connection = LockedGetLevelConnection(level, wantServer, ignoreServers);
+		if (connection || waitMsec == 0 || generation != m_generation)
+		{
+			return connection;
+		}
+
+		int remaining = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+			deadline - std::chrono::steady_clock::now()).count();
+		if (remaining <= 0)
+		{
+			return nullptr;
+		}
+
+		LevelCond(level).WaitFor(m_connectionsMutex, remaining);
+	}
+}
+
+NntpConnection* ServerPool::LockedGetLevelConnection(int level, NewsServer* wantServer, RawServerList* ignoreServers)
+{
 	for (; level < (int)m_levels.size() && m_levels[level] > 0; level++)
 	{
 		NntpConnection* connection = LockedGetConnection(level, wantServer, ignoreServers);
@@ -180,7 +224,8 @@ NntpConnection* ServerPool::LockedGetConnection(int level, NewsServer* wantServe
 	{
 		NewsServer* candidateServer = candidateConnection->GetNewsServer();
 		if (!candidateConnection->GetInUse() && candidateServer->GetActive() &&
-			candidateServer->GetNormLevel() == level &&
+			candidateServer->GetNormLevel() == level && !candidateConnection->IsPipelineBusy() &&
+			candidateServer->GetConnectionsInUse() < candidateServer->GetActiveConnections() &&
 			(!wantServer || candidateServer == wantServer ||
 			 (wantServer->GetGroup() > 0 && wantServer->GetGroup() == candidateServer->GetGroup())) &&
 			(candidateConnection->GetStatus() == Connection::csConnected ||
@@ -213,11 +258,22 @@ NntpConnection* ServerPool::LockedGetConnection(int level, NewsServer* wantServe
 
 	if (!candidates.empty())
 	{
-		// Peeking a random free connection. This is better than taking the first
-		// available connection because provides better distribution across news servers,
-		// especially when one of servers becomes unavailable or doesn't have requested articles.
-		int randomIndex = rand() % candidates.size();
-		connection = candidates[randomIndex];
+		connection = ChooseConnection(candidates);
+
+		// prefer an already opened connection to the chosen server
+		if (connection->GetStatus() != Connection::csConnected)
+		{
+			for (PooledConnection* candidate : candidates)
+			{
+				if (candidate->GetNewsServer() == connection->GetNewsServer() &&
+					candidate->GetStatus() == Connection::csConnected)
+				{
+					connection = candidate;
+					break;
+				}
+			}
+		}
+
 		connection->SetInUse(true);
 	}
 
@@ -229,6 +285,131 @@ NntpConnection* ServerPool::LockedGetConnection(int level, NewsServer* wantServe
 	return connection;
 }
 
+/*
+ * Peeking a random free connection. This is better than taking the first
+ * available connection because provides better distribution across news servers,
+ * especially when one of servers becomes unavailable or doesn't have requested articles.
+ * The chance of each connection is proportional to the rating of its server, so that
+ * servers currently answering faster and having more articles get more requests.
+ * Servers which weren't rated yet get the weight of the best server.
+ */
+ServerPool::PooledConnection* ServerPool::ChooseConnection(std::vector<PooledConnection*>& candidates)
+{
+	int maxWeight = 0;
+	for (PooledConnection* candidate : candidates)
+	{
+		maxWeight = std::max(maxWeight, candidate->GetNewsServer()->GetRating()->GetWeight());
+	}
+
+	if (maxWeight == 0)
+	{
+		return candidates[rand() % candidates.size()];
+	}
+
+	int minWeight = std::max(maxWeight / 100 * MIN_WEIGHT_PERCENT, 1);
+	std::vector<int> weights;
+	weights.reserve(candidates.size());
+	int64 totalWeight = 0;
+	for (PooledConnection* candidate : candidates)
+	{
+		int weight = candidate->GetNewsServer()->GetRating()->GetWeight();
+		weight = weight == 0 ? maxWeight : std::max(weight, minWeight);
+		weights.push_back(weight);
+		totalWeight += weight;
+	}
+
+	int64 point = (int64)rand() * totalWeight / ((int64)RAND_MAX + 1);
+	for (int i = 0; i < (int)candidates.size(); i++)
+	{
+		point -= weights[i];
+		if (point < 0)
+		{
+			return candidates[i];
+		}
+	}
+
+	return candidates.back();
+}
+
+/*
+ * Returns the connection on which the request for the article was sent (pipelined)
+ * if the response to the request is the next one to read. Sets "lost" if the
+ * request isn't pending on the connection anymore (for example the connection
+ * was closed); the article must then be requested using another connection.
+ * With "waitMsec" the caller is blocked until the response is the next one to read.
+ */
+NntpConnection* ServerPool::GetPipelinedConnection(NntpConnection* connection, const char* messageId,
+	bool* lost, int waitMsec)
+{
+	Guard guard(m_connectionsMutex);
+
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(waitMsec);
+
+	while (true)
+	{
+		NntpConnection* pipelinedConnection = LockedGetPipelinedConnection(connection, messageId, lost);
+		if (pipelinedConnection || *lost || waitMsec == 0)
+		{
+			return pipelinedConnection;
+		}
+
+		int remaining = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+			deadline - std::chrono::steady_clock::now()).count();
+		if (remaining <= 0)
+		{
+			return nullptr;
+		}
+
+		LevelCond(std::max(connection->GetNewsServer()->GetNormLevel(), 0)).WaitFor(m_connectionsMutex, remaining);
+	}
+}
+
+NntpConnection* ServerPool::LockedGetPipelinedConnection(NntpConnection* connection, const char* messageId, bool* lost)
+{
+	for (PooledConnection* candidateConnection : &m_connections)
+	{
+		if (candidateConnection == connection)
+		{
+			NewsServer* newsServer = connection->GetNewsServer();
+			if (!newsServer->GetActive() || !connection->HasPipelineRequest(messageId))
+			{
+				connection->CancelPipelineRequest(messageId);
+				break;
+			}
+
+			if (candidateConnection->GetInUse() || !connection->IsPipelineHead(messageId))
+			{
+				return nullptr;
+			}
+
+			candidateConnection->SetInUse(true);
+			if (newsServer->GetNormLevel() > -1)
+			{
+				m_levels[newsServer->GetNormLevel()]--;
+			}
+			return connection;
+		}
+	}
+
+	*lost = true;
+	return nullptr;
+}
+
+void ServerPool::CancelPipelineRequest(NntpConnection* connection, const char* messageId)
+{
+	Guard guard(m_connectionsMutex);
+
+	for (PooledConnection* candidateConnection : &m_connections)
+	{
+		if (candidateConnection == connection)
+		{
+			connection->CancelPipelineRequest(messageId);
+			NotifyWaiters(connection->GetNewsServer()->GetNormLevel());
+			break;
+		}
+	}
+}
+
 void ServerPool::FreeConnection(NntpConnection* connection, bool used)
 {
 	if (used)
@@ -237,7 +418,11 @@ void ServerPool::FreeConnection(NntpConnection* connection, bool used)
 	}
 
 	Guard guard(m_connectionsMutex);
+	LockedFreeConnection(connection, used);
+}
 
+void ServerPool::LockedFreeConnection(NntpConnection* connection, bool used)
+{
 	((PooledConnection*)connection)->SetInUse(false);
 	if (used)
 	{
@@ -248,6 +433,37 @@ void ServerPool::FreeConnection(NntpConnection* connection, bool used)
 	{
 		m_levels[connection->GetNewsServer()->GetNormLevel()]++;
 	}
+
+	NotifyWaiters(connection->GetNewsServer()->GetNormLevel());
+}
+
+/*
+ * Each level has its own condition variable, which waiters for a connection on that level
+ * (or for a pipelined connection of a server on that level) are waiting on.
+ * Condition variables are never deleted, since threads may be waiting on them.
+ */
+ConditionVar& ServerPool::LevelCond(int level)
+{
+	while ((int)m_levelConds.size() <= level)
+	{
+		m_levelConds.push_back(std::make_unique<ConditionVar>());
+	}
+	return *m_levelConds[level];
+}
+
+/*
+ * Wakes up waiters of the level and of all lower levels, since they may use connections
+ * of higher levels if all servers on their level are blocked.
+ */
+void ServerPool::NotifyWaiters(int level)
+{
+	for (int i = 0; i <= level || i == 0; i++)
+	{
+		if (i < (int)m_levelConds.size())
+		{
+			m_levelConds[i]->NotifyAll();
+		}
+	}
 }
 
 void ServerPool::BlockServer(NewsServer* newsServer)
@@ -266,6 +482,22 @@ void ServerPool::BlockServer(NewsServer* newsServer)
 	}
 }
 
+/*
+ * Limits the number of connections used for the server (see "ConnectionTuner").
+ */
+void ServerPool::SetActiveConnections(NewsServer* newsServer, int activeConnections)
+{
+	Guard guard(m_connectionsMutex);
+	newsServer->SetActiveConnections(activeConnections);
+	NotifyWaiters(newsServer->GetNormLevel());
+}
+
+int ServerPool::GetConnectionsInUse(NewsServer* newsServer)
+{
+	Guard guard(m_connectionsMutex);
+	return newsServer->GetConnectionsInUse();
+}
+
 bool ServerPool::IsServerBlocked(NewsServer* newsServer)
 {
 	if (!newsServer->GetBlockTime())
@@ -331,14 +563,20 @@ void ServerPool::CloseUnusedConnections()
 		}
 
 		// if there are no in-use connections on the level and the hold time out has
-		// expired - close all connections of the level.
+		// expired - close all connections of the level, except of warm connections
+		// (see "KeepWarm").
 		if (!hasInUseConnections && inactiveTime > CONNECTION_HOLD_SECODNS)
 		{
+			std::map<NewsServer*, int> warmConnections;
 			for (PooledConnection* connection : &m_connections)
 			{
 				if (connection->GetNewsServer()->GetNormLevel() == level &&
 					connection->GetStatus() == Connection::csConnected)
 				{
+					if (level == 0 && warmConnections[connection->GetNewsServer()]++ < m_warmConnections)
+					{
+						continue;
+					}
 					debug("Closing (and keeping) unused connection to server%i", connection->GetNewsServer()->GetId());
 					connection->Disconnect();
 				}
@@ -347,6 +585,159 @@ void ServerPool::CloseUnusedConnections()
 	}
 }
 
+/*
+ * Opens the given number of connections to each server of the first level in advance,
+ * so that downloads don't have to wait for connection setup and authentication. To avoid
+ * a burst of handshakes at most one connection per server is opened per call. Idle warm
+ * connections are kept alive with cheap commands instead of being closed. Value "0" stops
+ * warming and cancels running warmers, the connections are then closed as usual.
+ * This method is called periodically (once per second) while downloads are expected.
+ */
+void ServerPool::KeepWarm(int connections)
+{
+	Guard guard(m_connectionsMutex);
+
+	m_warmConnections = connections;
+	if (connections == 0)
+	{
+		CancelWarmers();
+		return;
+	}
+
+	if (m_levels.empty())
+	{
+		return;
+	}
+
+	time_t curTime = Util::CurrentTime();
+
+	for (NewsServer* newsServer : &m_servers)
+	{
+		if (newsServer->GetNormLevel() != 0 || !newsServer->GetActive() || IsServerBlocked(newsServer))
+		{
+			continue;
+		}
+
+		// after a failed warm-up the server isn't warmed up again before the retry interval
+		bool canConnect = curTime - m_warmFailures[newsServer] >= m_retryInterval;
+
+		int wanted = std::min(connections, newsServer->GetActiveConnections());
+		int warm = 0;
+		PooledConnection* coldConnection = nullptr;
+
+		for (PooledConnection* connection : &m_connections)
+		{
+			if (connection->GetNewsServer() != newsServer)
+			{
+				continue;
+			}
+
+			if (connection->GetInUse())
+			{
+				warm++;
+			}
+			else if (connection->GetStatus() == Connection::csConnected)
+			{
+				warm++;
+				if (curTime - connection->GetFreeTime() >= m_keepAliveInterval &&
+					!connection->IsPipelineBusy())
+				{
+					StartWarmer(connection);
+				}
+			}
+			else if (!coldConnection)
+			{
+				coldConnection = connection;
+			}
+		}
+
+		if (coldConnection && warm < wanted && canConnect)
+		{
+			debug("Warming up connection to server%i", newsServer->GetId());
+			StartWarmer(coldConnection);
+		}
+	}
+}
+
+/*
+ * Stops warming and waits until all warmers are finished.
+ */
+void ServerPool::StopWarming()
+{
+	Guard guard(m_connectionsMutex);
+	m_warmConnections = 0;
+	CancelWarmers();
+	m_warmersCond.Wait(m_connectionsMutex, [&]{ return m_warmingConnections.empty(); });
+}
+
+bool ServerPool::IsWarming()
+{
+	Guard guard(m_connectionsMutex);
+	return !m_warmingConnections.empty();
+}
+
+void ServerPool::StartWarmer(PooledConnection* connection)
+{
+	connection->SetInUse(true);
+	connection->SetSuppressErrors(false);
+	m_levels[0]--;
+	m_warmingConnections.push_back(connection);
+
+	ConnectionWarmer* warmer = new ConnectionWarmer(this, connection);
+	warmer->SetAutoDestroy(true);
+	warmer->Start();
+}
+
+/*
+ * Aborts connecting or waiting for keep-alive answers, otherwise stopping would have to
+ * wait up to the connection timeout.
+ */
+void ServerPool::CancelWarmers()
+{
+	for (PooledConnection* connection : m_warmingConnections)
+	{
+		connection->SetSuppressErrors(true);
+		connection->Cancel();
+	}
+}
+
+void ServerPool::FinishWarmer(PooledConnection* connection, bool failed)
+{
+	Guard guard(m_connectionsMutex);
+
+	if (failed)
+	{
+		m_warmFailures[connection->GetNewsServer()] = Util::CurrentTime();
+	}
+
+	m_warmingConnections.erase(std::find(m_warmingConnections.begin(), m_warmingConnections.end(), connection));
+	if (connection->GetStatus() == Connection::csCancelled)
+	{
+		connection->Disconnect();
+	}
+	LockedFreeConnection(connection, true);
+	m_warmersCond.NotifyAll();
+}
+
+void ServerPool::ConnectionWarmer::Run()
+{
+	bool failed = false;
+
+	if (m_connection->GetStatus() == Connection::csConnected)
+	{
+		m_connection->KeepAlive();
+	}
+	else if (!m_connection->Connect() && m_connection->GetStatus() != Connection::csCancelled)
+	{
+		// the connection was only speculative, the server isn't blocked here; downloaders
+		// block it if it's really unavailable
+		detail("Could not warm up connection to %s", m_connection->GetHost());
+		failed = true;
+	}
+
+	m_owner->FinishWarmer(m_connection, failed);
+}
+
 void ServerPool::Changed()
 {
 	debug("Server config has been changed");
@@ -368,10 +759,13 @@ void ServerPool::LogDebugInfo()
 	info("    Servers: %i", (int)m_servers.size());
 	for (NewsServer* newsServer : &m_servers)
 	{
-		info("      %i) %s (%s): Level=%i, NormLevel=%i, BlockSec=%i", newsServer->GetId(), newsServer->GetName(),
+		info("      %i) %s (%s): Level=%i, NormLevel=%i, BlockSec=%i, FirstByteMs=%i, Throughput=%i, NotFound=%i%%, Weight=%i",
+			newsServer->GetId(), newsServer->GetName(),
 			newsServer->GetHost(), newsServer->GetLevel(), newsServer->GetNormLevel(),
 			newsServer->GetBlockTime() && newsServer->GetBlockTime() + m_retryInterval > curTime ?
-				(int)(newsServer->GetBlockTime() + m_retryInterval - curTime) : 0);
+				(int)(newsServer->GetBlockTime() + m_retryInterval - curTime) : 0,
+			newsServer->GetRating()->GetFirstByteTime(), newsServer->GetRating()->GetThroughput(),
+			newsServer->GetRating()->GetNotFoundRate(), newsServer->GetRating()->GetWeight());
 	}
 
 	info("    Levels: %i", (int)m_levels.size());
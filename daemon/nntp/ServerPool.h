@@ -35,17 +35,25 @@ public:
 
 	void SetTimeout(int timeout) { m_timeout = timeout; }
 	void SetRetryInterval(int retryInterval) { m_retryInterval = retryInterval; }
+	void SetKeepAliveInterval(int keepAliveInterval) { m_keepAliveInterval = keepAliveInterval; }
 	void AddServer(std::unique_ptr<NewsServer> newsServer);
 	void InitConnections();
 	int GetMaxNormLevel() { return m_maxNormLevel; }
 	Servers* GetServers() { return &m_servers; } // Only for read access (no lockings)
-	NntpConnection* GetConnection(int level, NewsServer* wantServer, RawServerList* ignoreServers);
+	NntpConnection* GetConnection(int level, NewsServer* wantServer, RawServerList* ignoreServers, int waitMsec = 0);
+	NntpConnection* GetPipelinedConnection(NntpConnection* connection, const char* messageId, bool* lost, int waitMsec = 0);
+	void CancelPipelineRequest(NntpConnection* connection, const char* messageId);
 	void FreeConnection(NntpConnection* connection, bool used);
 	void CloseUnusedConnections();
 	void Changed();
 	int GetGeneration() { return m_generation; }
 	void BlockServer(NewsServer* newsServer);
 	bool IsServerBlocked(NewsServer* newsServer);
+	void SetActiveConnections(NewsServer* newsServer, int activeConnections);
+	int GetConnectionsInUse(NewsServer* newsServer);
+	void KeepWarm(int connections);
+	void StopWarming();
+	bool IsWarming();
 
 protected:
 	virtual void LogDebugInfo();
@@ -56,7 +64,7 @@ private:
 	public:
 		using NntpConnection::NntpConnection;
 		bool GetInUse() { return m_inUse; }
-		void SetInUse(bool inUse) { m_inUse = inUse; }
+		void SetInUse(bool inUse);
 		time_t GetFreeTime() { return m_freeTime; }
 		void SetFreeTimeNow();
 	private:
@@ -64,8 +72,21 @@ private:
 		time_t m_freeTime = 0;
 	};
 
+	class ConnectionWarmer : public Thread
+	{
+	public:
+		ConnectionWarmer(ServerPool* owner, PooledConnection* connection) :
+			m_owner(owner), m_connection(connection) {}
+		virtual void Run();
+	private:
+		ServerPool* m_owner;
+		PooledConnection* m_connection;
+	};
+
 	typedef std::vector<int> Levels;
 	typedef std::vector<std::unique_ptr<PooledConnection>> Connections;
+	typedef std::vector<PooledConnection*> WarmingConnections;
+	typedef std::vector<std::unique_ptr<ConditionVar>> LevelConds;
 
 	Servers m_servers;
 	RawServerList m_sortedServers;
@@ -73,12 +94,27 @@ private:
 	Levels m_levels;
 	int m_maxNormLevel = 0;
 	Mutex m_connectionsMutex;
+	LevelConds m_levelConds;
 	int m_timeout = 60;
 	int m_retryInterval = 0;
+	int m_keepAliveInterval = 30;
 	int m_generation = 0;
+	int m_warmConnections = 0;
+	WarmingConnections m_warmingConnections;
+	std::map<NewsServer*, time_t> m_warmFailures;
+	ConditionVar m_warmersCond;
 
 	void NormalizeLevels();
 	NntpConnection* LockedGetConnection(int level, NewsServer* wantServer, RawServerList* ignoreServers);
+	NntpConnection* LockedGetLevelConnection(int level, NewsServer* wantServer, RawServerList* ignoreServers);
+	PooledConnection* ChooseConnection(std::vector<PooledConnection*>& candidates);
+	NntpConnection* LockedGetPipelinedConnection(NntpConnection* connection, const char* messageId, bool* lost);
+	ConditionVar& LevelCond(int level);
+	void NotifyWaiters(int level);
+	void LockedFreeConnection(NntpConnection* connection, bool used);
+	void StartWarmer(PooledConnection* connection);
+	void CancelWarmers();
+	void FinishWarmer(PooledConnection* connection, bool failed);
 };
 
 extern ServerPool* g_ServerPool;
@@ -0,0 +1,98 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "nzbget.h"
+#include "ServerRating.h"
+
+// weight of a new measurement in the rolling averages
+static const double SMOOTHING = 0.1;
+
+static void Average(double& value, double measurement, int count)
+{
+	// the first measurements are weighted more to quickly reach a meaningful value
+	double factor = std::max(SMOOTHING, 1.0 / count);
+	value += (measurement - value) * factor;
+}
+
+void ServerRating::AddResponse(int64 firstByteUsec)
+{
+	Guard guard(m_mutex);
+	m_responses++;
+	Average(m_firstByteUsec, (double)firstByteUsec, m_responses);
+	UpdateWeight();
+}
+
+void ServerRating::AddArticle(bool found, int64 bytes, int64 usec)
+{
+	Guard guard(m_mutex);
+	m_articles++;
+	Average(m_notFound, found ? 0.0 : 1.0, m_articles);
+	if (found && bytes > 0)
+	{
+		m_transfers++;
+		Average(m_articleBytes, (double)bytes, m_transfers);
+		Average(m_bytesPerUsec, (double)bytes / std::max(usec, (int64)1), m_transfers);
+	}
+	UpdateWeight();
+}
+
+int ServerRating::GetFirstByteTime()
+{
+	Guard guard(m_mutex);
+	return (int)(m_firstByteUsec / 1000);
+}
+
+int ServerRating::GetThroughput()
+{
+	Guard guard(m_mutex);
+	return (int)(m_bytesPerUsec * 1000000);
+}
+
+int ServerRating::GetNotFoundRate()
+{
+	Guard guard(m_mutex);
+	return (int)(m_notFound * 100 + 0.5);
+}
+
+/*
+ * The weight is the expected number of articles successfully delivered per second
+ * on one connection (scaled by 1000). Until the first article was requested from
+ * the server the weight remains zero, which means "unknown". A server which hasn't
+ * delivered any article yet (only "not found" answers) gets the lowest weight.
+ */
+void ServerRating::UpdateWeight()
+{
+	if (m_articles == 0)
+	{
+		m_weight = 0;
+		return;
+	}
+
+	if (m_responses == 0 || m_bytesPerUsec <= 0)
+	{
+		m_weight = 1;
+		return;
+	}
+
+	double articleUsec = m_firstByteUsec + m_articleBytes / m_bytesPerUsec;
+	double weight = (1.0 - m_notFound) * 1000000000.0 / std::max(articleUsec, 1.0);
+	m_weight = (int)std::min(std::max(weight, 1.0), 1000000000.0);
+}
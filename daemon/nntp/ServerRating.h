@@ -0,0 +1,57 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef SERVERRATING_H
+#define SERVERRATING_H
+
+#include "Thread.h"
+
+/*
+ * Rolling measurements of how well a news server currently serves articles:
+ * time to first byte of the response, throughput and the rate of articles not
+ * found on the server. The measurements are combined into a weight used to
+ * prefer better servers among servers of the same level.
+ */
+class ServerRating
+{
+public:
+	void AddResponse(int64 firstByteUsec);
+	void AddArticle(bool found, int64 bytes, int64 usec);
+	int GetFirstByteTime(); // msec
+	int GetThroughput(); // bytes per second
+	int GetNotFoundRate(); // percent
+	int GetWeight() { return m_weight; }
+
+private:
+	Mutex m_mutex;
+	double m_firstByteUsec = 0;
+	double m_bytesPerUsec = 0;
+	double m_articleBytes = 0;
+	double m_notFound = 0;
+	int m_responses = 0;
+	int m_articles = 0;
+	int m_transfers = 0;
+	std::atomic<int> m_weight{0};
+
+	void UpdateWeight();
+};
+
+#endif
@@ -178,7 +178,12 @@ void StatMeter::Init()
 	m_lastCheck = m_startServer;
 	AdjustTimeOffset();
 
-	m_serverVolumes.resize(1 + g_ServerPool->GetServers()->size());
+	m_serverSlots = 1 + (int)g_ServerPool->GetServers()->size();
+	m_serverVolumes.resize(m_serverSlots);
+	for (CounterShard& shard : m_shards)
+	{
+		shard.serverBytes = std::make_unique<std::atomic<int64>[]>(m_serverSlots);
+	}
 }
 
 void StatMeter::AdjustTimeOffset()
@@ -202,6 +207,8 @@ void StatMeter::AdjustTimeOffset()
  */
 void StatMeter::IntervalCheck()
 {
+	CollectReadings();
+
 	time_t m_curTime = Util::CurrentTime();
 	time_t diff = m_curTime - m_lastCheck;
 	if (diff > 60 || diff < 0)
@@ -252,6 +259,7 @@ void StatMeter::EnterLeaveStandBy(bool enter)
 			m_startDownload += Util::CurrentTime() - m_pausedFrom;
 		}
 		m_pausedFrom = 0;
+		CollectSpeed();
 		ResetSpeedStat();
 	}
 }
@@ -259,6 +267,8 @@ void StatMeter::EnterLeaveStandBy(bool enter)
 void StatMeter::CalcTotalStat(int* upTimeSec, int* dnTimeSec, int64* allBytes, bool* standBy)
 {
 	Guard guard(m_statMutex);
+	CollectSpeed();
+
 	if (m_startServer > 0)
 	{
 		*upTimeSec = (int)(Util::CurrentTime() - m_startServer);
@@ -282,6 +292,9 @@ void StatMeter::CalcTotalStat(int* upTimeSec, int* dnTimeSec, int64* allBytes, b
 // Average speed in last 30 seconds
 int StatMeter::CalcCurrentDownloadSpeed()
 {
+	Guard guard(m_statMutex);
+	CollectSpeed();
+
 	if (m_standBy)
 	{
 		return 0;
@@ -299,12 +312,86 @@ int StatMeter::CalcCurrentDownloadSpeed()
 // Amount of data downloaded in current second
 int StatMeter::CalcMomentaryDownloadSpeed()
 {
+	Guard guard(m_statMutex);
+	CollectSpeed();
+
 	time_t curTime = Util::CurrentTime();
 	int speed = curTime == m_curSecTime ? m_curSecBytes : 0;
 	return speed;
 }
 
+/*
+ * Called by download threads on every portion of received data.
+ * The data is only added to a per thread counter, the speed meter is updated by readers.
+ */
 void StatMeter::AddSpeedReading(int bytes)
+{
+	GetShard().speedBytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+StatMeter::CounterShard& StatMeter::GetShard()
+{
+	static std::atomic<int> nextShard{0};
+	static thread_local int shard = nextShard++ % COUNTER_SHARDS;
+	return m_shards[shard];
+}
+
+/*
+ * Moves data accumulated in per thread counters into speed meter and volume statistics.
+ * Called frequently by queue coordinator and also before the statistics are read.
+ */
+void StatMeter::CollectReadings()
+{
+	{
+		Guard guard(m_statMutex);
+		CollectSpeed();
+	}
+
+	{
+		Guard guard(m_volumeMutex);
+		CollectVolumes();
+	}
+}
+
+// must be called with locked "m_statMutex"
+void StatMeter::CollectSpeed()
+{
+	int64 bytes = 0;
+	for (CounterShard& shard : m_shards)
+	{
+		if (shard.speedBytes.load(std::memory_order_relaxed) != 0)
+		{
+			bytes += shard.speedBytes.exchange(0, std::memory_order_relaxed);
+		}
+	}
+
+	AddSpeedBytes((int)bytes);
+}
+
+// must be called with locked "m_volumeMutex"
+void StatMeter::CollectVolumes()
+{
+	for (int serverId = 1; serverId < m_serverSlots && serverId < (int)m_serverVolumes.size(); serverId++)
+	{
+		int64 bytes = 0;
+		for (CounterShard& shard : m_shards)
+		{
+			if (shard.serverBytes[serverId].load(std::memory_order_relaxed) != 0)
+			{
+				bytes += shard.serverBytes[serverId].exchange(0, std::memory_order_relaxed);
+			}
+		}
+
+		if (bytes > 0)
+		{
+			m_serverVolumes[0].AddData((int)bytes);
+			m_serverVolumes[serverId].AddData((int)bytes);
+			m_statChanged = true;
+		}
+	}
+}
+
+void StatMeter::AddSpeedBytes(int bytes)
 {
 	time_t curTime = Util::CurrentTime();
 	int nowSlot = (int)curTime / SPEEDMETER_SLOTSIZE;
@@ -376,6 +463,8 @@ void StatMeter::ResetSpeedStat()
 
 void StatMeter::LogDebugInfo()
 {
+	CollectReadings();
+
 	info("   ---------- SpeedMeter");
 	int speed = CalcCurrentDownloadSpeed() / 1024;
 	int timeDiff = (int)Util::CurrentTime() - m_speedStartTime * SPEEDMETER_SLOTSIZE;
@@ -403,20 +492,18 @@ void StatMeter::LogDebugInfo()
 
 void StatMeter::AddServerData(int bytes, int serverId)
 {
-	if (bytes == 0)
+	if (bytes == 0 || serverId >= m_serverSlots)
 	{
 		return;
 	}
 
-	Guard guard(m_volumeMutex);
-	m_serverVolumes[0].AddData(bytes);
-	m_serverVolumes[serverId].AddData(bytes);
-	m_statChanged = true;
+	GetShard().serverBytes[serverId].fetch_add(bytes, std::memory_order_relaxed);
 }
 
 GuardedServerVolumes StatMeter::GuardServerVolumes()
 {
 	GuardedServerVolumes serverVolumes(&m_serverVolumes, &m_volumeMutex);
+	CollectVolumes();
 
 	// update slots
 	for (ServerVolume& serverVolume : m_serverVolumes)
@@ -435,6 +522,7 @@ void StatMeter::Save()
 	}
 
 	Guard guard(m_volumeMutex);
+	CollectVolumes();
 	g_DiskState->SaveStats(g_ServerPool->GetServers(), &m_serverVolumes);
 	m_statChanged = false;
 }
@@ -485,6 +573,7 @@ void StatMeter::CheckQuota()
 void StatMeter::CalcQuotaUsage(int64& monthBytes, int64& dayBytes)
 {
 	Guard guard(m_volumeMutex);
+	CollectVolumes();
 
 	ServerVolume totalVolume = m_serverVolumes[0];
 
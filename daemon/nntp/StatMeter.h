@@ -82,6 +82,7 @@ public:
 	int CalcMomentaryDownloadSpeed();
 	void AddSpeedReading(int bytes);
 	void AddServerData(int bytes, int serverId);
+	void CollectReadings();
 	void CalcTotalStat(int* upTimeSec, int* dnTimeSec, int64* allBytes, bool* standBy);
 	void CalcQuotaUsage(int64& monthBytes, int64& dayBytes);
 	void IntervalCheck();
@@ -106,6 +107,16 @@ private:
 	int m_curSecBytes;
 	time_t m_curSecTime;
 
+	// per thread counters, aggregated lazily by readers
+	static const int COUNTER_SHARDS = 16;
+	struct alignas(64) CounterShard
+	{
+		std::atomic<int64> speedBytes{0};
+		std::unique_ptr<std::atomic<int64>[]> serverBytes;
+	};
+	CounterShard m_shards[COUNTER_SHARDS];
+	int m_serverSlots = 0;
+
 	// time
 	int64 m_allBytes = 0;
 	time_t m_startServer = 0;
@@ -122,6 +133,10 @@ private:
 	Mutex m_volumeMutex;
 
 	void ResetSpeedStat();
+	CounterShard& GetShard();
+	void CollectSpeed();
+	void CollectVolumes();
+	void AddSpeedBytes(int bytes);
 	void AdjustTimeOffset();
 	void CheckQuota();
 	int CalcMonthSlots(ServerVolume& volume);
@@ -46,6 +46,7 @@ struct NServOpts
 	bool quit;
 	int latency;
 	int speed;
+	int missing;
 	bool memCache;
 	bool paramError;
 
@@ -119,7 +120,7 @@ int NServMain(int argc, char* argv[])
 	{
 		instances.emplace_back(std::make_unique<NntpServer>(i + 1, opts.bindAddress,
 			opts.firstPort + i, opts.secureCert, opts.secureKey, opts.dataDir, opts.cacheDir,
-			opts.latency, opts.speed, opts.memCache ? &cache : nullptr));
+			opts.latency, opts.speed, opts.missing, opts.memCache ? &cache : nullptr));
 		instances.back()->Start();
 	}
 
@@ -162,6 +163,7 @@ void NServPrintUsage(const char* com)
 		"    -v <verbose>    - verbosity level 0..3 (default is 2)\n"
 		"    -w <msec>       - response latency (in milliseconds)\n"
 		"    -r <KB/s>       - speed throttling (in kilobytes per second)\n"
+		"    -e <percent>    - percentage of articles reported missing (different on each instance)\n"
 		"    -z <seg-size>   - generate nzbs for all files in data-dir (size in bytes)\n"
 		"    -q              - quit after generating nzbs (in combination with -z)\n"
 		, FileSystem::BaseFileName(com));
@@ -178,10 +180,11 @@ NServOpts::NServOpts(int argc, char* argv[], Options::CmdOptList& cmdOpts)
 	latency = 0;
 	memCache = false;
 	speed = 0;
+	missing = 0;
 	paramError = false;
 	int verbosity = 2;
 
-	char short_options[] = "b:c:d:l:p:i:ms:v:w:r:z:q";
+	char short_options[] = "b:c:d:l:p:i:ms:v:w:r:e:z:q";
 
 	optind = 2;
 	while (true)
@@ -236,6 +239,10 @@ NServOpts::NServOpts(int argc, char* argv[], Options::CmdOptList& cmdOpts)
 				speed = atoi(optind > argc ? "0" : argv[optind - 1]);
 				break;
 
+			case 'e':
+				missing = atoi(optind > argc ? "0" : argv[optind - 1]);
+				break;
+
 			case 'z':
 				generateNzb = true;
 				segmentSize = atoi(optind > argc ? "500000" : argv[optind - 1]);
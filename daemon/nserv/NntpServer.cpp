@@ -28,10 +28,10 @@ class NntpProcessor : public Thread
 {
 public:
 	NntpProcessor(int id, int serverId, const char* dataDir, const char* cacheDir,
-		const char* secureCert, const char* secureKey, int latency, int speed, NntpCache* cache) :
+		const char* secureCert, const char* secureKey, int latency, int speed, int missing, NntpCache* cache) :
 		m_id(id), m_serverId(serverId), m_dataDir(dataDir), m_cacheDir(cacheDir),
 		m_secureCert(secureCert), m_secureKey(secureKey), m_latency(latency),
-		m_speed(speed), m_cache(cache) {}
+		m_speed(speed), m_missing(missing), m_cache(cache) {}
 	~NntpProcessor() { m_connection->Disconnect(); }
 	virtual void Run();
 	void SetConnection(std::unique_ptr<Connection>&& connection) { m_connection = std::move(connection); }
@@ -46,6 +46,7 @@ private:
 	const char* m_secureKey;
 	int m_latency;
 	int m_speed;
+	int m_missing;
 	const char* m_messageid;
 	CString m_filename;
 	int m_part;
@@ -56,8 +57,11 @@ private:
 	NntpCache* m_cache;
 
 	void ServArticle();
+	void StatArticle();
+	bool ParseMessageId(const char*& error);
 	void SendSegment();
 	bool ServerInList(const char* servList);
+	bool SimulateMissing();
 	void SendData(const char* buffer, int size);
 };
 
@@ -108,7 +112,7 @@ void NntpServer::Run()
 		}
 		
 		NntpProcessor* commandThread = new NntpProcessor(num++, m_id, m_dataDir,
-			m_cacheDir, m_secureCert, m_secureKey, m_latency, m_speed, m_cache);
+			m_cacheDir, m_secureCert, m_secureKey, m_latency, m_speed, m_missing, m_cache);
 		commandThread->SetAutoDestroy(true);
 		commandThread->SetConnection(std::move(acceptedConnection));
 		commandThread->Start();
@@ -170,6 +174,11 @@ void NntpProcessor::Run()
 			m_sendHeaders = false;
 			ServArticle();
 		}
+		else if (!strncasecmp(line, "STAT ", 5))
+		{
+			m_messageid = line + 5;
+			StatArticle();
+		}
 		else if (!strncasecmp(line, "GROUP ", 6))
 		{
 			m_connection->WriteLine(CString::FormatStr("211 0 0 0 %s\r\n", line + 7));
@@ -178,6 +187,32 @@ void NntpProcessor::Run()
 		{
 			m_connection->WriteLine("281 Authentication accepted\r\n");
 		}
+		else if (!strcasecmp(line, "COMPRESS DEFLATE"))
+		{
+#ifndef DISABLE_GZIP
+			if (m_connection->GetCompression())
+			{
+				m_connection->WriteLine("502 Compression already active\r\n");
+				continue;
+			}
+			m_connection->WriteLine("206 Compression active\r\n");
+			if (!m_connection->StartCompression())
+			{
+				break;
+			}
+#else
+			m_connection->WriteLine("403 Compression not supported\r\n");
+#endif
+		}
+		else if (!strcasecmp(line, "DATE"))
+		{
+			time_t curTime = Util::CurrentTime();
+			tm tmTime;
+			gmtime_r(&curTime, &tmTime);
+			m_connection->WriteLine(CString::FormatStr("111 %04i%02i%02i%02i%02i%02i\r\n",
+				tmTime.tm_year + 1900, tmTime.tm_mon + 1, tmTime.tm_mday,
+				tmTime.tm_hour, tmTime.tm_min, tmTime.tm_sec));
+		}
 		else if (!strcasecmp(line, "QUIT"))
 		{
 			detail("[%i] Closing connection", m_id);
@@ -219,38 +254,78 @@ void NntpProcessor::ServArticle()
 		Util::Sleep(m_latency);
 	}
 
-	bool ok = false;
+	const char* error;
+	if (ParseMessageId(error))
+	{
+		SendSegment();
+	}
+	else
+	{
+		m_connection->WriteLine(error);
+	}
+}
+
+void NntpProcessor::StatArticle()
+{
+	detail("[%i] Checking: %s", m_id, m_messageid);
+
+	const char* error;
+	if (!ParseMessageId(error))
+	{
+		m_connection->WriteLine(error);
+		return;
+	}
 
+	BString<1024> fullFilename("%s/%s", m_dataDir, *m_filename);
+	if (!FileSystem::FileExists(fullFilename))
+	{
+		m_connection->WriteLine("430 Article not found\r\n");
+		return;
+	}
+
+	m_connection->WriteLine(CString::FormatStr("223 0 %s\r\n", m_messageid));
+}
+
+/*
+ * Parses the message-id (see above) and checks if the article is available on this server.
+ * On failure "error" is set to the response to send.
+ */
+bool NntpProcessor::ParseMessageId(const char*& error)
+{
 	const char* from = strchr(m_messageid, '?');
 	const char* off = strchr(m_messageid, '=');
 	const char* to = strchr(m_messageid, ':');
 	const char* end = strchr(m_messageid, '>');
 	const char* serv = strchr(m_messageid, '!');
 
-	if (from && off && to && end)
+	if (!(from && off && to && end))
 	{
-		m_filename.Set(m_messageid + 1, (int)(from - m_messageid - 1));
-		m_part = atoi(from + 1);
-		m_offset = atoll(off + 1);
-		m_size = atoi(to + 1);
-
-		ok = !serv || ServerInList(serv + 1);
+		error = "430 No Such Article Found (invalid message id format)\r\n";
+		return false;
+	}
 
-		if (ok)
-		{
-			SendSegment();
-			return;
-		}
+	m_filename.Set(m_messageid + 1, (int)(from - m_messageid - 1));
+	m_part = atoi(from + 1);
+	m_offset = atoll(off + 1);
+	m_size = atoi(to + 1);
 
-		if (!ok)
-		{
-			m_connection->WriteLine("430 No Such Article Found\r\n");
-		}
-	}
-	else
+	if ((serv && !ServerInList(serv + 1)) || SimulateMissing())
 	{
-		m_connection->WriteLine("430 No Such Article Found (invalid message id format)\r\n");
+		error = "430 No Such Article Found\r\n";
+		return false;
 	}
+
+	return true;
+}
+
+/*
+ * With option "-e" a percentage of articles is reported missing. Which articles are
+ * missing depends on the message-id and the server; each server misses other articles.
+ */
+bool NntpProcessor::SimulateMissing()
+{
+	return m_missing > 0 &&
+		(int)(Util::HashBJ96(m_messageid, (int)strlen(m_messageid), m_serverId) % 100) < m_missing;
 }
 
 bool NntpProcessor::ServerInList(const char* servList)
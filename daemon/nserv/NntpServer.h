@@ -54,10 +54,10 @@ class NntpServer : public Thread
 public:
 	NntpServer(int id, const char* host, int port, const char* secureCert,
 		const char* secureKey, const char* dataDir, const char* cacheDir,
-		int latency, int speed, NntpCache* cache) :
+		int latency, int speed, int missing, NntpCache* cache) :
 		m_id(id), m_host(host), m_port(port), m_secureCert(secureCert),
 		m_secureKey(secureKey), m_dataDir(dataDir), m_cacheDir(cacheDir),
-		m_latency(latency), m_speed(speed), m_cache(cache) {}
+		m_latency(latency), m_speed(speed), m_missing(missing), m_cache(cache) {}
 	virtual void Run();
 	virtual void Stop();
 
@@ -72,6 +72,7 @@ private:
 	CString m_cacheDir;
 	int m_latency;
 	int m_speed;
+	int m_missing;
 	NntpCache* m_cache;
 };
 
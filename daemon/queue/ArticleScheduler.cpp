@@ -0,0 +1,377 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "nzbget.h"
+#include "ArticleScheduler.h"
+
+ArticleScheduler::~ArticleScheduler()
+{
+	for (auto& pair : m_entries)
+	{
+		pair.first->SetScheduler(nullptr);
+	}
+}
+
+FileInfo* ArticleScheduler::GetNextFile(NzbList* queue, time_t curTime, bool downloadPaused)
+{
+	m_curTime = curTime;
+
+	if (downloadPaused != m_downloadPaused)
+	{
+		// files dropped because of pause (or skipped while unpaused) must be reconsidered
+		m_downloadPaused = downloadPaused;
+		m_valid = false;
+	}
+
+	if (!m_valid)
+	{
+		Rebuild(queue);
+	}
+
+	WheelAdvance();
+
+	while (!m_heap.empty())
+	{
+		Entry* entry = m_heap.front();
+
+		if (!IsEligible(entry))
+		{
+			HeapRemove(entry);
+			continue;
+		}
+
+		if (m_propagationDelay > 0 && ReadyTime(entry) > m_curTime)
+		{
+			HeapRemove(entry);
+			WheelAdd(entry);
+			continue;
+		}
+
+		if (UpdateKey(entry))
+		{
+			HeapFix(entry->heapIndex);
+			continue;
+		}
+
+		return entry->fileInfo;
+	}
+
+	return nullptr;
+}
+
+ArticleInfo* ArticleScheduler::GetNextArticle(FileInfo* fileInfo)
+{
+	auto pos = m_entries.find(fileInfo);
+	if (pos == m_entries.end())
+	{
+		return nullptr;
+	}
+
+	Entry& entry = pos->second;
+	ArticleList* articles = fileInfo->GetArticles();
+	for (; entry.nextArticle < articles->size(); entry.nextArticle++)
+	{
+		ArticleInfo* articleInfo = (*articles)[entry.nextArticle].get();
+		if (articleInfo->GetStatus() == ArticleInfo::aiUndefined)
+		{
+			return articleInfo;
+		}
+	}
+
+	return nullptr;
+}
+
+void ArticleScheduler::FileExhausted(FileInfo* fileInfo)
+{
+	auto pos = m_entries.find(fileInfo);
+	if (pos != m_entries.end())
+	{
+		pos->second.exhausted = true;
+		HeapRemove(&pos->second);
+	}
+}
+
+void ArticleScheduler::ArticleReturned(FileInfo* fileInfo)
+{
+	auto pos = m_entries.find(fileInfo);
+	if (pos != m_entries.end())
+	{
+		Entry* entry = &pos->second;
+		entry->exhausted = false;
+		entry->nextArticle = 0;
+		if (entry->heapIndex == -1 && !entry->waiting)
+		{
+			Schedule(entry);
+		}
+	}
+}
+
+void ArticleScheduler::FileChanged(FileInfo* fileInfo)
+{
+	auto pos = m_entries.find(fileInfo);
+	if (pos != m_entries.end())
+	{
+		Entry* entry = &pos->second;
+		UpdateKey(entry);
+		if (entry->heapIndex > -1)
+		{
+			HeapFix(entry->heapIndex);
+		}
+		else if (!entry->waiting)
+		{
+			Schedule(entry);
+		}
+	}
+}
+
+void ArticleScheduler::FileDestroyed(FileInfo* fileInfo)
+{
+	auto pos = m_entries.find(fileInfo);
+	if (pos != m_entries.end())
+	{
+		HeapRemove(&pos->second);
+		WheelRemove(&pos->second);
+		m_entries.erase(pos);
+	}
+}
+
+void ArticleScheduler::Rebuild(NzbList* queue)
+{
+	debug("Rebuilding article scheduler");
+
+	m_generation++;
+	m_heap.clear();
+	for (EntryList& slot : m_wheel)
+	{
+		slot.clear();
+	}
+	m_waitingCount = 0;
+
+	int order = 0;
+	for (NzbInfo* nzbInfo : queue)
+	{
+		for (FileInfo* fileInfo : nzbInfo->GetFileList())
+		{
+			Entry& entry = m_entries[fileInfo];
+			entry.fileInfo = fileInfo;
+			entry.order = order++;
+			entry.generation = m_generation;
+			fileInfo->SetScheduler(this);
+		}
+	}
+
+	for (auto it = m_entries.begin(); it != m_entries.end(); )
+	{
+		Entry& entry = it->second;
+		if (entry.generation != m_generation)
+		{
+			// file is not in queue anymore
+			entry.fileInfo->SetScheduler(nullptr);
+			it = m_entries.erase(it);
+			continue;
+		}
+
+		// article states may have been changed by queue edits, rescan from the beginning
+		entry.heapIndex = -1;
+		entry.waiting = false;
+		entry.exhausted = false;
+		entry.nextArticle = 0;
+		UpdateKey(&entry);
+		Schedule(&entry);
+		it++;
+	}
+
+	m_valid = true;
+}
+
+void ArticleScheduler::Schedule(Entry* entry)
+{
+	if (!IsEligible(entry))
+	{
+		return;
+	}
+
+	if (m_propagationDelay > 0 && ReadyTime(entry) > m_curTime)
+	{
+		WheelAdd(entry);
+	}
+	else
+	{
+		HeapPush(entry);
+	}
+}
+
+bool ArticleScheduler::IsEligible(Entry* entry)
+{
+	FileInfo* fileInfo = entry->fileInfo;
+	return !entry->exhausted && !fileInfo->GetPaused() && !fileInfo->GetDeleted() &&
+		(!m_downloadPaused || fileInfo->GetNzbInfo()->GetForcePriority());
+}
+
+bool ArticleScheduler::UpdateKey(Entry* entry)
+{
+	bool extraPriority = entry->fileInfo->GetExtraPriority();
+	int priority = entry->fileInfo->GetNzbInfo()->GetPriority();
+	bool changed = extraPriority != entry->extraPriority || priority != entry->priority;
+	entry->extraPriority = extraPriority;
+	entry->priority = priority;
+	return changed;
+}
+
+bool ArticleScheduler::Before(Entry* a, Entry* b)
+{
+	// files with extra priority go first, then files of nzbs with higher priority,
+	// within the same priority files are downloaded in queue order
+	if (a->extraPriority != b->extraPriority)
+	{
+		return a->extraPriority;
+	}
+	if (a->priority != b->priority)
+	{
+		return a->priority > b->priority;
+	}
+	return a->order < b->order;
+}
+
+void ArticleScheduler::HeapPush(Entry* entry)
+{
+	entry->heapIndex = (int)m_heap.size();
+	m_heap.push_back(entry);
+	HeapFix(entry->heapIndex);
+}
+
+void ArticleScheduler::HeapRemove(Entry* entry)
+{
+	int index = entry->heapIndex;
+	if (index == -1)
+	{
+		return;
+	}
+
+	int last = (int)m_heap.size() - 1;
+	if (index != last)
+	{
+		HeapSwap(index, last);
+	}
+	m_heap.pop_back();
+	entry->heapIndex = -1;
+
+	if (index < (int)m_heap.size())
+	{
+		HeapFix(index);
+	}
+}
+
+void ArticleScheduler::HeapFix(int index)
+{
+	// sift up
+	while (index > 0)
+	{
+		int parent = (index - 1) / 2;
+		if (!Before(m_heap[index], m_heap[parent]))
+		{
+			break;
+		}
+		HeapSwap(index, parent);
+		index = parent;
+	}
+
+	// sift down
+	int size = (int)m_heap.size();
+	while (true)
+	{
+		int best = index;
+		int left = index * 2 + 1;
+		int right = left + 1;
+		if (left < size && Before(m_heap[left], m_heap[best]))
+		{
+			best = left;
+		}
+		if (right < size && Before(m_heap[right], m_heap[best]))
+		{
+			best = right;
+		}
+		if (best == index)
+		{
+			break;
+		}
+		HeapSwap(index, best);
+		index = best;
+	}
+}
+
+void ArticleScheduler::HeapSwap(int i, int j)
+{
+	std::swap(m_heap[i], m_heap[j]);
+	m_heap[i]->heapIndex = i;
+	m_heap[j]->heapIndex = j;
+}
+
+void ArticleScheduler::WheelAdd(Entry* entry)
+{
+	if (m_waitingCount == 0)
+	{
+		m_wheelTime = m_curTime;
+	}
+	m_wheel[ReadyTime(entry) % WHEEL_SIZE].push_back(entry);
+	entry->waiting = true;
+	m_waitingCount++;
+}
+
+void ArticleScheduler::WheelRemove(Entry* entry)
+{
+	if (!entry->waiting)
+	{
+		return;
+	}
+
+	EntryList& slot = m_wheel[ReadyTime(entry) % WHEEL_SIZE];
+	slot.erase(std::find(slot.begin(), slot.end(), entry));
+	entry->waiting = false;
+	m_waitingCount--;
+}
+
+void ArticleScheduler::WheelAdvance()
+{
+	// process slots of all seconds passed since last call; files waiting longer than
+	// one wheel turn stay in their slots until their time comes
+	for (int i = 0; m_waitingCount > 0 && m_wheelTime < m_curTime && i < WHEEL_SIZE; i++)
+	{
+		m_wheelTime++;
+		EntryList& slot = m_wheel[m_wheelTime % WHEEL_SIZE];
+		for (auto it = slot.begin(); it != slot.end(); )
+		{
+			Entry* entry = *it;
+			if (ReadyTime(entry) <= m_curTime)
+			{
+				it = slot.erase(it);
+				entry->waiting = false;
+				m_waitingCount--;
+				Schedule(entry);
+			}
+			else
+			{
+				it++;
+			}
+		}
+	}
+	m_wheelTime = m_curTime;
+}
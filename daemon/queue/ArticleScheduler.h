@@ -0,0 +1,98 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef ARTICLESCHEDULER_H
+#define ARTICLESCHEDULER_H
+
+#include "DownloadInfo.h"
+
+/*
+ * Keeps files eligible for download in a priority heap, so that the next article
+ * can be found without scanning the whole download queue.
+ * Files waiting for propagation delay are parked in a timer wheel.
+ * Each file has a cursor pointing to the first article which may still be undefined.
+ *
+ * The index is rebuilt from the queue after it was invalidated (queue edited,
+ * files or nzbs added or removed). Pausing, priority changes and returned articles
+ * are tracked incrementally. Files which became ineligible are dropped lazily
+ * when they come to the top of the heap.
+ *
+ * All methods must be called with locked download queue.
+ */
+class ArticleScheduler
+{
+public:
+	~ArticleScheduler();
+	void SetPropagationDelay(int propagationDelay) { m_propagationDelay = propagationDelay; }
+	void Invalidate() { m_valid = false; }
+	FileInfo* GetNextFile(NzbList* queue, time_t curTime, bool downloadPaused);
+	ArticleInfo* GetNextArticle(FileInfo* fileInfo);
+	void FileExhausted(FileInfo* fileInfo);
+	void ArticleReturned(FileInfo* fileInfo);
+	void FileChanged(FileInfo* fileInfo);
+	void FileDestroyed(FileInfo* fileInfo);
+
+private:
+	struct Entry
+	{
+		FileInfo* fileInfo = nullptr;
+		bool extraPriority = false;
+		int priority = 0;
+		int order = 0;
+		int heapIndex = -1;
+		bool waiting = false;
+		bool exhausted = false;
+		uint32 nextArticle = 0;
+		int generation = 0;
+	};
+
+	typedef std::unordered_map<FileInfo*, Entry> EntryMap;
+	typedef std::vector<Entry*> EntryList;
+
+	static const int WHEEL_SIZE = 256;
+
+	EntryMap m_entries;
+	EntryList m_heap;
+	EntryList m_wheel[WHEEL_SIZE];
+	int m_waitingCount = 0;
+	time_t m_wheelTime = 0;
+	time_t m_curTime = 0;
+	bool m_downloadPaused = false;
+	int m_propagationDelay = 0;
+	int m_generation = 0;
+	bool m_valid = false;
+
+	void Rebuild(NzbList* queue);
+	void Schedule(Entry* entry);
+	bool IsEligible(Entry* entry);
+	bool UpdateKey(Entry* entry);
+	time_t ReadyTime(Entry* entry) { return entry->fileInfo->GetTime() + m_propagationDelay + 1; }
+	bool Before(Entry* a, Entry* b);
+	void HeapPush(Entry* entry);
+	void HeapRemove(Entry* entry);
+	void HeapFix(int index);
+	void HeapSwap(int i, int j);
+	void WheelAdd(Entry* entry);
+	void WheelRemove(Entry* entry);
+	void WheelAdvance();
+};
+
+#endif
@@ -0,0 +1,453 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "nzbget.h"
+#include "AvailabilityChecker.h"
+#include "ServerPool.h"
+#include "Options.h"
+#include "Log.h"
+#include "Util.h"
+
+// number of STAT requests sent at once over one connection
+static const int STAT_BATCH_SIZE = 100;
+// maximum number of connections to one server used for checking
+static const int MAX_CONNECTIONS = 4;
+// how long to wait for the first connection to a server
+static const int CONNECTION_WAIT_SEC = 30;
+static const int CONNECTION_WAIT_MSEC = 1000;
+
+bool ArticleAvailability::IsMissing(Article& article, int level)
+{
+	return article.checked && (article.foundLevel < 0 || article.foundLevel > level);
+}
+
+int ArticleAvailability::CountFound(int level)
+{
+	return (int)std::count_if(m_articles.begin(), m_articles.end(),
+		[level](Article& article) { return article.foundLevel > -1 && article.foundLevel <= level; });
+}
+
+/*
+ * Same as "NzbInfo::CalcHealth()" but using the share of articles missing on
+ * the servers up to the given level. Articles not checked are considered available.
+ */
+int ArticleAvailability::CalcHealth(int level)
+{
+	int64 sampleSize = 0;
+	int64 missingSize = 0;
+	for (Article& article : m_articles)
+	{
+		if (!article.parFile)
+		{
+			sampleSize += article.size;
+			missingSize += IsMissing(article, level) ? article.size : 0;
+		}
+	}
+
+	if (missingSize == 0 || sampleSize == 0)
+	{
+		return 1000;
+	}
+
+	return (int)((sampleSize - missingSize) * 1000 / sampleSize);
+}
+
+/*
+ * Same as "NzbInfo::CalcCriticalHealth(true)" but using the expected
+ * size of available par-files.
+ */
+int ArticleAvailability::CalcCriticalHealth(int level)
+{
+	if (m_size == 0)
+	{
+		return 1000;
+	}
+
+	if (m_size == m_parSize)
+	{
+		return 0;
+	}
+
+	int64 sampleSize = 0;
+	int64 missingSize = 0;
+	for (Article& article : m_articles)
+	{
+		if (article.parFile)
+		{
+			sampleSize += article.size;
+			missingSize += IsMissing(article, level) ? article.size : 0;
+		}
+	}
+
+	int64 goodParSize = sampleSize > 0 ?
+		(int64)((double)m_parSize * (sampleSize - missingSize) / sampleSize) : m_parSize;
+	int criticalHealth = (int)((m_size - goodParSize*2) * 1000 / (m_size - goodParSize));
+
+	if (goodParSize*2 > m_size)
+	{
+		criticalHealth = 0;
+	}
+	else if (criticalHealth == 1000 && m_parSize > 0)
+	{
+		criticalHealth = 999;
+	}
+
+	if (criticalHealth == 1000)
+	{
+		criticalHealth = 850;
+	}
+
+	return criticalHealth;
+}
+
+/*
+ * Picks the given percentage of articles evenly distributed over the whole nzb.
+ * The first article is always picked.
+ */
+bool AvailabilityChecker::IsSampled(int index, int samplePercent)
+{
+	return ((int64)index * samplePercent + 99) / 100 < ((int64)(index + 1) * samplePercent + 99) / 100;
+}
+
+bool AvailabilityChecker::CanStart()
+{
+	Guard guard(m_jobsMutex);
+	return (int)m_jobs.size() < MAX_JOBS;
+}
+
+void AvailabilityChecker::Start(DownloadQueue* downloadQueue, NzbInfo* nzbInfo)
+{
+	int samplePercent = g_Options->GetPreCheck() == Options::pcFull ? 100 :
+		std::min(std::max(g_Options->GetPreCheckSample(), 1), 100);
+
+	std::unique_ptr<ArticleAvailability> availability =
+		std::make_unique<ArticleAvailability>(nzbInfo->GetSize(), nzbInfo->GetParSize());
+
+	int index = 0;
+	for (FileInfo* fileInfo : nzbInfo->GetFileList())
+	{
+		for (ArticleInfo* articleInfo : fileInfo->GetArticles())
+		{
+			if (IsSampled(index++, samplePercent))
+			{
+				availability->AddArticle(articleInfo->GetMessageId(), articleInfo->GetSize(), fileInfo->GetParFile());
+			}
+		}
+	}
+
+	nzbInfo->PrintMessage(Message::mkInfo, "Checking availability of %i of %i articles of %s",
+		(int)availability->GetArticles()->size(), index, nzbInfo->GetName());
+
+	nzbInfo->SetPreCheckStatus(NzbInfo::pkRunning);
+
+	Job* job = new Job(this, nzbInfo->GetId(), nzbInfo->GetName(), std::move(availability));
+	job->SetAutoDestroy(true);
+
+	{
+		Guard guard(m_jobsMutex);
+		m_jobs.push_back(job);
+	}
+
+	job->Start();
+}
+
+void AvailabilityChecker::Stop()
+{
+	Guard guard(m_jobsMutex);
+	for (Job* job : m_jobs)
+	{
+		job->Stop();
+	}
+}
+
+bool AvailabilityChecker::IsRunning()
+{
+	Guard guard(m_jobsMutex);
+	return !m_jobs.empty();
+}
+
+void AvailabilityChecker::JobFinished(Job* job)
+{
+	Guard guard(m_jobsMutex);
+	m_jobs.erase(std::find(m_jobs.begin(), m_jobs.end(), job));
+}
+
+void AvailabilityChecker::Job::Run()
+{
+	m_serverConfigGeneration = g_ServerPool->GetGeneration();
+
+	for (int level = 0; level <= g_ServerPool->GetMaxNormLevel() && !IsStopped(); level++)
+	{
+		CheckLevel(level);
+	}
+
+	if (!IsStopped())
+	{
+		GuardedDownloadQueue downloadQueue = DownloadQueue::Guard();
+		NzbInfo* nzbInfo = downloadQueue->GetQueue()->Find(m_nzbId);
+		if (nzbInfo)
+		{
+			m_owner->CheckCompleted(downloadQueue, nzbInfo, m_availability.get());
+		}
+	}
+
+	m_owner->JobFinished(this);
+}
+
+void AvailabilityChecker::Job::Stop()
+{
+	Thread::Stop();
+	Guard guard(m_connectionsMutex);
+	for (NntpConnection* connection : m_connections)
+	{
+		connection->SetSuppressErrors(true);
+		connection->Cancel();
+	}
+}
+
+/*
+ * Checks articles not found on lower levels on all servers of the level.
+ * Servers of the same group have the same articles, only one of them is checked.
+ */
+void AvailabilityChecker::Job::CheckLevel(int level)
+{
+	ServerPool::RawServerList checkedServers;
+	ArticleAvailability::ArticleList* articles = m_availability->GetArticles();
+
+	for (NewsServer* newsServer : g_ServerPool->GetServers())
+	{
+		if (IsStopped() || m_serverConfigGeneration != g_ServerPool->GetGeneration())
+		{
+			return;
+		}
+
+		if (newsServer->GetNormLevel() != level || !newsServer->GetActive() ||
+			newsServer->GetMaxConnections() == 0 ||
+			(newsServer->GetOptional() && g_ServerPool->IsServerBlocked(newsServer)) ||
+			std::find_if(checkedServers.begin(), checkedServers.end(),
+				[newsServer](NewsServer* checkedServer)
+				{
+					return newsServer->GetGroup() > 0 && newsServer->GetGroup() == checkedServer->GetGroup();
+				}) != checkedServers.end())
+		{
+			continue;
+		}
+
+		Indices pending;
+		for (int i = 0; i < (int)articles->size(); i++)
+		{
+			if ((*articles)[i].foundLevel < 0)
+			{
+				pending.push_back(i);
+			}
+		}
+
+		if (pending.empty())
+		{
+			return;
+		}
+
+		CheckServer(newsServer, level, pending);
+		checkedServers.push_back(newsServer);
+	}
+}
+
+/*
+ * The articles are distributed across several connections of the server in batches;
+ * all batches are sent before the responses are read.
+ */
+void AvailabilityChecker::Job::CheckServer(NewsServer* newsServer, int level, Indices& pending)
+{
+	AcquireConnections(newsServer, level);
+
+	int articleCount = (int)pending.size();
+	bool unsupported = false;
+	uint32 next = 0;
+
+	while (next < pending.size() && !m_connections.empty() && !unsupported && !IsStopped())
+	{
+		std::vector<Indices> batches(m_connections.size());
+		std::vector<bool> failed(m_connections.size());
+		Indices retry;
+
+		for (uint32 i = 0; i < m_connections.size(); i++)
+		{
+			std::vector<const char*> messageIds;
+			for (; next < pending.size() && messageIds.size() < STAT_BATCH_SIZE; next++)
+			{
+				batches[i].push_back(pending[next]);
+				messageIds.push_back((*m_availability->GetArticles())[pending[next]].messageId);
+			}
+
+			if (!m_connections[i]->SendStatRequests(messageIds))
+			{
+				retry.insert(retry.end(), batches[i].begin(), batches[i].end());
+				failed[i] = true;
+			}
+		}
+
+		for (uint32 i = 0; i < m_connections.size(); i++)
+		{
+			if (!failed[i])
+			{
+				EBatchStatus status = CheckBatch(m_connections[i], m_availability.get(), level, batches[i], retry);
+				failed[i] = status != bsOk;
+				unsupported |= status == bsUnsupported;
+			}
+		}
+
+		for (int i = (int)m_connections.size() - 1; i >= 0; i--)
+		{
+			if (failed[i])
+			{
+				ReleaseConnection(m_connections[i], false);
+			}
+		}
+
+		// the articles whose responses weren't received are checked via other connections
+		pending.insert(pending.end(), retry.begin(), retry.end());
+	}
+
+	while (!m_connections.empty())
+	{
+		ReleaseConnection(m_connections.back(), true);
+	}
+
+	detail("Checked availability of %i articles of %s on %s", articleCount, *m_name, newsServer->GetName());
+}
+
+/*
+ * Reads the responses to STAT requests of the batch.
+ * The articles whose responses couldn't be read are added to "retry". If the server
+ * requests authorization the connection is authenticated and the rejected articles
+ * are added to "retry" too.
+ */
+AvailabilityChecker::EBatchStatus AvailabilityChecker::CheckBatch(NntpConnection* connection,
+	ArticleAvailability* availability, int level, Indices& batch, Indices& retry)
+{
+	bool authRequested = false;
+
+	for (uint32 i = 0; i < batch.size(); i++)
+	{
+		const char* response = connection->ReadResponse();
+		if (!response)
+		{
+			retry.insert(retry.end(), batch.begin() + i, batch.end());
+			return bsConnectionError;
+		}
+
+		ArticleAvailability::Article& article = (*availability->GetArticles())[batch[i]];
+		if (!strncmp(response, "223", 3))
+		{
+			article.checked = true;
+			if (article.foundLevel < 0)
+			{
+				article.foundLevel = level;
+			}
+		}
+		else if (!strncmp(response, "480", 3))
+		{
+			// all requests sent after the rejected one are rejected too, reading them all
+			// before authenticating
+			authRequested = true;
+			retry.push_back(batch[i]);
+		}
+		else if (!strncmp(response, "42", 2) || !strncmp(response, "43", 2))
+		{
+			article.checked = true;
+		}
+		else
+		{
+			detail("Could not check availability of articles on %s: %s",
+				connection->GetNewsServer()->GetName(), response);
+			return bsUnsupported;
+		}
+	}
+
+	if (authRequested)
+	{
+		debug("%s requested authorization", connection->GetHost());
+		if (!connection->Authenticate())
+		{
+			return bsConnectionError;
+		}
+	}
+
+	return bsOk;
+}
+
+/*
+ * Takes up to MAX_CONNECTIONS connections of the server from the server pool,
+ * waiting for the first one if all connections are in use.
+ */
+void AvailabilityChecker::Job::AcquireConnections(NewsServer* newsServer, int level)
+{
+	time_t start = Util::CurrentTime();
+
+	while ((int)m_connections.size() < MAX_CONNECTIONS && !IsStopped() &&
+		m_serverConfigGeneration == g_ServerPool->GetGeneration())
+	{
+		bool wait = m_connections.empty() && Util::CurrentTime() - start < CONNECTION_WAIT_SEC;
+		NntpConnection* connection = g_ServerPool->GetConnection(level, newsServer, nullptr,
+			wait ? CONNECTION_WAIT_MSEC : 0);
+		if (!connection)
+		{
+			if (wait)
+			{
+				continue;
+			}
+			break;
+		}
+
+		{
+			Guard guard(m_connectionsMutex);
+			m_connections.push_back(connection);
+		}
+
+		if (connection->GetNewsServer()->GetNormLevel() != level)
+		{
+			ReleaseConnection(connection, true);
+			break;
+		}
+
+		connection->SetSuppressErrors(false);
+		if (!connection->Connect())
+		{
+			g_ServerPool->BlockServer(connection->GetNewsServer());
+			ReleaseConnection(connection, false);
+			break;
+		}
+	}
+}
+
+void AvailabilityChecker::Job::ReleaseConnection(NntpConnection* connection, bool keepConnected)
+{
+	{
+		Guard guard(m_connectionsMutex);
+		m_connections.erase(std::find(m_connections.begin(), m_connections.end(), connection));
+	}
+
+	if (!keepConnected || connection->GetStatus() == Connection::csCancelled)
+	{
+		connection->Disconnect();
+	}
+	g_ServerPool->FreeConnection(connection, true);
+}
@@ -0,0 +1,133 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef AVAILABILITYCHECKER_H
+#define AVAILABILITYCHECKER_H
+
+#include "DownloadInfo.h"
+#include "NntpConnection.h"
+#include "Thread.h"
+
+/*
+ * Articles of an nzb checked for availability and the server levels they were found on.
+ * The articles may be only a sample of all articles of the nzb; the health is then
+ * extrapolated from the sample.
+ */
+class ArticleAvailability
+{
+public:
+	struct Article
+	{
+		CString messageId;
+		int size;
+		bool parFile;
+		int foundLevel = -1; // lowest server level having the article
+		bool checked = false; // at least one server gave a definite answer
+
+		Article(const char* messageId, int size, bool parFile) :
+			messageId(messageId), size(size), parFile(parFile) {}
+	};
+
+	typedef std::vector<Article> ArticleList;
+
+	ArticleAvailability(int64 size, int64 parSize) : m_size(size), m_parSize(parSize) {}
+	void AddArticle(const char* messageId, int size, bool parFile) { m_articles.emplace_back(messageId, size, parFile); }
+	ArticleList* GetArticles() { return &m_articles; }
+	int CountFound(int level);
+	int CalcHealth(int level);
+	int CalcCriticalHealth(int level);
+
+private:
+	ArticleList m_articles;
+	int64 m_size;
+	int64 m_parSize;
+
+	bool IsMissing(Article& article, int level);
+};
+
+/*
+ * Checks the availability of articles of nzbs with pipelined STAT commands before
+ * the download begins (option "PreCheck"). Each nzb is checked in its own thread;
+ * the articles not found on a server are checked on other servers of the same level,
+ * then on the servers of higher levels.
+ */
+class AvailabilityChecker
+{
+public:
+	static const int MAX_JOBS = 2;
+
+	enum EBatchStatus
+	{
+		bsOk,
+		bsConnectionError,
+		bsUnsupported
+	};
+
+	typedef std::vector<int> Indices;
+
+	bool CanStart();
+	void Start(DownloadQueue* downloadQueue, NzbInfo* nzbInfo);
+	void Stop();
+	bool IsRunning();
+
+	static bool IsSampled(int index, int samplePercent);
+	static EBatchStatus CheckBatch(NntpConnection* connection, ArticleAvailability* availability,
+		int level, Indices& batch, Indices& retry);
+
+protected:
+	virtual void CheckCompleted(DownloadQueue* downloadQueue, NzbInfo* nzbInfo,
+		ArticleAvailability* availability) = 0;
+
+private:
+	class Job : public Thread
+	{
+	public:
+		Job(AvailabilityChecker* owner, int nzbId, const char* name, std::unique_ptr<ArticleAvailability> availability) :
+			m_owner(owner), m_nzbId(nzbId), m_name(name), m_availability(std::move(availability)) {}
+		virtual void Run();
+		virtual void Stop();
+
+	private:
+		typedef std::vector<NntpConnection*> Connections;
+
+		AvailabilityChecker* m_owner;
+		int m_nzbId;
+		CString m_name;
+		std::unique_ptr<ArticleAvailability> m_availability;
+		Connections m_connections;
+		Mutex m_connectionsMutex;
+		int m_serverConfigGeneration = 0;
+
+		void CheckLevel(int level);
+		void CheckServer(NewsServer* newsServer, int level, Indices& pending);
+		void AcquireConnections(NewsServer* newsServer, int level);
+		void ReleaseConnection(NntpConnection* connection, bool keepConnected);
+	};
+
+	typedef std::vector<Job*> Jobs;
+
+	Jobs m_jobs;
+	Mutex m_jobsMutex;
+
+	void JobFinished(Job* job);
+};
+
+#endif
@@ -21,6 +21,8 @@
 
 #include "nzbget.h"
 #include "DownloadInfo.h"
+#include "ArticleScheduler.h"
+#include "ArticleWriter.h"
 #include "DiskState.h"
 #include "Options.h"
 #include "Util.h"
@@ -799,14 +801,33 @@ void FileInfo::ResetGenId(bool max)
 	}
 }
 
+FileInfo::~FileInfo()
+{
+	if (m_scheduler)
+	{
+		m_scheduler->FileDestroyed(this);
+	}
+
+	if (g_ArticleCache)
+	{
+		Guard contentGuard = g_ArticleCache->GuardContent();
+		g_ArticleCache->FileDeleted(this);
+	}
+}
+
 void FileInfo::SetPaused(bool paused)
 {
-	if (m_paused != paused && m_nzbInfo)
+	bool changed = m_paused != paused;
+	if (changed && m_nzbInfo)
 	{
 		m_nzbInfo->SetPausedFileCount(m_nzbInfo->GetPausedFileCount() + (paused ? 1 : -1));
 		m_nzbInfo->SetPausedSize(m_nzbInfo->GetPausedSize() + (paused ? m_remainingSize : - m_remainingSize));
 	}
 	m_paused = paused;
+	if (changed && m_scheduler)
+	{
+		m_scheduler->FileChanged(this);
+	}
 }
 
 void FileInfo::SetExtraPriority(bool extraPriority)
@@ -815,7 +836,12 @@ void FileInfo::SetExtraPriority(bool extraPriority)
 	{
 		m_nzbInfo->SetExtraPriority(m_nzbInfo->GetExtraPriority() + (extraPriority ? 1 : -1));
 	}
+	bool changed = m_extraPriority != extraPriority;
 	m_extraPriority = extraPriority;
+	if (changed && m_scheduler)
+	{
+		m_scheduler->FileChanged(this);
+	}
 }
 
 void FileInfo::MakeValidFilename()
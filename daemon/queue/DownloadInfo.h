@@ -31,6 +31,8 @@
 class NzbInfo;
 class DownloadQueue;
 class PostInfo;
+class ArticleScheduler;
+class MappedFile;
 
 class ServerStat
 {
@@ -129,6 +131,7 @@ public:
 	typedef std::vector<CString> Groups;
 
 	FileInfo(int id = 0) : m_id(id ? id : ++m_idGen) {}
+	~FileInfo();
 	int GetId() { return m_id; }
 	void SetId(int id);
 	static void ResetGenId(bool max);
@@ -178,6 +181,8 @@ public:
 	void SetOutputFilename(const char* outputFilename) { m_outputFilename = outputFilename; }
 	bool GetOutputInitialized() { return m_outputInitialized; }
 	void SetOutputInitialized(bool outputInitialized) { m_outputInitialized = outputInitialized; }
+	std::shared_ptr<MappedFile> GetOutputMapping() { return m_outputMapping; }
+	void SetOutputMapping(std::shared_ptr<MappedFile> outputMapping) { m_outputMapping = std::move(outputMapping); }
 	bool GetExtraPriority() { return m_extraPriority; }
 	void SetExtraPriority(bool extraPriority);
 	int GetActiveDownloads() { return m_activeDownloads; }
@@ -200,6 +205,8 @@ public:
 	void SetParSetId(const char* parSetId) { m_parSetId = parSetId; }
 	bool GetFlushLocked() { return m_flushLocked; }
 	void SetFlushLocked(bool flushLocked) { m_flushLocked = flushLocked; }
+	ArticleScheduler* GetScheduler() { return m_scheduler; }
+	void SetScheduler(ArticleScheduler* scheduler) { m_scheduler = scheduler; }
 
 	ServerStatList* GetServerStats() { return &m_serverStats; }
 
@@ -230,6 +237,8 @@ private:
 	bool m_outputInitialized = false;
 	CString m_outputFilename;
 	std::unique_ptr<Mutex> m_outputFileMutex;
+	// output file mapped into memory, shared with the article writers using it
+	std::shared_ptr<MappedFile> m_outputMapping;
 	bool m_extraPriority = false;
 	int m_activeDownloads = 0;
 	bool m_dupeDeleted = false;
@@ -241,6 +250,7 @@ private:
 	CString m_hash16k;
 	CString m_parSetId;
 	bool m_flushLocked = false;
+	ArticleScheduler* m_scheduler = nullptr;
 
 	static int m_idGen;
 	static int m_idMax;
@@ -365,6 +375,13 @@ public:
 		tsSuccess
 	};
 
+	enum EPreCheckStatus
+	{
+		pkNone,
+		pkRunning,
+		pkFinished
+	};
+
 	enum EPostRenameStatus
 	{
 		rsNone,
@@ -538,6 +555,8 @@ public:
 	CompletedFileList* GetCompletedFiles() { return &m_completedFiles; }
 	void SetDirectRenameStatus(EDirectRenameStatus renameStatus) { m_directRenameStatus = renameStatus; }
 	EDirectRenameStatus GetDirectRenameStatus() { return m_directRenameStatus; }
+	void SetPreCheckStatus(EPreCheckStatus preCheckStatus) { m_preCheckStatus = preCheckStatus; }
+	EPreCheckStatus GetPreCheckStatus() { return m_preCheckStatus; }
 	EPostRenameStatus GetParRenameStatus() { return m_parRenameStatus; }
 	void SetParRenameStatus(EPostRenameStatus renameStatus) { m_parRenameStatus = renameStatus; }
 	EPostRenameStatus GetRarRenameStatus() { return m_rarRenameStatus; }
@@ -688,6 +707,7 @@ private:
 	int m_extraPriority = 0;
 	CompletedFileList m_completedFiles;
 	EDirectRenameStatus m_directRenameStatus = tsNone;
+	EPreCheckStatus m_preCheckStatus = pkNone;
 	EPostRenameStatus m_parRenameStatus = rsNone;
 	EPostRenameStatus m_rarRenameStatus = rsNone;
 	EParStatus m_parStatus = psNone;
@@ -0,0 +1,51 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "nzbget.h"
+#include "HedgeMonitor.h"
+
+void HedgeMonitor::StartRound()
+{
+	m_lastRound = std::move(m_round);
+	m_round.clear();
+}
+
+bool HedgeMonitor::Check(ArticleDownloader* articleDownloader, ArticleInfo* articleInfo, int64 receivedBytes)
+{
+	Entry entry{articleInfo, receivedBytes, 0};
+
+	Entries::iterator last = m_lastRound.find(articleDownloader);
+	if (last != m_lastRound.end() && last->second.articleInfo == articleInfo &&
+		receivedBytes - last->second.receivedBytes < m_minBytes)
+	{
+		entry.slowChecks = last->second.slowChecks + 1;
+	}
+
+	m_round[articleDownloader] = entry;
+
+	return entry.slowChecks >= SLOW_CHECKS;
+}
+
+void HedgeMonitor::Clear()
+{
+	m_lastRound.clear();
+	m_round.clear();
+}
@@ -0,0 +1,64 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef HEDGEMONITOR_H
+#define HEDGEMONITOR_H
+
+#include "DownloadInfo.h"
+
+class ArticleDownloader;
+
+/*
+ * Finds downloads which are too slow, their articles are downloaded once more.
+ * The running downloads are checked in rounds (once per second). A download is slow
+ * if it receives less than the minimum amount of data per round in several rounds
+ * in a row while downloading the same article.
+ *
+ * All methods must be called with locked download queue.
+ */
+class HedgeMonitor
+{
+public:
+	void SetMinBytes(int64 minBytes) { m_minBytes = minBytes; }
+	// starts a new round, downloads not checked in the round are forgotten
+	void StartRound();
+	// returns "true" if the download is too slow
+	bool Check(ArticleDownloader* articleDownloader, ArticleInfo* articleInfo, int64 receivedBytes);
+	void Clear();
+
+private:
+	struct Entry
+	{
+		ArticleInfo* articleInfo;
+		int64 receivedBytes;
+		int slowChecks;
+	};
+
+	typedef std::map<ArticleDownloader*, Entry> Entries;
+
+	static const int SLOW_CHECKS = 2;
+
+	int64 m_minBytes = 0;
+	Entries m_lastRound;
+	Entries m_round;
+};
+
+#endif
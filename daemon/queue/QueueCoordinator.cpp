@@ -32,6 +32,10 @@
 #include "Decoder.h"
 #include "StatMeter.h"
 
+static const int CONNECTION_WAIT_MSEC = 100;
+// connections are warmed up this long before a scheduled resume of download
+static const int WARM_BEFORE_RESUME_SECONDS = 60;
+
 bool QueueCoordinator::CoordinatorDownloadQueue::EditEntry(
 	int ID, EEditAction action, const char* args)
 {
@@ -65,6 +69,9 @@ void QueueCoordinator::CoordinatorDownloadQueue::Save()
 		m_stateChanged = true;
 	}
 
+	// files may have been added, removed, moved or reset
+	m_owner->m_scheduler.Invalidate();
+
 	for (NzbInfo* nzbInfo : GetQueue())
 	{
 		nzbInfo->SetChanged(false);
@@ -189,8 +196,18 @@ void QueueCoordinator::Run()
 
 	Load();
 	AdjustDownloadsLimit();
+	m_scheduler.SetPropagationDelay(g_Options->GetPropagationDelay());
+	StartDownloadEngine();
+	if (g_Options->GetAdaptiveConnections())
+	{
+		m_connectionTuner = std::make_unique<ConnectionTuner>();
+		m_connectionTuner->Init();
+	}
 	bool wasStandBy = true;
 	bool articeDownloadsRunning = false;
+	bool queueExhausted = false;
+	bool hedging = g_Options->GetHedgeSpeed() > 0 && g_Options->GetArticleCache() > 0 && !g_Options->GetRawArticle();
+	m_hedgeMonitor.SetMinBytes((int64)g_Options->GetHedgeSpeed() * 1024);
 	time_t lastReset = 0;
 	g_StatMeter->IntervalCheck();
 	int waitInterval = 100;
@@ -199,7 +216,9 @@ void QueueCoordinator::Run()
 	{
 		bool downloadsChecked = false;
 		bool downloadStarted = false;
-		NntpConnection* connection = g_ServerPool->GetConnection(0, nullptr, nullptr);
+		// while downloads are running wait for one of their connections to become free
+		int connectionWait = articeDownloadsRunning ? CONNECTION_WAIT_MSEC : 0;
+		NntpConnection* connection = g_ServerPool->GetConnection(0, nullptr, nullptr, connectionWait);
 		if (connection)
 		{
 			// start download for next article
@@ -212,11 +231,12 @@ void QueueCoordinator::Run()
 				bool hasMoreArticles = GetNextArticle(downloadQueue, fileInfo, articleInfo);
 				articeDownloadsRunning = !m_activeDownloads.empty();
 				downloadsChecked = true;
+				queueExhausted = !hasMoreArticles;
 				m_hasMoreJobs = hasMoreArticles || articeDownloadsRunning;
 				if (hasMoreArticles && !IsStopped() && (int)m_activeDownloads.size() < m_downloadsLimit &&
 					(!g_WorkState->GetTempPauseDownload() || fileInfo->GetExtraPriority()))
 				{
-					StartArticleDownload(fileInfo, articleInfo, connection);
+					StartArticleDownload(downloadQueue, fileInfo, articleInfo, connection);
 					articeDownloadsRunning = true;
 					downloadStarted = true;
 				}
@@ -262,17 +282,29 @@ void QueueCoordinator::Run()
 		}
 		else
 		{
-			int sleepInterval = downloadStarted ? 0 : 5;
+			int sleepInterval = downloadStarted || (!connection && connectionWait > 0) ? 0 : 5;
 			Util::Sleep(sleepInterval);
-			g_StatMeter->AddSpeedReading(0);
+			g_StatMeter->CollectReadings();
 			waitInterval = 100;
 		}
 
 		if (lastReset != Util::CurrentTime())
 		{
 			// this code should not be called too often, once per second is OK
+			if (g_Options->GetWarmConnections() > 0)
+			{
+				g_ServerPool->KeepWarm(IsDownloadImminent() ? g_Options->GetWarmConnections() : 0);
+			}
 			g_ServerPool->CloseUnusedConnections();
 			ResetHangingDownloads();
+			if (hedging && queueExhausted && !standBy)
+			{
+				HedgeSlowDownloads();
+			}
+			else
+			{
+				m_hedgeMonitor.Clear();
+			}
 			if (!standBy)
 			{
 				SaveAllPartialState();
@@ -280,12 +312,28 @@ void QueueCoordinator::Run()
 			g_StatMeter->IntervalCheck();
 			g_Log->IntervalCheck();
 			AdjustDownloadsLimit();
+			if (m_connectionTuner && !standBy)
+			{
+				m_connectionTuner->Check();
+			}
 			Util::SetStandByMode(false);
 			lastReset = Util::CurrentTime();
 		}
 	}
 
 	WaitJobs();
+	if (m_articleReactor)
+	{
+		m_articleReactor->Stop();
+	}
+	if (m_workerPool)
+	{
+		m_workerPool->Stop();
+	}
+	if (m_decoderPool)
+	{
+		m_decoderPool->Stop();
+	}
 	SaveAllPartialState();
 	SaveQueueIfChanged();
 	SaveAllFileState();
@@ -320,9 +368,42 @@ void QueueCoordinator::WaitJobs()
 		ResetHangingDownloads();
 	}
 
+	while (m_availabilityChecker.IsRunning())
+	{
+		Util::Sleep(100);
+	}
+
+	g_ServerPool->StopWarming();
+
 	debug("QueueCoordinator: Downloads are completed");
 }
 
+void QueueCoordinator::StartDownloadEngine()
+{
+	if (g_Options->GetDecodeThreads() > 0)
+	{
+		m_decoderPool = std::make_unique<ArticleDecoderPool>(g_Options->GetDecodeThreads());
+	}
+
+	if (g_Options->GetDownloadEngine() == Options::deEvent)
+	{
+		if (ArticleReactor::IsSupported())
+		{
+			m_articleReactor = std::make_unique<ArticleReactor>();
+			m_articleReactor->Start();
+			return;
+		}
+
+		warn("Event download engine is not supported on this system, using pool engine");
+	}
+
+	if (g_Options->GetDownloadEngine() != Options::deThreaded)
+	{
+		m_workerPool = std::make_unique<ArticleWorkerPool>(&m_jobSource);
+		m_workerPool->SetMaxWorkers(m_downloadsLimit);
+	}
+}
+
 /*
  * Compute maximum number of allowed download threads
 **/
@@ -337,15 +418,22 @@ void QueueCoordinator::AdjustDownloadsLimit()
 	int downloadsLimit = 2;
 
 	// allow one thread per 0-level (main) and 1-level (backup) server connection
+	// and pipelined request
 	for (NewsServer* newsServer : g_ServerPool->GetServers())
 	{
 		if ((newsServer->GetNormLevel() == 0 || newsServer->GetNormLevel() == 1) && newsServer->GetActive())
 		{
-			downloadsLimit += newsServer->GetMaxConnections();
+			downloadsLimit += newsServer->GetMaxConnections() * newsServer->GetPipelineDepth();
 		}
 	}
 
 	m_downloadsLimit = downloadsLimit;
+
+	// pipelined downloads share connections, the pool needs a worker for each of them
+	if (m_workerPool)
+	{
+		m_workerPool->SetMaxWorkers(downloadsLimit);
+	}
 }
 
 NzbInfo* QueueCoordinator::AddNzbFileToQueue(std::unique_ptr<NzbInfo> nzbInfo, NzbInfo* urlInfo, bool addFirst)
@@ -497,6 +585,9 @@ void QueueCoordinator::Stop()
 	}
 	debug("ArticleDownloads are notified");
 
+	m_availabilityChecker.Stop();
+	g_ServerPool->KeepWarm(0);
+
 	// Resume Run() to exit it
 	Guard guard(m_waitMutex);
 	m_waitCond.NotifyAll();
@@ -507,61 +598,23 @@ void QueueCoordinator::Stop()
  */
 bool QueueCoordinator::GetNextArticle(DownloadQueue* downloadQueue, FileInfo* &fileInfo, ArticleInfo* &articleInfo)
 {
-	// find an unpaused file with the highest priority, then take the next article from the file.
-	// if the file doesn't have any articles left for download, we store that fact and search again,
-	// ignoring all files which were previously marked as not having any articles.
+	// take an unpaused file with the highest priority from the scheduler, then take the next
+	// article from the file. If the file doesn't have any articles left for download, we
+	// let the scheduler know and take the next file.
 
 	// special case: if the file has ExtraPriority-flag set, it has the highest priority.
 
 	//debug("QueueCoordinator::GetNextArticle()");
 
-	bool ok = false;
-
-	RawFileList checkedFiles;
-	time_t curDate = Util::CurrentTime();
+	bool downloadPaused = g_WorkState->GetPauseDownload() || g_WorkState->GetQuotaReached();
 
-	while (!ok)
+	while ((fileInfo = m_scheduler.GetNextFile(downloadQueue->GetQueue(), Util::CurrentTime(), downloadPaused)))
 	{
-		fileInfo = nullptr;
-
-		for (NzbInfo* nzbInfo : downloadQueue->GetQueue())
-		{
-			bool nzbHigherPriority = fileInfo &&
-				((nzbInfo->HasExtraPriority() == fileInfo->GetNzbInfo()->HasExtraPriority() &&
-					nzbInfo->GetPriority() > fileInfo->GetNzbInfo()->GetPriority()) ||
-					(nzbInfo->HasExtraPriority() > fileInfo->GetNzbInfo()->HasExtraPriority()));
-
-			bool nzbPaused = nzbInfo->GetFileList()->size() - nzbInfo->GetPausedFileCount() <= 0;
-
-			if ((!fileInfo || nzbHigherPriority) && !nzbPaused &&
-				(!(g_WorkState->GetPauseDownload() || g_WorkState->GetQuotaReached()) || nzbInfo->GetForcePriority()))
-			{
-				for (FileInfo* fileInfo1 : nzbInfo->GetFileList())
-				{
-					bool alreadyChecked = !checkedFiles.empty() &&
-						std::find(checkedFiles.begin(), checkedFiles.end(), fileInfo1) != checkedFiles.end();
-
-					bool propagationWait = g_Options->GetPropagationDelay() > 0 &&
-						(int)fileInfo1->GetTime() + g_Options->GetPropagationDelay() >= (int)curDate;
-
-					bool higherPriority = fileInfo &&
-						((fileInfo1->GetExtraPriority() == fileInfo->GetExtraPriority() &&
-							fileInfo1->GetNzbInfo()->GetPriority() > fileInfo->GetNzbInfo()->GetPriority()) ||
-							(fileInfo1->GetExtraPriority() > fileInfo->GetExtraPriority()));
-
-					if (!alreadyChecked && !propagationWait && !fileInfo1->GetPaused() && 
-						!fileInfo1->GetDeleted() && (!fileInfo || higherPriority))
-					{
-						fileInfo = fileInfo1;
-					}
-				}
-			}
-		}
-
-		if (!fileInfo)
+		if (!PreCheck(downloadQueue, fileInfo->GetNzbInfo()))
 		{
-			// there are no more files for download
-			break;
+			// the files are taken again once the check is completed
+			m_scheduler.FileExhausted(fileInfo);
+			continue;
 		}
 
 		if (g_Options->GetDirectRename() &&
@@ -579,21 +632,14 @@ bool QueueCoordinator::GetNextArticle(DownloadQueue* downloadQueue, FileInfo* &f
 		}
 
 		// check if the file has any articles left for download
-		for (ArticleInfo* article : fileInfo->GetArticles())
+		articleInfo = m_scheduler.GetNextArticle(fileInfo);
+		if (articleInfo)
 		{
-			if (article->GetStatus() == ArticleInfo::aiUndefined)
-			{
-				articleInfo = article;
-				return true;
-			}
+			return true;
 		}
 
-		if (!ok)
-		{
-			// the file doesn't have any articles left for download
-			checkedFiles.reserve(100);
-			checkedFiles.push_back(fileInfo);
-		}
+		// the file doesn't have any articles left for download
+		m_scheduler.FileExhausted(fileInfo);
 	}
 
 	return false;
@@ -631,7 +677,107 @@ bool QueueCoordinator::GetNextFirstArticle(NzbInfo* nzbInfo, FileInfo* &fileInfo
 	return false;
 }
 
-void QueueCoordinator::StartArticleDownload(FileInfo* fileInfo, ArticleInfo* articleInfo, NntpConnection* connection)
+void QueueCoordinator::StartArticleDownload(DownloadQueue* downloadQueue, FileInfo* fileInfo,
+	ArticleInfo* articleInfo, NntpConnection* connection)
+{
+	StartDownloader(PrepareArticleDownload(downloadQueue, fileInfo, articleInfo, connection));
+}
+
+/*
+ * Creates the downloader for the article which is downloaded via given connection.
+ * With pipelining downloaders for next articles are created and started too.
+ * Returns the first downloader, which isn't started yet.
+ */
+ArticleDownloader* QueueCoordinator::PrepareArticleDownload(DownloadQueue* downloadQueue, FileInfo* fileInfo,
+	ArticleInfo* articleInfo, NntpConnection* connection)
+{
+	std::vector<ArticleDownloader*> downloaders;
+	downloaders.push_back(CreateArticleDownloader(fileInfo, articleInfo));
+	downloaders.front()->SetConnection(connection);
+
+	// with pipelining the requests for next articles are sent over the same connection
+	// without waiting for responses; each downloader then reads its own response
+	NewsServer* newsServer = connection->GetNewsServer();
+	if (newsServer->GetPipelineDepth() > 1 && !newsServer->GetJoinGroup() && !g_Options->GetRawArticle())
+	{
+		while ((int)downloaders.size() < newsServer->GetPipelineDepth() &&
+			(int)m_activeDownloads.size() < m_downloadsLimit &&
+			GetNextArticle(downloadQueue, fileInfo, articleInfo) &&
+			(!g_WorkState->GetTempPauseDownload() || fileInfo->GetExtraPriority()))
+		{
+			ArticleDownloader* articleDownloader = CreateArticleDownloader(fileInfo, articleInfo);
+			articleDownloader->SetPipelineConnection(connection);
+			downloaders.push_back(articleDownloader);
+		}
+
+		if (downloaders.size() > 1)
+		{
+			for (ArticleDownloader* articleDownloader : downloaders)
+			{
+				connection->AddPipelineRequest(articleDownloader->GetArticleInfo()->GetMessageId());
+			}
+		}
+	}
+
+	for (ArticleDownloader* articleDownloader : downloaders)
+	{
+		if (articleDownloader != downloaders.front())
+		{
+			StartDownloader(articleDownloader);
+		}
+	}
+
+	return downloaders.front();
+}
+
+/*
+ * Called by a download worker after it has successfully downloaded an article of the file.
+ * If the next article to download belongs to the same file it is downloaded by the
+ * same worker via the same connection, otherwise the connection goes back to the server pool.
+ */
+ArticleDownloader* QueueCoordinator::ContinueDownload(int fileId, NntpConnection* connection)
+{
+	// only main servers are used for first download attempts
+	NewsServer* newsServer = connection->GetNewsServer();
+	if (IsStopped() || newsServer->GetNormLevel() != 0 || !newsServer->GetActive() ||
+		g_ServerPool->IsServerBlocked(newsServer) ||
+		g_ServerPool->GetConnectionsInUse(newsServer) > newsServer->GetActiveConnections())
+	{
+		return nullptr;
+	}
+
+	GuardedDownloadQueue downloadQueue = DownloadQueue::Guard();
+
+	FileInfo* fileInfo;
+	ArticleInfo* articleInfo;
+	if ((int)m_activeDownloads.size() >= m_downloadsLimit ||
+		!GetNextArticle(downloadQueue, fileInfo, articleInfo) || fileInfo->GetId() != fileId ||
+		(g_WorkState->GetTempPauseDownload() && !fileInfo->GetExtraPriority()))
+	{
+		return nullptr;
+	}
+
+	return PrepareArticleDownload(downloadQueue, fileInfo, articleInfo, connection);
+}
+
+void QueueCoordinator::StartDownloader(ArticleDownloader* articleDownloader)
+{
+	if (m_articleReactor)
+	{
+		m_articleReactor->AddDownloader(articleDownloader);
+	}
+	else if (m_workerPool)
+	{
+		m_workerPool->AddDownloader(articleDownloader);
+	}
+	else
+	{
+		// each article in its own thread
+		articleDownloader->Start();
+	}
+}
+
+ArticleDownloader* QueueCoordinator::CreateArticleDownloader(FileInfo* fileInfo, ArticleInfo* articleInfo)
 {
 	debug("Starting new ArticleDownloader");
 
@@ -640,7 +786,10 @@ void QueueCoordinator::StartArticleDownload(FileInfo* fileInfo, ArticleInfo* art
 	articleDownloader->Attach(this);
 	articleDownloader->SetFileInfo(fileInfo);
 	articleDownloader->SetArticleInfo(articleInfo);
-	articleDownloader->SetConnection(connection);
+	if (m_decoderPool)
+	{
+		articleDownloader->SetDecoderPool(m_decoderPool.get());
+	}
 
 	if (articleInfo->GetPartNumber() == 1 && g_Options->GetDirectRename() && !g_Options->GetRawArticle())
 	{
@@ -655,7 +804,8 @@ void QueueCoordinator::StartArticleDownload(FileInfo* fileInfo, ArticleInfo* art
 	fileInfo->GetNzbInfo()->SetActiveDownloads(fileInfo->GetNzbInfo()->GetActiveDownloads() + 1);
 
 	m_activeDownloads.push_back(articleDownloader);
-	articleDownloader->Start();
+
+	return articleDownloader;
 }
 
 void QueueCoordinator::Update(Subject* caller, void* aspect)
@@ -670,9 +820,10 @@ void QueueCoordinator::Update(Subject* caller, void* aspect)
 	debug("Notification from ArticleDownloader received");
 
 	ArticleDownloader* articleDownloader = (ArticleDownloader*)caller;
-	if ((articleDownloader->GetStatus() == ArticleDownloader::adFinished) ||
+	if (((articleDownloader->GetStatus() == ArticleDownloader::adFinished) ||
 		(articleDownloader->GetStatus() == ArticleDownloader::adFailed) ||
-		(articleDownloader->GetStatus() == ArticleDownloader::adRetry))
+		(articleDownloader->GetStatus() == ArticleDownloader::adRetry)) &&
+		!HedgeCompleted(articleDownloader))
 	{
 		ArticleCompleted(articleDownloader);
 	}
@@ -683,101 +834,228 @@ void QueueCoordinator::ArticleCompleted(ArticleDownloader* articleDownloader)
 	debug("Article downloaded");
 
 	FileInfo* fileInfo = articleDownloader->GetFileInfo();
-	bool completeFileParts = false;
 
+	ArticleCompletion completion;
+	completion.articleDownloader = articleDownloader;
+	QueueCompletion(&completion);
+
+	if (completion.completeFileParts)
 	{
-		NzbInfo* nzbInfo = fileInfo->GetNzbInfo();
-		ArticleInfo* articleInfo = articleDownloader->GetArticleInfo();
-		bool retry = false;
-		bool fileCompleted = false;
+		// all jobs done
+		articleDownloader->CompleteFileParts();
+		fileInfo->SetPartialChanged(false);
 
 		GuardedDownloadQueue downloadQueue = DownloadQueue::Guard();
+		DeleteDownloader(downloadQueue, articleDownloader, true);
+	}
+}
+
+/*
+ * Completed articles are queued without locking. The thread which finds nobody applying
+ * the queued completions takes over and applies all of them in one go, under a single
+ * lock of the download queue. The other threads wait until their completions are applied:
+ * the downloaders must stay alive until then and the changes must be visible when they
+ * proceed (for example with the next article of the same file).
+ */
+void QueueCoordinator::QueueCompletion(ArticleCompletion* completion)
+{
+	completion->next = m_completions.load(std::memory_order_relaxed);
+	while (!m_completions.compare_exchange_weak(completion->next, completion,
+		std::memory_order_release, std::memory_order_relaxed)) ;
 
-		if (articleDownloader->GetStatus() == ArticleDownloader::adFinished)
+	while (!completion->applied)
+	{
+		if (!m_applyingCompletions.exchange(true))
 		{
-			articleInfo->SetStatus(ArticleInfo::aiFinished);
-			fileInfo->SetSuccessSize(fileInfo->GetSuccessSize() + articleInfo->GetSize());
-			nzbInfo->SetCurrentSuccessSize(nzbInfo->GetCurrentSuccessSize() + articleInfo->GetSize());
-			nzbInfo->SetParCurrentSuccessSize(nzbInfo->GetParCurrentSuccessSize() + (fileInfo->GetParFile() ? articleInfo->GetSize() : 0));
-			fileInfo->SetSuccessArticles(fileInfo->GetSuccessArticles() + 1);
-			nzbInfo->SetCurrentSuccessArticles(nzbInfo->GetCurrentSuccessArticles() + 1);
+			ApplyCompletions();
+			m_applyingCompletions = false;
+
+			Guard guard(m_completionsMutex);
+			m_completionsCond.NotifyAll();
 		}
-		else if (articleDownloader->GetStatus() == ArticleDownloader::adFailed)
+		else
 		{
-			articleInfo->SetStatus(ArticleInfo::aiFailed);
-			fileInfo->SetFailedSize(fileInfo->GetFailedSize() + articleInfo->GetSize());
-			nzbInfo->SetCurrentFailedSize(nzbInfo->GetCurrentFailedSize() + articleInfo->GetSize());
-			nzbInfo->SetParCurrentFailedSize(nzbInfo->GetParCurrentFailedSize() + (fileInfo->GetParFile() ? articleInfo->GetSize() : 0));
-			fileInfo->SetFailedArticles(fileInfo->GetFailedArticles() + 1);
-			nzbInfo->SetCurrentFailedArticles(nzbInfo->GetCurrentFailedArticles() + 1);
+			Guard guard(m_completionsMutex);
+			m_completionsCond.Wait(m_completionsMutex,
+				[&]{ return completion->applied || !m_applyingCompletions; });
 		}
-		else if (articleDownloader->GetStatus() == ArticleDownloader::adRetry)
+	}
+}
+
+void QueueCoordinator::ApplyCompletions()
+{
+	ArticleCompletion* completion = m_completions.exchange(nullptr, std::memory_order_acquire);
+	if (!completion)
+	{
+		return;
+	}
+
+	// the newest completion is on top, restore the order in which the articles were completed
+	ArticleCompletion* ordered = nullptr;
+	while (completion)
+	{
+		ArticleCompletion* next = completion->next;
+		completion->next = ordered;
+		ordered = completion;
+		completion = next;
+	}
+
+	GuardedDownloadQueue downloadQueue = DownloadQueue::Guard();
+
+	while (ordered)
+	{
+		// the completion belongs to the waiting thread and must not be accessed after
+		// it's marked as applied
+		ArticleCompletion* next = ordered->next;
+		ordered->completeFileParts = CompleteArticle(downloadQueue, ordered->articleDownloader);
+		ordered->applied = true;
+		ordered = next;
+	}
+}
+
+/*
+ * Updates the queue with the result of article download.
+ * Returns "true" if the file is completed and its parts must be joined.
+ */
+bool QueueCoordinator::CompleteArticle(DownloadQueue* downloadQueue, ArticleDownloader* articleDownloader)
+{
+	FileInfo* fileInfo = articleDownloader->GetFileInfo();
+	NzbInfo* nzbInfo = fileInfo->GetNzbInfo();
+	ArticleInfo* articleInfo = articleDownloader->GetArticleInfo();
+	bool retry = false;
+	bool fileCompleted = false;
+
+	if (articleDownloader->GetStatus() == ArticleDownloader::adFinished)
+	{
+		articleInfo->SetStatus(ArticleInfo::aiFinished);
+		fileInfo->SetSuccessSize(fileInfo->GetSuccessSize() + articleInfo->GetSize());
+		nzbInfo->SetCurrentSuccessSize(nzbInfo->GetCurrentSuccessSize() + articleInfo->GetSize());
+		nzbInfo->SetParCurrentSuccessSize(nzbInfo->GetParCurrentSuccessSize() + (fileInfo->GetParFile() ? articleInfo->GetSize() : 0));
+		fileInfo->SetSuccessArticles(fileInfo->GetSuccessArticles() + 1);
+		nzbInfo->SetCurrentSuccessArticles(nzbInfo->GetCurrentSuccessArticles() + 1);
+	}
+	else if (articleDownloader->GetStatus() == ArticleDownloader::adFailed)
+	{
+		articleInfo->SetStatus(ArticleInfo::aiFailed);
+		fileInfo->SetFailedSize(fileInfo->GetFailedSize() + articleInfo->GetSize());
+		nzbInfo->SetCurrentFailedSize(nzbInfo->GetCurrentFailedSize() + articleInfo->GetSize());
+		nzbInfo->SetParCurrentFailedSize(nzbInfo->GetParCurrentFailedSize() + (fileInfo->GetParFile() ? articleInfo->GetSize() : 0));
+		fileInfo->SetFailedArticles(fileInfo->GetFailedArticles() + 1);
+		nzbInfo->SetCurrentFailedArticles(nzbInfo->GetCurrentFailedArticles() + 1);
+	}
+	else if (articleDownloader->GetStatus() == ArticleDownloader::adRetry)
+	{
+		articleInfo->SetStatus(ArticleInfo::aiUndefined);
+		m_scheduler.ArticleReturned(fileInfo);
+		retry = true;
+		if (articleInfo->GetPartNumber() == 1)
 		{
-			articleInfo->SetStatus(ArticleInfo::aiUndefined);
-			retry = true;
-			if (articleInfo->GetPartNumber() == 1)
-			{
-				nzbInfo->SetAllFirst(false);
-			}
+			nzbInfo->SetAllFirst(false);
 		}
+	}
 
-		if (!retry)
+	if (!retry)
+	{
+		fileInfo->SetRemainingSize(fileInfo->GetRemainingSize() - articleInfo->GetSize());
+		nzbInfo->SetRemainingSize(nzbInfo->GetRemainingSize() - articleInfo->GetSize());
+		if (fileInfo->GetPaused())
 		{
-			fileInfo->SetRemainingSize(fileInfo->GetRemainingSize() - articleInfo->GetSize());
-			nzbInfo->SetRemainingSize(nzbInfo->GetRemainingSize() - articleInfo->GetSize());
-			if (fileInfo->GetPaused())
-			{
-				nzbInfo->SetPausedSize(nzbInfo->GetPausedSize() - articleInfo->GetSize());
-			}
-			fileInfo->SetCompletedArticles(fileInfo->GetCompletedArticles() + 1);
-			fileCompleted = (int)fileInfo->GetArticles()->size() == fileInfo->GetCompletedArticles();
-			fileInfo->GetServerStats()->ListOp(articleDownloader->GetServerStats(), ServerStatList::soAdd);
-			nzbInfo->GetCurrentServerStats()->ListOp(articleDownloader->GetServerStats(), ServerStatList::soAdd);
-			fileInfo->SetPartialChanged(true);
+			nzbInfo->SetPausedSize(nzbInfo->GetPausedSize() - articleInfo->GetSize());
 		}
-
-		if (!fileInfo->GetFilenameConfirmed() &&
-			articleDownloader->GetStatus() == ArticleDownloader::adFinished &&
-			articleDownloader->GetArticleFilename())
+		fileInfo->SetCompletedArticles(fileInfo->GetCompletedArticles() + 1);
+		// a duplicate download of the last article may be still running,
+		// the file is completed when it's gone
+		fileCompleted = (int)fileInfo->GetArticles()->size() == fileInfo->GetCompletedArticles() &&
+			fileInfo->GetActiveDownloads() == 1;
+		fileInfo->GetServerStats()->ListOp(articleDownloader->GetServerStats(), ServerStatList::soAdd);
+		nzbInfo->GetCurrentServerStats()->ListOp(articleDownloader->GetServerStats(), ServerStatList::soAdd);
+		fileInfo->SetPartialChanged(true);
+	}
+
+	if (!fileInfo->GetFilenameConfirmed() &&
+		articleDownloader->GetStatus() == ArticleDownloader::adFinished &&
+		articleDownloader->GetArticleFilename())
+	{
+		// in "FileNaming=auto"-mode prefer filename from nzb-file to filename read from article
+		// if the name from article seems to be obfuscated
+		bool useFilenameFromArticle = g_Options->GetFileNaming() == Options::nfArticle ||
+			(g_Options->GetFileNaming() == Options::nfAuto &&
+			 !Util::AlphaNum(articleDownloader->GetArticleFilename()) &&
+			 !nzbInfo->GetManyDupeFiles());
+		if (useFilenameFromArticle)
 		{
-			// in "FileNaming=auto"-mode prefer filename from nzb-file to filename read from article
-			// if the name from article seems to be obfuscated
-			bool useFilenameFromArticle = g_Options->GetFileNaming() == Options::nfArticle ||
-				(g_Options->GetFileNaming() == Options::nfAuto &&
-				 !Util::AlphaNum(articleDownloader->GetArticleFilename()) &&
-				 !nzbInfo->GetManyDupeFiles());
-			if (useFilenameFromArticle)
-			{
-				fileInfo->SetFilename(articleDownloader->GetArticleFilename());
-				fileInfo->MakeValidFilename();
-			}
-			fileInfo->SetFilenameConfirmed(true);
-			if (g_Options->GetDupeCheck() &&
-				nzbInfo->GetDupeMode() != dmForce &&
-				!nzbInfo->GetManyDupeFiles() &&
-				FileSystem::FileExists(BString<1024>("%s%c%s", nzbInfo->GetDestDir(), PATH_SEPARATOR, fileInfo->GetFilename())))
-			{
-				warn("File \"%s\" seems to be duplicate, cancelling download and deleting file from queue", fileInfo->GetFilename());
-				fileCompleted = false;
-				fileInfo->SetDupeDeleted(true);
-				DeleteQueueEntry(downloadQueue, fileInfo);
-			}
+			fileInfo->SetFilename(articleDownloader->GetArticleFilename());
+			fileInfo->MakeValidFilename();
 		}
-
-		if (articleDownloader->GetContentAnalyzer() && articleDownloader->GetStatus() == ArticleDownloader::adFinished)
+		fileInfo->SetFilenameConfirmed(true);
+		if (g_Options->GetDupeCheck() &&
+			nzbInfo->GetDupeMode() != dmForce &&
+			!nzbInfo->GetManyDupeFiles() &&
+			FileSystem::FileExists(BString<1024>("%s%c%s", nzbInfo->GetDestDir(), PATH_SEPARATOR, fileInfo->GetFilename())))
 		{
-			m_directRenamer.ArticleDownloaded(downloadQueue, fileInfo, articleInfo, articleDownloader->GetContentAnalyzer());
+			warn("File \"%s\" seems to be duplicate, cancelling download and deleting file from queue", fileInfo->GetFilename());
+			fileCompleted = false;
+			fileInfo->SetDupeDeleted(true);
+			DeleteQueueEntry(downloadQueue, fileInfo);
 		}
+	}
 
-		nzbInfo->SetDownloadedSize(nzbInfo->GetDownloadedSize() + articleDownloader->GetDownloadedSize());
+	if (articleDownloader->GetContentAnalyzer() && articleDownloader->GetStatus() == ArticleDownloader::adFinished)
+	{
+		m_directRenamer.ArticleDownloaded(downloadQueue, fileInfo, articleInfo, articleDownloader->GetContentAnalyzer());
+	}
+
+	nzbInfo->SetDownloadedSize(nzbInfo->GetDownloadedSize() + articleDownloader->GetDownloadedSize());
+
+	CheckHealth(downloadQueue, fileInfo);
+
+	if (nzbInfo->GetParking() && fileInfo->GetActiveDownloads() == 1 && !fileInfo->GetDupeDeleted())
+	{
+		fileCompleted = true;
+	}
+
+	bool completeFileParts = fileCompleted && (!fileInfo->GetDeleted() || nzbInfo->GetParking());
+
+	if (!completeFileParts)
+	{
+		DeleteDownloader(downloadQueue, articleDownloader, false);
+	}
+
+	return completeFileParts;
+}
+
+/*
+ * Handles the completion of a download which has or had a duplicate download.
+ * Returns "true" if the result was discarded because the article is
+ * delivered by the other download.
+ */
+bool QueueCoordinator::HedgeCompleted(ArticleDownloader* articleDownloader)
+{
+	if (!articleDownloader->GetHedged())
+	{
+		return false;
+	}
+
+	FileInfo* fileInfo = articleDownloader->GetFileInfo();
+	bool completeFileParts = false;
+
+	{
+		NzbInfo* nzbInfo = fileInfo->GetNzbInfo();
 
-		CheckHealth(downloadQueue, fileInfo);
+		GuardedDownloadQueue downloadQueue = DownloadQueue::Guard();
 
-		if (nzbInfo->GetParking() && fileInfo->GetActiveDownloads() == 1 && !fileInfo->GetDupeDeleted())
+		if (!articleDownloader->ResolveHedge())
 		{
-			fileCompleted = true;
+			return false;
 		}
 
+		nzbInfo->SetDownloadedSize(nzbInfo->GetDownloadedSize() + articleDownloader->GetDownloadedSize());
+
+		// the file could have been completed while the discarded download was running
+		bool fileCompleted = fileInfo->GetActiveDownloads() == 1 &&
+			((int)fileInfo->GetArticles()->size() == fileInfo->GetCompletedArticles() ||
+			 (nzbInfo->GetParking() && !fileInfo->GetDupeDeleted()));
+
 		completeFileParts = fileCompleted && (!fileInfo->GetDeleted() || nzbInfo->GetParking());
 
 		if (!completeFileParts)
@@ -788,13 +1066,14 @@ void QueueCoordinator::ArticleCompleted(ArticleDownloader* articleDownloader)
 
 	if (completeFileParts)
 	{
-		// all jobs done
 		articleDownloader->CompleteFileParts();
 		fileInfo->SetPartialChanged(false);
 
 		GuardedDownloadQueue downloadQueue = DownloadQueue::Guard();
 		DeleteDownloader(downloadQueue, articleDownloader, true);
 	}
+
+	return true;
 }
 
 void QueueCoordinator::DeleteDownloader(DownloadQueue* downloadQueue,
@@ -909,6 +1188,10 @@ void QueueCoordinator::DiscardTempFiles(FileInfo* fileInfo)
 
 	if (g_Options->GetDirectWrite() && fileInfo->GetOutputFilename() && !fileInfo->GetForceDirectWrite())
 	{
+		{
+			Guard guard = fileInfo->GuardOutputFile();
+			fileInfo->SetOutputMapping(nullptr);
+		}
 		FileSystem::DeleteFile(fileInfo->GetOutputFilename());
 	}
 }
@@ -1007,27 +1290,100 @@ void QueueCoordinator::CheckHealth(DownloadQueue* downloadQueue, FileInfo* fileI
 		return;
 	}
 
+	HealthCheckFailed(downloadQueue, fileInfo->GetNzbInfo(),
+		BString<1024>("health %.1f%% below critical %.1f%%", fileInfo->GetNzbInfo()->CalcHealth() / 10.0,
+			fileInfo->GetNzbInfo()->CalcCriticalHealth(true) / 10.0));
+}
+
+void QueueCoordinator::HealthCheckFailed(DownloadQueue* downloadQueue, NzbInfo* nzbInfo, const char* reason)
+{
 	if (g_Options->GetHealthCheck() == Options::hcPause)
 	{
-		warn("Pausing %s due to health %.1f%% below critical %.1f%%", fileInfo->GetNzbInfo()->GetName(),
-			fileInfo->GetNzbInfo()->CalcHealth() / 10.0, fileInfo->GetNzbInfo()->CalcCriticalHealth(true) / 10.0);
-		fileInfo->GetNzbInfo()->SetHealthPaused(true);
-		downloadQueue->EditEntry(fileInfo->GetNzbInfo()->GetId(), DownloadQueue::eaGroupPause, nullptr);
+		warn("Pausing %s due to %s", nzbInfo->GetName(), reason);
+		nzbInfo->SetHealthPaused(true);
+		downloadQueue->EditEntry(nzbInfo->GetId(), DownloadQueue::eaGroupPause, nullptr);
 	}
 	else if (g_Options->GetHealthCheck() == Options::hcDelete ||
 		g_Options->GetHealthCheck() == Options::hcPark)
 	{
-		fileInfo->GetNzbInfo()->PrintMessage(Message::mkWarning,
-			"Cancelling download and deleting %s due to health %.1f%% below critical %.1f%%",
-			fileInfo->GetNzbInfo()->GetName(), fileInfo->GetNzbInfo()->CalcHealth() / 10.0,
-			fileInfo->GetNzbInfo()->CalcCriticalHealth(true) / 10.0);
-		fileInfo->GetNzbInfo()->SetDeleteStatus(NzbInfo::dsHealth);
-		downloadQueue->EditEntry(fileInfo->GetNzbInfo()->GetId(),
+		nzbInfo->PrintMessage(Message::mkWarning, "Cancelling download and deleting %s due to %s",
+			nzbInfo->GetName(), reason);
+		nzbInfo->SetDeleteStatus(NzbInfo::dsHealth);
+		downloadQueue->EditEntry(nzbInfo->GetId(),
 			g_Options->GetHealthCheck() == Options::hcPark ? DownloadQueue::eaGroupParkDelete : DownloadQueue::eaGroupDelete,
 			nullptr);
 	}
 }
 
+/*
+ * Returns "true" if the nzb can be downloaded. Otherwise the availability of its articles
+ * is being checked or the check can't be started yet (option "PreCheck").
+ */
+bool QueueCoordinator::PreCheck(DownloadQueue* downloadQueue, NzbInfo* nzbInfo)
+{
+	if (g_Options->GetPreCheck() == Options::pcNone || nzbInfo->GetPreCheckStatus() == NzbInfo::pkFinished)
+	{
+		return true;
+	}
+
+	if (nzbInfo->GetPreCheckStatus() == NzbInfo::pkRunning || !m_availabilityChecker.CanStart())
+	{
+		return false;
+	}
+
+	// the check makes sense only before the download begins
+	if (nzbInfo->GetSuccessArticles() + nzbInfo->GetFailedArticles() > 0)
+	{
+		nzbInfo->SetPreCheckStatus(NzbInfo::pkFinished);
+		return true;
+	}
+
+	if (g_Options->GetServerMode())
+	{
+		for (FileInfo* fileInfo : nzbInfo->GetFileList())
+		{
+			if (fileInfo->GetArticles()->empty())
+			{
+				g_DiskState->LoadArticles(fileInfo);
+				LoadPartialState(fileInfo);
+			}
+		}
+	}
+
+	m_availabilityChecker.Start(downloadQueue, nzbInfo);
+	return false;
+}
+
+void QueueCoordinator::PreCheckCompleted(DownloadQueue* downloadQueue, NzbInfo* nzbInfo,
+	ArticleAvailability* availability)
+{
+	nzbInfo->SetPreCheckStatus(NzbInfo::pkFinished);
+	m_scheduler.Invalidate();
+	WakeUp();
+
+	int articleCount = (int)availability->GetArticles()->size();
+	int maxLevel = g_ServerPool->GetMaxNormLevel();
+	for (int level = 0; level <= maxLevel; level++)
+	{
+		nzbInfo->PrintMessage(Message::mkInfo,
+			"Availability of %s on level %i servers: %i of %i articles found, expected health %.1f%%",
+			nzbInfo->GetName(), level, availability->CountFound(level), articleCount,
+			availability->CalcHealth(level) / 10.0);
+	}
+
+	int health = availability->CalcHealth(maxLevel);
+	int criticalHealth = availability->CalcCriticalHealth(maxLevel);
+	if (health < criticalHealth)
+	{
+		BString<1024> reason("expected health %.1f%% below critical %.1f%%", health / 10.0, criticalHealth / 10.0);
+		if (g_Options->GetHealthCheck() == Options::hcNone)
+		{
+			nzbInfo->PrintMessage(Message::mkWarning, "Downloading %s despite %s", nzbInfo->GetName(), *reason);
+		}
+		HealthCheckFailed(downloadQueue, nzbInfo, reason);
+	}
+}
+
 void QueueCoordinator::LogDebugInfo()
 {
 	GuardedDownloadQueue downloadQueue = DownloadQueue::Guard();
@@ -1071,6 +1427,109 @@ void QueueCoordinator::ResetHangingDownloads()
 	}
 }
 
+/*
+ * Checks if there are files to download and the download isn't paused or is going
+ * to be resumed shortly, so that connections to news servers are going to be needed.
+ */
+bool QueueCoordinator::IsDownloadImminent()
+{
+	if (g_WorkState->GetQuotaReached())
+	{
+		return false;
+	}
+
+	if (g_WorkState->GetPauseDownload() && (g_WorkState->GetResumeTime() == 0 ||
+		g_WorkState->GetResumeTime() - Util::CurrentTime() > WARM_BEFORE_RESUME_SECONDS))
+	{
+		return false;
+	}
+
+	GuardedDownloadQueue downloadQueue = DownloadQueue::Guard();
+	for (NzbInfo* nzbInfo : downloadQueue->GetQueue())
+	{
+		if (nzbInfo->GetRemainingSize() > nzbInfo->GetPausedSize())
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Once all articles are being downloaded a few slow connections may delay the completion
+ * of the download. The articles which are downloaded too slowly are downloaded once more
+ * via idle connections, preferably from other servers. The download which completes
+ * first delivers the article, the other one is cancelled.
+ */
+void QueueCoordinator::HedgeSlowDownloads()
+{
+	GuardedDownloadQueue guard = DownloadQueue::Guard();
+
+	std::vector<ArticleDownloader*> slowDownloads;
+
+	// checks are made once per second
+	m_hedgeMonitor.StartRound();
+	for (ArticleDownloader* articleDownloader : m_activeDownloads)
+	{
+		if (articleDownloader->GetStatus() == ArticleDownloader::adRunning && !articleDownloader->GetHedged() &&
+			m_hedgeMonitor.Check(articleDownloader, articleDownloader->GetArticleInfo(), articleDownloader->GetReceivedBytes()))
+		{
+			slowDownloads.push_back(articleDownloader);
+		}
+	}
+
+	for (ArticleDownloader* articleDownloader : slowDownloads)
+	{
+		if (!StartHedgeDownload(articleDownloader))
+		{
+			break;
+		}
+	}
+}
+
+/*
+ * Starts a duplicate download of the article if there is an idle connection.
+ * Returns "false" if no connections are available.
+ */
+bool QueueCoordinator::StartHedgeDownload(ArticleDownloader* articleDownloader)
+{
+	NewsServer* newsServer = articleDownloader->GetNewsServer();
+	FileInfo* fileInfo = articleDownloader->GetFileInfo();
+	if (!newsServer || fileInfo->GetDeleted())
+	{
+		return true;
+	}
+
+	if ((int)m_activeDownloads.size() >= m_downloadsLimit)
+	{
+		return false;
+	}
+
+	ServerPool::RawServerList ignoreServers{newsServer};
+	NntpConnection* connection = g_ServerPool->GetConnection(newsServer->GetNormLevel(), nullptr, &ignoreServers);
+	if (!connection)
+	{
+		connection = g_ServerPool->GetConnection(newsServer->GetNormLevel(), nullptr, nullptr);
+	}
+	if (!connection)
+	{
+		return false;
+	}
+
+	detail("Downloading %s once more, download @ %s is too slow",
+		articleDownloader->GetInfoName(), articleDownloader->GetConnectionName());
+
+	ArticleDownloader* hedgeDownloader = CreateArticleDownloader(fileInfo, articleDownloader->GetArticleInfo());
+	hedgeDownloader->HedgeWith(articleDownloader);
+	hedgeDownloader->SetHedgePartner(articleDownloader);
+	articleDownloader->SetHedgePartner(hedgeDownloader);
+	hedgeDownloader->SetConnection(connection);
+	StartDownloader(hedgeDownloader);
+
+	return true;
+}
+
 /*
  * Returns True if Entry was deleted from Queue or False if it was scheduled for Deletion.
  * NOTE: "False" does not mean unsuccess; the entry is (or will be) deleted in any case.
@@ -1465,9 +1924,17 @@ void QueueCoordinator::DiscardDownloadedArticles(NzbInfo* nzbInfo, FileInfo* fil
 	DiscardTempFiles(fileInfo);
 	g_DiskState->DiscardFile(fileInfo->GetId(), false, true, false);
 
-	fileInfo->SetOutputFilename(nullptr);
-	fileInfo->SetOutputInitialized(false);
-	fileInfo->SetCachedArticles(0);
+	{
+		Guard guard = fileInfo->GuardOutputFile();
+		fileInfo->SetOutputFilename(nullptr);
+		fileInfo->SetOutputInitialized(false);
+		fileInfo->SetOutputMapping(nullptr);
+	}
+	{
+		Guard contentGuard = g_ArticleCache->GuardContent();
+		fileInfo->SetCachedArticles(0);
+		g_ArticleCache->FileDeleted(fileInfo);
+	}
 	fileInfo->SetPartialChanged(false);
 	fileInfo->SetPartialState(FileInfo::psNone);
 
@@ -1486,4 +1953,6 @@ void QueueCoordinator::DiscardDownloadedArticles(NzbInfo* nzbInfo, FileInfo* fil
 			articleInfo->DiscardSegment();
 		}
 	}
+
+	m_scheduler.ArticleReturned(fileInfo);
 }
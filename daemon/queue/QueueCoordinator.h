@@ -26,11 +26,18 @@
 #include "Thread.h"
 #include "NzbFile.h"
 #include "ArticleDownloader.h"
+#include "ArticleReactor.h"
+#include "ArticleWorkerPool.h"
+#include "ArticleDecoderPool.h"
+#include "ConnectionTuner.h"
 #include "DownloadInfo.h"
 #include "Observer.h"
 #include "QueueEditor.h"
 #include "NntpConnection.h"
 #include "DirectRenamer.h"
+#include "AvailabilityChecker.h"
+#include "ArticleScheduler.h"
+#include "HedgeMonitor.h"
 
 class QueueCoordinator : public Thread, public Observer, public Debuggable
 {
@@ -88,28 +95,85 @@ private:
 		QueueCoordinator* m_owner;
 	};
 
+	class CoordinatorAvailabilityChecker : public AvailabilityChecker
+	{
+	public:
+		CoordinatorAvailabilityChecker(QueueCoordinator* owner) : m_owner(owner) {}
+	protected:
+		virtual void CheckCompleted(DownloadQueue* downloadQueue, NzbInfo* nzbInfo, ArticleAvailability* availability)
+			{ m_owner->PreCheckCompleted(downloadQueue, nzbInfo, availability); }
+	private:
+		QueueCoordinator* m_owner;
+	};
+
+	class CoordinatorJobSource : public ArticleWorkerPool::JobSource
+	{
+	public:
+		CoordinatorJobSource(QueueCoordinator* owner) : m_owner(owner) {}
+		virtual ArticleDownloader* ContinueDownload(int fileId, NntpConnection* connection)
+			{ return m_owner->ContinueDownload(fileId, connection); }
+	private:
+		QueueCoordinator* m_owner;
+	};
+
+	// completed article waiting to be applied to the download queue, see "QueueCompletion"
+	struct ArticleCompletion
+	{
+		ArticleDownloader* articleDownloader;
+		ArticleCompletion* next;
+		bool completeFileParts = false;
+		std::atomic<bool> applied{false};
+	};
+
 	CoordinatorDownloadQueue m_downloadQueue{this};
 	ActiveDownloads m_activeDownloads;
 	QueueEditor m_queueEditor;
 	CoordinatorDirectRenamer m_directRenamer{this};
+	CoordinatorAvailabilityChecker m_availabilityChecker{this};
+	ArticleScheduler m_scheduler;
 	bool m_hasMoreJobs = true;
 	int m_downloadsLimit;
 	int m_serverConfigGeneration = 0;
 	Mutex m_waitMutex;
 	ConditionVar m_waitCond;
+	std::unique_ptr<ArticleReactor> m_articleReactor;
+	CoordinatorJobSource m_jobSource{this};
+	std::unique_ptr<ArticleWorkerPool> m_workerPool;
+	std::unique_ptr<ArticleDecoderPool> m_decoderPool;
+	std::unique_ptr<ConnectionTuner> m_connectionTuner;
+	HedgeMonitor m_hedgeMonitor;
+	std::atomic<ArticleCompletion*> m_completions{nullptr};
+	std::atomic<bool> m_applyingCompletions{false};
+	Mutex m_completionsMutex;
+	ConditionVar m_completionsCond;
 
 	bool GetNextArticle(DownloadQueue* downloadQueue, FileInfo* &fileInfo, ArticleInfo* &articleInfo);
 	bool GetNextFirstArticle(NzbInfo* nzbInfo, FileInfo* &fileInfo, ArticleInfo* &articleInfo);
-	void StartArticleDownload(FileInfo* fileInfo, ArticleInfo* articleInfo, NntpConnection* connection);
+	void StartArticleDownload(DownloadQueue* downloadQueue, FileInfo* fileInfo, ArticleInfo* articleInfo, NntpConnection* connection);
+	ArticleDownloader* PrepareArticleDownload(DownloadQueue* downloadQueue, FileInfo* fileInfo, ArticleInfo* articleInfo, NntpConnection* connection);
+	ArticleDownloader* ContinueDownload(int fileId, NntpConnection* connection);
+	void StartDownloader(ArticleDownloader* articleDownloader);
+	ArticleDownloader* CreateArticleDownloader(FileInfo* fileInfo, ArticleInfo* articleInfo);
 	void ArticleCompleted(ArticleDownloader* articleDownloader);
+	void QueueCompletion(ArticleCompletion* completion);
+	void ApplyCompletions();
+	bool CompleteArticle(DownloadQueue* downloadQueue, ArticleDownloader* articleDownloader);
+	bool HedgeCompleted(ArticleDownloader* articleDownloader);
 	void DeleteDownloader(DownloadQueue* downloadQueue, ArticleDownloader* articleDownloader, bool fileCompleted);
 	void DeleteFileInfo(DownloadQueue* downloadQueue, FileInfo* fileInfo, bool completed);
 	void DirectRenameCompleted(DownloadQueue* downloadQueue, NzbInfo* nzbInfo);
 	void DiscardDirectRename(DownloadQueue* downloadQueue, NzbInfo* nzbInfo);
 	void DiscardDownloadedArticles(NzbInfo* nzbInfo, FileInfo* fileInfo);
 	void CheckHealth(DownloadQueue* downloadQueue, FileInfo* fileInfo);
+	void HealthCheckFailed(DownloadQueue* downloadQueue, NzbInfo* nzbInfo, const char* reason);
+	bool PreCheck(DownloadQueue* downloadQueue, NzbInfo* nzbInfo);
+	void PreCheckCompleted(DownloadQueue* downloadQueue, NzbInfo* nzbInfo, ArticleAvailability* availability);
 	void ResetHangingDownloads();
+	void HedgeSlowDownloads();
+	bool IsDownloadImminent();
+	bool StartHedgeDownload(ArticleDownloader* articleDownloader);
 	void AdjustDownloadsLimit();
+	void StartDownloadEngine();
 	void Load();
 	void SaveQueueIfChanged();
 	void SaveAllPartialState();
@@ -1204,6 +1204,9 @@ void StatusXmlCommand::Execute()
 		"<member><name>ArticleCacheLo</name><value><i4>%u</i4></value></member>\n"
 		"<member><name>ArticleCacheHi</name><value><i4>%u</i4></value></member>\n"
 		"<member><name>ArticleCacheMB</name><value><i4>%i</i4></value></member>\n"
+		"<member><name>CacheFlushFiles</name><value><i4>%i</i4></value></member>\n"
+		"<member><name>CacheFlushBacklogMB</name><value><i4>%i</i4></value></member>\n"
+		"<member><name>CacheFlushLatency</name><value><i4>%i</i4></value></member>\n"
 		"<member><name>DownloadRate</name><value><i4>%i</i4></value></member>\n"
 		"<member><name>AverageDownloadRate</name><value><i4>%i</i4></value></member>\n"
 		"<member><name>DownloadLimit</name><value><i4>%i</i4></value></member>\n"
@@ -1253,6 +1256,9 @@ void StatusXmlCommand::Execute()
 		"\"ArticleCacheLo\" : %u,\n"
 		"\"ArticleCacheHi\" : %u,\n"
 		"\"ArticleCacheMB\" : %i,\n"
+		"\"CacheFlushFiles\" : %i,\n"
+		"\"CacheFlushBacklogMB\" : %i,\n"
+		"\"CacheFlushLatency\" : %i,\n"
 		"\"DownloadRate\" : %i,\n"
 		"\"AverageDownloadRate\" : %i,\n"
 		"\"DownloadLimit\" : %i,\n"
@@ -1286,12 +1292,22 @@ void StatusXmlCommand::Execute()
 		"<value><struct>\n"
 		"<member><name>ID</name><value><i4>%i</i4></value></member>\n"
 		"<member><name>Active</name><value><boolean>%s</boolean></value></member>\n"
+		"<member><name>TlsHandshakes</name><value><i4>%i</i4></value></member>\n"
+		"<member><name>TlsResumed</name><value><i4>%i</i4></value></member>\n"
+		"<member><name>ActiveConnections</name><value><i4>%i</i4></value></member>\n"
+		"<member><name>CompressedMB</name><value><i4>%i</i4></value></member>\n"
+		"<member><name>UncompressedMB</name><value><i4>%i</i4></value></member>\n"
 		"</struct></value>\n";
 
 	const char* JSON_NEWSSERVER_ITEM =
 		"{\n"
 		"\"ID\" : %i,\n"
-		"\"Active\" : %s\n"
+		"\"Active\" : %s,\n"
+		"\"TlsHandshakes\" : %i,\n"
+		"\"TlsResumed\" : %i,\n"
+		"\"ActiveConnections\" : %i,\n"
+		"\"CompressedMB\" : %i,\n"
+		"\"UncompressedMB\" : %i\n"
 		"}";
 
 	int postJobCount = 0;
@@ -1320,6 +1336,12 @@ void StatusXmlCommand::Execute()
 	Util::SplitInt64(articleCache, &articleCacheHi, &articleCacheLo);
 	int articleCacheMBytes = (int)(articleCache / 1024 / 1024);
 
+	int flushFiles;
+	int64 flushBacklog;
+	g_ArticleCache->GetFlushBacklog(&flushFiles, &flushBacklog);
+	int flushBacklogMBytes = (int)(flushBacklog / 1024 / 1024);
+	int flushLatency = g_ArticleCache->GetFlushLatency();
+
 	int downloadRate = (int)(g_StatMeter->CalcCurrentDownloadSpeed());
 	int downloadLimit = (int)(g_WorkState->GetSpeedLimit());
 	bool downloadPaused = g_WorkState->GetPauseDownload();
@@ -1362,6 +1384,7 @@ void StatusXmlCommand::Execute()
 		forcedSizeHi, forcedMBytes, downloadedSizeLo, downloadedSizeHi, downloadedMBytes,
 		monthSizeLo, monthSizeHi, monthMBytes, daySizeLo, daySizeHi, dayMBytes,
 		articleCacheLo, articleCacheHi, articleCacheMBytes,
+		flushFiles, flushBacklogMBytes, flushLatency,
 		downloadRate, averageDownloadRate, downloadLimit, threadCount,
 		postJobCount, postJobCount, urlCount, upTimeSec, downloadTimeSec,
 		BoolToStr(downloadPaused), BoolToStr(downloadPaused), BoolToStr(downloadPaused),
@@ -1374,7 +1397,10 @@ void StatusXmlCommand::Execute()
 	{
 		AppendCondResponse(",\n", IsJson() && index++ > 0);
 		AppendFmtResponse(IsJson() ? JSON_NEWSSERVER_ITEM : XML_NEWSSERVER_ITEM,
-			server->GetId(), BoolToStr(server->GetActive()));
+			server->GetId(), BoolToStr(server->GetActive()),
+			server->GetTlsSessionCache()->GetHandshakes(), server->GetTlsSessionCache()->GetResumed(),
+			server->GetActiveConnections(), (int)(server->GetCompressedBytes() / 1024 / 1024),
+			(int)(server->GetUncompressedBytes() / 1024 / 1024));
 	}
 
 	AppendResponse(IsJson() ? JSON_STATUS_END : XML_STATUS_END);
@@ -3305,7 +3331,7 @@ void TestServerXmlCommand::Execute()
 		return;
 	}
 
-	NewsServer server(0, true, "test server", host, port, 0, username, password, false, encryption, cipher, 1, 0, 0, 0, false);
+	NewsServer server(0, true, "test server", host, port, 0, username, password, false, encryption, cipher, 1, 0, 0, 0, false, 1, 0, false);
 	TestConnection connection(&server, this);
 	connection.SetTimeout(timeout == 0 ? g_Options->GetArticleTimeout() : timeout);
 	connection.SetSuppressErrors(false);
@@ -111,4 +111,47 @@ public:
 	}
 };
 
+
+/*
+ * Lock-free ring buffer for exactly one producer thread and one consumer thread.
+ * The capacity is fixed, "Push" fails when the queue is full, "Pop" when it's empty.
+ */
+template <typename T, uint32 Capacity>
+class SpscQueue
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+	bool Push(T&& item)
+	{
+		uint32 tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) == Capacity)
+		{
+			return false;
+		}
+		m_items[tail % Capacity] = std::move(item);
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool Pop(T& item)
+	{
+		uint32 head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+		item = std::move(m_items[head % Capacity]);
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool Empty() { return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire); }
+
+private:
+	T m_items[Capacity];
+	std::atomic<uint32> m_head{0};
+	std::atomic<uint32> m_tail{0};
+};
+
 #endif
@@ -1173,6 +1173,92 @@ int64 DiskFile::Write(const void* buffer, int64 size)
 	return fwrite(buffer, 1, (size_t)size, m_file);
 }
 
+/*
+ * Writes a sequence of buffers to the file as one contiguous block starting at
+ * the given position. Where supported the buffers go into one positional vectored
+ * write system call bypassing the stream buffer. Afterwards the file position is
+ * at the end of the written block.
+ */
+bool DiskFile::WriteAt(int64 position, const WriteSegment* segments, int count)
+{
+#ifdef HAVE_PWRITEV
+	if (fflush(m_file) != 0)
+	{
+		return false;
+	}
+
+	// IOV_MAX on common systems
+	const int maxVecs = 1024;
+	struct iovec vecs[maxVecs];
+	int fd = fileno(m_file);
+
+	while (count > 0)
+	{
+		int batch = std::min(count, maxVecs);
+		int vecCount = batch;
+		int64 total = 0;
+		for (int i = 0; i < batch; i++)
+		{
+			vecs[i].iov_base = (void*)segments[i].buffer;
+			vecs[i].iov_len = segments[i].size;
+			total += segments[i].size;
+		}
+
+		struct iovec* vec = vecs;
+		int64 pos = position;
+		while (total > 0)
+		{
+			ssize_t written = pwritev(fd, vec, vecCount, pos);
+			if (written <= 0)
+			{
+				if (written < 0 && errno == EINTR)
+				{
+					continue;
+				}
+				return false;
+			}
+
+			pos += written;
+			total -= written;
+
+			// skip fully written buffers and adjust the partially written one
+			while (vecCount > 0 && written >= (ssize_t)vec->iov_len)
+			{
+				written -= vec->iov_len;
+				vec++;
+				vecCount--;
+			}
+			if (vecCount > 0)
+			{
+				vec->iov_base = (char*)vec->iov_base + written;
+				vec->iov_len -= written;
+			}
+		}
+
+		segments += batch;
+		count -= batch;
+		position = pos;
+	}
+
+	return Seek(position);
+#else
+	if (!Seek(position))
+	{
+		return false;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		if (Write(segments[i].buffer, segments[i].size) != segments[i].size)
+		{
+			return false;
+		}
+	}
+
+	return true;
+#endif
+}
+
 int64 DiskFile::Print(const char* format, ...)
 {
 	va_list ap;
@@ -1224,3 +1310,128 @@ bool DiskFile::Sync(CString& errmsg)
 	return FileSystem::FlushFileBuffers(fileno(m_file), errmsg);
 }
 
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+/*
+ * Maps existing file of given size. The disk space for the whole file is allocated
+ * first: unlike a failed write call a failed write into mapped memory can't be handled.
+ */
+bool MappedFile::Open(const char* filename, int64 size)
+{
+	m_filename = filename;
+
+	if (size <= 0 || (int64)(size_t)size != size)
+	{
+		errno = EFBIG;
+		return false;
+	}
+
+#ifdef WIN32
+	m_file = CreateFileW(FileSystem::UtfPathToWidePath(filename), GENERIC_READ | GENERIC_WRITE,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, 0, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+	{
+		errno = 0; // wanting error message from WinAPI instead of C-lib
+		return false;
+	}
+
+	m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READWRITE,
+		(DWORD)((uint64)size >> 32), (DWORD)((uint64)size & 0xFFFFFFFF), nullptr);
+	if (!m_mapping)
+	{
+		errno = 0;
+		Close();
+		return false;
+	}
+
+	m_data = (char*)MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0, (size_t)size);
+	if (!m_data)
+	{
+		errno = 0;
+		Close();
+		return false;
+	}
+#else
+	m_fd = open(filename, O_RDWR);
+	if (m_fd < 0)
+	{
+		return false;
+	}
+
+#ifdef HAVE_POSIX_FALLOCATE
+	int err = posix_fallocate(m_fd, 0, size);
+	if (err != 0)
+	{
+		Close();
+		errno = err;
+		return false;
+	}
+#else
+	Close();
+	errno = ENOTSUP;
+	return false;
+#endif
+
+	void* data = mmap(nullptr, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+	if (data == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+	m_data = (char*)data;
+
+#ifdef MADV_RANDOM
+	// articles are written in any order, reading ahead of untouched pages is useless
+	madvise(m_data, (size_t)size, MADV_RANDOM);
+#endif
+#endif
+
+	m_size = size;
+	return true;
+}
+
+/*
+ * Unmaps the file. The modified data is written to disk by the system later,
+ * the writing of the whole file is started at once here.
+ */
+void MappedFile::Close()
+{
+#ifdef WIN32
+	if (m_data)
+	{
+		FlushViewOfFile(m_data, 0);
+		UnmapViewOfFile(m_data);
+	}
+	if (m_mapping)
+	{
+		CloseHandle(m_mapping);
+	}
+	if (m_file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_file);
+	}
+	m_mapping = nullptr;
+	m_file = INVALID_HANDLE_VALUE;
+#else
+	if (m_data)
+	{
+		msync(m_data, (size_t)m_size, MS_ASYNC);
+		munmap(m_data, (size_t)m_size);
+	}
+	if (m_fd > -1)
+	{
+#ifdef SYNC_FILE_RANGE_WRITE
+		// on Linux MS_ASYNC doesn't start writing
+		sync_file_range(m_fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+#endif
+		close(m_fd);
+	}
+	m_fd = -1;
+#endif
+	m_data = nullptr;
+	m_size = 0;
+}
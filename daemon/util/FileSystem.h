@@ -131,6 +131,12 @@ public:
 		soEnd
 	};
 
+	struct WriteSegment
+	{
+		const void* buffer;
+		int size;
+	};
+
 	DiskFile() = default;
 	DiskFile(const DiskFile&) = delete;
 	~DiskFile();
@@ -139,6 +145,7 @@ public:
 	bool Active() { return m_file != nullptr; }
 	int64 Read(void* buffer, int64 size);
 	int64 Write(const void* buffer, int64 size);
+	bool WriteAt(int64 position, const WriteSegment* segments, int count);
 	int64 Position();
 	bool Seek(int64 position, ESeekOrigin origin = soSet);
 	bool Eof();
@@ -153,4 +160,32 @@ private:
 	FILE* m_file = nullptr;
 };
 
+/*
+ * File mapped into memory as a whole. The data put into the memory goes directly
+ * into the system file cache, without write calls.
+ */
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	~MappedFile();
+	bool Open(const char* filename, int64 size);
+	void Close();
+	char* GetData() { return m_data; }
+	int64 GetSize() { return m_size; }
+	const char* GetFilename() { return m_filename; }
+
+private:
+	CString m_filename;
+	char* m_data = nullptr;
+	int64 m_size = 0;
+#ifdef WIN32
+	HANDLE m_file = INVALID_HANDLE_VALUE;
+	HANDLE m_mapping = nullptr;
+#else
+	int m_fd = -1;
+#endif
+};
+
 #endif
@@ -0,0 +1,354 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "nzbget.h"
+#include "IoUring.h"
+
+#ifdef HAVE_LINUX_IO_URING_H
+
+// the kernel limits the size of one registered buffer
+static const int64 BUFFER_CHUNK_SIZE = 1024 * 1024 * 1024;
+
+// writes queued before starting them without waiting for the end of the batch
+static const int SUBMIT_THRESHOLD = 8;
+
+IoUring::~IoUring()
+{
+	if (m_sqes)
+	{
+		munmap(m_sqes, m_sqesSize);
+	}
+	if (m_cqRing && m_cqRing != m_sqRing)
+	{
+		munmap(m_cqRing, m_cqRingSize);
+	}
+	if (m_sqRing)
+	{
+		munmap(m_sqRing, m_sqRingSize);
+	}
+	if (m_ringFd > -1)
+	{
+		close(m_ringFd);
+	}
+}
+
+bool IoUring::Init(int entries)
+{
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+
+	m_ringFd = (int)syscall(__NR_io_uring_setup, entries, &params);
+	if (m_ringFd < 0)
+	{
+		return false;
+	}
+
+	// IORING_OP_WRITE came together with this feature in Linux 5.6
+	if (!(params.features & IORING_FEAT_RW_CUR_POS))
+	{
+		errno = ENOSYS;
+		return false;
+	}
+
+	m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32);
+	m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+	if (singleMap)
+	{
+		m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+	}
+
+	m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		m_ringFd, IORING_OFF_SQ_RING);
+	if (m_sqRing == MAP_FAILED)
+	{
+		m_sqRing = nullptr;
+		return false;
+	}
+
+	m_cqRing = singleMap ? m_sqRing : mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_CQ_RING);
+	if (m_cqRing == MAP_FAILED)
+	{
+		m_cqRing = nullptr;
+		return false;
+	}
+
+	m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+	m_sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		m_ringFd, IORING_OFF_SQES);
+	if (m_sqes == MAP_FAILED)
+	{
+		m_sqes = nullptr;
+		return false;
+	}
+
+	m_sqTail = (uint32*)((char*)m_sqRing + params.sq_off.tail);
+	m_sqMask = *(uint32*)((char*)m_sqRing + params.sq_off.ring_mask);
+	m_sqArray = (uint32*)((char*)m_sqRing + params.sq_off.array);
+	m_cqHead = (uint32*)((char*)m_cqRing + params.cq_off.head);
+	m_cqTail = (uint32*)((char*)m_cqRing + params.cq_off.tail);
+	m_cqMask = *(uint32*)((char*)m_cqRing + params.cq_off.ring_mask);
+	m_cqes = (char*)m_cqRing + params.cq_off.cqes;
+
+	// no more requests in flight than the submission queue can hold, the completion
+	// queue is at least twice as large and never overflows
+	m_requests.resize(params.sq_entries);
+	for (int i = (int)params.sq_entries - 1; i >= 0; i--)
+	{
+		m_freeRequests.push_back(i);
+	}
+
+	return true;
+}
+
+bool IoUring::RegisterBuffer(char* buffer, int64 size)
+{
+	std::vector<iovec> chunks;
+	for (int64 offset = 0; offset < size; offset += BUFFER_CHUNK_SIZE)
+	{
+		chunks.push_back({buffer + offset, (size_t)std::min(size - offset, BUFFER_CHUNK_SIZE)});
+	}
+
+	if (syscall(__NR_io_uring_register, m_ringFd, IORING_REGISTER_BUFFERS,
+		chunks.data(), (int)chunks.size()) < 0)
+	{
+		return false;
+	}
+
+	m_buffer = buffer;
+	m_bufferSize = size;
+	return true;
+}
+
+int IoUring::Enter(int toSubmit, int minComplete, int flags)
+{
+	int ret;
+	do
+	{
+		ret = (int)syscall(__NR_io_uring_enter, m_ringFd, toSubmit, minComplete, flags, nullptr, 0);
+	} while (ret < 0 && errno == EINTR);
+	return ret;
+}
+
+/*
+ * Puts the request into the submission queue. Must be called with locked mutex.
+ */
+void IoUring::Queue(int index)
+{
+	Request& request = m_requests[index];
+
+	uint32 tail = *m_sqTail;
+	uint32 slot = tail & m_sqMask;
+	io_uring_sqe* sqe = (io_uring_sqe*)m_sqes + slot;
+	memset(sqe, 0, sizeof(*sqe));
+
+	sqe->fd = request.fd;
+	sqe->off = request.offset;
+	sqe->addr = (uint64)request.buffer;
+	sqe->len = request.size;
+	sqe->user_data = index;
+
+	int64 bufferOffset = request.buffer - m_buffer;
+	if (m_bufferSize > 0 && bufferOffset >= 0 && bufferOffset + request.size <= m_bufferSize &&
+		bufferOffset / BUFFER_CHUNK_SIZE == (bufferOffset + request.size - 1) / BUFFER_CHUNK_SIZE)
+	{
+		sqe->opcode = IORING_OP_WRITE_FIXED;
+		sqe->buf_index = (uint16)(bufferOffset / BUFFER_CHUNK_SIZE);
+	}
+	else
+	{
+		sqe->opcode = IORING_OP_WRITE;
+	}
+
+	m_sqArray[slot] = slot;
+	__atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+	m_toSubmit++;
+}
+
+/*
+ * Starts queued requests. Must be called with locked mutex.
+ */
+void IoUring::Submit()
+{
+	if (m_toSubmit > 0)
+	{
+		int submitted = Enter(m_toSubmit, 0, 0);
+		if (submitted > 0)
+		{
+			m_toSubmit -= submitted;
+		}
+	}
+}
+
+/*
+ * Processes completed requests, retries partial and refused writes.
+ * Must be called with locked mutex.
+ */
+void IoUring::Reap()
+{
+	uint32 head = *m_cqHead;
+	uint32 tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+
+	for (; head != tail; head++)
+	{
+		io_uring_cqe* cqe = (io_uring_cqe*)m_cqes + (head & m_cqMask);
+		int index = (int)cqe->user_data;
+		int result = cqe->res;
+		Request& request = m_requests[index];
+
+		if (result == -EINTR || result == -EAGAIN)
+		{
+			Queue(index);
+			continue;
+		}
+
+		if (result <= 0 && request.fallbackFd > -1)
+		{
+			request.fd = request.fallbackFd;
+			request.fallbackFd = -1;
+			Queue(index);
+			continue;
+		}
+
+		if (result > 0 && result < request.size)
+		{
+			request.buffer += result;
+			request.size -= result;
+			request.offset += result;
+			if (request.fallbackFd > -1)
+			{
+				// the rest is not aligned anymore
+				request.fd = request.fallbackFd;
+				request.fallbackFd = -1;
+			}
+			Queue(index);
+			continue;
+		}
+
+		if (result <= 0)
+		{
+			request.batch->m_error = result < 0 ? -result : EIO;
+		}
+
+		request.batch->m_pending--;
+		request.batch = nullptr;
+		m_freeRequests.push_back(index);
+	}
+
+	__atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+}
+
+/*
+ * Waits until the condition becomes true collecting completed requests. Only one thread
+ * waits in the kernel, others wait for it to collect the completions.
+ * Must be called with locked mutex.
+ */
+template <typename Pred>
+void IoUring::WaitCompleted(Pred pred)
+{
+	while (!pred())
+	{
+		if (m_reaping)
+		{
+			m_reapedCond.Wait(m_mutex, [&]{ return !m_reaping || pred(); });
+			continue;
+		}
+
+		int toSubmit = m_toSubmit;
+		m_toSubmit = 0;
+		m_reaping = true;
+
+		m_mutex.Unlock();
+		int ret = Enter(toSubmit, 1, IORING_ENTER_GETEVENTS);
+		m_mutex.Lock();
+
+		// requests not accepted by the kernel are submitted again on next round
+		m_toSubmit += ret < 0 ? toSubmit : toSubmit - std::min(ret, toSubmit);
+
+		m_reaping = false;
+		Reap();
+		m_reapedCond.NotifyAll();
+	}
+}
+
+void IoUring::Batch::Write(int fd, const char* buffer, int size, int64 offset, int fallbackFd)
+{
+	Guard guard(m_ioUring->m_mutex);
+
+	m_ioUring->WaitCompleted([&]{ return !m_ioUring->m_freeRequests.empty(); });
+
+	int index = m_ioUring->m_freeRequests.back();
+	m_ioUring->m_freeRequests.pop_back();
+
+	Request& request = m_ioUring->m_requests[index];
+	request.batch = this;
+	request.fd = fd;
+	request.fallbackFd = fallbackFd;
+	request.buffer = buffer;
+	request.size = size;
+	request.offset = offset;
+	m_pending++;
+
+	m_ioUring->Queue(index);
+
+	if (m_ioUring->m_toSubmit >= SUBMIT_THRESHOLD)
+	{
+		m_ioUring->Submit();
+	}
+}
+
+bool IoUring::Batch::Finish()
+{
+	Guard guard(m_ioUring->m_mutex);
+
+	m_ioUring->Submit();
+	m_ioUring->WaitCompleted([&]{ return m_pending == 0; });
+
+	return m_error == 0;
+}
+
+#else
+
+IoUring::~IoUring()
+{
+}
+
+bool IoUring::Init(int entries)
+{
+	return false;
+}
+
+bool IoUring::RegisterBuffer(char* buffer, int64 size)
+{
+	return false;
+}
+
+void IoUring::Batch::Write(int fd, const char* buffer, int size, int64 offset, int fallbackFd)
+{
+}
+
+bool IoUring::Batch::Finish()
+{
+	return true;
+}
+
+#endif
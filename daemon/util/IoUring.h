@@ -0,0 +1,117 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef IOURING_H
+#define IOURING_H
+
+#include "Thread.h"
+
+/*
+ * Asynchronous file writes via Linux io_uring. Writes are queued in batches: the
+ * caller queues the writes of a batch and then waits until all of them are done,
+ * meanwhile the kernel performs them in parallel with the writes of other batches.
+ * Buffers inside a registered memory region (the article cache) are written without
+ * mapping them into the kernel for each request.
+ * Can be shared by multiple threads. On systems without io_uring "Init" fails and
+ * the caller must write the files itself.
+ */
+class IoUring
+{
+public:
+	class Batch
+	{
+	public:
+		Batch(IoUring* ioUring) : m_ioUring(ioUring) {}
+		Batch(const Batch&) = delete;
+		~Batch() { Finish(); }
+		/*
+		 * Queues a write at given file offset. A write which fails on "fd" (usually
+		 * opened with O_DIRECT and refusing unaligned requests) is retried on "fallbackFd".
+		 */
+		void Write(int fd, const char* buffer, int size, int64 offset, int fallbackFd = -1);
+		// waits for queued writes, returns "false" if any of them has failed
+		bool Finish();
+		int GetError() { return m_error; }
+
+	private:
+		IoUring* m_ioUring;
+		int m_pending = 0;
+		int m_error = 0;
+
+		friend class IoUring;
+	};
+
+	IoUring() = default;
+	IoUring(const IoUring&) = delete;
+	~IoUring();
+	bool Init(int entries);
+	/*
+	 * Registers memory region for fixed buffer writes. The kernel pins the whole region,
+	 * its memory is therefore allocated at once and stays allocated.
+	 */
+	bool RegisterBuffer(char* buffer, int64 size);
+	bool GetBufferRegistered() { return m_bufferSize > 0; }
+
+private:
+	struct Request
+	{
+		Batch* batch = nullptr;
+		int fd;
+		int fallbackFd;
+		const char* buffer;
+		int size;
+		int64 offset;
+	};
+
+	typedef std::vector<Request> Requests;
+	typedef std::vector<int> FreeRequests;
+
+	int m_ringFd = -1;
+	void* m_sqRing = nullptr;
+	void* m_cqRing = nullptr;
+	size_t m_sqRingSize = 0;
+	size_t m_cqRingSize = 0;
+	void* m_sqes = nullptr;
+	size_t m_sqesSize = 0;
+	uint32* m_sqTail = nullptr;
+	uint32 m_sqMask = 0;
+	uint32* m_sqArray = nullptr;
+	uint32* m_cqHead = nullptr;
+	uint32* m_cqTail = nullptr;
+	uint32 m_cqMask = 0;
+	void* m_cqes = nullptr;
+	char* m_buffer = nullptr;
+	int64 m_bufferSize = 0;
+	Requests m_requests;
+	FreeRequests m_freeRequests;
+	int m_toSubmit = 0;
+	bool m_reaping = false;
+	Mutex m_mutex;
+	ConditionVar m_reapedCond;
+
+	void Queue(int index);
+	void Submit();
+	void Reap();
+	template <typename Pred> void WaitCompleted(Pred pred);
+	int Enter(int toSubmit, int minComplete, int flags);
+};
+
+#endif
@@ -322,6 +322,7 @@ public:
 	void Append(uchar* block, uint32 length);
 	uint32 Finish();
 	static uint32 Combine(uint32 crc1, uint32 crc2, uint32 len2);
+	void* GetState() { return State(); }
 
 private:
 #if defined(WIN32) && !defined(_WIN64)
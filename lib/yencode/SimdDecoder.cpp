@@ -418,6 +418,227 @@ static inline void do_decode_sse(size_t& dLen, const uint8_t* dSrc, unsigned cha
 #endif
 
 
+#ifdef __AVX2__
+// The wide decoders work on bit masks (one bit per byte) instead of shifted vectors,
+// which avoids lane crossing shuffles. The bytes following the block, needed to
+// recognize sequences straddled across the block end, are taken from memory.
+
+// one bit for each of the four bytes following the block which is equal to 'ch'
+template<typename T>
+static inline T next_bits(const uint8_t* next, uint8_t ch) {
+	return (T)((next[0] == ch) | ((next[1] == ch) << 1) | ((next[2] == ch) << 2) | ((next[3] == ch) << 3));
+}
+
+// shift mask down by 'n' bits, filling in bits of the following block
+template<typename T>
+static inline T shr_next(T mask, T next, int n) {
+	return (mask >> n) | (next << (sizeof(T)*8 - n));
+}
+
+// resolve sequences of '=': within each group of consecutive '=' only every second
+// char is an escape char, the others are escaped '='
+template<typename T>
+static inline T fix_eq_mask(T maskEq) {
+	const T even = (T)0x5555555555555555ULL;
+	T start = maskEq & ~(maskEq << 1);
+	// carry from adding the group start clears all groups starting on an even bit
+	T evenGroups = maskEq & ~(maskEq + (start & even));
+	return (evenGroups & even) | (maskEq & ~evenGroups & ~even);
+}
+
+// handle \r\n. sequences (dot-stuffing, RFC3977 requires the first dot on a line to be
+// stripped) and find terminators \r\n=y, \r\n.\r\n, \r\n.=y starting within the block.
+// returns true if terminator is found.
+template<typename T>
+static inline bool find_crlf_seq(T crlf, T cr, T lf, T eq, T dot, T y, const uint8_t* next, T& killDots) {
+	T eqNext = next_bits<T>(next, '=');
+	T yNext = next_bits<T>(next, 'y');
+	T eqy2 = shr_next(eq, eqNext, 2) & shr_next(y, yNext, 3); // "=y" following \r\n
+	killDots = crlf & shr_next(dot, next_bits<T>(next, '.'), 2);
+	T crlf3 = shr_next(cr, next_bits<T>(next, '\r'), 3) & shr_next(lf, next_bits<T>(next, '\n'), 4);
+	T eqy3 = shr_next(eq, eqNext, 3) & shr_next(y, yNext, 4);
+	return (crlf & eqy2) | (killDots & (crlf3 | eqy3));
+}
+
+// 'compress' data of a 128 bit lane (skip over masked chars) and store it
+static inline unsigned char* compress_store_xmm(unsigned char* p, __m128i data, uint16_t mask) {
+	unsigned char skipped = BitsSetTable256[mask & 0xff];
+	__m128i shuf = LOAD_HALVES(unshufLUT + (mask&0xff), unshufLUT + (mask>>8));
+	shuf = _mm_add_epi8(shuf, _mm_set_epi32(0x08080808, 0x08080808, 0, 0));
+	shuf = _mm_shuffle_epi8(shuf, _mm_load_si128((const __m128i*)pshufb_combine_table + skipped));
+	STOREU_XMM(p, _mm_shuffle_epi8(data, shuf));
+	return p + XMM_SIZE - _mm_popcnt_u32(mask);
+}
+
+static inline uint64_t avx2_cmpeq_mask(__m256i dataA, __m256i dataB, char ch) {
+	__m256i chars = _mm256_set1_epi8(ch);
+	return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(dataA, chars)) |
+		((uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(dataB, chars)) << 32);
+}
+
+// vector with 'value' in bytes whose bits are set in mask
+static inline __m256i avx2_expand_mask(uint32_t mask, char value) {
+	__m256i bytes = _mm256_shuffle_epi8(_mm256_set1_epi32((int)mask),
+		_mm256_set_epi64x(0x0303030303030303, 0x0202020202020202, 0x0101010101010101, 0));
+	const __m256i bits = _mm256_set1_epi64x(0x8040201008040201);
+	return _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(bytes, bits), bits), _mm256_set1_epi8(value));
+}
+
+// processes two 256 bit vectors per iteration to make better use of 64 bit masks
+static inline void do_decode_avx2(size_t& dLen, const uint8_t* dSrc, unsigned char*& p, unsigned char& escFirst, uint16_t& nextMask) {
+	long dI = -(long)dLen;
+
+	for(; dI; dI += sizeof(__m256i)*2) {
+		const uint8_t* src = dSrc + dI;
+
+		__m256i dataA = _mm256_load_si256((__m256i *)src);
+		__m256i dataB = _mm256_load_si256((__m256i *)src + 1);
+
+		// search for special chars
+		uint64_t eq = avx2_cmpeq_mask(dataA, dataB, '=');
+		uint64_t cr = avx2_cmpeq_mask(dataA, dataB, '\r');
+		uint64_t lf = avx2_cmpeq_mask(dataA, dataB, '\n');
+		uint64_t mask = eq | cr | lf;
+
+		__m256i oDataA = _mm256_sub_epi8(dataA, _mm256_set1_epi8(42));
+		__m256i oDataB = _mm256_sub_epi8(dataB, _mm256_set1_epi8(42));
+		if(escFirst) {
+			// first byte needs escaping due to preceeding = in last loop iteration
+			oDataA = _mm256_sub_epi8(oDataA, _mm256_set_epi32(0, 0, 0, 0, 0, 0, 0, 64));
+			mask &= ~1ULL;
+		}
+		mask |= nextMask;
+
+		if (mask != 0) {
+			uint64_t maskEq = fix_eq_mask<uint64_t>(eq & ~(uint64_t)escFirst);
+
+			unsigned char oldEscFirst = escFirst;
+			escFirst = (unsigned char)(maskEq >> 63);
+			// eliminate anything following a `=` from the special char mask; this eliminates cases of `=\r` so that they aren't removed
+			maskEq <<= 1;
+			mask &= ~maskEq;
+
+			// unescape chars following `=`
+			if (maskEq) {
+				oDataA = _mm256_add_epi8(oDataA, avx2_expand_mask((uint32_t)maskEq, -64));
+				oDataB = _mm256_add_epi8(oDataB, avx2_expand_mask((uint32_t)(maskEq >> 32), -64));
+			}
+
+			const uint8_t* next = src + sizeof(__m256i)*2;
+			uint64_t crlf = cr & shr_next<uint64_t>(lf, next[0] == '\n', 1);
+			uint64_t killDots = 0;
+			if (crlf) {
+				uint64_t dot = avx2_cmpeq_mask(dataA, dataB, '.');
+				uint64_t y = avx2_cmpeq_mask(dataA, dataB, 'y');
+				if (find_crlf_seq<uint64_t>(crlf, cr, lf, eq, dot, y, next, killDots)) {
+					// terminator found
+					// reverting to scalar code should be good enough
+					escFirst = oldEscFirst;
+					dLen += dI;
+					return;
+				}
+			}
+			mask |= killDots << 2;
+			nextMask = (uint16_t)(killDots >> (sizeof(__m256i)*2-2));
+
+			// all that's left is to 'compress' the data (skip over masked chars)
+			p = compress_store_xmm(p, _mm256_castsi256_si128(oDataA), (uint16_t)mask);
+			p = compress_store_xmm(p, _mm256_extracti128_si256(oDataA, 1), (uint16_t)(mask >> 16));
+			p = compress_store_xmm(p, _mm256_castsi256_si128(oDataB), (uint16_t)(mask >> 32));
+			p = compress_store_xmm(p, _mm256_extracti128_si256(oDataB, 1), (uint16_t)(mask >> 48));
+		} else {
+			_mm256_storeu_si256((__m256i*)p, oDataA);
+			_mm256_storeu_si256((__m256i*)p + 1, oDataB);
+			p += sizeof(__m256i)*2;
+			escFirst = 0;
+			nextMask = 0;
+		}
+	}
+}
+#endif
+
+#ifdef __AVX512BW__
+static inline int popcnt64(uint64_t mask) {
+	return _mm_popcnt_u32((uint32_t)mask) + _mm_popcnt_u32((uint32_t)(mask >> 32));
+}
+
+template<bool use_vbmi2>
+static inline void do_decode_avx512(size_t& dLen, const uint8_t* dSrc, unsigned char*& p, unsigned char& escFirst, uint16_t& nextMask) {
+	long dI = -(long)dLen;
+
+	for(; dI; dI += sizeof(__m512i)) {
+		const uint8_t* src = dSrc + dI;
+
+		__m512i data = _mm512_load_si512((__m512i *)src);
+
+		// search for special chars
+		uint64_t eq = _mm512_cmpeq_epi8_mask(data, _mm512_set1_epi8('='));
+		uint64_t cr = _mm512_cmpeq_epi8_mask(data, _mm512_set1_epi8('\r'));
+		uint64_t lf = _mm512_cmpeq_epi8_mask(data, _mm512_set1_epi8('\n'));
+		uint64_t mask = eq | cr | lf;
+
+		__m512i oData = _mm512_sub_epi8(data, _mm512_set1_epi8(42));
+		if(escFirst) {
+			// first byte needs escaping due to preceeding = in last loop iteration
+			oData = _mm512_mask_sub_epi8(oData, 1, oData, _mm512_set1_epi8(64));
+			mask &= ~1ULL;
+		}
+		mask |= nextMask;
+
+		if (mask != 0) {
+			uint64_t maskEq = fix_eq_mask<uint64_t>(eq & ~(uint64_t)escFirst);
+
+			unsigned char oldEscFirst = escFirst;
+			escFirst = (unsigned char)(maskEq >> 63);
+			// eliminate anything following a `=` from the special char mask; this eliminates cases of `=\r` so that they aren't removed
+			maskEq <<= 1;
+			mask &= ~maskEq;
+
+			// unescape chars following `=`
+			oData = _mm512_mask_add_epi8(oData, maskEq, oData, _mm512_set1_epi8(-64));
+
+			const uint8_t* next = src + sizeof(__m512i);
+			uint64_t crlf = cr & shr_next<uint64_t>(lf, next[0] == '\n', 1);
+			uint64_t killDots = 0;
+			if (crlf) {
+				uint64_t dot = _mm512_cmpeq_epi8_mask(data, _mm512_set1_epi8('.'));
+				uint64_t y = _mm512_cmpeq_epi8_mask(data, _mm512_set1_epi8('y'));
+				if (find_crlf_seq<uint64_t>(crlf, cr, lf, eq, dot, y, next, killDots)) {
+					// terminator found
+					// reverting to scalar code should be good enough
+					escFirst = oldEscFirst;
+					dLen += dI;
+					return;
+				}
+			}
+			mask |= killDots << 2;
+			nextMask = (uint16_t)(killDots >> (sizeof(__m512i)-2));
+
+			// all that's left is to 'compress' the data (skip over masked chars)
+#ifdef __AVX512VBMI2__
+			if(use_vbmi2) {
+				_mm512_storeu_si512((__m512i*)p, _mm512_maskz_compress_epi8(~mask, oData));
+				p += sizeof(__m512i) - popcnt64(mask);
+			} else {
+#endif
+				p = compress_store_xmm(p, _mm512_castsi512_si128(oData), (uint16_t)mask);
+				p = compress_store_xmm(p, _mm512_extracti32x4_epi32(oData, 1), (uint16_t)(mask >> 16));
+				p = compress_store_xmm(p, _mm512_extracti32x4_epi32(oData, 2), (uint16_t)(mask >> 32));
+				p = compress_store_xmm(p, _mm512_extracti32x4_epi32(oData, 3), (uint16_t)(mask >> 48));
+#ifdef __AVX512VBMI2__
+			}
+#endif
+		} else {
+			_mm512_storeu_si512((__m512i*)p, oData);
+			p += sizeof(__m512i);
+			escFirst = 0;
+			nextMask = 0;
+		}
+	}
+}
+#endif
+
+
 #ifdef __ARM_NEON
 inline uint16_t neon_movemask(uint8x16_t in) {
 	uint8x16_t mask = vandq_u8(in, (uint8x16_t){1,2,4,8,16,32,64,128, 1,2,4,8,16,32,64,128});
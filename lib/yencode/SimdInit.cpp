@@ -34,6 +34,9 @@ namespace YEncode
 int (*decode)(const unsigned char**, unsigned char**, size_t, YencDecoderState*) = nullptr;
 extern void init_decode_scalar();
 bool decode_simd = false;
+int decoder_count = 0;
+const char* decoder_names[MAX_DECODERS];
+void (*decoder_inits[MAX_DECODERS])();
 
 void (*crc_init)(crc_state *const s) = nullptr;
 void (*crc_incr)(crc_state *const s, const unsigned char *src, long len) = nullptr;
@@ -41,21 +44,58 @@ uint32_t (*crc_finish)(crc_state *const s) = nullptr;
 extern void init_crc_slice();
 bool crc_simd = false;
 
+int (*decode_crc)(const unsigned char**, unsigned char**, size_t, YencDecoderState*, crc_state*) = nullptr;
+
+// Input is decoded in blocks small enough for the decoded data to stay in L1 cache
+// until the crc is calculated, instead of making a second pass over the whole output.
+static const size_t DECODE_CRC_BLOCK = 4096;
+
+int decode_crc_blocks(const unsigned char** src, unsigned char** dest, size_t len, YencDecoderState* state, crc_state* crc)
+{
+	int ended = 0;
+	while (len > 0 && !ended)
+	{
+		const unsigned char* blockSrc = *src;
+		unsigned char* blockDest = *dest;
+		ended = decode(src, dest, len < DECODE_CRC_BLOCK ? len : DECODE_CRC_BLOCK, state);
+		crc_incr(crc, blockDest, (long)(*dest - blockDest));
+		len -= *src - blockSrc;
+	}
+	return ended;
+}
+
+// activates the decoder and remembers it unless it is not compiled in (no effect)
+static void use_decoder(const char* name, void (*init_decoder)())
+{
+	int (*prev)(const unsigned char**, unsigned char**, size_t, YencDecoderState*) = decode;
+	init_decoder();
+	if ((decode != prev || decoder_count == 0) && decoder_count < MAX_DECODERS)
+	{
+		decoder_names[decoder_count] = name;
+		decoder_inits[decoder_count] = init_decoder;
+		decoder_count++;
+	}
+}
+
 #if defined(__i686__) || defined(__amd64__)
 extern void init_decode_sse2();
 extern void init_decode_ssse3();
+extern void init_decode_avx2();
+extern void init_decode_avx512();
+extern void init_decode_vbmi2();
 extern void init_crc_pclmul();
+extern void init_crc_vpclmul();
 
 class CpuId
 {
 	uint32_t regs[4];
 public:
-	CpuId(unsigned level)
+	CpuId(unsigned level, unsigned subleaf = 0)
 	{
 #ifdef WIN32
-		__cpuid((int *)regs, (int)level);
+		__cpuidex((int *)regs, (int)level, (int)subleaf);
 #else
-		__cpuid(level, regs[0], regs[1], regs[2], regs[3]);
+		__cpuid_count(level, subleaf, regs[0], regs[1], regs[2], regs[3]);
 #endif
 	}
 	const uint32_t &EAX() const {return regs[0];}
@@ -63,6 +103,18 @@ public:
 	const uint32_t &ECX() const {return regs[2];}
 	const uint32_t &EDX() const {return regs[3];}
 };
+
+// register states enabled by OS (XCR0)
+uint64_t xgetbv()
+{
+#ifdef WIN32
+	return _xgetbv(0);
+#else
+	uint32_t eax, edx;
+	__asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((uint64_t)edx << 32) | eax;
+#endif
+}
 #endif
 
 #if defined(__arm__) || defined(__aarch64__)
@@ -72,7 +124,8 @@ extern void init_crc_acle();
 
 void init()
 {
-	init_decode_scalar();
+	decoder_count = 0;
+	use_decoder("scalar", init_decode_scalar);
 	init_crc_slice();
 
 #if defined(__i686__) || defined(__amd64__)
@@ -82,19 +135,51 @@ void init()
 	bool cpu_supports_ssse3 = cpuid.ECX() & 0x00000200;
 	bool cpu_supports_sse41 = cpuid.ECX() & 0x00080000;
 	bool cpu_supports_pclmul = cpuid.ECX() & 0x00000002;
+	bool cpu_supports_popcnt = cpuid.ECX() & 0x00800000;
+	bool os_supports_avx = (cpuid.ECX() & 0x08000000) && (xgetbv() & 0x06) == 0x06;
+	bool os_supports_avx512 = os_supports_avx && (xgetbv() & 0xE6) == 0xE6;
+	bool cpu_supports_avx2 = false;
+	bool cpu_supports_avx512bw = false;
+	bool cpu_supports_vbmi2 = false;
+	bool cpu_supports_vpclmul = false;
+
+	if (os_supports_avx && CpuId(0).EAX() >= 7)
+	{
+		CpuId cpuid7(7);
+		cpu_supports_avx2 = cpuid7.EBX() & 0x00000020;
+		cpu_supports_avx512bw = os_supports_avx512 && (cpuid7.EBX() & 0x40010000) == 0x40010000; // F + BW
+		cpu_supports_vbmi2 = cpu_supports_avx512bw && (cpuid7.ECX() & 0x00000040);
+		cpu_supports_vpclmul = cpuid7.ECX() & 0x00000400;
+	}
 
 	if (cpu_supports_sse2)
 	{
-		init_decode_sse2();
+		use_decoder("sse2", init_decode_sse2);
 	}
 	if (cpu_supports_ssse3)
 	{
-		init_decode_ssse3();
+		use_decoder("ssse3", init_decode_ssse3);
+	}
+	if (cpu_supports_avx2 && cpu_supports_popcnt)
+	{
+		use_decoder("avx2", init_decode_avx2);
+	}
+	if (cpu_supports_avx512bw && cpu_supports_popcnt)
+	{
+		use_decoder("avx512", init_decode_avx512);
+	}
+	if (cpu_supports_vbmi2 && cpu_supports_popcnt)
+	{
+		use_decoder("vbmi2", init_decode_vbmi2);
 	}
 	if (cpu_supports_sse41 && cpu_supports_pclmul)
 	{
 		init_crc_pclmul();
 	}
+	if (cpu_supports_sse41 && cpu_supports_pclmul && cpu_supports_avx2 && cpu_supports_vpclmul)
+	{
+		init_crc_vpclmul();
+	}
 #endif
 
 #if defined(__arm__) || defined(__aarch64__)
@@ -117,13 +202,15 @@ void init()
 
 	if (cpu_supports_neon)
 	{
-		init_decode_neon();
+		use_decoder("neon", init_decode_neon);
 	}
 	if (cpu_supports_crc)
 	{
 		init_crc_acle();
 	}
 #endif
+
+	decode_crc = &decode_crc_blocks;
 }
 
 }
@@ -0,0 +1,122 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// CRC32 folding with VPCLMULQDQ on 256 bit registers (AVX2), available on CPUs
+// supporting AVX-512 as well as on newer AVX2-only CPUs.
+// The crc state is the same as used by PCLMULQDQ routines (four 128 bit lanes
+// holding the last 64 bytes), which are also used for short and trailing blocks.
+
+
+#include "nzbget.h"
+
+#include "YEncode.h"
+
+#if defined(__VPCLMULQDQ__) && defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace YEncode
+{
+#if defined(__VPCLMULQDQ__) && defined(__AVX2__)
+
+extern void crc_fold_init(crc_state *const s);
+extern void crc_fold(crc_state *const s, const unsigned char *src, long len);
+extern uint32_t crc_fold_512to32(crc_state *const s);
+
+// data is processed in blocks of 256 bytes kept in eight accumulators
+static const long VPCLMUL_BLOCK = 256;
+
+// moves each 128 bit lane forward by 64 bytes (x^(512-32), x^(512+32) mod P)
+alignas(16) static const uint32_t crc_k64[4] = {
+	0xc6e41596, 0x00000001, 0x54442bd4, 0x00000001
+};
+
+// moves each 128 bit lane forward by 256 bytes (x^(2048-32), x^(2048+32) mod P)
+alignas(16) static const uint32_t crc_k256[4] = {
+	0x322d1430, 0x00000001, 0x1542778a, 0x00000001
+};
+
+static inline __m256i fold_xor(__m256i crc, __m256i k, __m256i data)
+{
+	return _mm256_xor_si256(
+		_mm256_xor_si256(_mm256_clmulepi64_epi128(crc, k, 0x01), _mm256_clmulepi64_epi128(crc, k, 0x10)),
+		data);
+}
+
+void crc_fold_vpclmul(crc_state *const s, const unsigned char *src, long len)
+{
+	if (len < VPCLMUL_BLOCK * 2)
+	{
+		crc_fold(s, src, len);
+		return;
+	}
+
+	const __m256i k64 = _mm256_broadcastsi128_si256(_mm_load_si128((__m128i*)crc_k64));
+	const __m256i k256 = _mm256_broadcastsi128_si256(_mm_load_si128((__m128i*)crc_k256));
+
+	// the state is a virtual 64 byte block preceding the data: fold it into the first
+	// 64 bytes of data, the next 192 bytes become the other accumulators
+	__m256i crc0 = fold_xor(_mm256_loadu_si256((__m256i*)s->crc0), k64, _mm256_loadu_si256((__m256i*)src));
+	__m256i crc1 = fold_xor(_mm256_loadu_si256((__m256i*)s->crc0 + 1), k64, _mm256_loadu_si256((__m256i*)src + 1));
+	__m256i crc2 = _mm256_loadu_si256((__m256i*)src + 2);
+	__m256i crc3 = _mm256_loadu_si256((__m256i*)src + 3);
+	__m256i crc4 = _mm256_loadu_si256((__m256i*)src + 4);
+	__m256i crc5 = _mm256_loadu_si256((__m256i*)src + 5);
+	__m256i crc6 = _mm256_loadu_si256((__m256i*)src + 6);
+	__m256i crc7 = _mm256_loadu_si256((__m256i*)src + 7);
+	src += VPCLMUL_BLOCK;
+	len -= VPCLMUL_BLOCK;
+
+	for (; len >= VPCLMUL_BLOCK; src += VPCLMUL_BLOCK, len -= VPCLMUL_BLOCK)
+	{
+		crc0 = fold_xor(crc0, k256, _mm256_loadu_si256((__m256i*)src));
+		crc1 = fold_xor(crc1, k256, _mm256_loadu_si256((__m256i*)src + 1));
+		crc2 = fold_xor(crc2, k256, _mm256_loadu_si256((__m256i*)src + 2));
+		crc3 = fold_xor(crc3, k256, _mm256_loadu_si256((__m256i*)src + 3));
+		crc4 = fold_xor(crc4, k256, _mm256_loadu_si256((__m256i*)src + 4));
+		crc5 = fold_xor(crc5, k256, _mm256_loadu_si256((__m256i*)src + 5));
+		crc6 = fold_xor(crc6, k256, _mm256_loadu_si256((__m256i*)src + 6));
+		crc7 = fold_xor(crc7, k256, _mm256_loadu_si256((__m256i*)src + 7));
+	}
+
+	// reduce 256 bytes to the last 64 bytes, which become the new state
+	crc2 = fold_xor(crc0, k64, crc2);
+	crc3 = fold_xor(crc1, k64, crc3);
+	crc4 = fold_xor(crc2, k64, crc4);
+	crc5 = fold_xor(crc3, k64, crc5);
+	crc6 = fold_xor(crc4, k64, crc6);
+	crc7 = fold_xor(crc5, k64, crc7);
+	_mm256_storeu_si256((__m256i*)s->crc0, crc6);
+	_mm256_storeu_si256((__m256i*)s->crc0 + 1, crc7);
+
+	crc_fold(s, src, len);
+}
+#endif
+
+void init_crc_vpclmul()
+{
+#if defined(__VPCLMULQDQ__) && defined(__AVX2__)
+	crc_init = &crc_fold_init;
+	crc_incr = &crc_fold_vpclmul;
+	crc_finish = &crc_fold_512to32;
+	crc_simd = true;
+#endif
+}
+
+}
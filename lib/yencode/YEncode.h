@@ -42,6 +42,13 @@ extern int (*decode)(const unsigned char** src, unsigned char** dest, size_t len
 extern int decode_scalar(const unsigned char** src, unsigned char** dest, size_t len, YencDecoderState* state);
 extern bool decode_simd;
 
+// decoder implementations supported on this system, from the slowest (scalar) to the
+// fastest one, which is active after "init()"; used by tests to check each of them
+static const int MAX_DECODERS = 8;
+extern int decoder_count;
+extern const char* decoder_names[MAX_DECODERS];
+extern void (*decoder_inits[MAX_DECODERS])();
+
 struct crc_state
 {
 #if defined(__i686__) || defined(__amd64__)
@@ -56,6 +63,9 @@ extern void (*crc_incr)(crc_state *const s, const unsigned char *src, long len);
 extern uint32_t (*crc_finish)(crc_state *const s);
 extern bool crc_simd;
 
+// decodes and calculates crc of decoded data in one pass
+extern int (*decode_crc)(const unsigned char** src, unsigned char** dest, size_t len, YencDecoderState* state, crc_state* crc);
+
 }
 
 #endif
@@ -0,0 +1,211 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "nzbget.h"
+
+#include "catch.h"
+
+#include "Connection.h"
+#include "TlsSocket.h"
+#include "TlsSessionCache.h"
+#include "TestUtil.h"
+
+#if !defined(WIN32) && !defined(DISABLE_GZIP)
+TEST_CASE("Connection: compression", "[Connection]")
+{
+	int sockets[2];
+	REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == 0);
+
+	Connection client(sockets[0], false);
+	Connection server(sockets[1], false);
+
+	char buf[1024];
+	server.WriteLine("206 Compression active\r\n");
+	REQUIRE(client.ReadLine(buf, sizeof(buf), nullptr));
+	REQUIRE(client.StartCompression());
+	REQUIRE(server.StartCompression());
+	CHECK(client.GetCompression());
+
+	client.WriteLine("BODY <test@example>\r\n");
+	REQUIRE(server.ReadLine(buf, sizeof(buf), nullptr));
+	CHECK(!strcmp(buf, "BODY <test@example>\r\n"));
+
+	// highly compressible data larger than the internal buffers
+	std::string body;
+	for (int i = 0; body.size() < 200000; i++)
+	{
+		body += "line " + std::to_string(i % 100) + " of the article body\r\n";
+	}
+	REQUIRE(server.Send(body.c_str(), (int)body.size()));
+
+	CharBuffer received((int)body.size());
+	REQUIRE(client.Recv(received, received.Size()));
+	CHECK(!memcmp(received, body.c_str(), body.size()));
+
+	int compressedBytes = client.FetchTotalBytesRead();
+	int uncompressedBytes = client.FetchUncompressedBytesRead();
+	CHECK(uncompressedBytes == (int)body.size());
+	CHECK(compressedBytes < uncompressedBytes / 10);
+
+	server.WriteLine(".\r\n");
+	REQUIRE(client.ReadLine(buf, sizeof(buf), nullptr));
+	CHECK(!strcmp(buf, ".\r\n"));
+	CHECK(!client.HasPendingData());
+}
+#endif
+
+#if !defined(WIN32) && !defined(DISABLE_GZIP)
+TEST_CASE("Connection: send while compressed input is pending", "[Connection]")
+{
+	int sockets[2];
+	REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == 0);
+
+	Connection client(sockets[0], false);
+	Connection server(sockets[1], false);
+
+	REQUIRE(client.StartCompression());
+	REQUIRE(server.StartCompression());
+
+	std::string body;
+	for (int i = 0; body.size() < 100000; i++)
+	{
+		body += "line " + std::to_string(i * 7919 % 10007) + " of the article body\r\n";
+	}
+	REQUIRE(server.Send(body.c_str(), (int)body.size()));
+
+	// take only a part, the rest of received compressed data waits for inflating
+	CharBuffer received((int)body.size());
+	int len = client.TryRecv(received, 100);
+	REQUIRE(len > 0);
+
+	// pipelined requests sent meanwhile, poorly compressible to produce much output
+	std::string requests;
+	for (uint32 i = 1; requests.size() < 20000; i++)
+	{
+		requests += "BODY <" + std::to_string(i * 2654435761u) + "@example>\r\n";
+	}
+	REQUIRE(client.Send(requests.c_str(), (int)requests.size()));
+	CharBuffer sent((int)requests.size());
+	REQUIRE(server.Recv(sent, sent.Size()));
+	CHECK(!memcmp(sent, requests.c_str(), requests.size()));
+
+	REQUIRE(client.Recv(received + len, received.Size() - len));
+	CHECK(!memcmp(received, body.c_str(), body.size()));
+}
+#endif
+
+#ifndef WIN32
+TEST_CASE("Connection: cancel connecting", "[Connection]")
+{
+	SOCKET listener = socket(AF_INET, SOCK_STREAM, 0);
+	REQUIRE(listener != INVALID_SOCKET);
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t addressLen = sizeof(address);
+	REQUIRE(bind(listener, (sockaddr*)&address, addressLen) == 0);
+	REQUIRE(listen(listener, 5) == 0);
+	REQUIRE(getsockname(listener, (sockaddr*)&address, &addressLen) == 0);
+
+	Connection client("127.0.0.1", ntohs(address.sin_port), false);
+
+	// the connection has no socket yet, the cancelling must abort the connecting anyway
+	client.Cancel();
+	CHECK(!client.Connect());
+
+	// the cancelling applies to one connect only
+	CHECK(client.Connect());
+	client.Disconnect();
+
+	closesocket(listener);
+}
+#endif
+
+#if !defined(WIN32) && !defined(DISABLE_TLS)
+TEST_CASE("Connection: TLS session resumption", "[Connection]")
+{
+	static bool tlsInitialized = false;
+	if (!tlsInitialized)
+	{
+		TlsSocket::Init();
+		tlsInitialized = true;
+	}
+
+	std::string certFile = TestUtil::TestDataDir() + "/tls/cert.pem";
+	std::string keyFile = TestUtil::TestDataDir() + "/tls/key.pem";
+
+	SOCKET listener = socket(AF_INET, SOCK_STREAM, 0);
+	REQUIRE(listener != INVALID_SOCKET);
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t addressLen = sizeof(address);
+	REQUIRE(bind(listener, (sockaddr*)&address, addressLen) == 0);
+	REQUIRE(listen(listener, 5) == 0);
+	REQUIRE(getsockname(listener, (sockaddr*)&address, &addressLen) == 0);
+
+	const int connections = 2;
+	std::thread serverThread([&]
+		{
+			for (int i = 0; i < connections; i++)
+			{
+				SOCKET socket = accept(listener, nullptr, nullptr);
+				if (socket == INVALID_SOCKET)
+				{
+					return;
+				}
+				Connection server(socket, false);
+				server.SetSuppressErrors(true);
+				if (server.StartTls(false, certFile.c_str(), keyFile.c_str()))
+				{
+					server.WriteLine("200 Welcome\r\n");
+					char buf[100];
+					server.ReadLine(buf, sizeof(buf), nullptr);
+				}
+				server.Disconnect();
+			}
+		});
+
+	TlsSessionCache sessionCache;
+	for (int i = 0; i < connections; i++)
+	{
+		Connection client("127.0.0.1", ntohs(address.sin_port), true);
+		client.SetTimeout(10);
+		client.SetTlsSessionCache(&sessionCache);
+		REQUIRE(client.Connect());
+
+		// the session ticket (TLS 1.3) is received together with the greeting
+		char buf[100];
+		char* line = client.ReadLine(buf, sizeof(buf), nullptr);
+		REQUIRE(line);
+		CHECK(!strncmp(line, "200 Welcome", 11));
+		client.WriteLine("QUIT\r\n");
+		client.Disconnect();
+	}
+
+	serverThread.join();
+	closesocket(listener);
+
+	// the second connection resumes the session of the first one
+	CHECK(sessionCache.GetHandshakes() == connections);
+	CHECK(sessionCache.GetResumed() == connections - 1);
+}
+#endif
@@ -0,0 +1,110 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#include "nzbget.h"
+
+#include "catch.h"
+
+#include "HostCache.h"
+
+static HostCache::Address MakeAddress(int family, int id)
+{
+	HostCache::Address address;
+	memset(&address, 0, sizeof(address));
+	address.family = family;
+	address.socktype = SOCK_STREAM;
+	address.addr.ss_family = family;
+	address.addrLen = sizeof(address.addr);
+	// the id goes into the bytes following the address family
+	memcpy((char*)&address.addr + sizeof(address.addr.ss_family) + 2, &id, sizeof(id));
+	return address;
+}
+
+static int AddressId(HostCache::Address& address)
+{
+	int id;
+	memcpy(&id, (char*)&address.addr + sizeof(address.addr.ss_family) + 2, sizeof(id));
+	return id;
+}
+
+TEST_CASE("Host cache: expiration", "[HostCache]")
+{
+	HostCache hostCache(300);
+	HostCache::Addresses addresses;
+
+	REQUIRE_FALSE(hostCache.Get("news.example.com", 563, AF_UNSPEC, addresses, 1000));
+
+	hostCache.Put("news.example.com", 563, AF_UNSPEC, {MakeAddress(AF_INET, 1), MakeAddress(AF_INET6, 2)}, 1000);
+	REQUIRE(hostCache.Get("news.example.com", 563, AF_UNSPEC, addresses, 1299));
+	REQUIRE(addresses.size() == 2);
+	REQUIRE(AddressId(addresses[1]) == 2);
+
+	// other port or address family are different entries
+	REQUIRE_FALSE(hostCache.Get("news.example.com", 119, AF_UNSPEC, addresses, 1000));
+	REQUIRE_FALSE(hostCache.Get("news.example.com", 563, AF_INET, addresses, 1000));
+
+	REQUIRE_FALSE(hostCache.Get("news.example.com", 563, AF_UNSPEC, addresses, 1300));
+
+	hostCache.Put("news.example.com", 563, AF_UNSPEC, {MakeAddress(AF_INET, 3)}, 1300);
+	REQUIRE(hostCache.Get("news.example.com", 563, AF_UNSPEC, addresses, 1300));
+	REQUIRE(addresses.size() == 1);
+
+	hostCache.Invalidate("news.example.com", 563, AF_UNSPEC);
+	REQUIRE_FALSE(hostCache.Get("news.example.com", 563, AF_UNSPEC, addresses, 1300));
+}
+
+TEST_CASE("Host cache: preferred family", "[HostCache]")
+{
+	HostCache hostCache(300);
+
+	hostCache.Put("news.example.com", 563, AF_UNSPEC, {MakeAddress(AF_INET6, 1)}, 1000);
+	REQUIRE(hostCache.GetPreferredFamily("news.example.com", 563, AF_UNSPEC) == AF_UNSPEC);
+
+	hostCache.SetPreferredFamily("news.example.com", 563, AF_UNSPEC, AF_INET);
+	REQUIRE(hostCache.GetPreferredFamily("news.example.com", 563, AF_UNSPEC) == AF_INET);
+
+	// the preference survives expiration of addresses
+	hostCache.Put("news.example.com", 563, AF_UNSPEC, {MakeAddress(AF_INET6, 2)}, 2000);
+	REQUIRE(hostCache.GetPreferredFamily("news.example.com", 563, AF_UNSPEC) == AF_INET);
+}
+
+TEST_CASE("Host cache: address order", "[HostCache]")
+{
+	HostCache::Addresses addresses = {MakeAddress(AF_INET6, 1), MakeAddress(AF_INET6, 2),
+		MakeAddress(AF_INET6, 3), MakeAddress(AF_INET, 4), MakeAddress(AF_INET, 5)};
+
+	SECTION("resolver order")
+	{
+		HostCache::SortAddresses(addresses, AF_UNSPEC);
+		std::vector<int> ids;
+		for (HostCache::Address& address : addresses) ids.push_back(AddressId(address));
+		REQUIRE(ids == std::vector<int>({1, 4, 2, 5, 3}));
+	}
+
+	SECTION("preferred family")
+	{
+		HostCache::SortAddresses(addresses, AF_INET);
+		std::vector<int> ids;
+		for (HostCache::Address& address : addresses) ids.push_back(AddressId(address));
+		REQUIRE(ids == std::vector<int>({4, 1, 5, 2, 3}));
+	}
+}
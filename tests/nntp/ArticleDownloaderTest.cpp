@@ -0,0 +1,119 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "nzbget.h"
+
+#include "catch.h"
+
+#include "ArticleDownloader.h"
+
+class DownloaderMock : public ArticleDownloader
+{
+public:
+	using ArticleDownloader::SetStatus;
+};
+
+TEST_CASE("Article downloader: claiming hedged article", "[ArticleDownloader][Quick]")
+{
+	ArticleDownloader original;
+	ArticleDownloader hedge;
+	REQUIRE(!original.GetHedged());
+
+	hedge.HedgeWith(&original);
+	CHECK(original.GetHedged());
+	CHECK(hedge.GetHedged());
+
+	SECTION("first finisher wins")
+	{
+		CHECK(hedge.ClaimArticle());
+		CHECK(!original.ClaimArticle());
+		CHECK(!hedge.ClaimArticle());
+	}
+
+	SECTION("parallel finish")
+	{
+		std::atomic<int> claims{0};
+		std::thread thread1([&]{ claims += original.ClaimArticle() ? 1 : 0; });
+		std::thread thread2([&]{ claims += hedge.ClaimArticle() ? 1 : 0; });
+		thread1.join();
+		thread2.join();
+		CHECK(claims == 1);
+	}
+
+	SECTION("independent downloads")
+	{
+		ArticleDownloader other;
+		CHECK(hedge.ClaimArticle());
+		CHECK(other.ClaimArticle());
+	}
+}
+
+TEST_CASE("Article downloader: resolving hedged downloads", "[ArticleDownloader][Quick]")
+{
+	// the result of exactly one of two downloads of the article is applied to the queue,
+	// the dropped result doesn't count as a failed article
+	DownloaderMock original;
+	DownloaderMock hedge;
+	hedge.HedgeWith(&original);
+	hedge.SetHedgePartner(&original);
+	original.SetHedgePartner(&hedge);
+
+	SECTION("hedge finishes first")
+	{
+		hedge.SetStatus(ArticleDownloader::adFinished);
+		CHECK(!hedge.ResolveHedge());
+		CHECK(original.GetHedgeDiscarded());
+		CHECK(original.IsStopped());
+		CHECK(!original.GetHedgePartner());
+
+		// the cancelled download fails
+		original.SetStatus(ArticleDownloader::adFailed);
+		CHECK(original.ResolveHedge());
+	}
+
+	SECTION("hedge fails first")
+	{
+		hedge.SetStatus(ArticleDownloader::adFailed);
+		CHECK(hedge.ResolveHedge());
+		CHECK(!original.GetHedgeDiscarded());
+		CHECK(!original.IsStopped());
+
+		SECTION("the other download succeeds")
+		{
+			original.SetStatus(ArticleDownloader::adFinished);
+			CHECK(!original.ResolveHedge());
+		}
+
+		SECTION("the other download fails too")
+		{
+			original.SetStatus(ArticleDownloader::adFailed);
+			CHECK(!original.ResolveHedge());
+		}
+	}
+
+	SECTION("original needs retry")
+	{
+		original.SetStatus(ArticleDownloader::adRetry);
+		CHECK(original.ResolveHedge());
+		hedge.SetStatus(ArticleDownloader::adFinished);
+		CHECK(!hedge.ResolveHedge());
+	}
+}
@@ -0,0 +1,248 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "nzbget.h"
+
+#include "catch.h"
+
+#include "ArticleWorkerPool.h"
+#include "DownloadInfo.h"
+#include "Util.h"
+
+// blocks the downloaders until opened
+class Gate
+{
+public:
+	void Open() { Guard guard(m_mutex); m_open = true; m_cond.NotifyAll(); }
+	void Pass() { Guard guard(m_mutex); m_cond.Wait(m_mutex, [&]{ return m_open; }); }
+
+private:
+	bool m_open = false;
+	Mutex m_mutex;
+	ConditionVar m_cond;
+};
+
+class DownloaderMock : public ArticleDownloader
+{
+public:
+	DownloaderMock(FileInfo* fileInfo, Gate* gate = nullptr, NntpConnection* connection = nullptr) :
+		m_gate(gate), m_connection(connection) { SetFileInfo(fileInfo); }
+	virtual void Run()
+	{
+		m_threadId = std::this_thread::get_id();
+		if (m_gate)
+		{
+			m_gate->Pass();
+		}
+		m_finished = true;
+	}
+	virtual NntpConnection* DetachConnection() { return m_connection; }
+	std::thread::id GetThreadId() { return m_threadId; }
+	bool GetFinished() { return m_finished; }
+
+private:
+	Gate* m_gate;
+	NntpConnection* m_connection;
+	std::thread::id m_threadId;
+	std::atomic<bool> m_finished{false};
+};
+
+class JobSourceMock : public ArticleWorkerPool::JobSource
+{
+public:
+	virtual ArticleDownloader* ContinueDownload(int fileId, NntpConnection* connection)
+	{
+		m_fileId = fileId;
+		m_connection = connection;
+		ArticleDownloader* next = m_next;
+		m_next = nullptr;
+		return next;
+	}
+	void SetNext(ArticleDownloader* next) { m_next = next; }
+	int GetFileId() { return m_fileId; }
+	NntpConnection* GetConnection() { return m_connection; }
+
+private:
+	ArticleDownloader* m_next = nullptr;
+	int m_fileId = 0;
+	NntpConnection* m_connection = nullptr;
+};
+
+void WaitFinished(DownloaderMock* downloader)
+{
+	for (int i = 0; i < 500 && !downloader->GetFinished(); i++)
+	{
+		Util::Sleep(10);
+	}
+	REQUIRE(downloader->GetFinished());
+}
+
+void WaitIdle(ArticleWorkerPool* pool, int count)
+{
+	for (int i = 0; i < 500 && pool->GetIdleWorkerCount() < count; i++)
+	{
+		Util::Sleep(10);
+	}
+	REQUIRE(pool->GetIdleWorkerCount() == count);
+}
+
+TEST_CASE("Article worker pool: task hand-off", "[ArticleWorkerPool][Quick]")
+{
+	FileInfo fileInfo;
+	JobSourceMock jobSource;
+	ArticleWorkerPool pool(&jobSource);
+	NntpConnection* connection = (NntpConnection*)&fileInfo; // never dereferenced
+
+	// the first download keeps the connection, the worker continues with the next
+	// article of the same file via this connection
+	DownloaderMock first(&fileInfo, nullptr, connection);
+	DownloaderMock second(&fileInfo);
+	jobSource.SetNext(&second);
+
+	pool.AddDownloader(&first);
+	WaitIdle(&pool, 1);
+
+	CHECK(first.GetFinished());
+	CHECK(second.GetFinished());
+	CHECK(jobSource.GetFileId() == fileInfo.GetId());
+	CHECK(jobSource.GetConnection() == connection);
+	CHECK(second.GetThreadId() == first.GetThreadId());
+	CHECK(first.GetThreadId() != std::this_thread::get_id());
+
+	// the idle worker takes the next download
+	DownloaderMock third(&fileInfo);
+	pool.AddDownloader(&third);
+	WaitFinished(&third);
+	WaitIdle(&pool, 1);
+
+	CHECK(third.GetThreadId() == first.GetThreadId());
+	CHECK(pool.GetWorkerCount() == 1);
+
+	pool.Stop();
+}
+
+TEST_CASE("Article worker pool: pool size", "[ArticleWorkerPool][Quick]")
+{
+	FileInfo fileInfo;
+	JobSourceMock jobSource;
+	ArticleWorkerPool pool(&jobSource);
+	Gate gate;
+	std::vector<std::unique_ptr<DownloaderMock>> downloaders;
+
+	// a new worker is started for each download if no worker is idle
+	for (int i = 0; i < 4; i++)
+	{
+		downloaders.push_back(std::make_unique<DownloaderMock>(&fileInfo, &gate));
+		pool.AddDownloader(downloaders.back().get());
+	}
+	CHECK(pool.GetWorkerCount() == 4);
+
+	gate.Open();
+	WaitIdle(&pool, 4);
+
+	// idle workers are reused, the pool grows only if there are more downloads
+	for (int i = 0; i < 6; i++)
+	{
+		downloaders.push_back(std::make_unique<DownloaderMock>(&fileInfo, &gate));
+		pool.AddDownloader(downloaders.back().get());
+	}
+	for (std::unique_ptr<DownloaderMock>& downloader : downloaders)
+	{
+		WaitFinished(downloader.get());
+	}
+	WaitIdle(&pool, pool.GetWorkerCount());
+	CHECK(pool.GetWorkerCount() >= 4);
+	CHECK(pool.GetWorkerCount() <= 6);
+
+	pool.Stop();
+}
+
+TEST_CASE("Article worker pool: stop with work queued", "[ArticleWorkerPool][Quick]")
+{
+	FileInfo fileInfo;
+	JobSourceMock jobSource;
+	ArticleWorkerPool pool(&jobSource);
+	Gate gate;
+	std::vector<std::unique_ptr<DownloaderMock>> downloaders;
+
+	for (int i = 0; i < 8; i++)
+	{
+		downloaders.push_back(std::make_unique<DownloaderMock>(&fileInfo, &gate));
+		pool.AddDownloader(downloaders.back().get());
+	}
+
+	// "Stop" waits for running downloads and lets the workers take the remaining
+	// downloads from the queue, no download is lost
+	std::thread opener([&gate]
+		{
+			Util::Sleep(100);
+			gate.Open();
+		});
+	pool.Stop();
+	opener.join();
+
+	for (std::unique_ptr<DownloaderMock>& downloader : downloaders)
+	{
+		CHECK(downloader->GetFinished());
+	}
+}
+
+TEST_CASE("Article worker pool: limits", "[ArticleWorkerPool][Quick]")
+{
+	FileInfo fileInfo;
+	JobSourceMock jobSource;
+	ArticleWorkerPool pool(&jobSource);
+	pool.SetMaxWorkers(2);
+	pool.SetIdleTimeout(50);
+	Gate gate;
+	std::vector<std::unique_ptr<DownloaderMock>> downloaders;
+
+	// downloads over the limit wait for a free worker
+	for (int i = 0; i < 4; i++)
+	{
+		downloaders.push_back(std::make_unique<DownloaderMock>(&fileInfo, &gate));
+		pool.AddDownloader(downloaders.back().get());
+	}
+	CHECK(pool.GetWorkerCount() == 2);
+
+	gate.Open();
+	for (std::unique_ptr<DownloaderMock>& downloader : downloaders)
+	{
+		WaitFinished(downloader.get());
+	}
+
+	// idle workers exit after the timeout
+	for (int i = 0; i < 500 && pool.GetWorkerCount() > 0; i++)
+	{
+		Util::Sleep(10);
+	}
+	CHECK(pool.GetWorkerCount() == 0);
+	CHECK(pool.GetIdleWorkerCount() == 0);
+
+	// a new worker is started for the next download
+	pool.SetIdleTimeout(60000);
+	DownloaderMock last(&fileInfo);
+	pool.AddDownloader(&last);
+	WaitFinished(&last);
+	CHECK(pool.GetWorkerCount() == 1);
+
+	pool.Stop();
+}
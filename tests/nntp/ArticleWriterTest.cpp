@@ -0,0 +1,447 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "nzbget.h"
+
+#include "catch.h"
+
+#include "Options.h"
+#include "ArticleWriter.h"
+#include "FileSystem.h"
+#include "TestUtil.h"
+
+class ArticleCacheMock : public ArticleCache
+{
+public:
+	ArticleCacheMock() { g_ArticleCache = this; }
+	~ArticleCacheMock() { g_ArticleCache = nullptr; }
+};
+
+static void WriteArticle(FileInfo* fileInfo, ArticleInfo* articleInfo, int64 fileSize,
+	int64 offset, const char* data)
+{
+	int len = strlen(data);
+
+	ArticleWriter writer;
+	writer.SetInfoName("test");
+	writer.SetFileInfo(fileInfo);
+	writer.SetArticleInfo(articleInfo);
+	writer.Prepare();
+	REQUIRE(writer.Start(Decoder::efYenc, nullptr, fileSize, offset, len));
+
+	// the article must be decoded directly into the mapped file
+	int size = 0;
+	char* buffer = writer.GetWriteBuffer(&size);
+	REQUIRE(buffer != nullptr);
+	REQUIRE(size == len);
+
+	memcpy(buffer, data, len);
+	REQUIRE(writer.Write(buffer, len));
+	writer.Finish(true);
+}
+
+static std::string ReadFile(const char* filename)
+{
+	CharBuffer buffer;
+	REQUIRE(FileSystem::LoadFileIntoBuffer(filename, buffer, false));
+	return std::string(buffer, buffer.Size());
+}
+
+TEST_CASE("Article writer: memory mapped output file", "[ArticleWriter][Quick]")
+{
+	TestUtil::PrepareWorkingDir("empty");
+
+	BString<1024> tempDir("TempDir=%s", TestUtil::WorkingDir().c_str());
+
+	Options::CmdOptList cmdOpts;
+	cmdOpts.push_back("WriteLog=none");
+	cmdOpts.push_back("NzbLog=no");
+	cmdOpts.push_back("ArticleCache=0");
+	cmdOpts.push_back("DirectWrite=yes");
+	cmdOpts.push_back("WriteEngine=mmap");
+	cmdOpts.push_back(tempDir);
+	Options options(&cmdOpts, nullptr);
+
+	NzbInfo nzbInfo;
+	nzbInfo.SetDestDir(TestUtil::WorkingDir().c_str());
+
+	FileInfo fileInfo;
+	fileInfo.SetNzbInfo(&nzbInfo);
+	ArticleInfo article1;
+	article1.SetPartNumber(1);
+	ArticleInfo article2;
+	article2.SetPartNumber(2);
+
+	WriteArticle(&fileInfo, &article2, 20, 10, "abcdefghij");
+	WriteArticle(&fileInfo, &article1, 20, 0, "0123456789");
+
+	REQUIRE(fileInfo.GetOutputMapping());
+	CString firstFilename = fileInfo.GetOutputFilename();
+	REQUIRE(!strcmp(fileInfo.GetOutputMapping()->GetFilename(), firstFilename));
+	REQUIRE(ReadFile(firstFilename) == "0123456789abcdefghij");
+
+	SECTION("output file replaced")
+	{
+		// the mapping of the old file must not be reused for a new output file
+		std::shared_ptr<MappedFile> oldMapping = fileInfo.GetOutputMapping();
+		CString secondFilename = (TestUtil::WorkingDir() + "/second.out.tmp").c_str();
+		fileInfo.SetOutputFilename(secondFilename);
+		fileInfo.SetOutputInitialized(false);
+
+		WriteArticle(&fileInfo, &article1, 20, 0, "9876543210");
+
+		REQUIRE(fileInfo.GetOutputMapping() != oldMapping);
+		REQUIRE(!strcmp(fileInfo.GetOutputMapping()->GetFilename(), secondFilename));
+		REQUIRE(ReadFile(secondFilename).substr(0, 10) == "9876543210");
+		REQUIRE(ReadFile(firstFilename) == "0123456789abcdefghij");
+	}
+}
+
+static void CacheFile(FileInfo* fileInfo, int size)
+{
+	Guard contentGuard = g_ArticleCache->GuardContent();
+	fileInfo->SetCachedArticles(fileInfo->GetCachedArticles() + 1);
+	g_ArticleCache->FileCached(fileInfo, size);
+}
+
+TEST_CASE("Article cache: dirty files", "[ArticleCache][Quick]")
+{
+	ArticleCacheMock cache;
+
+	NzbInfo nzbInfo;
+	FileInfo file1;
+	FileInfo file2;
+	FileInfo file3;
+	file1.SetNzbInfo(&nzbInfo);
+	file2.SetNzbInfo(&nzbInfo);
+	file3.SetNzbInfo(&nzbInfo);
+
+	CacheFile(&file2, 1000);
+	CacheFile(&file1, 3000);
+	CacheFile(&file3, 2000);
+	CacheFile(&file2, 500);
+
+	int files;
+	int64 size;
+	cache.GetFlushBacklog(&files, &size);
+	REQUIRE(files == 3);
+	REQUIRE(size == 6500);
+
+	SECTION("oldest first")
+	{
+		REQUIRE(cache.PickDirtyFile(false) == &file2);
+		REQUIRE(cache.PickDirtyFile(false) == &file1);
+		REQUIRE(cache.PickDirtyFile(false) == &file3);
+		REQUIRE(cache.PickDirtyFile(false) == nullptr);
+
+		cache.ReleaseDirtyFile(&file1);
+		REQUIRE(cache.PickDirtyFile(false) == &file1);
+	}
+
+	SECTION("largest first when cache is full")
+	{
+		REQUIRE(cache.PickDirtyFile(true) == &file1);
+		REQUIRE(cache.PickDirtyFile(true) == &file3);
+		REQUIRE(cache.PickDirtyFile(true) == &file2);
+		REQUIRE(cache.PickDirtyFile(true) == nullptr);
+	}
+
+	SECTION("active downloads")
+	{
+		// files still being downloaded are flushed only when the cache is full
+		file2.SetActiveDownloads(1);
+		REQUIRE(cache.PickDirtyFile(false) == &file1);
+		REQUIRE(cache.PickDirtyFile(false) == &file3);
+		REQUIRE(cache.PickDirtyFile(false) == nullptr);
+		REQUIRE(cache.PickDirtyFile(true) == &file2);
+		file2.SetActiveDownloads(0);
+	}
+
+	SECTION("backlog")
+	{
+		{
+			Guard contentGuard = cache.GuardContent();
+			file1.SetCachedArticles(0);
+			cache.FileFlushed(&file1, 3000);
+
+			file2.SetCachedArticles(1);
+			cache.FileFlushed(&file2, 1000);
+		}
+		cache.GetFlushBacklog(&files, &size);
+		REQUIRE(files == 2);
+		REQUIRE(size == 2500);
+
+		// discarded articles
+		{
+			Guard contentGuard = cache.GuardContent();
+			file3.SetCachedArticles(0);
+			cache.FileDeleted(&file3);
+		}
+		cache.GetFlushBacklog(&files, &size);
+		REQUIRE(files == 1);
+		REQUIRE(size == 500);
+
+		REQUIRE(cache.PickDirtyFile(true) == &file2);
+		REQUIRE(cache.PickDirtyFile(true) == nullptr);
+	}
+}
+
+TEST_CASE("Article cache: parallel flushing", "[ArticleCache][Quick]")
+{
+	ArticleCacheMock cache;
+
+	NzbInfo nzbInfo;
+	FileInfo files[3];
+	std::atomic<int> holders[3];
+	for (int i = 0; i < 3; i++)
+	{
+		files[i].SetNzbInfo(&nzbInfo);
+		CacheFile(&files[i], 1000);
+		holders[i] = 0;
+	}
+
+	// two workers must never pick the same file
+	std::atomic<int> collisions{0};
+	std::vector<std::thread> workers;
+	for (int w = 0; w < 4; w++)
+	{
+		workers.emplace_back([&]
+			{
+				for (int n = 0; n < 2000; n++)
+				{
+					FileInfo* fileInfo = cache.PickDirtyFile(true);
+					if (!fileInfo)
+					{
+						std::this_thread::yield();
+						continue;
+					}
+					int index = (int)(fileInfo - files);
+					if (++holders[index] != 1)
+					{
+						collisions++;
+					}
+					std::this_thread::yield();
+					holders[index]--;
+					cache.ReleaseDirtyFile(fileInfo);
+				}
+			});
+	}
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+	REQUIRE(collisions == 0);
+
+	// flush guard lets only one thread write the file
+	std::atomic<bool> guarded{false};
+	std::unique_ptr<ArticleCache::FlushGuard> flushGuard =
+		std::make_unique<ArticleCache::FlushGuard>(cache.GuardFlush(&files[0]));
+	REQUIRE(cache.GetFlushing());
+
+	std::thread waiter([&]
+		{
+			ArticleCache::FlushGuard waiterGuard = cache.GuardFlush(&files[0]);
+			guarded = true;
+		});
+	Util::Sleep(50);
+	REQUIRE(!guarded);
+
+	{
+		// other files are not blocked
+		ArticleCache::FlushGuard otherGuard = cache.GuardFlush(&files[1]);
+	}
+
+	flushGuard.reset();
+	waiter.join();
+	REQUIRE(guarded);
+	REQUIRE(!cache.GetFlushing());
+}
+
+TEST_CASE("Article cache: memory blocks", "[ArticleCache][Quick]")
+{
+	const int BLOCK = 1024 * 16;
+	const int BLOCKS = 1024 * 1024 / BLOCK;
+
+	Options::CmdOptList cmdOpts;
+	cmdOpts.push_back("WriteLog=none");
+	cmdOpts.push_back("ArticleCache=1");
+	Options options(&cmdOpts, nullptr);
+
+	ArticleCacheMock articleCache;
+
+	// the whole cache in single blocks, taken one after another
+	std::vector<CachedSegmentData> segments;
+	for (int i = 0; i < BLOCKS; i++)
+	{
+		segments.push_back(articleCache.Alloc(BLOCK - i % 100));
+		REQUIRE(segments.back().GetData());
+		if (i > 0)
+		{
+			CHECK(segments[i].GetData() == segments[i - 1].GetData() + BLOCK);
+		}
+	}
+	CHECK(articleCache.GetAllocated() == (size_t)BLOCKS * BLOCK);
+	CHECK(!articleCache.Alloc(1).GetData());
+
+	SECTION("splitting")
+	{
+		char* first = segments[10].GetData();
+		for (int i = 10; i < 14; i++)
+		{
+			segments[i] = CachedSegmentData();
+		}
+
+		// the free run is divided, the rest of it remains available
+		CachedSegmentData seg1 = articleCache.Alloc(BLOCK);
+		CHECK(seg1.GetData() == first);
+		CachedSegmentData seg2 = articleCache.Alloc(BLOCK * 2);
+		CHECK(seg2.GetData() == first + BLOCK);
+		CachedSegmentData seg3 = articleCache.Alloc(BLOCK);
+		CHECK(seg3.GetData() == first + BLOCK * 3);
+		CHECK(!articleCache.Alloc(1).GetData());
+	}
+
+	SECTION("merging neighbours")
+	{
+		char* first = segments[20].GetData();
+		segments[22] = CachedSegmentData();
+		segments[20] = CachedSegmentData();
+		segments[21] = CachedSegmentData();
+
+		// the freed block is merged with the free blocks before and after it
+		CachedSegmentData seg = articleCache.Alloc(BLOCK * 3);
+		CHECK(seg.GetData() == first);
+		CHECK(articleCache.GetAllocated() == (size_t)BLOCKS * BLOCK);
+	}
+
+	SECTION("fragmentation")
+	{
+		segments[30] = CachedSegmentData();
+		segments[32] = CachedSegmentData();
+		segments[34] = CachedSegmentData();
+
+		// there is space for three blocks but not in a row
+		CHECK(articleCache.GetAllocated() == (size_t)(BLOCKS - 3) * BLOCK);
+		CHECK(!articleCache.Alloc(BLOCK * 2).GetData());
+
+		// small segments still fit, the best fitting run is taken
+		segments[50] = CachedSegmentData();
+		segments[51] = CachedSegmentData();
+		CachedSegmentData seg1 = articleCache.Alloc(BLOCK * 2);
+		CHECK(seg1.GetData() == segments[49].GetData() + BLOCK);
+		CachedSegmentData seg2 = articleCache.Alloc(BLOCK);
+		CHECK(seg2.GetData() == segments[29].GetData() + BLOCK);
+	}
+
+	SECTION("shrinking")
+	{
+		char* first = segments[40].GetData();
+		segments[40] = CachedSegmentData();
+		segments[41] = CachedSegmentData();
+		CachedSegmentData seg = articleCache.Alloc(BLOCK * 2);
+		REQUIRE(seg.GetData() == first);
+
+		// the blocks at the end of the segment are given back
+		CHECK(articleCache.Realloc(&seg, 100));
+		CHECK(!articleCache.Realloc(&seg, BLOCK * 2));
+		CachedSegmentData seg2 = articleCache.Alloc(BLOCK);
+		CHECK(seg2.GetData() == first + BLOCK);
+	}
+
+	segments.clear();
+	CHECK(articleCache.GetAllocated() == 0);
+}
+
+TEST_CASE("Article writer: discarded duplicate download", "[ArticleWriter][Quick]")
+{
+	TestUtil::PrepareWorkingDir("empty");
+
+	BString<1024> tempDir("TempDir=%s", TestUtil::WorkingDir().c_str());
+
+	Options::CmdOptList cmdOpts;
+	cmdOpts.push_back("WriteLog=none");
+	cmdOpts.push_back("NzbLog=no");
+	cmdOpts.push_back("ArticleCache=10");
+	cmdOpts.push_back("DirectWrite=yes");
+	cmdOpts.push_back(tempDir);
+	Options options(&cmdOpts, nullptr);
+
+	ArticleCacheMock articleCache;
+
+	NzbInfo nzbInfo;
+	nzbInfo.SetDestDir(TestUtil::WorkingDir().c_str());
+	FileInfo fileInfo;
+	fileInfo.SetNzbInfo(&nzbInfo);
+	ArticleInfo articleInfo;
+	articleInfo.SetPartNumber(1);
+
+	const char* winnerData = "0123456789";
+	const char* loserData = "9876543210";
+
+	// both downloads receive the article at the same time, the duplicate download
+	// keeps it in the cache only
+	ArticleWriter original;
+	ArticleWriter hedge;
+	hedge.SetCacheOnly(true);
+	for (ArticleWriter* writer : {&original, &hedge})
+	{
+		writer->SetInfoName("test");
+		writer->SetFileInfo(&fileInfo);
+		writer->SetArticleInfo(&articleInfo);
+		writer->Prepare();
+		REQUIRE(writer->Start(Decoder::efYenc, nullptr, 10, 0, 10));
+	}
+
+	bool hedgeWins = false;
+	SECTION("duplicate download wins")
+	{
+		hedgeWins = true;
+	}
+	SECTION("original download wins")
+	{
+		hedgeWins = false;
+	}
+	ArticleWriter* winner = hedgeWins ? &hedge : &original;
+	ArticleWriter* loser = hedgeWins ? &original : &hedge;
+
+	int size = 0;
+	char* buffer = winner->GetWriteBuffer(&size);
+	REQUIRE(buffer);
+	memcpy(buffer, winnerData, 10);
+	REQUIRE(winner->Write(buffer, 10));
+	winner->Finish(true);
+
+	buffer = loser->GetWriteBuffer(&size);
+	REQUIRE(buffer);
+	memcpy(buffer, loserData, 10);
+	REQUIRE(loser->Write(buffer, 10));
+	loser->Discard();
+
+	// the segment of the winner remains intact, the memory of the loser is freed
+	REQUIRE(articleInfo.GetSegmentContent());
+	CHECK(!strncmp(articleInfo.GetSegmentContent(), winnerData, 10));
+	CHECK(articleInfo.GetSegmentSize() == 10);
+	CHECK(fileInfo.GetCachedArticles() == 1);
+	CHECK(articleCache.GetAllocated() == 1024 * 16);
+
+	articleInfo.DiscardSegment();
+	CHECK(articleCache.GetAllocated() == 0);
+}
@@ -0,0 +1,158 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "nzbget.h"
+
+#include "catch.h"
+
+#include "BandwidthLimiter.h"
+#include "WorkState.h"
+
+typedef std::chrono::steady_clock::time_point TimePoint;
+
+static TimePoint Later(TimePoint time, int64 usec)
+{
+	return time + std::chrono::microseconds(usec);
+}
+
+class BandwidthLimiterMock : public BandwidthLimiter
+{
+public:
+	void Advance(int64 usec) { m_now = Later(m_now, usec); }
+
+protected:
+	virtual TimePoint Now() { return m_now; }
+
+private:
+	TimePoint m_now;
+};
+
+class WorkStateMock : public WorkState
+{
+public:
+	WorkStateMock() { m_oldWorkState = g_WorkState; g_WorkState = this; }
+	~WorkStateMock() { g_WorkState = m_oldWorkState; }
+
+private:
+	WorkState* m_oldWorkState;
+};
+
+TEST_CASE("Token bucket: unlimited", "[BandwidthLimiter][Quick]")
+{
+	TimePoint now;
+	TokenBucket bucket;
+	REQUIRE(bucket.Consume(1000000, now) == 0);
+
+	bucket.SetRate(1000, now);
+	bucket.SetRate(0, now);
+	REQUIRE(bucket.Consume(1000000, now) == 0);
+}
+
+TEST_CASE("Token bucket: debt", "[BandwidthLimiter][Quick]")
+{
+	TimePoint now;
+	TokenBucket bucket;
+	bucket.SetRate(1000000, now);
+
+	// every receiver waits for the data received by all receivers before it
+	REQUIRE(bucket.Consume(10000, now) == 10000);
+	REQUIRE(bucket.Consume(10000, now) == 20000);
+	REQUIRE(bucket.Consume(10000, Later(now, 5000)) == 25000);
+
+	// the debt is paid off over time
+	REQUIRE(bucket.Consume(0, Later(now, 29000)) == 1000);
+	REQUIRE(bucket.Consume(1000, Later(now, 31000)) == 0);
+}
+
+TEST_CASE("Token bucket: refill and burst", "[BandwidthLimiter][Quick]")
+{
+	TimePoint now;
+	TokenBucket bucket;
+	bucket.SetRate(1000000, now);
+
+	// the bucket is refilled with the rate but holds only 5 ms of data
+	now = Later(now, 1000);
+	REQUIRE(bucket.Consume(1000, now) == 0);
+	REQUIRE(bucket.Consume(1, now) == 1);
+
+	now = Later(now, 1000000);
+	REQUIRE(bucket.Consume(5000, now) == 0);
+	REQUIRE(bucket.Consume(1000, now) == 1000);
+
+	// a clock running behind (other thread) doesn't take tokens away
+	REQUIRE(bucket.Consume(0, Later(now, -500)) == 1000);
+	REQUIRE(bucket.Consume(0, Later(now, 500)) == 500);
+
+	// a new rate starts with an empty bucket
+	bucket.SetRate(2000000, now);
+	REQUIRE(bucket.Consume(2000, now) == 1000);
+}
+
+TEST_CASE("Bandwidth limiter: speed limits", "[BandwidthLimiter][Quick]")
+{
+	WorkStateMock workState;
+
+	Servers servers;
+	servers.push_back(std::make_unique<NewsServer>(1, true, nullptr, "", 119, 0,
+		"", "", false, false, nullptr, 4, 0, 0, 0, false, 1, 0, false));
+	servers.push_back(std::make_unique<NewsServer>(2, true, nullptr, "", 119, 0,
+		"", "", false, false, nullptr, 4, 0, 0, 0, false, 1, 500000, false));
+	Options::Categories categories;
+	categories.emplace_back("cat", nullptr, false, nullptr, 250000);
+	NewsServer* unlimited = servers[0].get();
+	NewsServer* limited = servers[1].get();
+	Options::Category* category = &categories.front();
+
+	BandwidthLimiterMock limiter;
+	limiter.Init(&servers, &categories);
+	REQUIRE(limiter.IsActive());
+	REQUIRE(limiter.GetMaxReadSize() == 2500);
+
+	SECTION("server limit")
+	{
+		CHECK(limiter.Consume(5000, unlimited, nullptr) == 0);
+		CHECK(limiter.Consume(5000, limited, nullptr) == 10000);
+		limiter.Advance(10000);
+		CHECK(limiter.Consume(0, limited, nullptr) == 0);
+	}
+
+	SECTION("category limit")
+	{
+		CHECK(limiter.Consume(5000, unlimited, category) == 20000);
+		CHECK(limiter.Consume(5000, limited, category) == 40000);
+		limiter.Advance(30000);
+		CHECK(limiter.Consume(0, unlimited, category) == 10000);
+	}
+
+	SECTION("global limit")
+	{
+		workState.SetSpeedLimit(100000);
+		CHECK(limiter.GetMaxReadSize() == 1024);
+		CHECK(limiter.Consume(1000, unlimited, nullptr) == 10000);
+		limiter.Advance(10000);
+		CHECK(limiter.Consume(0, unlimited, nullptr) == 0);
+
+		// after a pause only the burst (5 ms of data) can be received without waiting
+		limiter.Advance(1000000);
+		CHECK(limiter.Consume(500, unlimited, nullptr) == 0);
+		CHECK(limiter.Consume(500, unlimited, nullptr) == 5000);
+	}
+}
@@ -0,0 +1,99 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "nzbget.h"
+
+#include "catch.h"
+
+#include "ConnectionTuner.h"
+
+// throughput of a server which saturates at "knee" connections
+int SaturatingServer(int connections, int knee)
+{
+	return std::min(connections, knee) * 1000000;
+}
+
+// throughput of a server which throttles if more than "allowed" connections are used
+int ThrottlingServer(int connections, int allowed)
+{
+	return connections <= allowed ? connections * 1000000 : allowed * 500000;
+}
+
+TEST_CASE("Connection tuner: saturation", "[ConnectionTuner]")
+{
+	ConnectionTuner::Controller controller(20);
+	REQUIRE(controller.GetLimit() == 10);
+
+	for (int i = 0; i < 10; i++)
+	{
+		controller.Update(SaturatingServer(controller.GetLimit(), 20));
+	}
+	REQUIRE(controller.GetLimit() == 20);
+
+	ConnectionTuner::Controller controller2(20);
+	std::set<int> limits;
+	for (int i = 0; i < 100; i++)
+	{
+		controller2.Update(SaturatingServer(controller2.GetLimit(), 6));
+		if (i > 10)
+		{
+			limits.insert(controller2.GetLimit());
+		}
+	}
+	// the controller stays at the knee except for probing
+	REQUIRE(*limits.begin() >= 5);
+	REQUIRE(*limits.rbegin() <= 7);
+}
+
+TEST_CASE("Connection tuner: probing at knee", "[ConnectionTuner]")
+{
+	ConnectionTuner::Controller controller(8);
+	REQUIRE(controller.GetLimit() == 4);
+
+	int probes = 0;
+	for (int i = 0; i < 100; i++)
+	{
+		int limit = controller.GetLimit();
+		controller.Update(SaturatingServer(limit, 5));
+		REQUIRE(controller.GetLimit() >= 4);
+		REQUIRE(controller.GetLimit() <= 6);
+		probes += controller.GetLimit() == 6 ? 1 : 0;
+	}
+
+	// the connection over the knee is probed only once per hold period
+	REQUIRE(probes > 5);
+	REQUIRE(probes < 20);
+}
+
+TEST_CASE("Connection tuner: throttling", "[ConnectionTuner]")
+{
+	ConnectionTuner::Controller controller(16);
+	int sum = 0;
+	for (int i = 0; i < 100; i++)
+	{
+		controller.Update(ThrottlingServer(controller.GetLimit(), 4));
+		sum += controller.GetLimit();
+		REQUIRE(controller.GetLimit() >= 1);
+	}
+
+	int average = sum / 100;
+	REQUIRE(average <= 6);
+}
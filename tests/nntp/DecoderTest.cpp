@@ -0,0 +1,301 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "nzbget.h"
+
+#include "catch.h"
+
+#include "Decoder.h"
+#include "YEncode.h"
+#include "ArticleDecoderPool.h"
+#include "Options.h"
+
+// builds an NNTP article body with yEnc-encoded data as sent by a news server
+static std::string EncodeArticle(const std::vector<uchar>& data, uint32 crc)
+{
+	std::string article = "=ybegin part=1 line=128 size=" + std::to_string(data.size()) + " name=test.bin\r\n";
+	article += "=ypart begin=1 end=" + std::to_string(data.size()) + "\r\n";
+
+	int col = 0;
+	for (uchar ch : data)
+	{
+		uchar enc = (uchar)(ch + 42);
+		if (enc == 0 || enc == '\n' || enc == '\r' || enc == '=' ||
+			((enc == '\t' || enc == ' ') && (col == 0 || col >= 127)) ||
+			(enc == '.' && col == 0))
+		{
+			article += '=';
+			enc = (uchar)(enc + 64);
+			col++;
+		}
+		article += (char)enc;
+		if (++col >= 128)
+		{
+			article += "\r\n";
+			col = 0;
+		}
+	}
+	if (col > 0)
+	{
+		article += "\r\n";
+	}
+
+	char crcbuf[32];
+	snprintf(crcbuf, sizeof(crcbuf), "%08x", crc);
+	article += "=yend size=" + std::to_string(data.size()) + " part=1 pcrc32=" + crcbuf + "\r\n.\r\n";
+	return article;
+}
+
+static void DecodeArticle(const std::string& article, int portion, std::vector<uchar>& output, Decoder::EStatus& status)
+{
+	Decoder decoder;
+	decoder.Clear();
+	decoder.SetCrcCheck(true);
+	output.clear();
+
+	std::vector<char> buffer(portion + 1);
+	std::vector<char> outbuf(portion);
+	for (size_t pos = 0; pos < article.size() && !decoder.GetEof(); pos += portion)
+	{
+		int len = (int)std::min((size_t)portion, article.size() - pos);
+		memcpy(buffer.data(), article.data() + pos, len);
+		buffer[len] = '\0';
+		int outlen = decoder.DecodeBuffer(buffer.data(), len, outbuf.data());
+		output.insert(output.end(), outbuf.begin(), outbuf.begin() + outlen);
+	}
+
+	status = decoder.Check();
+}
+
+TEST_CASE("Decoder: yEnc with crc check", "[Decoder][Quick]")
+{
+	std::vector<uchar> data(300000);
+	uint32 seed = 54321;
+	for (uchar& ch : data)
+	{
+		seed = seed * 1103515245 + 12345;
+		ch = (uchar)(seed >> 16);
+	}
+	// runs of critical characters
+	for (int i = 1000; i < 1300; i++)
+	{
+		data[i] = (uchar)(i % 2 ? '=' - 42 : '\r' - 42);
+	}
+
+	Crc32 crc;
+	crc.Append(data.data(), (uint32)data.size());
+	std::string article = EncodeArticle(data, crc.Finish());
+
+	for (int portion : {1000, 4096, 10000, 65536, 512 * 1024})
+	{
+		std::vector<uchar> output;
+		Decoder::EStatus status;
+		DecodeArticle(article, portion, output, status);
+		REQUIRE(status == Decoder::dsFinished);
+		REQUIRE(output == data);
+	}
+
+	std::string corrupted = article;
+	corrupted[corrupted.size() / 2] = corrupted[corrupted.size() / 2] == 'a' ? 'b' : 'a';
+	std::vector<uchar> output;
+	Decoder::EStatus status;
+	DecodeArticle(corrupted, 65536, output, status);
+	REQUIRE(status == Decoder::dsCrcError);
+}
+
+typedef int (*DecodeFunc)(const uchar** src, uchar** dest, size_t len, YEncode::YencDecoderState* state);
+
+struct DecodeResult
+{
+	int ended;
+	int consumed;
+	YEncode::YencDecoderState state;
+	std::vector<uchar> output;
+};
+
+// decodes the data in two calls, the state is carried over the split point
+static DecodeResult DecodeSplit(DecodeFunc decodeFunc, const uchar* data, int len, int split,
+	YEncode::YencDecoderState state)
+{
+	DecodeResult result;
+	result.output.resize(len + 64);
+	result.state = state;
+	const uchar* src = data;
+	uchar* dest = result.output.data();
+	result.ended = decodeFunc(&src, &dest, split, &result.state);
+	if (!result.ended && split < len)
+	{
+		result.ended = decodeFunc(&src, &dest, len - split, &result.state);
+	}
+	result.consumed = (int)(src - data);
+	result.output.resize(dest - result.output.data());
+	return result;
+}
+
+TEST_CASE("Decoder: SIMD decoders match scalar decoder", "[Decoder][Quick]")
+{
+	const char special[] = "=\r\n.y";
+	const char* sequences[] = { "\r\n.\r\n", "\r\n=y", "\r\n.=y", "\r\n..", "=\r\n.", "===" };
+
+	std::vector<uchar> src(2048 + 128);
+
+	REQUIRE(YEncode::decoder_count > 0);
+	for (int d = 0; d < YEncode::decoder_count; d++)
+	{
+		INFO("decoder " << YEncode::decoder_names[d]);
+		YEncode::decoder_inits[d]();
+		DecodeFunc decodeFunc = YEncode::decode;
+
+		uint32 seed = 777;
+		auto random = [&seed]() { seed = seed * 1103515245 + 12345; return seed >> 8; };
+
+		for (int i = 0; i < 5000; i++)
+		{
+			int len = random() % 2048;
+			int offset = random() % 64;
+			int density = random() % 60;
+			uchar* data = src.data() + offset;
+			for (int k = 0; k < len; k++)
+			{
+				data[k] = (int)(random() % 100) < density ? special[random() % 5] : (uchar)random();
+			}
+			for (int k = 0; k < 4 && len > 8; k++)
+			{
+				const char* seq = sequences[random() % 6];
+				memcpy(data + random() % (len - 5), seq, strlen(seq));
+			}
+			YEncode::YencDecoderState initialState = (YEncode::YencDecoderState)(random() % 7);
+
+			// the data is either decoded at once or in two chunks; the first chunk ends
+			// in the middle of an escape sequence or of a line start sequence if there are any
+			int split = len;
+			if (i % 3 == 1 && len > 0)
+			{
+				split = random() % len;
+			}
+			else if (i % 3 == 2 && len > 0)
+			{
+				int start = random() % len;
+				for (int k = start; k < len; k++)
+				{
+					if (data[k] == '=' || data[k] == '\r' || data[k] == '.')
+					{
+						split = k + 1;
+						break;
+					}
+				}
+			}
+
+			DecodeResult scalar = DecodeSplit(&YEncode::decode_scalar, data, len, split, initialState);
+			DecodeResult simd = DecodeSplit(decodeFunc, data, len, split, initialState);
+
+			REQUIRE(simd.ended == scalar.ended);
+			REQUIRE(simd.consumed == scalar.consumed);
+			REQUIRE(simd.state == scalar.state);
+			REQUIRE(simd.output == scalar.output);
+		}
+	}
+
+	// restore the fastest decoder chosen by "init()"
+	YEncode::decoder_inits[YEncode::decoder_count - 1]();
+}
+
+class DecoderStream : public ArticleDecoderPool::Stream
+{
+public:
+	DecoderStream() { m_decoder.Clear(); m_decoder.SetCrcCheck(true); }
+	Decoder* GetDecoder() { return &m_decoder; }
+	std::vector<uchar>* GetOutput() { return &m_output; }
+
+protected:
+	virtual bool Process(char* buffer, int len)
+	{
+		std::vector<char> outbuf(len);
+		int outlen = m_decoder.DecodeBuffer(buffer, len, outbuf.data());
+		m_output.insert(m_output.end(), outbuf.begin(), outbuf.begin() + outlen);
+		return true;
+	}
+
+private:
+	Decoder m_decoder;
+	std::vector<uchar> m_output;
+};
+
+TEST_CASE("Decoder: decoding via decoder pool", "[Decoder][Quick]")
+{
+	Options::CmdOptList cmdOpts;
+	cmdOpts.push_back("WriteLog=none");
+	cmdOpts.push_back("ArticleCache=0");
+	Options options(&cmdOpts, nullptr);
+
+	ArticleDecoderPool pool(2);
+
+	// several articles are received at once, each in portions of random length
+	std::vector<std::thread> receivers;
+	std::vector<int> results(6);
+	for (int n = 0; n < (int)results.size(); n++)
+	{
+		receivers.emplace_back([&pool, &results, n]
+			{
+				uint32 seed = 1000 + n;
+				auto random = [&seed]() { seed = seed * 1103515245 + 12345; return seed >> 8; };
+
+				std::vector<uchar> data(200000 + n * 10000);
+				for (uchar& ch : data)
+				{
+					ch = (uchar)random();
+				}
+				Crc32 crc;
+				crc.Append(data.data(), (uint32)data.size());
+				uint32 crcValue = crc.Finish();
+				std::string article = EncodeArticle(data, crcValue);
+
+				DecoderStream stream;
+				pool.Open(&stream);
+				for (size_t pos = 0; pos < article.size(); )
+				{
+					int size;
+					char* buffer = stream.GetBuffer(&size);
+					int len = (int)std::min((size_t)(random() % size + 1), article.size() - pos);
+					memcpy(buffer, article.data() + pos, len);
+					stream.Push(len);
+					pos += len;
+				}
+				pool.Close(&stream);
+
+				results[n] = !stream.GetFailed() &&
+					stream.GetDecoder()->Check() == Decoder::dsFinished &&
+					stream.GetDecoder()->GetCalculatedCrc() == crcValue &&
+					*stream.GetOutput() == data;
+			});
+	}
+
+	for (std::thread& receiver : receivers)
+	{
+		receiver.join();
+	}
+	pool.Stop();
+
+	for (int result : results)
+	{
+		CHECK(result);
+	}
+}
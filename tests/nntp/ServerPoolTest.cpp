@@ -23,11 +23,12 @@
 #include "catch.h"
 
 #include "ServerPool.h"
+#include "Util.h"
 
 void AddTestServer(ServerPool* pool, int id, bool active, int level, bool optional, int group, int connections)
 {
 	pool->AddServer(std::make_unique<NewsServer>(id, active, nullptr, "", 119, 0,
-		"", "", false, false, nullptr, connections, 0, level, group, optional));
+		"", "", false, false, nullptr, connections, 0, level, group, optional, 1, 0, false));
 }
 
 TEST_CASE("Server pool: simple levels", "[ServerPool]")
@@ -270,3 +271,383 @@ TEST_CASE("Server pool: block optional and non-optional servers", "[ServerPool]"
 	REQUIRE(con3 == nullptr);
 	REQUIRE(con4 == nullptr);
 }
+
+TEST_CASE("Server pool: pipelined connection", "[ServerPool]")
+{
+	ServerPool pool;
+	AddTestServer(&pool, 1, true, 0, false, 0, 1);
+	pool.InitConnections();
+
+	NntpConnection* con1 = pool.GetConnection(0, nullptr, nullptr);
+	REQUIRE(con1 != nullptr);
+	con1->AddPipelineRequest("<1@test>");
+	con1->AddPipelineRequest("<2@test>");
+	con1->AddPipelineRequest("<3@test>");
+	pool.FreeConnection(con1, true);
+
+	// connection with pending requests is not given out to other downloaders
+	REQUIRE(pool.GetConnection(0, nullptr, nullptr) == nullptr);
+
+	// the response to the first request must be read first
+	bool lost = false;
+	REQUIRE(pool.GetPipelinedConnection(con1, "<2@test>", &lost) == nullptr);
+	REQUIRE_FALSE(lost);
+
+	pool.CancelPipelineRequest(con1, "<1@test>");
+	REQUIRE(pool.GetPipelinedConnection(con1, "<2@test>", &lost) == con1);
+	REQUIRE_FALSE(lost);
+	con1->CancelPipelineRequest("<2@test>");
+	pool.FreeConnection(con1, true);
+
+	REQUIRE(pool.GetPipelinedConnection(con1, "<4@test>", &lost) == nullptr);
+	REQUIRE(lost);
+
+	pool.CancelPipelineRequest(con1, "<3@test>");
+	REQUIRE(pool.GetConnection(0, nullptr, nullptr) == con1);
+}
+
+TEST_CASE("Server pool: wait for connection", "[ServerPool]")
+{
+	ServerPool pool;
+	AddTestServer(&pool, 1, true, 0, false, 0, 1);
+	AddTestServer(&pool, 2, true, 0, false, 0, 1);
+	pool.InitConnections();
+
+	NewsServer* serv1 = pool.GetServers()->at(0).get();
+	ServerPool::RawServerList ignoreServers;
+	ignoreServers.push_back(serv1);
+
+	NntpConnection* con1 = pool.GetConnection(0, nullptr, nullptr);
+	NntpConnection* con2 = pool.GetConnection(0, nullptr, nullptr);
+	REQUIRE(con1 != nullptr);
+	REQUIRE(con2 != nullptr);
+	NntpConnection* con1b = con1->GetNewsServer() == serv1 ? con1 : con2;
+	NntpConnection* con2b = con1->GetNewsServer() == serv1 ? con2 : con1;
+
+	// time out without free connection
+	REQUIRE(pool.GetConnection(0, nullptr, nullptr, 20) == nullptr);
+
+	// waiter ignoring server 1 must not take its connection but the connection of server 2
+	NntpConnection* waited = nullptr;
+	std::thread waiter([&]{ waited = pool.GetConnection(0, nullptr, &ignoreServers, 10000); });
+	Util::Sleep(20);
+	pool.FreeConnection(con1b, false);
+	Util::Sleep(20);
+	pool.FreeConnection(con2b, false);
+	waiter.join();
+	REQUIRE(waited == con2b);
+
+	// configuration change wakes up waiters
+	REQUIRE(pool.GetConnection(0, nullptr, &ignoreServers) == nullptr);
+	waited = con1b;
+	std::thread waiter2([&]{ waited = pool.GetConnection(0, nullptr, &ignoreServers, 10000); });
+	Util::Sleep(20);
+	pool.Changed();
+	waiter2.join();
+	REQUIRE(waited == nullptr);
+}
+
+TEST_CASE("Server pool: server rating", "[ServerPool]")
+{
+	ServerPool pool;
+	AddTestServer(&pool, 1, true, 0, false, 0, 1);
+	AddTestServer(&pool, 2, true, 0, false, 0, 1);
+	AddTestServer(&pool, 3, true, 0, false, 0, 1);
+	pool.InitConnections();
+
+	NewsServer* serv1 = pool.GetServers()->at(0).get();
+	NewsServer* serv2 = pool.GetServers()->at(1).get();
+	for (int i = 0; i < 20; i++)
+	{
+		serv1->GetRating()->AddResponse(10000);
+		serv1->GetRating()->AddArticle(true, 500000, 50000);
+		serv2->GetRating()->AddResponse(500000);
+		serv2->GetRating()->AddArticle(true, 500000, 500000);
+	}
+
+	// server 3 isn't rated yet and is treated as good as the best server,
+	// server 2 is much slower but still gets a share of requests
+	int counts[3] = {0, 0, 0};
+	for (int i = 0; i < 3000; i++)
+	{
+		NntpConnection* con = pool.GetConnection(0, nullptr, nullptr);
+		REQUIRE(con != nullptr);
+		counts[con->GetNewsServer()->GetId() - 1]++;
+		pool.FreeConnection(con, false);
+	}
+
+	CHECK(counts[0] > counts[1] * 3);
+	CHECK(counts[2] > counts[1] * 3);
+	CHECK(counts[1] > 0);
+
+	// server 3 doesn't have the articles, it isn't treated as unrated anymore
+	NewsServer* serv3 = pool.GetServers()->at(2).get();
+	for (int i = 0; i < 20; i++)
+	{
+		serv3->GetRating()->AddArticle(false, 0, 0);
+	}
+
+	counts[0] = counts[1] = counts[2] = 0;
+	for (int i = 0; i < 3000; i++)
+	{
+		NntpConnection* con = pool.GetConnection(0, nullptr, nullptr);
+		REQUIRE(con != nullptr);
+		counts[con->GetNewsServer()->GetId() - 1]++;
+		pool.FreeConnection(con, false);
+	}
+
+	CHECK(counts[0] > counts[2] * 3);
+	CHECK(counts[2] > 0);
+}
+
+#ifndef WIN32
+class TestNewsServer
+{
+public:
+	TestNewsServer(bool greet, const char* dateAnswer);
+	~TestNewsServer();
+	int GetPort() { return m_port; }
+	int GetAccepted() { return m_accepted; }
+	int GetKeepAlives() { return m_keepAlives; }
+
+private:
+	SOCKET m_listener;
+	int m_port;
+	bool m_greet;
+	const char* m_dateAnswer;
+	std::atomic<int> m_accepted{0};
+	std::atomic<int> m_keepAlives{0};
+	std::thread m_acceptThread;
+	std::vector<std::thread> m_clientThreads;
+
+	void Serve(SOCKET socket);
+};
+
+TestNewsServer::TestNewsServer(bool greet, const char* dateAnswer) :
+	m_greet(greet), m_dateAnswer(dateAnswer)
+{
+	m_listener = socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t addressLen = sizeof(address);
+	bind(m_listener, (sockaddr*)&address, addressLen);
+	listen(m_listener, 10);
+	getsockname(m_listener, (sockaddr*)&address, &addressLen);
+	m_port = ntohs(address.sin_port);
+
+	m_acceptThread = std::thread([&]
+		{
+			while (true)
+			{
+				SOCKET socket = accept(m_listener, nullptr, nullptr);
+				if (socket == INVALID_SOCKET)
+				{
+					return;
+				}
+				m_accepted++;
+				m_clientThreads.emplace_back([this, socket]{ Serve(socket); });
+			}
+		});
+}
+
+TestNewsServer::~TestNewsServer()
+{
+	shutdown(m_listener, SHUT_RDWR);
+	closesocket(m_listener);
+	m_acceptThread.join();
+	for (std::thread& clientThread : m_clientThreads)
+	{
+		clientThread.join();
+	}
+}
+
+void TestNewsServer::Serve(SOCKET socket)
+{
+	Connection connection(socket, false);
+	connection.SetSuppressErrors(true);
+	if (m_greet)
+	{
+		connection.WriteLine("200 Welcome\r\n");
+	}
+
+	char buf[1024];
+	while (char* line = connection.ReadLine(buf, sizeof(buf), nullptr))
+	{
+		if (!strncasecmp(line, "DATE", 4))
+		{
+			m_keepAlives++;
+			connection.WriteLine(m_dateAnswer);
+		}
+		else if (!strncasecmp(line, "QUIT", 4))
+		{
+			connection.WriteLine("205 Bye\r\n");
+			break;
+		}
+		else
+		{
+			connection.WriteLine("500 Unknown command\r\n");
+		}
+	}
+	connection.Disconnect();
+}
+
+void AddLocalServer(ServerPool* pool, int id, int port, int connections)
+{
+	pool->AddServer(std::make_unique<NewsServer>(id, true, nullptr, "127.0.0.1", port, 0,
+		"", "", false, false, nullptr, connections, 0, 0, 0, false, 1, 0, false));
+}
+
+bool WaitWarmers(ServerPool* pool)
+{
+	for (int i = 0; i < 1000 && pool->IsWarming(); i++)
+	{
+		Util::Sleep(10);
+	}
+	return !pool->IsWarming();
+}
+
+int CountConnected(ServerPool* pool, int connections)
+{
+	std::vector<NntpConnection*> taken;
+	int connected = 0;
+	for (int i = 0; i < connections; i++)
+	{
+		NntpConnection* connection = pool->GetConnection(0, nullptr, nullptr);
+		if (connection)
+		{
+			taken.push_back(connection);
+			connected += connection->GetStatus() == Connection::csConnected ? 1 : 0;
+		}
+	}
+	for (NntpConnection* connection : taken)
+	{
+		pool->FreeConnection(connection, false);
+	}
+	return connected;
+}
+
+TEST_CASE("Server pool: warm connections", "[ServerPool]")
+{
+	TestNewsServer server(true, "111 20260101000000\r\n");
+	ServerPool pool;
+	pool.SetTimeout(10);
+	AddLocalServer(&pool, 1, server.GetPort(), 4);
+	pool.InitConnections();
+
+	// one connection per call, until the wanted number is reached
+	pool.KeepWarm(2);
+	REQUIRE(WaitWarmers(&pool));
+	CHECK(server.GetAccepted() == 1);
+
+	pool.KeepWarm(2);
+	REQUIRE(WaitWarmers(&pool));
+	CHECK(server.GetAccepted() == 2);
+
+	pool.KeepWarm(2);
+	REQUIRE(WaitWarmers(&pool));
+	CHECK(server.GetAccepted() == 2);
+	CHECK(CountConnected(&pool, 4) == 2);
+
+	// recently used connections don't need keep-alive
+	CHECK(server.GetKeepAlives() == 0);
+
+	pool.StopWarming();
+	CHECK_FALSE(pool.IsWarming());
+}
+
+TEST_CASE("Server pool: keep-alive", "[ServerPool]")
+{
+	SECTION("accepted")
+	{
+		TestNewsServer server(true, "111 20260101000000\r\n");
+		ServerPool pool;
+		pool.SetTimeout(10);
+		AddLocalServer(&pool, 1, server.GetPort(), 1);
+		pool.InitConnections();
+
+		pool.KeepWarm(1);
+		REQUIRE(WaitWarmers(&pool));
+		CHECK(CountConnected(&pool, 1) == 1);
+
+		// the connection was used just now, the keep-alive interval hasn't elapsed yet
+		pool.KeepWarm(1);
+		CHECK_FALSE(pool.IsWarming());
+		CHECK(server.GetKeepAlives() == 0);
+
+		pool.SetKeepAliveInterval(0);
+		pool.KeepWarm(1);
+		REQUIRE(WaitWarmers(&pool));
+		CHECK(server.GetKeepAlives() == 1);
+		CHECK(CountConnected(&pool, 1) == 1);
+	}
+
+	SECTION("rejected")
+	{
+		TestNewsServer server(true, "400 Idle timeout\r\n");
+		ServerPool pool;
+		pool.SetTimeout(10);
+		pool.SetKeepAliveInterval(0);
+		AddLocalServer(&pool, 1, server.GetPort(), 1);
+		pool.InitConnections();
+
+		pool.KeepWarm(1);
+		REQUIRE(WaitWarmers(&pool));
+		pool.KeepWarm(1);
+		REQUIRE(WaitWarmers(&pool));
+
+		// unexpected answer closes the connection
+		CHECK(server.GetKeepAlives() == 1);
+		CHECK(CountConnected(&pool, 1) == 0);
+	}
+}
+
+TEST_CASE("Server pool: stop warming", "[ServerPool]")
+{
+	SECTION("cancel connecting")
+	{
+		// the server never sends a greeting, the warmer waits for it
+		TestNewsServer server(false, "");
+		ServerPool pool;
+		pool.SetTimeout(60);
+		AddLocalServer(&pool, 1, server.GetPort(), 1);
+		pool.InitConnections();
+
+		pool.KeepWarm(1);
+		for (int i = 0; i < 1000 && server.GetAccepted() == 0; i++)
+		{
+			Util::Sleep(10);
+		}
+		REQUIRE(server.GetAccepted() == 1);
+		CHECK(pool.IsWarming());
+
+		time_t start = Util::CurrentTime();
+		pool.StopWarming();
+		int duration = (int)(Util::CurrentTime() - start);
+		CHECK_FALSE(pool.IsWarming());
+		CHECK(duration < 10);
+		CHECK_FALSE(pool.IsServerBlocked(pool.GetServers()->at(0).get()));
+	}
+
+	SECTION("failed connect")
+	{
+		// no one listens on the port anymore
+		int port;
+		{
+			TestNewsServer server(true, "");
+			port = server.GetPort();
+		}
+		ServerPool pool;
+		pool.SetTimeout(10);
+		AddLocalServer(&pool, 1, port, 1);
+		pool.InitConnections();
+
+		pool.KeepWarm(1);
+		REQUIRE(WaitWarmers(&pool));
+
+		// failed speculative connection doesn't block the server
+		CHECK_FALSE(pool.IsServerBlocked(pool.GetServers()->at(0).get()));
+		CHECK(CountConnected(&pool, 1) == 0);
+	}
+}
+#endif
@@ -0,0 +1,106 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "nzbget.h"
+
+#include "catch.h"
+
+#include "ServerRating.h"
+
+TEST_CASE("Server rating: measurements", "[ServerRating]")
+{
+	ServerRating rating;
+	REQUIRE(rating.GetWeight() == 0);
+
+	rating.AddResponse(20000);
+	REQUIRE(rating.GetWeight() == 0);
+
+	rating.AddArticle(true, 500000, 80000);
+	REQUIRE(rating.GetFirstByteTime() == 20);
+	REQUIRE(rating.GetThroughput() == 6250000);
+	REQUIRE(rating.GetNotFoundRate() == 0);
+	// 100 ms per article
+	REQUIRE(rating.GetWeight() == 10000);
+
+	rating.AddArticle(false, 0, 0);
+	REQUIRE(rating.GetNotFoundRate() == 50);
+	REQUIRE(rating.GetWeight() == 5000);
+
+	for (int i = 0; i < 100; i++)
+	{
+		rating.AddArticle(true, 500000, 80000);
+	}
+	REQUIRE(rating.GetNotFoundRate() == 0);
+}
+
+TEST_CASE("Server rating: comparison", "[ServerRating]")
+{
+	ServerRating fast;
+	ServerRating slowResponse;
+	ServerRating slowTransfer;
+	ServerRating incomplete;
+
+	for (int i = 0; i < 20; i++)
+	{
+		fast.AddResponse(10000);
+		fast.AddArticle(true, 700000, 100000);
+
+		slowResponse.AddResponse(200000);
+		slowResponse.AddArticle(true, 700000, 100000);
+
+		slowTransfer.AddResponse(10000);
+		slowTransfer.AddArticle(true, 700000, 1000000);
+
+		incomplete.AddResponse(10000);
+		incomplete.AddArticle(i % 2 == 0, 700000, 100000);
+	}
+
+	REQUIRE(fast.GetWeight() > slowResponse.GetWeight());
+	REQUIRE(fast.GetWeight() > slowTransfer.GetWeight());
+	REQUIRE(fast.GetWeight() > incomplete.GetWeight());
+}
+
+TEST_CASE("Server rating: articles not found", "[ServerRating]")
+{
+	ServerRating missing;
+	ServerRating good;
+
+	for (int i = 0; i < 20; i++)
+	{
+		missing.AddArticle(false, 0, 0);
+
+		good.AddResponse(10000);
+		good.AddArticle(true, 700000, 100000);
+	}
+
+	// rated, but lower than any server delivering articles
+	REQUIRE(missing.GetNotFoundRate() == 100);
+	REQUIRE(missing.GetWeight() > 0);
+	REQUIRE(missing.GetWeight() < good.GetWeight());
+
+	// the articles found later improve the rating
+	for (int i = 0; i < 50; i++)
+	{
+		missing.AddResponse(10000);
+		missing.AddArticle(true, 700000, 100000);
+	}
+	REQUIRE(missing.GetWeight() > 1);
+}
@@ -0,0 +1,195 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "nzbget.h"
+
+#include "catch.h"
+
+#include "ArticleScheduler.h"
+
+NzbInfo* AddNzb(NzbList* queue, int fileCount, int articleCount, int priority = 0)
+{
+	std::unique_ptr<NzbInfo> nzbInfo = std::make_unique<NzbInfo>();
+	nzbInfo->SetPriority(priority);
+	for (int i = 0; i < fileCount; i++)
+	{
+		std::unique_ptr<FileInfo> fileInfo = std::make_unique<FileInfo>();
+		fileInfo->SetNzbInfo(nzbInfo.get());
+		for (int j = 0; j < articleCount; j++)
+		{
+			fileInfo->GetArticles()->push_back(std::make_unique<ArticleInfo>());
+		}
+		nzbInfo->GetFileList()->Add(std::move(fileInfo));
+	}
+	NzbInfo* result = nzbInfo.get();
+	queue->Add(std::move(nzbInfo));
+	return result;
+}
+
+FileInfo* FileAt(NzbInfo* nzbInfo, int index)
+{
+	return nzbInfo->GetFileList()->at(index).get();
+}
+
+// takes the next file having articles for download and marks all its articles as running
+FileInfo* TakeFile(ArticleScheduler& scheduler, NzbList* queue, time_t curTime = 0, bool downloadPaused = false)
+{
+	while (FileInfo* fileInfo = scheduler.GetNextFile(queue, curTime, downloadPaused))
+	{
+		bool found = false;
+		while (ArticleInfo* articleInfo = scheduler.GetNextArticle(fileInfo))
+		{
+			articleInfo->SetStatus(ArticleInfo::aiRunning);
+			found = true;
+		}
+		scheduler.FileExhausted(fileInfo);
+		if (found)
+		{
+			return fileInfo;
+		}
+	}
+	return nullptr;
+}
+
+TEST_CASE("Article scheduler: queue order", "[ArticleScheduler][Quick]")
+{
+	NzbList queue;
+	NzbInfo* nzb1 = AddNzb(&queue, 2, 3);
+	NzbInfo* nzb2 = AddNzb(&queue, 2, 3);
+	ArticleScheduler scheduler;
+
+	FileInfo* fileInfo = scheduler.GetNextFile(&queue, 0, false);
+	REQUIRE(fileInfo == FileAt(nzb1, 0));
+
+	ArticleInfo* article = scheduler.GetNextArticle(fileInfo);
+	REQUIRE(article == fileInfo->GetArticles()->at(0).get());
+	article->SetStatus(ArticleInfo::aiRunning);
+	article = scheduler.GetNextArticle(fileInfo);
+	REQUIRE(article == fileInfo->GetArticles()->at(1).get());
+	article->SetStatus(ArticleInfo::aiFinished);
+	scheduler.GetNextArticle(fileInfo)->SetStatus(ArticleInfo::aiRunning);
+	REQUIRE(scheduler.GetNextArticle(fileInfo) == nullptr);
+	scheduler.FileExhausted(fileInfo);
+
+	REQUIRE(TakeFile(scheduler, &queue) == FileAt(nzb1, 1));
+	REQUIRE(TakeFile(scheduler, &queue) == FileAt(nzb2, 0));
+	REQUIRE(TakeFile(scheduler, &queue) == FileAt(nzb2, 1));
+	REQUIRE(TakeFile(scheduler, &queue) == nullptr);
+
+	// retry of a failed article makes the file available again
+	fileInfo->GetArticles()->at(0)->SetStatus(ArticleInfo::aiUndefined);
+	scheduler.ArticleReturned(fileInfo);
+	REQUIRE(scheduler.GetNextFile(&queue, 0, false) == fileInfo);
+	REQUIRE(scheduler.GetNextArticle(fileInfo) == fileInfo->GetArticles()->at(0).get());
+}
+
+TEST_CASE("Article scheduler: priorities", "[ArticleScheduler][Quick]")
+{
+	NzbList queue;
+	NzbInfo* nzb1 = AddNzb(&queue, 2, 1);
+	NzbInfo* nzb2 = AddNzb(&queue, 2, 1, 100);
+	NzbInfo* nzb3 = AddNzb(&queue, 2, 1, -100);
+	ArticleScheduler scheduler;
+
+	REQUIRE(scheduler.GetNextFile(&queue, 0, false) == FileAt(nzb2, 0));
+
+	// extra priority of a file beats nzb priority
+	FileAt(nzb3, 1)->SetExtraPriority(true);
+	REQUIRE(TakeFile(scheduler, &queue) == FileAt(nzb3, 1));
+
+	// priority change of nzb is picked up after invalidation (queue edit)
+	nzb1->SetPriority(200);
+	scheduler.Invalidate();
+	REQUIRE(TakeFile(scheduler, &queue) == FileAt(nzb1, 0));
+	REQUIRE(TakeFile(scheduler, &queue) == FileAt(nzb1, 1));
+	REQUIRE(TakeFile(scheduler, &queue) == FileAt(nzb2, 0));
+	REQUIRE(TakeFile(scheduler, &queue) == FileAt(nzb2, 1));
+	REQUIRE(TakeFile(scheduler, &queue) == FileAt(nzb3, 0));
+	REQUIRE(TakeFile(scheduler, &queue) == nullptr);
+}
+
+TEST_CASE("Article scheduler: pause", "[ArticleScheduler][Quick]")
+{
+	NzbList queue;
+	NzbInfo* nzb1 = AddNzb(&queue, 2, 1);
+	NzbInfo* nzb2 = AddNzb(&queue, 1, 1);
+	ArticleScheduler scheduler;
+
+	FileAt(nzb1, 0)->SetPaused(true);
+	REQUIRE(scheduler.GetNextFile(&queue, 0, false) == FileAt(nzb1, 1));
+	FileAt(nzb1, 1)->SetPaused(true);
+	REQUIRE(scheduler.GetNextFile(&queue, 0, false) == FileAt(nzb2, 0));
+	FileAt(nzb1, 0)->SetPaused(false);
+	REQUIRE(scheduler.GetNextFile(&queue, 0, false) == FileAt(nzb1, 0));
+
+	// only force priority nzbs are downloaded during global pause
+	REQUIRE(scheduler.GetNextFile(&queue, 0, true) == nullptr);
+	nzb2->SetPriority(NzbInfo::FORCE_PRIORITY);
+	scheduler.Invalidate();
+	REQUIRE(scheduler.GetNextFile(&queue, 0, true) == FileAt(nzb2, 0));
+	REQUIRE(scheduler.GetNextFile(&queue, 0, false) == FileAt(nzb2, 0));
+}
+
+TEST_CASE("Article scheduler: propagation delay", "[ArticleScheduler][Quick]")
+{
+	NzbList queue;
+	NzbInfo* nzb1 = AddNzb(&queue, 1, 1);
+	NzbInfo* nzb2 = AddNzb(&queue, 1, 1);
+	NzbInfo* nzb3 = AddNzb(&queue, 1, 1);
+	FileAt(nzb1, 0)->SetTime(1000);
+	FileAt(nzb2, 0)->SetTime(900);
+	FileAt(nzb3, 0)->SetTime(1500);
+	ArticleScheduler scheduler;
+	scheduler.SetPropagationDelay(100);
+
+	REQUIRE(scheduler.GetNextFile(&queue, 1000, false) == nullptr);
+	REQUIRE(scheduler.GetNextFile(&queue, 1000, false) == nullptr);
+	REQUIRE(TakeFile(scheduler, &queue, 1001) == FileAt(nzb2, 0));
+	REQUIRE(TakeFile(scheduler, &queue, 1100) == nullptr);
+	REQUIRE(TakeFile(scheduler, &queue, 1101) == FileAt(nzb1, 0));
+
+	// waiting longer than a full turn of the timer wheel
+	REQUIRE(TakeFile(scheduler, &queue, 1200) == nullptr);
+	REQUIRE(TakeFile(scheduler, &queue, 1601) == FileAt(nzb3, 0));
+	REQUIRE(TakeFile(scheduler, &queue, 1602) == nullptr);
+}
+
+TEST_CASE("Article scheduler: queue changes", "[ArticleScheduler][Quick]")
+{
+	NzbList queue;
+	NzbInfo* nzb1 = AddNzb(&queue, 2, 1);
+	ArticleScheduler scheduler;
+
+	REQUIRE(scheduler.GetNextFile(&queue, 0, false) == FileAt(nzb1, 0));
+
+	// deleted file is forgotten by scheduler
+	nzb1->GetFileList()->erase(nzb1->GetFileList()->begin());
+	REQUIRE(scheduler.GetNextFile(&queue, 0, false) == FileAt(nzb1, 0));
+
+	// added nzb is seen after invalidation
+	NzbInfo* nzb2 = AddNzb(&queue, 1, 1, 100);
+	REQUIRE(scheduler.GetNextFile(&queue, 0, false) == FileAt(nzb1, 0));
+	scheduler.Invalidate();
+	REQUIRE(scheduler.GetNextFile(&queue, 0, false) == FileAt(nzb2, 0));
+
+	queue.clear();
+	REQUIRE(scheduler.GetNextFile(&queue, 0, false) == nullptr);
+}
@@ -0,0 +1,172 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "nzbget.h"
+
+#include "catch.h"
+
+#include "AvailabilityChecker.h"
+#include "NntpServer.h"
+#include "TestUtil.h"
+
+TEST_CASE("Availability check: sampling", "[AvailabilityChecker]")
+{
+	int sampled = 0;
+	for (int i = 0; i < 1000; i++)
+	{
+		sampled += AvailabilityChecker::IsSampled(i, 10) ? 1 : 0;
+	}
+	REQUIRE(sampled == 100);
+
+	REQUIRE(AvailabilityChecker::IsSampled(0, 10));
+	REQUIRE_FALSE(AvailabilityChecker::IsSampled(1, 10));
+	REQUIRE(AvailabilityChecker::IsSampled(10, 10));
+	REQUIRE(AvailabilityChecker::IsSampled(0, 1));
+	REQUIRE(AvailabilityChecker::IsSampled(5, 100));
+}
+
+TEST_CASE("Availability check: health", "[AvailabilityChecker]")
+{
+	// 10 data articles and 2 par articles in the sample of a 1200 KB nzb with 200 KB par-files
+	ArticleAvailability availability(1200 * 1024, 200 * 1024);
+	for (int i = 0; i < 12; i++)
+	{
+		availability.AddArticle("<id>", 100 * 1024, i >= 10);
+	}
+
+	ArticleAvailability::ArticleList* articles = availability.GetArticles();
+	REQUIRE(availability.CalcHealth(0) == 1000);
+
+	// all data articles on level 0, except two which are only on level 1
+	for (int i = 0; i < 12; i++)
+	{
+		(*articles)[i].checked = true;
+		(*articles)[i].foundLevel = i < 8 ? 0 : 1;
+	}
+	REQUIRE(availability.CountFound(0) == 8);
+	REQUIRE(availability.CountFound(1) == 12);
+	REQUIRE(availability.CalcHealth(0) == 800);
+	REQUIRE(availability.CalcHealth(1) == 1000);
+
+	// par-files are on level 1 only, without them any damage is critical
+	REQUIRE(availability.CalcCriticalHealth(0) == 999);
+	REQUIRE(availability.CalcCriticalHealth(1) == 800);
+
+	// articles which no server could tell about are considered available
+	(*articles)[9].checked = false;
+	(*articles)[9].foundLevel = -1;
+	REQUIRE(availability.CalcHealth(1) == 1000);
+
+	(*articles)[9].checked = true;
+	REQUIRE(availability.CalcHealth(1) == 900);
+}
+
+#ifndef WIN32
+TEST_CASE("Availability check: batch", "[AvailabilityChecker]")
+{
+	// find a free port for the news server
+	SOCKET listener = socket(AF_INET, SOCK_STREAM, 0);
+	REQUIRE(listener != INVALID_SOCKET);
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t addressLen = sizeof(address);
+	REQUIRE(bind(listener, (sockaddr*)&address, addressLen) == 0);
+	REQUIRE(getsockname(listener, (sockaddr*)&address, &addressLen) == 0);
+	int port = ntohs(address.sin_port);
+	closesocket(listener);
+
+	std::string dataDir = TestUtil::TestDataDir();
+	NntpServer server(1, "127.0.0.1", port, nullptr, nullptr, dataDir.c_str(), nullptr, 0, 0, 0, nullptr);
+	server.Start();
+
+	NewsServer newsServer(1, true, "server1", "127.0.0.1", port, 0, "", "", false, false, nullptr,
+		1, 0, 0, 0, false, 1, 0, false);
+	NntpConnection connection(&newsServer);
+	connection.SetTimeout(10);
+	bool connected = false;
+	for (int i = 0; i < 100 && !connected; i++)
+	{
+		connected = connection.Connect();
+		if (!connected)
+		{
+			Util::Sleep(20);
+		}
+	}
+	REQUIRE(connected);
+
+	// the first article is on the server; the second one is only on server 2;
+	// the third one doesn't exist
+	ArticleAvailability availability(0, 0);
+	availability.AddArticle("<tls/cert.pem?1=0:100>", 100, false);
+	availability.AddArticle("<tls/cert.pem?1=0:100!2>", 100, false);
+	availability.AddArticle("<tls/missing.pem?1=0:100>", 100, false);
+	ArticleAvailability::ArticleList* articles = availability.GetArticles();
+
+	std::vector<const char*> messageIds;
+	AvailabilityChecker::Indices batch;
+	for (int i = 0; i < (int)articles->size(); i++)
+	{
+		messageIds.push_back((*articles)[i].messageId);
+		batch.push_back(i);
+	}
+
+	SECTION("responses")
+	{
+		AvailabilityChecker::Indices retry;
+		REQUIRE(connection.SendStatRequests(messageIds));
+		CHECK(AvailabilityChecker::CheckBatch(&connection, &availability, 0, batch, retry) == AvailabilityChecker::bsOk);
+		CHECK(retry.empty());
+
+		CHECK((*articles)[0].checked);
+		CHECK((*articles)[0].foundLevel == 0);
+		CHECK((*articles)[1].checked);
+		CHECK((*articles)[1].foundLevel == -1);
+		CHECK((*articles)[2].checked);
+		CHECK((*articles)[2].foundLevel == -1);
+
+		// the connection can be used for the next batch, the found level is kept
+		REQUIRE(connection.SendStatRequests(messageIds));
+		CHECK(AvailabilityChecker::CheckBatch(&connection, &availability, 1, batch, retry) == AvailabilityChecker::bsOk);
+		CHECK((*articles)[0].foundLevel == 0);
+	}
+
+	SECTION("dropped connection")
+	{
+		// the connection is lost before the responses are read
+		AvailabilityChecker::Indices retry;
+		REQUIRE(connection.SendStatRequests(messageIds));
+		connection.SetSuppressErrors(true);
+		connection.Cancel();
+		CHECK(AvailabilityChecker::CheckBatch(&connection, &availability, 0, batch, retry) ==
+			AvailabilityChecker::bsConnectionError);
+		CHECK(retry == batch);
+		CHECK_FALSE((*articles)[0].checked);
+	}
+
+	connection.Disconnect();
+	server.Stop();
+	while (server.IsRunning())
+	{
+		Util::Sleep(10);
+	}
+}
+#endif
@@ -0,0 +1,88 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "nzbget.h"
+
+#include "catch.h"
+
+#include "HedgeMonitor.h"
+#include "ArticleDownloader.h"
+
+TEST_CASE("Hedge monitor: slow downloads", "[HedgeMonitor][Quick]")
+{
+	HedgeMonitor monitor;
+	monitor.SetMinBytes(1000);
+
+	ArticleInfo article1;
+	ArticleInfo article2;
+	ArticleDownloader slow;
+	ArticleDownloader fast;
+
+	// first round: nothing to compare with
+	monitor.StartRound();
+	CHECK(!monitor.Check(&slow, &article1, 0));
+	CHECK(!monitor.Check(&fast, &article2, 0));
+
+	// one slow round isn't enough
+	monitor.StartRound();
+	CHECK(!monitor.Check(&slow, &article1, 500));
+	CHECK(!monitor.Check(&fast, &article2, 5000));
+
+	// slow in two rounds in a row
+	monitor.StartRound();
+	CHECK(monitor.Check(&slow, &article1, 900));
+	CHECK(!monitor.Check(&fast, &article2, 10000));
+
+	SECTION("fast round resets")
+	{
+		monitor.StartRound();
+		CHECK(!monitor.Check(&slow, &article1, 5000));
+		monitor.StartRound();
+		CHECK(!monitor.Check(&slow, &article1, 5500));
+		monitor.StartRound();
+		CHECK(monitor.Check(&slow, &article1, 5600));
+	}
+
+	SECTION("next article")
+	{
+		// the downloader is reused for another article
+		monitor.StartRound();
+		CHECK(!monitor.Check(&slow, &article2, 0));
+		monitor.StartRound();
+		CHECK(!monitor.Check(&slow, &article2, 100));
+	}
+
+	SECTION("download not checked in a round")
+	{
+		// for example the download was hedged or has completed
+		monitor.StartRound();
+		CHECK(!monitor.Check(&fast, &article2, 20000));
+		monitor.StartRound();
+		CHECK(!monitor.Check(&slow, &article1, 950));
+	}
+
+	SECTION("cleared")
+	{
+		monitor.Clear();
+		monitor.StartRound();
+		CHECK(!monitor.Check(&slow, &article1, 950));
+	}
+}
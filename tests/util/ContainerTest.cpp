@@ -0,0 +1,83 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "nzbget.h"
+
+#include "catch.h"
+
+#include "Container.h"
+
+TEST_CASE("SpscQueue", "[Container][Quick]")
+{
+	SpscQueue<std::unique_ptr<int>, 4> queue;
+	std::unique_ptr<int> item;
+
+	REQUIRE(queue.Empty());
+	REQUIRE_FALSE(queue.Pop(item));
+
+	for (int i = 0; i < 4; i++)
+	{
+		REQUIRE(queue.Push(std::make_unique<int>(i)));
+	}
+	REQUIRE_FALSE(queue.Push(std::make_unique<int>(4)));
+
+	REQUIRE(queue.Pop(item));
+	REQUIRE(*item == 0);
+	REQUIRE(queue.Push(std::make_unique<int>(4)));
+
+	for (int i = 1; i <= 4; i++)
+	{
+		REQUIRE(queue.Pop(item));
+		REQUIRE(*item == i);
+	}
+	REQUIRE(queue.Empty());
+}
+
+TEST_CASE("SpscQueue threads", "[Container][Quick]")
+{
+	const int count = 100000;
+	SpscQueue<int, 64> queue;
+
+	std::thread producer([&]
+		{
+			for (int i = 0; i < count; i++)
+			{
+				while (!queue.Push(std::move(i)))
+				{
+					std::this_thread::yield();
+				}
+			}
+		});
+
+	int expected = 0;
+	while (expected < count)
+	{
+		int item;
+		if (queue.Pop(item))
+		{
+			REQUIRE(item == expected);
+			expected++;
+		}
+	}
+
+	producer.join();
+	REQUIRE(queue.Empty());
+}
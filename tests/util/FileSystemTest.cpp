@@ -23,6 +23,7 @@
 #include "catch.h"
 
 #include "FileSystem.h"
+#include "TestUtil.h"
 
 #ifdef WIN32
 TEST_CASE("FileSystem: MakeCanonicalPath", "[FileSystem][Quick]")
@@ -37,3 +38,62 @@ TEST_CASE("FileSystem: MakeCanonicalPath", "[FileSystem][Quick]")
 	REQUIRE(!strcmp(FileSystem::MakeCanonicalPath("\\\\server\\Program Files\\NZBGet\\scripts\\email\\..\\..\\"), "\\\\server\\Program Files\\NZBGet\\"));
 }
 #endif
+
+TEST_CASE("DiskFile: WriteAt", "[FileSystem][Quick]")
+{
+	std::string workDir = TestUtil::WorkingDir();
+	std::string filename = workDir + "/writeat.bin";
+	CString errmsg;
+	FileSystem::DeleteDirectoryWithContent(workDir.c_str(), errmsg);
+	REQUIRE(FileSystem::CreateDirectory(workDir.c_str()));
+
+	DiskFile outfile;
+	REQUIRE(outfile.Open(filename.c_str(), DiskFile::omWrite));
+	REQUIRE(outfile.Write("0123456789", 10) == 10);
+	outfile.Close();
+
+	DiskFile::WriteSegment segments[] = {{"ab", 2}, {"cde", 3}};
+	REQUIRE(outfile.Open(filename.c_str(), DiskFile::omReadWrite));
+	REQUIRE(outfile.WriteAt(2, segments, 2));
+	// file position follows the written block
+	REQUIRE(outfile.Write("X", 1) == 1);
+	outfile.Close();
+
+	char buffer[16];
+	DiskFile infile;
+	REQUIRE(infile.Open(filename.c_str(), DiskFile::omRead));
+	REQUIRE(infile.Read(buffer, sizeof(buffer)) == 10);
+	infile.Close();
+	REQUIRE(!strncmp(buffer, "01abcdeX89", 10));
+
+	FileSystem::DeleteDirectoryWithContent(workDir.c_str(), errmsg);
+}
+
+TEST_CASE("MappedFile", "[FileSystem][Quick]")
+{
+	std::string workDir = TestUtil::WorkingDir();
+	std::string filename = workDir + "/mapped.bin";
+	CString errmsg;
+	FileSystem::DeleteDirectoryWithContent(workDir.c_str(), errmsg);
+	REQUIRE(FileSystem::CreateDirectory(workDir.c_str()));
+	REQUIRE(FileSystem::AllocateFile(filename.c_str(), 100000, true, errmsg));
+
+	MappedFile mapping;
+	if (!mapping.Open(filename.c_str(), 100000))
+	{
+		WARN("File mapping is not supported");
+		return;
+	}
+	REQUIRE(mapping.GetSize() == 100000);
+	memcpy(mapping.GetData() + 99990, "0123456789", 10);
+	mapping.Close();
+	REQUIRE(mapping.GetData() == nullptr);
+
+	CharBuffer content;
+	REQUIRE(FileSystem::LoadFileIntoBuffer(filename.c_str(), content, false));
+	REQUIRE(content.Size() == 100000);
+	REQUIRE(content[0] == 0);
+	REQUIRE(!strncmp(content + 99990, "0123456789", 10));
+
+	FileSystem::DeleteDirectoryWithContent(workDir.c_str(), errmsg);
+}
@@ -0,0 +1,211 @@
+/*
+ *  This file is part of nzbget. See <http://nzbget.net>.
+ *
+ *  Copyright (C) 2019 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "nzbget.h"
+
+#include "catch.h"
+
+#include "IoUring.h"
+#include "FileSystem.h"
+#include "Util.h"
+#include "TestUtil.h"
+
+#ifndef WIN32
+
+static const int SEGMENT_SIZE = 768000;
+
+static void PrepareWorkingDir()
+{
+	CString errmsg;
+	FileSystem::DeleteDirectoryWithContent(TestUtil::WorkingDir().c_str(), errmsg);
+	REQUIRE(FileSystem::CreateDirectory(TestUtil::WorkingDir().c_str()));
+}
+
+static std::string CreateFile(const char* name, int64 size)
+{
+	std::string filename = TestUtil::WorkingDir() + "/" + name;
+	CString errmsg;
+	REQUIRE(FileSystem::AllocateFile(filename.c_str(), size, true, errmsg));
+	return filename;
+}
+
+static char* AllocBuffer(int64 size)
+{
+	char* buffer = (char*)mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+	REQUIRE(buffer != MAP_FAILED);
+	for (int64 i = 0; i < size; i++)
+	{
+		buffer[i] = (char)(i * 7 + i / 251);
+	}
+	return buffer;
+}
+
+TEST_CASE("IoUring: write", "[IoUring][Quick]")
+{
+	IoUring ioUring;
+	if (!ioUring.Init(4))
+	{
+		WARN("io_uring is not available");
+		return;
+	}
+
+	// more segments than ring entries, of different sizes, not in file order
+	const int count = 20;
+	const int64 size = (int64)SEGMENT_SIZE * count;
+	char* buffer = AllocBuffer(size);
+	ioUring.RegisterBuffer(buffer, size / 2);
+
+	PrepareWorkingDir();
+	std::string filename = CreateFile("iouring.bin", size);
+	int fd = open(filename.c_str(), O_WRONLY);
+	REQUIRE(fd > -1);
+	int directFd = -1;
+#ifdef O_DIRECT
+	directFd = open(filename.c_str(), O_WRONLY | O_DIRECT);
+#endif
+
+	{
+		IoUring::Batch batch(&ioUring);
+		for (int i = count - 1; i >= 0; i--)
+		{
+			int64 offset = (int64)SEGMENT_SIZE * i;
+			int len = i % 2 ? SEGMENT_SIZE : SEGMENT_SIZE - 1000;
+			batch.Write(i % 3 == 0 && directFd > -1 ? directFd : fd, buffer + offset, len, offset, fd);
+		}
+		REQUIRE(batch.Finish());
+	}
+
+	if (directFd > -1)
+	{
+		close(directFd);
+	}
+	close(fd);
+
+	CharBuffer content;
+	REQUIRE(FileSystem::LoadFileIntoBuffer(filename.c_str(), content, false));
+	REQUIRE(content.Size() == size);
+	for (int i = 0; i < count; i++)
+	{
+		int64 offset = (int64)SEGMENT_SIZE * i;
+		int len = i % 2 ? SEGMENT_SIZE : SEGMENT_SIZE - 1000;
+		REQUIRE(!memcmp(content + offset, buffer + offset, len));
+		if (len < SEGMENT_SIZE)
+		{
+			// the gap after a shorter segment remains empty
+			REQUIRE(content[offset + len] == 0);
+		}
+	}
+
+	munmap(buffer, size);
+	CString errmsg;
+	FileSystem::DeleteDirectoryWithContent(TestUtil::WorkingDir().c_str(), errmsg);
+}
+
+/*
+ * Compares writing of the same files via stdio with writing via io_uring. Each file
+ * gets its segments in runs of adjacent segments, same as when flushing the article cache.
+ * Not a part of regular test runs, start with: nzbget -tests "[IoUringBenchmark]"
+ */
+TEST_CASE("IoUring: benchmark", "[.][IoUringBenchmark]")
+{
+	const int files = 4;
+	const int segments = 256;
+	const int runLength = 16;
+	const int64 fileSize = (int64)SEGMENT_SIZE * segments;
+	char* buffer = AllocBuffer(fileSize);
+
+	auto run = [&](const char* title, std::function<void(const char*)> writeFile)
+	{
+		PrepareWorkingDir();
+		std::vector<std::string> filenames;
+		for (int i = 0; i < files; i++)
+		{
+			filenames.push_back(CreateFile(BString<100>("bench%i.bin", i), fileSize));
+		}
+		sync();
+
+		int64 start = Util::CurrentTicks();
+		for (std::string& filename : filenames)
+		{
+			writeFile(filename.c_str());
+		}
+		sync();
+		int64 elapsed = Util::CurrentTicks() - start;
+
+		printf("%-12s %8.1f MB/s\n", title,
+			(double)fileSize * files / 1024 / 1024 / ((double)elapsed / 1000000));
+	};
+
+	run("stdio", [&](const char* filename)
+		{
+			DiskFile outfile;
+			REQUIRE(outfile.Open(filename, DiskFile::omReadWrite));
+			for (int first = 0; first < segments; first += runLength)
+			{
+				std::vector<DiskFile::WriteSegment> run;
+				for (int i = first; i < first + runLength; i++)
+				{
+					run.push_back({buffer + (int64)SEGMENT_SIZE * i, SEGMENT_SIZE});
+				}
+				REQUIRE(outfile.WriteAt((int64)SEGMENT_SIZE * first, run.data(), runLength));
+			}
+			outfile.Close();
+		});
+
+	for (bool direct : {false, true})
+	{
+		IoUring ioUring;
+		if (!ioUring.Init(64))
+		{
+			WARN("io_uring is not available");
+			break;
+		}
+		ioUring.RegisterBuffer(buffer, fileSize);
+
+		run(direct ? "uringdirect" : "uring", [&](const char* filename)
+			{
+				int fd = open(filename, O_WRONLY);
+				REQUIRE(fd > -1);
+				int directFd = -1;
+#ifdef O_DIRECT
+				directFd = direct ? open(filename, O_WRONLY | O_DIRECT) : -1;
+#endif
+				IoUring::Batch batch(&ioUring);
+				for (int i = 0; i < segments; i++)
+				{
+					int64 offset = (int64)SEGMENT_SIZE * i;
+					batch.Write(directFd > -1 ? directFd : fd, buffer + offset, SEGMENT_SIZE, offset, fd);
+				}
+				REQUIRE(batch.Finish());
+				if (directFd > -1)
+				{
+					close(directFd);
+				}
+				close(fd);
+			});
+	}
+
+	munmap(buffer, fileSize);
+	CString errmsg;
+	FileSystem::DeleteDirectoryWithContent(TestUtil::WorkingDir().c_str(), errmsg);
+}
+
+#endif
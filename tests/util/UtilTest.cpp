@@ -118,3 +118,54 @@ TEST_CASE("Util: RegEx", "[Util][Quick]")
 	REQUIRE(seasonEpisode.GetMatchStart(1) == 14);
 	REQUIRE(seasonEpisode.GetMatchLen(1) == 2);
 }
+
+static uint32 ReferenceCrc32(const uchar* data, int len)
+{
+	uint32 crc = 0xFFFFFFFF;
+	for (int i = 0; i < len; i++)
+	{
+		crc ^= data[i];
+		for (int k = 0; k < 8; k++)
+		{
+			crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+		}
+	}
+	return ~crc;
+}
+
+TEST_CASE("Crc32", "[Util][Quick]")
+{
+	const int size = 8192;
+	std::vector<uchar> data(size + 64);
+	uint32 seed = 12345;
+	for (uchar& ch : data)
+	{
+		seed = seed * 1103515245 + 12345;
+		ch = (uchar)(seed >> 16);
+	}
+
+	// different lengths and alignments to cover short, folded and wide-folded blocks
+	for (int len : {0, 1, 15, 16, 63, 64, 100, 511, 512, 513, 1000, 4096, 4097, size})
+	{
+		for (int offset : {0, 1, 7, 16, 33})
+		{
+			uchar* block = data.data() + offset;
+			uint32 expected = ReferenceCrc32(block, len);
+
+			Crc32 crc;
+			crc.Append(block, len);
+			REQUIRE(crc.Finish() == expected);
+
+			// in portions of varying size
+			crc.Reset();
+			int pos = 0;
+			for (int portion = 1; pos < len; portion = portion * 3 + 1)
+			{
+				int plen = std::min(portion, len - pos);
+				crc.Append(block + pos, plen);
+				pos += plen;
+			}
+			REQUIRE(crc.Finish() == expected);
+		}
+	}
+}